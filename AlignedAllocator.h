@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <malloc.h>
+#endif
+
+namespace VulkanDemo
+{
+    ///
+    /// Standard allocator returning memory aligned on the given boundary. Used for arrays that are processed in
+    /// parallel, so that workers writing to different chunks never share a cache line.
+    ///
+    template<typename T, size_t Alignment = 64>
+    class AlignedAllocator
+    {
+    public:
+        typedef T value_type;
+
+        template<typename U>
+        struct rebind
+        {
+            typedef AlignedAllocator<U, Alignment> other;
+        };
+
+        AlignedAllocator() {}
+
+        template<typename U>
+        AlignedAllocator(AlignedAllocator<U, Alignment> const &) {}
+
+        T * allocate(size_t count)
+        {
+            void * memory;
+#if defined(_MSC_VER)
+            memory = _aligned_malloc(count * sizeof(T), Alignment);
+#else
+            if (posix_memalign(&memory, Alignment, count * sizeof(T)) != 0)
+            {
+                memory = nullptr;
+            }
+#endif
+            if (memory == nullptr)
+            {
+                throw std::bad_alloc();
+            }
+            return static_cast<T *>(memory);
+        }
+
+        void deallocate(T * pointer, size_t)
+        {
+#if defined(_MSC_VER)
+            _aligned_free(pointer);
+#else
+            free(pointer);
+#endif
+        }
+
+        template<typename U>
+        bool operator==(AlignedAllocator<U, Alignment> const &) const { return true; }
+
+        template<typename U>
+        bool operator!=(AlignedAllocator<U, Alignment> const &) const { return false; }
+    };
+
+    template<typename T>
+    using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+} // VulkanDemo
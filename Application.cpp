@@ -1,7 +1,15 @@
 #include "Application.h"
 
+#include <atomic>
+
+#include "Camera.h"
+#include "GameObject.h"
 #include "GraphicsHelper.h"
+#include "MeshRenderer.h"
+#include "Scene.h"
 #include "ShaderLoader.h"
+#include "SimulationLoop.h"
+#include "Transform.h"
 #include "VulkanManager.h"
 
 #include "Window.h"
@@ -56,9 +64,47 @@ namespace VulkanDemo
     {
         Window w{ 640, 480 };
 
+        Scene scene;
+        GameObject * camera = new GameObject();
+        camera->AddComponent(*new Transform());
+        Camera * cameraComponent = new Camera();
+        camera->AddComponent(*cameraComponent);
+        scene.AddGameObjects(camera, 1);
+
+        // A ring of boxes around the camera, drawn with the box of the GraphicsHelper as mesh 0.
+        const uint32_t boxCount = 16;
+        w.GetSceneRenderer().GetDrawCommandBuilder().SetMeshGeometry(0, 0, MeshGeometry{ GraphicsHelper::BoxIndexCount, 0, 0 });
+        GameObject * boxes = GameObject::CreateBatch(boxCount);
+        Transform * boxTransforms = Transform::CreateBatch(boxCount);
+        MeshRenderer * boxRenderers = MeshRenderer::CreateBatch(boxCount);
+        for (uint32_t i = 0; i < boxCount; ++i)
+        {
+            float angle = 2 * glm::pi<float>() * i / boxCount;
+            boxTransforms[i].SetLocalPosition(glm::vec3{ 10 * glm::cos(angle), 0, 10 * glm::sin(angle) });
+            boxes[i].AddComponent(boxTransforms[i]);
+            boxes[i].AddComponent(boxRenderers[i]);
+        }
+        scene.AddGameObjects(boxes, boxCount);
+
+        // The camera renders to the whole window, whose size is read on the main thread.
+        std::atomic<float> aspectRatio{ (float)w.GetWidth() / w.GetHeight() };
+
+        // The scene is only accessed by the simulation thread from here on.
+        SimulationLoop simulation{ scene, [camera, cameraComponent, &aspectRatio](Scene &, double time, float) {
+            // The camera turns slowly on itself.
+            camera->GetTransform()->SetLocalRotation(glm::angleAxis(0.1f * (float)time, glm::vec3{ 0, 1, 0 }));
+            cameraComponent->SetAspectRatio(aspectRatio);
+        } };
+        simulation.Start();
+
         while (w.Run())
         {
-            w.Render();
+            aspectRatio = (float)w.GetWidth() / w.GetHeight();
+            w.Render(simulation.AcquireFrame());
         }
+
+        simulation.Stop();
+        simulation.PrintStats();
+        w.GetSceneRenderer().PrintStats();
     }
 } // VulkanDemo
@@ -0,0 +1,2788 @@
+#include "Benchmarks.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "Application.h"
+#include "Bvh.h"
+#include "Camera.h"
+#include "Configuration.h"
+#include "DrawCommandBuilder.h"
+#include "FrustumCuller.h"
+#include "GameObject.h"
+#include "GpuCuller.h"
+#include "GraphicsHelper.h"
+#include "HzbPyramid.h"
+#include "InstanceBatcher.h"
+#include "InstancePipelineGenerator.h"
+#include "LodSelector.h"
+#include "MatrixKernels.h"
+#include "MeshRenderer.h"
+#include "NameTable.h"
+#include "OcclusionCuller.h"
+#include "PoolAllocator.h"
+#include "RenderQueue.h"
+#include "RenderSnapshot.h"
+#include "Scene.h"
+#include "SceneCommandBuffer.h"
+#include "SceneFile.h"
+#include "SceneStreamer.h"
+#include "Shared.h"
+#include "SimulationLoop.h"
+#include "ThreadPool.h"
+#include "Transform.h"
+#include "TransformStore.h"
+#include "VulkanManager.h"
+
+namespace VulkanDemo
+{
+    namespace
+    {
+        typedef std::vector<std::vector<std::string>> Table;
+
+        ///
+        /// Returns the best time, in milliseconds, out of a few runs of the function.
+        ///
+        template<typename Function>
+        double Measure(Function function, int runs = 5)
+        {
+            double best = 0;
+            for (int run = 0; run < runs; ++run)
+            {
+                auto start = std::chrono::high_resolution_clock::now();
+                function();
+                auto end = std::chrono::high_resolution_clock::now();
+
+                double elapsed = std::chrono::duration<double, std::milli>(end - start).count();
+                if (run == 0 || elapsed < best)
+                {
+                    best = elapsed;
+                }
+            }
+            return best;
+        }
+
+        std::string Format(double value)
+        {
+            std::ostringstream oss;
+            oss.precision(3);
+            oss << std::fixed << value;
+            return oss.str();
+        }
+
+        void Print(std::vector<char const *> const & headers, Table const & table)
+        {
+            PrintTable((int)headers.size(), (int)table.size(), headers.data(), [&table](int row, int col) {
+                return table[row][col].c_str();
+            });
+        }
+
+        ///
+        /// Compares the per-object heap layout that the Transform component used to have against the TransformStore.
+        ///
+        void BenchmarkTransforms()
+        {
+            struct LegacyTransform
+            {
+                glm::vec3 localPosition{ 0, 0, 0 };
+                glm::quat localRotation{ 1, 0, 0, 0 };
+                glm::vec3 localScale{ 1, 1, 1 };
+                glm::mat4 localMatrix{ 1 };
+            };
+
+            std::mt19937 random{ 42 };
+            std::uniform_real_distribution<float> distribution{ -1, 1 };
+
+            Table table;
+            for (uint32_t count : { 10000u, 100000u, 1000000u })
+            {
+                // Interleave the allocations with the ones of other objects, and visit them in a hashed order, as the
+                // scene used to.
+                std::vector<LegacyTransform *> legacy(count);
+                std::vector<char *> padding(count);
+                for (uint32_t i = 0; i < count; ++i)
+                {
+                    legacy[i] = new LegacyTransform();
+                    legacy[i]->localPosition = glm::vec3{ distribution(random), distribution(random), distribution(random) };
+                    padding[i] = new char[64 + (i % 4) * 32];
+                }
+                std::shuffle(legacy.begin(), legacy.end(), random);
+
+                TransformStore store;
+                std::vector<TransformStore::Handle> handles(count);
+                for (uint32_t i = 0; i < count; ++i)
+                {
+                    handles[i] = store.Allocate(nullptr);
+                    store.SetLocalPosition(handles[i], legacy[i]->localPosition);
+                }
+
+                double legacyTime = Measure([&legacy]() {
+                    for (LegacyTransform * transform : legacy)
+                    {
+                        glm::mat4 matrix = glm::mat4_cast(transform->localRotation);
+                        matrix[0] *= transform->localScale.x;
+                        matrix[1] *= transform->localScale.y;
+                        matrix[2] *= transform->localScale.z;
+                        matrix[3] = glm::vec4(transform->localPosition, 1);
+                        transform->localMatrix = matrix;
+                    }
+                });
+
+                double storeTime = Measure([&store]() {
+                    store.UpdateLocalMatrices();
+                });
+
+                table.push_back({ std::to_string(count), Format(legacyTime), Format(storeTime), Format(legacyTime / storeTime) });
+
+                for (uint32_t i = 0; i < count; ++i)
+                {
+                    store.Free(handles[i]);
+                    delete legacy[i];
+                    delete[] padding[i];
+                }
+            }
+
+            Print({ "Objects", "Per-object heap (ms)", "TransformStore (ms)", "Speedup" }, table);
+        }
+
+        ///
+        /// Measures the level-ordered update of the world matrices with 1 to N threads, and checks that the results
+        /// match the ones of the lazy evaluation through the chain of parents.
+        ///
+        void BenchmarkHierarchy()
+        {
+            const uint32_t count = 500000;
+            const uint32_t branching = 8;
+
+            std::mt19937 random{ 42 };
+            std::uniform_real_distribution<float> distribution{ -1, 1 };
+
+            GameObject * gameObjects = GameObject::CreateBatch(count);
+            Transform * transforms = Transform::CreateBatch(count);
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                Transform * transform = transforms + i;
+                transform->SetLocalPosition(glm::vec3{ distribution(random), distribution(random), distribution(random) });
+                transform->SetLocalRotation(glm::normalize(glm::quat{ distribution(random), distribution(random), distribution(random), distribution(random) }));
+                gameObjects[i].AddComponent(*transform);
+                if (i > 0)
+                {
+                    gameObjects[i].SetParent(&gameObjects[(i - 1) / branching]);
+                }
+            }
+
+            Scene * scene = new Scene();
+            scene->AddGameObjects(gameObjects, count);
+            TransformStore & store = scene->GetTransformStore();
+
+            // Reference: serial walk through the parents.
+            std::vector<glm::mat4> reference(count);
+            double referenceTime = Measure([&]() {
+                gameObjects[0].InvalidateWorldMatrices();
+                for (uint32_t i = 0; i < count; ++i)
+                {
+                    reference[i] = gameObjects[i].GetTransform()->GetLocalToWorldMatrix();
+                }
+            });
+
+            Table table;
+            table.push_back({ "Serial walk", Format(referenceTime), "1.000", "yes" });
+
+            uint32_t maxThreadCount = std::max(1u, std::thread::hardware_concurrency());
+            for (uint32_t threadCount = 1; threadCount <= maxThreadCount; threadCount *= 2)
+            {
+                ThreadPool threadPool{ threadCount };
+
+                double best = 0;
+                for (int run = 0; run < 5; ++run)
+                {
+                    gameObjects[0].InvalidateWorldMatrices();
+
+                    auto start = std::chrono::high_resolution_clock::now();
+                    store.UpdateWorldMatrices(threadPool);
+                    auto end = std::chrono::high_resolution_clock::now();
+
+                    double elapsed = std::chrono::duration<double, std::milli>(end - start).count();
+                    best = run == 0 ? elapsed : std::min(best, elapsed);
+                }
+
+                bool identical = true;
+                for (uint32_t i = 0; i < count && identical; ++i)
+                {
+                    Transform * transform = gameObjects[i].GetTransform();
+                    identical = memcmp(&store.GetLocalToWorldMatrix(transform->GetStoreHandle()), &reference[i], sizeof(glm::mat4)) == 0;
+                }
+
+                table.push_back({ std::to_string(threadCount) + " thread(s)", Format(best), Format(referenceTime / best), identical ? "yes" : "NO" });
+
+                if (threadCount < maxThreadCount && threadCount * 2 > maxThreadCount)
+                {
+                    threadCount = maxThreadCount / 2;
+                }
+            }
+
+            std::cout << count << " nodes, branching factor " << branching << std::endl;
+            Print({ "Update", "Time (ms)", "Speedup", "Bit-identical" }, table);
+
+            scene->RemoveGameObjects(gameObjects, count);
+            delete scene;
+            GameObject::DestroyBatch(gameObjects, count);
+        }
+
+        ///
+        /// Measures the throughput of the matrix kernels for every instruction set supported by the CPU.
+        ///
+        void BenchmarkMatrixKernels()
+        {
+            const uint32_t count = 1000000;
+
+            std::mt19937 random{ 42 };
+            std::uniform_real_distribution<float> distribution{ -1, 1 };
+
+            std::vector<glm::vec3> positions(count);
+            std::vector<glm::quat> rotations(count);
+            std::vector<glm::vec3> scales(count);
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                positions[i] = glm::vec3{ distribution(random), distribution(random), distribution(random) };
+                rotations[i] = glm::normalize(glm::quat{ distribution(random), distribution(random), distribution(random), distribution(random) });
+                scales[i] = glm::vec3{ 1 + distribution(random), 1 + distribution(random), 1 + distribution(random) };
+            }
+
+            std::vector<glm::mat4> composed(count);
+            std::vector<glm::mat4> multiplied(count);
+            std::vector<glm::mat4> referenceComposed;
+            std::vector<glm::mat4> referenceMultiplied;
+
+            MatrixKernels::Isa supportedIsa = MatrixKernels::GetSupportedIsa();
+
+            Table table;
+            for (MatrixKernels::Isa isa : { MatrixKernels::Isa::Scalar, MatrixKernels::Isa::Sse, MatrixKernels::Isa::Avx2 })
+            {
+                if (isa > supportedIsa)
+                {
+                    continue;
+                }
+                MatrixKernels::SetIsa(isa);
+
+                double composeTime = Measure([&]() {
+                    MatrixKernels::ComposeTrs(count, positions.data(), rotations.data(), scales.data(), composed.data());
+                });
+
+                // Multiply every matrix by the previous one, as a parent/local pair.
+                double multiplyTime = Measure([&]() {
+                    MatrixKernels::Multiply(count - 1, composed.data(), composed.data() + 1, multiplied.data());
+                });
+
+                if (isa == MatrixKernels::Isa::Scalar)
+                {
+                    referenceComposed = composed;
+                    referenceMultiplied = multiplied;
+                }
+                bool identical =
+                    memcmp(composed.data(), referenceComposed.data(), count * sizeof(glm::mat4)) == 0 &&
+                    memcmp(multiplied.data(), referenceMultiplied.data(), (count - 1) * sizeof(glm::mat4)) == 0;
+
+                table.push_back({
+                    MatrixKernels::GetIsaName(isa),
+                    Format(count / composeTime / 1000.0),
+                    Format((count - 1) / multiplyTime / 1000.0),
+                    identical ? "yes" : "NO" });
+            }
+            MatrixKernels::SetIsa(supportedIsa);
+
+            Print({ "ISA", "TRS compose (M matrices/s)", "Multiply (M matrices/s)", "Matches scalar" }, table);
+        }
+
+        ///
+        /// Spawns and despawns batches of objects with a transform and a camera, through the pools and through the
+        /// default heap, then reports the statistics of every pool.
+        ///
+        void BenchmarkPools()
+        {
+            const uint32_t frameCount = 100;
+            const uint32_t objectsPerFrame = 10000;
+
+            // Reference: the same allocations through the default heap, with objects of the same sizes.
+            struct HeapGameObject { uint8_t data[sizeof(GameObject)]; };
+            struct HeapTransform { uint8_t data[sizeof(Transform)]; };
+            struct HeapCamera { uint8_t data[sizeof(Camera)]; };
+
+            std::vector<HeapGameObject *> heapGameObjects(objectsPerFrame);
+            std::vector<HeapTransform *> heapTransforms(objectsPerFrame);
+            std::vector<HeapCamera *> heapCameras(objectsPerFrame);
+            double heapTime = Measure([&]() {
+                for (uint32_t frame = 0; frame < frameCount; ++frame)
+                {
+                    for (uint32_t i = 0; i < objectsPerFrame; ++i)
+                    {
+                        heapGameObjects[i] = new HeapGameObject;
+                        heapTransforms[i] = new HeapTransform;
+                        heapCameras[i] = new HeapCamera;
+                    }
+                    for (uint32_t i = 0; i < objectsPerFrame; ++i)
+                    {
+                        delete heapCameras[i];
+                        delete heapTransforms[i];
+                        delete heapGameObjects[i];
+                    }
+                }
+            });
+
+            PoolAllocator & gameObjectPool = GameObject::GetPool();
+            PoolAllocator & transformPool = Transform::GetPool();
+            PoolAllocator & cameraPool = Camera::GetPool();
+            std::vector<void *> slots(3 * objectsPerFrame);
+            double poolTime = Measure([&]() {
+                for (uint32_t frame = 0; frame < frameCount; ++frame)
+                {
+                    for (uint32_t i = 0; i < objectsPerFrame; ++i)
+                    {
+                        slots[3 * i + 0] = gameObjectPool.Allocate();
+                        slots[3 * i + 1] = transformPool.Allocate();
+                        slots[3 * i + 2] = cameraPool.Allocate();
+                    }
+                    for (uint32_t i = 0; i < objectsPerFrame; ++i)
+                    {
+                        cameraPool.Free(slots[3 * i + 2]);
+                        transformPool.Free(slots[3 * i + 1]);
+                        gameObjectPool.Free(slots[3 * i + 0]);
+                    }
+                }
+            });
+
+            // Complete objects, spawned in batches into a scene and destroyed with it.
+            double sceneTime = Measure([&]() {
+                for (uint32_t frame = 0; frame < frameCount / 10; ++frame)
+                {
+                    GameObject * gameObjects = GameObject::CreateBatch(objectsPerFrame);
+                    Transform * transforms = Transform::CreateBatch(objectsPerFrame);
+                    Camera * cameras = Camera::CreateBatch(objectsPerFrame);
+                    for (uint32_t i = 0; i < objectsPerFrame; ++i)
+                    {
+                        gameObjects[i].AddComponent(transforms[i]);
+                        gameObjects[i].AddComponent(cameras[i]);
+                    }
+
+                    Scene * scene = new Scene();
+                    scene->AddGameObjects(gameObjects, objectsPerFrame);
+                    delete scene;
+                }
+            }, 1);
+
+            std::cout << frameCount << " frames of " << objectsPerFrame << " GameObject/Transform/Camera allocations" << std::endl;
+            Print({ "Allocator", "Time (ms)", "Speedup" }, {
+                { "Default heap", Format(heapTime), "1.000" },
+                { "Pools", Format(poolTime), Format(heapTime / poolTime) },
+            });
+
+            std::cout << std::endl << frameCount / 10 << " scenes of " << objectsPerFrame << " complete objects: " << Format(sceneTime) << " ms" << std::endl;
+
+            Table table;
+            PoolAllocator::ForEachPool([&table](PoolAllocator const & pool) {
+                PoolAllocator::Stats stats = pool.GetStats();
+                table.push_back({
+                    pool.GetName(),
+                    std::to_string(pool.GetSlotSize()),
+                    std::to_string(stats.liveObjects),
+                    std::to_string(stats.liveBytes),
+                    std::to_string(stats.peakLiveObjects),
+                    std::to_string(stats.peakLiveBytes),
+                    std::to_string(stats.reservedBytes),
+                    std::to_string(stats.blockCount) });
+            });
+            Print({ "Pool", "Slot size", "Live objects", "Live bytes", "Peak objects", "Peak bytes", "Reserved bytes", "Blocks" }, table);
+        }
+
+        ///
+        /// Finds the objects having both a Transform and a Camera by scanning the components of every object with
+        /// dynamic_cast, and with a scene query.
+        ///
+        void BenchmarkComponentQueries()
+        {
+            const uint32_t count = 200000;
+            const uint32_t cameraInterval = 16;
+
+            GameObject * gameObjects = GameObject::CreateBatch(count);
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                gameObjects[i].AddComponent(*new Transform());
+                if (i % cameraInterval == 0)
+                {
+                    gameObjects[i].AddComponent(*new Camera());
+                }
+            }
+
+            Scene * scene = new Scene();
+            scene->AddGameObjects(gameObjects, count);
+
+            float scanSum = 0;
+            double scanTime = Measure([&]() {
+                scanSum = 0;
+                for (auto gameObject : scene->GetAllGameObjects())
+                {
+                    Transform * transform = nullptr;
+                    Camera * camera = nullptr;
+                    for (auto component : gameObject->GetComponents())
+                    {
+                        if (transform == nullptr)
+                        {
+                            transform = dynamic_cast<Transform *>(component);
+                        }
+                        if (camera == nullptr)
+                        {
+                            camera = dynamic_cast<Camera *>(component);
+                        }
+                    }
+                    if (transform != nullptr && camera != nullptr)
+                    {
+                        scanSum += camera->GetNear() + transform->GetLocalScale().x;
+                    }
+                }
+            });
+
+            float querySum = 0;
+            double queryTime = Measure([&]() {
+                querySum = 0;
+                for (auto & match : scene->Query<Transform, Camera>())
+                {
+                    querySum += match.Get<Camera>().GetNear() + match.Get<Transform>().GetLocalScale().x;
+                }
+            });
+
+            std::cout << count << " objects, 1 in " << cameraInterval << " with a camera" << std::endl;
+            Print({ "Lookup", "Time (ms)", "Speedup", "Same result" }, {
+                { "dynamic_cast scan", Format(scanTime), "1.000", "yes" },
+                { "Query<Transform, Camera>", Format(queryTime), Format(scanTime / queryTime), scanSum == querySum ? "yes" : "NO" },
+            });
+
+            delete scene;
+        }
+
+        ///
+        /// Measures the edits of wide and deep hierarchies: attaching, reparenting and detaching children, and tearing
+        /// the trees down object by object or with GameObject::DestroyHierarchy().
+        ///
+        void BenchmarkHierarchyEdits()
+        {
+            const uint32_t wideCount = 100000;
+            const uint32_t deepCount = 10000;
+
+            auto createObjects = [](uint32_t count) {
+                std::vector<GameObject *> gameObjects(count);
+                for (auto & gameObject : gameObjects)
+                {
+                    gameObject = new GameObject();
+                    gameObject->AddComponent(*new Transform());
+                }
+                return gameObjects;
+            };
+
+            auto timeOnce = [](std::function<void()> const & function) {
+                return Measure(function, 1);
+            };
+
+            std::mt19937 random{ 42 };
+            Table table;
+
+            // Wide tree: one root with all the other objects as children.
+            {
+                std::vector<GameObject *> gameObjects = createObjects(wideCount + 2);
+                GameObject * root = gameObjects[0];
+                GameObject * otherRoot = gameObjects[1];
+                std::vector<GameObject *> children(gameObjects.begin() + 2, gameObjects.end());
+
+                double attachTime = timeOnce([&]() {
+                    for (auto child : children)
+                    {
+                        child->SetParent(root);
+                    }
+                });
+                double reparentTime = timeOnce([&]() {
+                    for (auto child : children)
+                    {
+                        child->SetParent(otherRoot);
+                    }
+                });
+
+                std::vector<GameObject *> shuffled = children;
+                std::shuffle(shuffled.begin(), shuffled.end(), random);
+                double detachTime = timeOnce([&]() {
+                    for (auto child : shuffled)
+                    {
+                        child->SetParent(nullptr);
+                    }
+                });
+
+                table.push_back({ "Wide: attach", std::to_string(wideCount), Format(attachTime), Format(attachTime * 1e6 / wideCount) });
+                table.push_back({ "Wide: reparent", std::to_string(wideCount), Format(reparentTime), Format(reparentTime * 1e6 / wideCount) });
+                table.push_back({ "Wide: detach (random order)", std::to_string(wideCount), Format(detachTime), Format(detachTime * 1e6 / wideCount) });
+
+                for (auto child : children)
+                {
+                    child->SetParent(root);
+                }
+                double deleteTime = timeOnce([&]() {
+                    std::shuffle(shuffled.begin(), shuffled.end(), random);
+                    for (auto child : shuffled)
+                    {
+                        delete child;
+                    }
+                });
+                table.push_back({ "Wide: delete children one by one", std::to_string(wideCount), Format(deleteTime), Format(deleteTime * 1e6 / wideCount) });
+
+                children = createObjects(wideCount);
+                for (auto child : children)
+                {
+                    child->SetParent(root);
+                }
+                double destroyTime = timeOnce([&]() {
+                    GameObject::DestroyHierarchy(root);
+                });
+                table.push_back({ "Wide: DestroyHierarchy", std::to_string(wideCount + 1), Format(destroyTime), Format(destroyTime * 1e6 / (wideCount + 1)) });
+
+                delete otherRoot;
+            }
+
+            // Deep tree: a single chain.
+            {
+                std::vector<GameObject *> gameObjects = createObjects(deepCount);
+                for (uint32_t i = 1; i < deepCount; ++i)
+                {
+                    gameObjects[i]->SetParent(gameObjects[i - 1]);
+                }
+                double deleteTime = timeOnce([&]() {
+                    for (auto gameObject : gameObjects)
+                    {
+                        delete gameObject;
+                    }
+                });
+                table.push_back({ "Deep: delete from the root", std::to_string(deepCount), Format(deleteTime), Format(deleteTime * 1e6 / deepCount) });
+
+                gameObjects = createObjects(deepCount);
+                for (uint32_t i = 1; i < deepCount; ++i)
+                {
+                    gameObjects[i]->SetParent(gameObjects[i - 1]);
+                }
+                double destroyTime = timeOnce([&]() {
+                    GameObject::DestroyHierarchy(gameObjects[0]);
+                });
+                table.push_back({ "Deep: DestroyHierarchy", std::to_string(deepCount), Format(destroyTime), Format(destroyTime * 1e6 / deepCount) });
+            }
+
+            Print({ "Operation", "Objects", "Time (ms)", "Per object (ns)" }, table);
+        }
+
+        ///
+        /// Compares the ancestry tests through the chain of parents and through the hierarchy index of the scene, on a
+        /// random tree and on a deep chain with a small branch at every link, both for queries and for the cycle checks
+        /// of consecutive reparents.
+        ///
+        void BenchmarkHierarchyIndex()
+        {
+            const uint32_t queryCount = 1000000;
+            const uint32_t moveCount = 10000;
+
+            Table table;
+            auto run = [&table, queryCount, moveCount](char const * name, uint32_t count, bool isChain) {
+                std::mt19937 random{ 42 };
+
+                // The links of the chain are the multiples of 3, and each has a branch of two objects.
+                GameObject * gameObjects = GameObject::CreateBatch(count);
+                for (uint32_t i = 1; i < count; ++i)
+                {
+                    gameObjects[i].SetParent(&gameObjects[isChain ? (i % 3 == 0 ? i - 3 : i - 1) : random() % i]);
+                }
+
+                // In the random tree, every object is moved under an object of lower index, which keeps the parents
+                // before their children. In the chain, the branches are moved between the links. No move makes a
+                // cycle, but the checks of SetParent() still test it.
+                auto reparent = [&]() {
+                    std::vector<std::pair<uint32_t, uint32_t>> moves(moveCount);
+                    for (auto & move : moves)
+                    {
+                        if (isChain)
+                        {
+                            move = std::make_pair(3 * (uint32_t)(random() % (count / 3)) + 1, 3 * (uint32_t)(random() % (count / 3)));
+                        }
+                        else
+                        {
+                            uint32_t child = 1 + random() % (count - 1);
+                            move = std::make_pair(child, (uint32_t)(random() % child));
+                        }
+                    }
+                    return Measure([&]() {
+                        for (auto const & move : moves)
+                        {
+                            gameObjects[move.first].SetParent(&gameObjects[move.second]);
+                        }
+                    }, 1);
+                };
+
+                // Outside of a scene, the cycle checks walk the chains of parents.
+                double walkMoveTime = reparent();
+
+                Scene * scene = new Scene();
+                scene->AddGameObjects(gameObjects, count);
+                scene->GetHierarchyIndex();
+                double indexMoveTime = reparent();
+
+                std::vector<std::pair<uint32_t, uint32_t>> queries(queryCount);
+                for (auto & query : queries)
+                {
+                    query = std::make_pair((uint32_t)(random() % count), (uint32_t)(random() % count));
+                }
+
+                auto walk = [](GameObject const & descendant, GameObject const & ancestor) {
+                    GameObject const * toTest = descendant.GetParent();
+                    while (toTest != nullptr && toTest != &ancestor)
+                    {
+                        toTest = toTest->GetParent();
+                    }
+                    return toTest != nullptr;
+                };
+                uint32_t walkResult = 0;
+                double walkTime = Measure([&]() {
+                    walkResult = 0;
+                    for (auto const & query : queries)
+                    {
+                        walkResult += walk(gameObjects[query.first], gameObjects[query.second]) ? 1 : 0;
+                    }
+                }, 1);
+
+                double buildTime = Measure([&]() {
+                    scene->GetHierarchyIndex();
+                    scene->MarkHierarchyChanged();
+                });
+                scene->GetHierarchyIndex();
+
+                uint32_t indexResult = 0;
+                double indexTime = Measure([&]() {
+                    indexResult = 0;
+                    for (auto const & query : queries)
+                    {
+                        indexResult += gameObjects[query.first].IsDescendantOf(gameObjects[query.second]) ? 1 : 0;
+                    }
+                });
+
+                // Linear sweep over the whole tree.
+                size_t subtreeSize = 0;
+                double sweepTime = Measure([&]() {
+                    subtreeSize = 0;
+                    for (auto gameObject : scene->GetSubtree(gameObjects[0]))
+                    {
+                        subtreeSize += gameObject->GetChildCount();
+                    }
+                });
+
+                table.push_back({
+                    name,
+                    std::to_string(count),
+                    Format(walkTime),
+                    Format(indexTime),
+                    Format(walkTime / indexTime),
+                    walkResult == indexResult && subtreeSize == count - 1 ? "yes" : "NO",
+                    Format(buildTime),
+                    Format(sweepTime),
+                    Format(walkMoveTime),
+                    Format(indexMoveTime) });
+
+                delete scene;
+            };
+
+            run("Random tree", 1000000, false);
+            run("Chain", 3000, true);
+
+            std::cout << queryCount << " IsDescendantOf queries, and " << moveCount << " consecutive SetParent calls" << std::endl;
+            Print({ "Hierarchy", "Objects", "Walk (ms)", "Index (ms)", "Speedup", "Same results", "Index build (ms)",
+                "Subtree sweep (ms)", "Moves, walk (ms)", "Moves, index (ms)" }, table);
+        }
+
+        ///
+        /// Compares finding objects by name with a scan of the scene and with the name index, and reports the memory
+        /// used by the names.
+        ///
+        void BenchmarkNames()
+        {
+            const uint32_t count = 100000;
+            const uint32_t lookupCount = 1000;
+
+            GameObject * gameObjects = GameObject::CreateBatch(count);
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                gameObjects[i].SetName("Enemy_" + std::to_string(i));
+            }
+
+            Scene * scene = new Scene();
+            scene->AddGameObjects(gameObjects, count);
+
+            std::mt19937 random{ 42 };
+            std::vector<std::string> names(lookupCount);
+            for (auto & name : names)
+            {
+                name = "Enemy_" + std::to_string(random() % count);
+            }
+
+            uint32_t scanFound = 0;
+            double scanTime = Measure([&]() {
+                scanFound = 0;
+                for (auto const & name : names)
+                {
+                    for (auto gameObject : scene->GetAllGameObjects())
+                    {
+                        if (strcmp(gameObject->GetName(), name.c_str()) == 0)
+                        {
+                            ++scanFound;
+                            break;
+                        }
+                    }
+                }
+            }, 1);
+
+            uint32_t indexFound = 0;
+            double indexTime = Measure([&]() {
+                indexFound = 0;
+                for (auto const & name : names)
+                {
+                    indexFound += scene->FindGameObject(name.c_str()) != nullptr ? 1 : 0;
+                }
+            });
+
+            std::cout << lookupCount << " lookups among " << count << " objects" << std::endl;
+            Print({ "Lookup", "Time (ms)", "Speedup", "Found" }, {
+                { "Scan with strcmp", Format(scanTime), "1.000", std::to_string(scanFound) },
+                { "Name index", Format(indexTime), Format(scanTime / indexTime), std::to_string(indexFound) },
+            });
+
+            NameTable & nameTable = NameTable::GetInstance();
+            std::cout << std::endl;
+            Print({ "Memory", "Bytes" }, {
+                { "Name per object, std::string (before)", std::to_string(sizeof(std::string)) },
+                { "Name per object, NameId", std::to_string(sizeof(NameId)) },
+                { "GameObject", std::to_string(sizeof(GameObject)) },
+                { "Interned names", std::to_string(nameTable.GetCount()) },
+                { "Name arena", std::to_string(nameTable.GetArenaSize()) },
+            });
+
+            delete scene;
+        }
+
+        ///
+        /// Spawns objects with a transform under existing parents, directly on the main thread, and through a command
+        /// buffer recorded by the threads of the default pool and played back at once.
+        ///
+        void BenchmarkCommandBuffer()
+        {
+            const uint32_t parentCount = 1000;
+            const uint32_t count = 200000;
+
+            auto createScene = [parentCount]() {
+                Scene * scene = new Scene();
+                GameObject * parents = GameObject::CreateBatch(parentCount);
+                scene->AddGameObjects(parents, parentCount);
+                return std::make_pair(scene, parents);
+            };
+
+            auto position = [](uint32_t i) { return glm::vec3{ (float)(i % 100), (float)(i / 100 % 100), (float)(i / 10000) }; };
+
+            // Direct changes, one object at a time.
+            auto direct = createScene();
+            double directTime = Measure([&]() {
+                for (uint32_t i = 0; i < count; ++i)
+                {
+                    GameObject * gameObject = new GameObject();
+                    direct.first->AddGameObjects(gameObject, 1);
+                    Transform * transform = new Transform();
+                    transform->SetLocalPosition(position(i));
+                    gameObject->AddComponent(*transform);
+                    gameObject->SetParent(&direct.second[i % parentCount]);
+                }
+            }, 1);
+
+            // Recorded in parallel, then played back.
+            ThreadPool & threadPool = ThreadPool::GetDefault();
+            auto deferred = createScene();
+            SceneCommandBuffer commandBuffer;
+            double recordTime = Measure([&]() {
+                threadPool.ParallelFor(count, 1024, [&](uint32_t begin, uint32_t end) {
+                    for (uint32_t i = begin; i < end; ++i)
+                    {
+                        GameObject * gameObject = commandBuffer.CreateGameObject();
+                        glm::vec3 localPosition = position(i);
+                        commandBuffer.AddComponent<Transform>(gameObject, [localPosition](Transform & transform) {
+                            transform.SetLocalPosition(localPosition);
+                        });
+                        commandBuffer.SetParent(gameObject, &deferred.second[i % parentCount]);
+                    }
+                });
+            }, 1);
+            size_t commandCount = commandBuffer.GetCommandCount();
+            double playbackTime = Measure([&]() {
+                commandBuffer.Playback(*deferred.first);
+            }, 1);
+
+            bool identical =
+                direct.first->GetAllGameObjects().size() == deferred.first->GetAllGameObjects().size() &&
+                direct.first->GetTransformStore().GetCount() == deferred.first->GetTransformStore().GetCount();
+
+            std::cout << count << " objects spawned, " << threadPool.GetThreadCount() << " recording thread(s), " << commandCount << " commands" << std::endl;
+            Print({ "Path", "Record (ms)", "Apply (ms)", "Same scene" }, {
+                { "Direct", "-", Format(directTime), "yes" },
+                { "Command buffer", Format(recordTime), Format(playbackTime), identical ? "yes" : "NO" },
+            });
+
+            delete direct.first;
+            delete deferred.first;
+        }
+
+        ///
+        /// Compares loading a scene file through the memory mapping and the bulk path against reading it and creating
+        /// the objects one by one with the public API.
+        ///
+        void BenchmarkSceneLoad()
+        {
+            const uint32_t count = 1000000;
+            char const * path = "benchmark.vdscene";
+
+            // Random tree with names, transforms, and a few cameras.
+            {
+                std::mt19937 random{ 42 };
+                std::uniform_real_distribution<float> distribution{ -10.0f, 10.0f };
+
+                GameObject * gameObjects = GameObject::CreateBatch(count);
+                Transform * transforms = Transform::CreateBatch(count);
+                for (uint32_t i = 0; i < count; ++i)
+                {
+                    gameObjects[i].SetName("Node" + std::to_string(i % 10000));
+                    transforms[i].SetLocalPosition(glm::vec3{ distribution(random), distribution(random), distribution(random) });
+                    transforms[i].SetLocalRotation(glm::angleAxis(distribution(random), glm::vec3{ 0, 1, 0 }));
+                    gameObjects[i].AddComponent(transforms[i]);
+                    if (i % 1000 == 0)
+                    {
+                        gameObjects[i].AddComponent(*new Camera());
+                    }
+                    if (i > 0)
+                    {
+                        gameObjects[i].SetParent(&gameObjects[random() % i]);
+                    }
+                }
+
+                Scene source;
+                source.AddGameObjects(gameObjects, count);
+                if (!SceneFile::Save(source, path))
+                {
+                    std::cout << "Failed to write " << path << std::endl;
+                    return;
+                }
+            }
+
+            // Naive path: read the whole file, then create every object and component separately.
+            Scene * naiveScene = new Scene();
+            double naiveTime = Measure([&]() {
+                std::ifstream file;
+                file.open(path, std::ios::in | std::ios::binary);
+                std::vector<char> content{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+
+                auto header = reinterpret_cast<SceneFile::Header const *>(content.data());
+                auto table = [&](SceneFile::Table table) { return content.data() + header->tables[table].offset; };
+                auto parents = reinterpret_cast<uint32_t const *>(table(SceneFile::Parents));
+                auto names = reinterpret_cast<SceneFile::NameRecord const *>(table(SceneFile::Names));
+                auto masks = reinterpret_cast<uint32_t const *>(table(SceneFile::ComponentMasks));
+                auto positions = reinterpret_cast<glm::vec3 const *>(table(SceneFile::LocalPositions));
+                auto rotations = reinterpret_cast<glm::quat const *>(table(SceneFile::LocalRotations));
+                auto scales = reinterpret_cast<glm::vec3 const *>(table(SceneFile::LocalScales));
+                auto cameras = reinterpret_cast<SceneFile::CameraRecord const *>(table(SceneFile::Cameras));
+                char const * strings = table(SceneFile::Strings);
+
+                std::vector<GameObject *> created(header->objectCount);
+                uint32_t transformIndex = 0;
+                uint32_t cameraIndex = 0;
+                for (uint32_t i = 0; i < header->objectCount; ++i)
+                {
+                    GameObject * gameObject = new GameObject();
+                    gameObject->SetName(std::string{ strings + names[i].offset, names[i].length });
+                    naiveScene->AddGameObjects(gameObject, 1);
+                    if ((masks[i] & ComponentType::GetMask(ComponentType::Transform)) != 0)
+                    {
+                        Transform * transform = new Transform();
+                        transform->SetLocalPosition(positions[transformIndex]);
+                        transform->SetLocalRotation(rotations[transformIndex]);
+                        transform->SetLocalScale(scales[transformIndex]);
+                        ++transformIndex;
+                        gameObject->AddComponent(*transform);
+                    }
+                    if ((masks[i] & ComponentType::GetMask(ComponentType::Camera)) != 0)
+                    {
+                        Camera * camera = new Camera();
+                        camera->SetNear(cameras[cameraIndex].nearPlane);
+                        camera->SetFar(cameras[cameraIndex].farPlane);
+                        camera->SetVerticalFieldOfView(cameras[cameraIndex].verticalFieldOfView);
+                        ++cameraIndex;
+                        gameObject->AddComponent(*camera);
+                    }
+                    if (parents[i] != SceneFile::NoParent)
+                    {
+                        gameObject->SetParent(created[parents[i]]);
+                    }
+                    created[i] = gameObject;
+                }
+            }, 1);
+
+            Scene * mappedScene = new Scene();
+            bool isLoaded = false;
+            double mappedTime = Measure([&]() { isLoaded = SceneFile::Load(path, *mappedScene); }, 1);
+
+            // Both scenes must produce the same world matrices.
+            auto checksum = [](Scene & scene) {
+                scene.UpdateWorldMatrices();
+                TransformStore const & store = scene.GetTransformStore();
+                double sum = 0;
+                for (uint32_t i = 0; i < store.GetCount(); ++i)
+                {
+                    sum += store.GetLocalToWorldMatrices()[i][3][0] + store.GetLocalToWorldMatrices()[i][3][1] + store.GetLocalToWorldMatrices()[i][3][2];
+                }
+                return sum;
+            };
+            bool identical = isLoaded &&
+                naiveScene->GetAllGameObjects().size() == mappedScene->GetAllGameObjects().size() &&
+                naiveScene->GetComponentsOfType(ComponentType::Camera).size() == mappedScene->GetComponentsOfType(ComponentType::Camera).size() &&
+                checksum(*naiveScene) == checksum(*mappedScene);
+
+            std::cout << count << " objects" << std::endl;
+            Print({ "Path", "Load (ms)", "Speedup", "Same scene" }, {
+                { "Read + per-object construction", Format(naiveTime), "1.000", "yes" },
+                { "Mapped + bulk", Format(mappedTime), Format(naiveTime / mappedTime), identical ? "yes" : "NO" },
+            });
+
+            delete naiveScene;
+            delete mappedScene;
+            remove(path);
+        }
+
+        ///
+        /// Moves a camera across a grid of chunks streamed in and out of a scene, and compares the frame times with a
+        /// blocking load of the chunks around the starting point.
+        ///
+        void BenchmarkStreaming()
+        {
+            const uint32_t gridSize = 6;
+            const uint32_t objectsPerChunk = 4000;
+            const float chunkSize = 64;
+            const uint32_t frameCount = 400;
+            const double frameBudget = 2;
+
+            // Every chunk is a set of small hierarchies spread over its area.
+            std::vector<std::string> paths;
+            {
+                std::mt19937 random{ 42 };
+                std::uniform_real_distribution<float> distribution{ 0, chunkSize };
+                for (uint32_t i = 0; i < gridSize * gridSize; ++i)
+                {
+                    glm::vec3 origin{ (i % gridSize) * chunkSize, 0, (i / gridSize) * chunkSize };
+                    GameObject * gameObjects = GameObject::CreateBatch(objectsPerChunk);
+                    Transform * transforms = Transform::CreateBatch(objectsPerChunk);
+                    for (uint32_t j = 0; j < objectsPerChunk; ++j)
+                    {
+                        bool isRoot = j % 8 == 0;
+                        glm::vec3 offset{ distribution(random), 0, distribution(random) };
+                        transforms[j].SetLocalPosition(isRoot ? origin + offset : offset * 0.01f);
+                        gameObjects[j].AddComponent(transforms[j]);
+                        if (!isRoot)
+                        {
+                            gameObjects[j].SetParent(&gameObjects[j - j % 8]);
+                        }
+                    }
+
+                    Scene chunk;
+                    chunk.AddGameObjects(gameObjects, objectsPerChunk);
+                    paths.push_back("benchmark-chunk-" + std::to_string(i) + ".vdscene");
+                    SceneFile::Save(chunk, paths.back().c_str());
+                }
+            }
+
+            auto createCamera = [](Scene & scene) {
+                GameObject * gameObject = new GameObject();
+                gameObject->AddComponent(*new Transform());
+                Camera * camera = new Camera();
+                gameObject->AddComponent(*camera);
+                scene.AddGameObjects(gameObject, 1);
+                return camera;
+            };
+            auto cameraPosition = [=](uint32_t frame) {
+                return glm::vec3{ chunkSize * gridSize * frame / frameCount, 0, chunkSize * gridSize / 2 };
+            };
+            const float loadRadius = 1.5f * chunkSize;
+            const float chunkRadius = chunkSize * 0.7072f;
+
+            // Blocking load of the chunks in range of the starting point.
+            double blockingTime;
+            uint32_t blockingChunkCount = 0;
+            {
+                Scene scene;
+                blockingTime = Measure([&]() {
+                    for (uint32_t i = 0; i < paths.size(); ++i)
+                    {
+                        glm::vec3 center{ (i % gridSize + 0.5f) * chunkSize, 0, (i / gridSize + 0.5f) * chunkSize };
+                        if (glm::length(center - cameraPosition(0)) - chunkRadius <= loadRadius)
+                        {
+                            SceneFile::Load(paths[i].c_str(), scene);
+                            ++blockingChunkCount;
+                        }
+                    }
+                }, 1);
+            }
+
+            // Streamed while the camera moves, with some idle time per frame standing for the rest of the frame.
+            Scene * scene = new Scene();
+            Camera * camera = createCamera(*scene);
+            double worstFrameTime = 0;
+            uint32_t frameIndex = 0;
+            {
+                SceneStreamer streamer{ *scene };
+                streamer.SetCamera(camera);
+                streamer.SetRadii(loadRadius, 2 * chunkSize);
+                streamer.SetFrameBudget(frameBudget);
+                for (uint32_t i = 0; i < paths.size(); ++i)
+                {
+                    streamer.AddChunk(paths[i], glm::vec3{ (i % gridSize + 0.5f) * chunkSize, 0, (i / gridSize + 0.5f) * chunkSize }, chunkRadius);
+                }
+
+                for (; frameIndex < frameCount || streamer.IsBusy(); ++frameIndex)
+                {
+                    camera->GetGameObject()->GetTransform()->SetLocalPosition(cameraPosition(std::min(frameIndex, frameCount)));
+
+                    auto start = std::chrono::high_resolution_clock::now();
+                    streamer.Update();
+                    scene->UpdateWorldMatrices();
+                    auto end = std::chrono::high_resolution_clock::now();
+                    worstFrameTime = std::max(worstFrameTime, std::chrono::duration<double, std::milli>(end - start).count());
+
+                    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                }
+
+                streamer.PrintStats();
+            }
+
+            std::cout << gridSize * gridSize << " chunks of " << objectsPerChunk << " objects, " << frameIndex << " frames" << std::endl;
+            Print({ "Path", "Chunks", "Worst frame (ms)" }, {
+                { "Blocking load at start", std::to_string(blockingChunkCount), Format(blockingTime) },
+                { "Streaming (update + world matrices)", "all", Format(worstFrameTime) },
+            });
+
+            delete scene;
+            for (auto const & path : paths)
+            {
+                remove(path.c_str());
+            }
+        }
+
+        ///
+        /// Measures the extraction of render snapshots, and compares simulating and rendering in sequence against
+        /// simulating frame N + 1 while frame N is rendered from a snapshot on another thread.
+        ///
+        void BenchmarkRenderSnapshot()
+        {
+            const uint32_t rootCount = 20000;
+            const uint32_t childrenPerRoot = 9;
+            const uint32_t count = rootCount * (childrenPerRoot + 1);
+            const uint32_t frameCount = 60;
+
+            Scene scene;
+            GameObject * gameObjects = GameObject::CreateBatch(count);
+            Transform * transforms = Transform::CreateBatch(count);
+            MeshRenderer * renderers = MeshRenderer::CreateBatch(count);
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                uint32_t root = i - i % (childrenPerRoot + 1);
+                transforms[i].SetLocalPosition(i == root ? glm::vec3{ (float)(i % 1000), 0, (float)(i / 1000) } : glm::vec3{ 0, (float)(i - root), 0 });
+                gameObjects[i].AddComponent(transforms[i]);
+                renderers[i].SetMeshId(i % 16);
+                renderers[i].SetMaterialId(i % 4);
+                gameObjects[i].AddComponent(renderers[i]);
+                if (i != root)
+                {
+                    gameObjects[i].SetParent(&gameObjects[root]);
+                }
+            }
+            scene.AddGameObjects(gameObjects, count);
+
+            GameObject * cameraObject = new GameObject();
+            cameraObject->AddComponent(*new Transform());
+            cameraObject->AddComponent(*new Camera());
+            scene.AddGameObjects(cameraObject, 1);
+
+            // The simulation moves every root, the renderer tests every object against a box.
+            auto simulate = [&](uint32_t frame) {
+                for (uint32_t i = 0; i < count; i += childrenPerRoot + 1)
+                {
+                    transforms[i].SetLocalRotation(glm::angleAxis(0.01f * frame, glm::vec3{ 0, 1, 0 }));
+                }
+            };
+            Aabb visibleRegion{ glm::vec3{ 0, 0, 0 }, glm::vec3{ 500, 5, 10 } };
+            auto render = [&](RenderSnapshot const & snapshot) {
+                uint32_t visibleCount = 0;
+                for (uint32_t i = 0; i < snapshot.GetObjectCount(); ++i)
+                {
+                    visibleCount += snapshot.GetWorldBounds()[i].Overlaps(visibleRegion) ? 1 : 0;
+                }
+                return visibleCount;
+            };
+
+            RenderSnapshotBuffer buffer;
+            double extractTime = Measure([&]() { buffer.GetBackSnapshot().Extract(scene); });
+
+            // Sequential: the renderer reads the snapshot right after it is extracted.
+            uint32_t sequentialVisible = 0;
+            double sequentialTime = Measure([&]() {
+                for (uint32_t frame = 0; frame < frameCount; ++frame)
+                {
+                    simulate(frame);
+                    RenderSnapshot & snapshot = buffer.GetBackSnapshot();
+                    snapshot.Extract(scene);
+                    sequentialVisible = render(snapshot);
+                }
+            }, 1);
+
+            // Pipelined: the render thread draws the front snapshot while the next one is simulated and extracted.
+            uint32_t pipelinedVisible = 0;
+            uint32_t renderedCount = 0;
+            double pipelinedTime = Measure([&]() {
+                std::atomic<bool> isDone{ false };
+                std::thread renderThread{ [&]() {
+                    uint64_t lastFrame = 0;
+                    while (!isDone || lastFrame < frameCount)
+                    {
+                        RenderSnapshot const * snapshot = buffer.AcquireFront();
+                        bool isNew = snapshot != nullptr && snapshot->GetFrameIndex() != lastFrame;
+                        if (isNew)
+                        {
+                            lastFrame = snapshot->GetFrameIndex();
+                            pipelinedVisible = render(*snapshot);
+                            ++renderedCount;
+                        }
+                        buffer.ReleaseFront();
+                        if (!isNew)
+                        {
+                            std::this_thread::yield();
+                        }
+                    }
+                } };
+
+                for (uint32_t frame = 0; frame < frameCount; ++frame)
+                {
+                    simulate(frame);
+                    buffer.GetBackSnapshot().Extract(scene);
+                    buffer.Publish();
+                }
+                isDone = true;
+                renderThread.join();
+            }, 1);
+
+            std::cout << count << " objects, " << frameCount << " frames, " << ThreadPool::GetDefault().GetThreadCount() << " extraction thread(s)" << std::endl;
+            Print({ "Path", "Per frame (ms)", "Speedup", "Frames rendered", "Same result" }, {
+                { "Extraction only", Format(extractTime), "-", "-", "-" },
+                { "Simulate, then render", Format(sequentialTime / frameCount), "1.000", std::to_string(frameCount), "yes" },
+                { "Render N while simulating N + 1", Format(pipelinedTime / frameCount), Format(sequentialTime / pipelinedTime), std::to_string(renderedCount), pipelinedVisible == sequentialVisible ? "yes" : "NO" },
+            });
+        }
+
+        ///
+        /// Measures the build and the refit of a BVH, with and without rotations, and the throughput of its queries
+        /// against a linear scan of the boxes.
+        ///
+        void BenchmarkBvh()
+        {
+            const float frameTime = 1 / 60.0f;
+            const uint32_t movingFrameCount = 60;
+            const uint32_t queryCount = 10000;
+            const uint32_t linearQueryCount = 100;
+
+            Table maintenanceTable;
+            Table queryTable;
+            for (uint32_t count : { 10000u, 100000u, 1000000u })
+            {
+                // Boxes at a constant density, a tenth of them moving.
+                std::mt19937 random{ 42 };
+                float side = 10 * std::cbrt((float)count);
+                std::uniform_real_distribution<float> position{ 0, side };
+                std::uniform_real_distribution<float> size{ 0.25f, 1 };
+                std::uniform_real_distribution<float> velocity{ -5, 5 };
+
+                std::vector<Aabb> bounds(count);
+                std::vector<glm::vec3> velocities(count, glm::vec3{ 0 });
+                for (uint32_t i = 0; i < count; ++i)
+                {
+                    glm::vec3 center{ position(random), position(random), position(random) };
+                    glm::vec3 extents{ size(random), size(random), size(random) };
+                    bounds[i] = Aabb{ center - extents, center + extents };
+                    if (i % 10 == 0)
+                    {
+                        velocities[i] = glm::vec3{ velocity(random), velocity(random), velocity(random) };
+                    }
+                }
+                auto move = [&]() {
+                    for (uint32_t i = 0; i < count; i += 10)
+                    {
+                        bounds[i].min += velocities[i] * frameTime;
+                        bounds[i].max += velocities[i] * frameTime;
+                    }
+                };
+
+                Bvh bvh;
+                double buildTime = Measure([&]() { bvh.Build(bounds.data(), count); }, 3);
+                float builtCost = bvh.GetCost();
+
+                Bvh rotatedBvh;
+                rotatedBvh.Build(bounds.data(), count);
+                double refitTime = 0;
+                double rotateTime = 0;
+                for (uint32_t frame = 0; frame < movingFrameCount; ++frame)
+                {
+                    move();
+                    refitTime += Measure([&]() { bvh.Refit(bounds.data()); }, 1);
+                    rotateTime += Measure([&]() { rotatedBvh.Refit(bounds.data(), true); }, 1);
+                }
+                float refitCost = bvh.GetCost();
+                float rotatedCost = rotatedBvh.GetCost();
+                bvh.Build(bounds.data(), count);
+
+                maintenanceTable.push_back({ std::to_string(count), Format(buildTime), Format(refitTime / movingFrameCount), Format(rotateTime / movingFrameCount),
+                    Format(builtCost), Format(refitCost), Format(rotatedCost), Format(bvh.GetCost()) });
+
+                // Queries around random points, with boxes of 20 units, and cameras seeing 100 units away.
+                std::vector<glm::vec3> points(queryCount);
+                std::vector<glm::vec3> directions(queryCount);
+                for (uint32_t i = 0; i < queryCount; ++i)
+                {
+                    points[i] = glm::vec3{ position(random), position(random), position(random) };
+                    directions[i] = glm::normalize(glm::vec3{ velocity(random), velocity(random), velocity(random) } + glm::vec3{ 0.01f, 0, 0 });
+                }
+
+                std::vector<uint32_t> items;
+                items.reserve(count);
+                size_t overlapCount = 0;
+                double overlapTime = Measure([&]() {
+                    overlapCount = 0;
+                    for (glm::vec3 const & point : points)
+                    {
+                        items.clear();
+                        bvh.QueryOverlap(Aabb{ point - glm::vec3{ 10 }, point + glm::vec3{ 10 } }, items);
+                        overlapCount += items.size();
+                    }
+                }, 3);
+
+                std::vector<uint32_t> linearItems;
+                double linearTime = Measure([&]() {
+                    for (uint32_t q = 0; q < linearQueryCount; ++q)
+                    {
+                        Aabb box{ points[q] - glm::vec3{ 10 }, points[q] + glm::vec3{ 10 } };
+                        linearItems.clear();
+                        for (uint32_t i = 0; i < count; ++i)
+                        {
+                            if (bounds[i].Overlaps(box))
+                            {
+                                linearItems.push_back(i);
+                            }
+                        }
+                    }
+                }, 1);
+
+                bool isSame = true;
+                for (uint32_t q = 0; q < linearQueryCount; ++q)
+                {
+                    Aabb box{ points[q] - glm::vec3{ 10 }, points[q] + glm::vec3{ 10 } };
+                    items.clear();
+                    bvh.QueryOverlap(box, items);
+                    linearItems.clear();
+                    for (uint32_t i = 0; i < count; ++i)
+                    {
+                        if (bounds[i].Overlaps(box))
+                        {
+                            linearItems.push_back(i);
+                        }
+                    }
+                    std::sort(items.begin(), items.end());
+                    isSame = isSame && items == linearItems;
+                }
+
+                glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16 / 9.0f, 0.1f, 100.0f);
+                double frustumTime = Measure([&]() {
+                    for (uint32_t q = 0; q < queryCount / 10; ++q)
+                    {
+                        items.clear();
+                        Frustum frustum = Frustum::FromMatrix(projection * glm::lookAt(points[q], points[q] + directions[q], glm::vec3{ 0, 1, 0 }));
+                        bvh.QueryFrustum(frustum, items);
+                    }
+                }, 3);
+
+                double nearestTime = Measure([&]() {
+                    for (glm::vec3 const & point : points)
+                    {
+                        uint32_t item;
+                        float distance;
+                        bvh.QueryNearest(point, 50, item, distance);
+                    }
+                }, 3);
+
+                queryTable.push_back({ std::to_string(count), Format(overlapTime * 1000 / queryCount), Format(linearTime * 1000 / linearQueryCount),
+                    Format((linearTime / linearQueryCount) / (overlapTime / queryCount)), Format(frustumTime * 1000 / (queryCount / 10)),
+                    Format(nearestTime * 1000 / queryCount), isSame ? "yes" : "NO" });
+            }
+
+            std::cout << "Maintenance, a tenth of the objects moving for " << movingFrameCount << " frames:" << std::endl;
+            Print({ "Objects", "Build (ms)", "Refit (ms)", "Refit + rotations (ms)", "Cost built", "Cost refit", "Cost rotated", "Cost rebuilt" }, maintenanceTable);
+            std::cout << std::endl << "Queries, per query (us):" << std::endl;
+            Print({ "Objects", "Overlap", "Linear overlap", "Speedup", "Frustum", "Nearest", "Same result" }, queryTable);
+        }
+
+        ///
+        /// Measures the frustum culling of a million boxes with every instruction set supported by the CPU, then with
+        /// 1 to N threads, against the BVH query.
+        ///
+        void BenchmarkFrustumCulling()
+        {
+            const uint32_t count = 1000000;
+            const float side = 1000;
+
+            std::mt19937 random{ 42 };
+            std::uniform_real_distribution<float> position{ 0, side };
+            std::uniform_real_distribution<float> size{ 0.25f, 2 };
+
+            std::vector<Aabb> bounds(count);
+            PackedBounds packedBounds;
+            packedBounds.Resize(count);
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                glm::vec3 center{ position(random), position(random), position(random) };
+                glm::vec3 extents{ size(random), size(random), size(random) };
+                bounds[i] = Aabb{ center - extents, center + extents };
+                packedBounds.Set(i, bounds[i]);
+            }
+
+            // A camera in the middle of the boxes, seeing a few percent of them.
+            CameraSnapshot camera;
+            camera.position = glm::vec3{ side / 2 };
+            camera.viewMatrix = glm::lookAt(camera.position, camera.position + glm::vec3{ 1, 0.2f, 0.5f }, glm::vec3{ 0, 1, 0 });
+            camera.nearPlane = 0.1f;
+            camera.farPlane = 400;
+            camera.verticalFieldOfView = 60;
+            Frustum frustum = camera.GetFrustum(16 / 9.0f);
+
+            std::vector<uint32_t> reference;
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                if (frustum.Intersects(packedBounds.Get(i)))
+                {
+                    reference.push_back(i);
+                }
+            }
+
+            FrustumCuller culler;
+            Table table;
+            ThreadPool singleThread{ 1 };
+            MatrixKernels::Isa supportedIsa = MatrixKernels::GetSupportedIsa();
+            for (int isa = (int)MatrixKernels::Isa::Scalar; isa <= (int)supportedIsa; ++isa)
+            {
+                MatrixKernels::SetIsa((MatrixKernels::Isa)isa);
+
+                Span<uint32_t const> visible;
+                double time = Measure([&]() { visible = culler.Cull(frustum, packedBounds, singleThread); });
+                bool isSame = visible.size() == reference.size() && std::equal(visible.begin(), visible.end(), reference.begin());
+                table.push_back({ MatrixKernels::GetIsaName((MatrixKernels::Isa)isa), "1", Format(time), std::to_string(visible.size()), isSame ? "yes" : "NO" });
+            }
+
+            uint32_t maxThreadCount = std::max(1u, std::thread::hardware_concurrency());
+            for (uint32_t threadCount = 2; threadCount <= maxThreadCount; threadCount *= 2)
+            {
+                ThreadPool threadPool{ threadCount };
+
+                Span<uint32_t const> visible;
+                double time = Measure([&]() { visible = culler.Cull(frustum, packedBounds, threadPool); });
+                bool isSame = visible.size() == reference.size() && std::equal(visible.begin(), visible.end(), reference.begin());
+                table.push_back({ MatrixKernels::GetIsaName(supportedIsa), std::to_string(threadCount), Format(time), std::to_string(visible.size()), isSame ? "yes" : "NO" });
+
+                if (threadCount < maxThreadCount && threadCount * 2 > maxThreadCount)
+                {
+                    threadCount = maxThreadCount / 2;
+                }
+            }
+
+            Bvh bvh;
+            bvh.Build(bounds.data(), count);
+            std::vector<uint32_t> items;
+            double bvhTime = Measure([&]() {
+                items.clear();
+                bvh.QueryFrustum(frustum, items);
+            });
+            table.push_back({ "BVH query", "1", Format(bvhTime), std::to_string(items.size()), items.size() == reference.size() ? "yes" : "NO" });
+
+            std::cout << count << " boxes" << std::endl;
+            Print({ "Culling", "Threads", "Time (ms)", "Visible", "Same result" }, table);
+        }
+
+        ///
+        /// Culls the objects of a city seen from the street, behind the buildings.
+        ///
+        void BenchmarkOcclusionCulling()
+        {
+            const uint32_t blockCount = 40;
+            const float blockSize = 20;
+            const float streetWidth = 6;
+            const uint32_t propCount = 100000;
+            const float side = blockCount * blockSize;
+
+            std::mt19937 random{ 42 };
+            std::uniform_real_distribution<float> height{ 8, 40 };
+            std::uniform_real_distribution<float> position{ 0, side };
+            std::uniform_real_distribution<float> elevation{ 0, 3 };
+
+            // The buildings fill the blocks between the streets and are their own occluders. The props are small
+            // objects scattered on the streets.
+            const uint32_t buildingCount = blockCount * blockCount;
+            const uint32_t count = buildingCount + propCount;
+            Scene scene;
+            GameObject * gameObjects = GameObject::CreateBatch(count);
+            Transform * transforms = Transform::CreateBatch(count);
+            MeshRenderer * renderers = MeshRenderer::CreateBatch(count);
+            std::vector<Aabb> buildings(buildingCount);
+            for (uint32_t i = 0; i < buildingCount; ++i)
+            {
+                glm::vec3 size{ blockSize - streetWidth, height(random), blockSize - streetWidth };
+                glm::vec3 center{ (i % blockCount + 0.5f) * blockSize, size.y / 2, (i / blockCount + 0.5f) * blockSize };
+                buildings[i] = Aabb{ center - size / 2.0f, center + size / 2.0f };
+                transforms[i].SetLocalPosition(center);
+                transforms[i].SetLocalScale(size);
+                renderers[i].SetOccluderBounds(renderers[i].GetLocalBounds());
+            }
+            for (uint32_t i = buildingCount; i < count; ++i)
+            {
+                glm::vec3 center;
+                do
+                {
+                    center = glm::vec3{ position(random), elevation(random), position(random) };
+                } while (std::fmod(center.x, blockSize) > streetWidth / 2 && std::fmod(center.x, blockSize) < blockSize - streetWidth / 2 &&
+                    std::fmod(center.z, blockSize) > streetWidth / 2 && std::fmod(center.z, blockSize) < blockSize - streetWidth / 2);
+                transforms[i].SetLocalPosition(center);
+                transforms[i].SetLocalScale(glm::vec3{ 0.5f });
+            }
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                gameObjects[i].AddComponent(transforms[i]);
+                gameObjects[i].AddComponent(renderers[i]);
+            }
+            scene.AddGameObjects(gameObjects, count);
+
+            // A pedestrian at a crossing in the middle of the city, looking along a street at an angle.
+            GameObject * cameraObject = new GameObject();
+            Transform * cameraTransform = new Transform();
+            cameraTransform->SetLocalPosition(glm::vec3{ side / 2, 1.7f, side / 2 });
+            cameraTransform->SetLocalRotation(glm::angleAxis(-1.2f, glm::vec3{ 0, 1, 0 }));
+            cameraObject->AddComponent(*cameraTransform);
+            Camera * camera = new Camera();
+            camera->SetFar(2 * side);
+            cameraObject->AddComponent(*camera);
+            scene.AddGameObjects(cameraObject, 1);
+
+            RenderSnapshot snapshot;
+            snapshot.Extract(scene);
+            CameraSnapshot const & cameraSnapshot = snapshot.GetCameras()[0];
+            const float aspectRatio = 16 / 9.0f;
+
+            FrustumCuller frustumCuller;
+            Span<uint32_t const> inFrustum = frustumCuller.Cull(cameraSnapshot.GetFrustum(aspectRatio), snapshot.GetPackedWorldBounds());
+
+            OcclusionCuller occlusionCuller;
+            Span<uint32_t const> visible;
+            double time = Measure([&]() {
+                occlusionCuller.RenderOccluders(snapshot, cameraSnapshot, aspectRatio);
+                visible = occlusionCuller.Cull(inFrustum, snapshot.GetWorldBounds());
+            });
+
+            // A culled object is wrongly culled when the segment from the camera to its center misses every building.
+            std::vector<uint8_t> isVisible(snapshot.GetObjectCount(), 0);
+            for (uint32_t object : visible)
+            {
+                isVisible[object] = 1;
+            }
+            uint32_t wrongCount = 0;
+            for (uint32_t object : inFrustum)
+            {
+                if (isVisible[object] != 0)
+                {
+                    continue;
+                }
+
+                glm::vec3 target = snapshot.GetWorldBounds()[object].GetCenter();
+                glm::vec3 direction = target - cameraSnapshot.position;
+                bool isHidden = false;
+                for (uint32_t i = 0; i < buildingCount && !isHidden; ++i)
+                {
+                    float enter = 0;
+                    float exit = 1;
+                    for (int axis = 0; axis < 3; ++axis)
+                    {
+                        float a = (buildings[i].min[axis] - cameraSnapshot.position[axis]) / direction[axis];
+                        float b = (buildings[i].max[axis] - cameraSnapshot.position[axis]) / direction[axis];
+                        enter = (std::max)(enter, (std::min)(a, b));
+                        exit = (std::min)(exit, (std::max)(a, b));
+                    }
+                    isHidden = enter <= exit;
+                }
+                wrongCount += isHidden ? 0 : 1;
+            }
+
+            OcclusionCuller::Stats const & stats = occlusionCuller.GetStats();
+            std::cout << count << " objects, " << buildingCount << " of them occluders" << std::endl;
+            Print({ "Stage", "Objects", "Time (ms)" }, {
+                { "Scene", std::to_string(count), "-" },
+                { "Frustum culling", std::to_string(inFrustum.size()), "-" },
+                { "Occlusion culling", std::to_string(visible.size()), Format(time) },
+            });
+            occlusionCuller.PrintStats();
+            std::cout << "Culled objects seen from the camera: " << wrongCount << std::endl;
+        }
+
+        ///
+        /// Selects the levels of detail of the objects in view, and counts the switches of a camera moving back and forth.
+        ///
+        void BenchmarkLodSelection()
+        {
+            const uint32_t count = 1000000;
+            const uint32_t meshCount = 8;
+            const uint32_t levelCount = 6;
+            const float side = 1000;
+            const uint32_t viewportHeight = 1080;
+
+            std::mt19937 random{ 42 };
+            std::uniform_real_distribution<float> position{ 0, side };
+            std::uniform_real_distribution<float> scale{ 0.5f, 4 };
+
+            Scene scene;
+            GameObject * gameObjects = GameObject::CreateBatch(count);
+            Transform * transforms = Transform::CreateBatch(count);
+            MeshRenderer * renderers = MeshRenderer::CreateBatch(count);
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                transforms[i].SetLocalPosition(glm::vec3{ position(random), position(random), position(random) });
+                transforms[i].SetLocalScale(glm::vec3{ scale(random) });
+                gameObjects[i].AddComponent(transforms[i]);
+                renderers[i].SetMeshId(i % meshCount);
+                gameObjects[i].AddComponent(renderers[i]);
+            }
+            scene.AddGameObjects(gameObjects, count);
+
+            GameObject * cameraObject = new GameObject();
+            Transform * cameraTransform = new Transform();
+            cameraObject->AddComponent(*cameraTransform);
+            Camera * camera = new Camera();
+            camera->SetFar(side);
+            camera->SetVerticalFieldOfView(60);
+            cameraObject->AddComponent(*camera);
+            scene.AddGameObjects(cameraObject, 1);
+
+            // Every level halves the detail of the previous one.
+            LodSelector selector;
+            for (MeshId mesh = 0; mesh < meshCount; ++mesh)
+            {
+                float errors[levelCount] = {};
+                for (uint32_t level = 1; level < levelCount; ++level)
+                {
+                    errors[level] = 0.01f * (mesh + 1) * (1u << level);
+                }
+                selector.SetMeshLevels(mesh, Span<float const>{ errors, levelCount });
+            }
+
+            auto setCamera = [&](float offset) {
+                glm::vec3 eye{ side / 2 + offset, side / 2, side / 2 + offset };
+                cameraTransform->SetLocalPosition(eye);
+                cameraTransform->SetLocalRotation(glm::angleAxis(-2.356f, glm::vec3{ 0, 1, 0 }));
+            };
+            setCamera(0);
+
+            RenderSnapshot snapshot;
+            snapshot.Extract(scene);
+            CameraSnapshot camera0 = snapshot.GetCameras()[0];
+            FrustumCuller culler;
+            Span<uint32_t const> visible = culler.Cull(camera0.GetFrustum(16 / 9.0f), snapshot.GetPackedWorldBounds());
+
+            // The reference is the scalar selection, without previous levels.
+            MatrixKernels::SetIsa(MatrixKernels::Isa::Scalar);
+            selector.Reset();
+            Span<uint8_t const> levels = selector.Select(snapshot, camera0, viewportHeight, visible);
+            std::vector<uint8_t> reference{ levels.begin(), levels.end() };
+
+            Table table;
+            ThreadPool singleThread{ 1 };
+            MatrixKernels::Isa supportedIsa = MatrixKernels::GetSupportedIsa();
+            for (int isa = (int)MatrixKernels::Isa::Scalar; isa <= (int)(std::min)(supportedIsa, MatrixKernels::Isa::Sse); ++isa)
+            {
+                MatrixKernels::SetIsa((MatrixKernels::Isa)isa);
+                double time = Measure([&]() {
+                    selector.Reset();
+                    levels = selector.Select(snapshot, camera0, viewportHeight, visible, 0, singleThread);
+                });
+                bool isSame = std::equal(levels.begin(), levels.end(), reference.begin());
+                table.push_back({ MatrixKernels::GetIsaName((MatrixKernels::Isa)isa), "1", Format(time), isSame ? "yes" : "NO" });
+            }
+            MatrixKernels::SetIsa(supportedIsa);
+
+            uint32_t maxThreadCount = std::max(1u, std::thread::hardware_concurrency());
+            for (uint32_t threadCount = 2; threadCount <= maxThreadCount; threadCount *= 2)
+            {
+                ThreadPool threadPool{ threadCount };
+                double time = Measure([&]() {
+                    selector.Reset();
+                    levels = selector.Select(snapshot, camera0, viewportHeight, visible, 0, threadPool);
+                });
+                bool isSame = std::equal(levels.begin(), levels.end(), reference.begin());
+                table.push_back({ MatrixKernels::GetIsaName(supportedIsa), std::to_string(threadCount), Format(time), isSame ? "yes" : "NO" });
+
+                if (threadCount < maxThreadCount && threadCount * 2 > maxThreadCount)
+                {
+                    threadCount = maxThreadCount / 2;
+                }
+            }
+
+            std::cout << count << " objects, " << visible.size() << " in view" << std::endl;
+            Print({ "Selection", "Threads", "Time (ms)", "Same result" }, table);
+
+            // The bias trades the detail for fewer vertices, counted as halving with every level.
+            Table biasTable;
+            for (float bias : { -1.0f, 0.0f, 1.0f, 2.0f })
+            {
+                selector.SetBias(bias);
+                selector.Reset();
+                levels = selector.Select(snapshot, camera0, viewportHeight, visible);
+
+                std::vector<uint32_t> histogram(levelCount, 0);
+                double vertexCount = 0;
+                for (uint8_t level : levels)
+                {
+                    ++histogram[level];
+                    vertexCount += 1.0 / (1u << level);
+                }
+
+                std::vector<std::string> row = { Format(bias) };
+                for (uint32_t level = 0; level < levelCount; ++level)
+                {
+                    row.push_back(std::to_string(histogram[level]));
+                }
+                row.push_back(Format(vertexCount / levels.size()));
+                biasTable.push_back(row);
+            }
+            selector.SetBias(0);
+            Print({ "Bias", "Level 0", "Level 1", "Level 2", "Level 3", "Level 4", "Level 5", "Relative vertices" }, biasTable);
+
+            // The camera shakes along the diagonal, which moves the objects back and forth across the thresholds.
+            Table hysteresisTable;
+            const int frameCount = 60;
+            for (float hysteresis : { 0.0f, 0.05f, 0.1f, 0.2f })
+            {
+                selector.SetHysteresis(hysteresis);
+                selector.Reset();
+
+                std::vector<uint8_t> previousLevels(snapshot.GetObjectCount(), 0);
+                uint64_t switchCount = 0;
+                for (int frame = 0; frame < frameCount; ++frame)
+                {
+                    setCamera(frame % 2 == 0 ? 0.0f : 5.0f);
+                    snapshot.Extract(scene);
+                    levels = selector.Select(snapshot, snapshot.GetCameras()[0], viewportHeight, visible);
+                    for (size_t i = 0; i < levels.size(); ++i)
+                    {
+                        switchCount += frame != 0 && previousLevels[visible[i]] != levels[i] ? 1 : 0;
+                        previousLevels[visible[i]] = levels[i];
+                    }
+                }
+                hysteresisTable.push_back({ Format(hysteresis), std::to_string(switchCount), Format((double)switchCount / (frameCount - 1)) });
+            }
+            Print({ "Hysteresis", "Level switches", "Per frame" }, hysteresisTable);
+        }
+
+        ///
+        /// Compares the cached camera matrices to recomputing them, and culling several views in one pass to culling
+        /// each view separately.
+        ///
+        void BenchmarkMultiView()
+        {
+            // Cameras standing still between frames, as most do.
+            {
+                const uint32_t cameraCount = 10000;
+                const float aspectRatio = 16 / 9.0f;
+
+                Scene scene;
+                GameObject * gameObjects = GameObject::CreateBatch(cameraCount);
+                Transform * transforms = Transform::CreateBatch(cameraCount);
+                Camera * cameras = Camera::CreateBatch(cameraCount);
+                for (uint32_t i = 0; i < cameraCount; ++i)
+                {
+                    transforms[i].SetLocalPosition(glm::vec3{ (float)i, 1, 0 });
+                    transforms[i].SetLocalRotation(glm::angleAxis(0.001f * i, glm::vec3{ 0, 1, 0 }));
+                    gameObjects[i].AddComponent(transforms[i]);
+                    gameObjects[i].AddComponent(cameras[i]);
+                }
+                scene.AddGameObjects(gameObjects, cameraCount);
+                scene.UpdateWorldMatrices();
+
+                glm::mat4 sum{ 0 };
+                double recomputeTime = Measure([&]() {
+                    for (uint32_t i = 0; i < cameraCount; ++i)
+                    {
+                        glm::mat4 projection = glm::perspective(glm::radians(cameras[i].GetVerticalFieldOfView()), aspectRatio, cameras[i].GetNear(), cameras[i].GetFar());
+                        sum += projection * glm::inverse(transforms[i].GetLocalToWorldMatrix());
+                    }
+                });
+                glm::mat4 cachedSum{ 0 };
+                double cachedTime = Measure([&]() {
+                    for (uint32_t i = 0; i < cameraCount; ++i)
+                    {
+                        cachedSum += cameras[i].GetViewProjectionMatrix(aspectRatio);
+                    }
+                });
+                bool isSame = true;
+                for (uint32_t i = 0; i < cameraCount && isSame; ++i)
+                {
+                    glm::mat4 projection = glm::perspective(glm::radians(cameras[i].GetVerticalFieldOfView()), aspectRatio, cameras[i].GetNear(), cameras[i].GetFar());
+                    glm::mat4 reference = projection * transforms[i].GetWorldToLocalMatrix();
+                    isSame = memcmp(&reference, &cameras[i].GetViewProjectionMatrix(aspectRatio), sizeof(glm::mat4)) == 0;
+                }
+
+                std::cout << cameraCount << " cameras" << std::endl;
+                Print({ "View-projection matrices", "Time (ms)", "Speedup", "Same result" }, {
+                    { "Recomputed", Format(recomputeTime), "1.000", "-" },
+                    { "Cached", Format(cachedTime), Format(recomputeTime / cachedTime), isSame ? "yes" : "NO" },
+                });
+            }
+
+            // Split screen views of a million boxes.
+            {
+                const uint32_t count = 1000000;
+                const float side = 1000;
+
+                std::mt19937 random{ 42 };
+                std::uniform_real_distribution<float> position{ 0, side };
+                std::uniform_real_distribution<float> size{ 0.25f, 2 };
+
+                PackedBounds packedBounds;
+                packedBounds.Resize(count);
+                for (uint32_t i = 0; i < count; ++i)
+                {
+                    glm::vec3 center{ position(random), position(random), position(random) };
+                    glm::vec3 extents{ size(random), size(random), size(random) };
+                    packedBounds.Set(i, Aabb{ center - extents, center + extents });
+                }
+
+                Table table;
+                FrustumCuller culler;
+                for (uint32_t viewCount : { 1u, 2u, 4u, 8u })
+                {
+                    std::vector<Frustum> frustums;
+                    for (uint32_t v = 0; v < viewCount; ++v)
+                    {
+                        CameraSnapshot camera;
+                        camera.position = glm::vec3{ side / 2 };
+                        float angle = 6.2831853f * v / viewCount;
+                        camera.viewMatrix = glm::lookAt(camera.position, camera.position + glm::vec3{ std::cos(angle), 0.2f, std::sin(angle) }, glm::vec3{ 0, 1, 0 });
+                        camera.nearPlane = 0.1f;
+                        camera.farPlane = 400;
+                        camera.verticalFieldOfView = 60;
+                        frustums.push_back(camera.GetFrustum(16 / 9.0f));
+                    }
+
+                    std::vector<std::vector<uint32_t>> separate(viewCount);
+                    double separateTime = Measure([&]() {
+                        for (uint32_t v = 0; v < viewCount; ++v)
+                        {
+                            Span<uint32_t const> visible = culler.Cull(frustums[v], packedBounds);
+                            separate[v].assign(visible.begin(), visible.end());
+                        }
+                    });
+
+                    std::vector<std::vector<uint32_t>> shared(viewCount);
+                    double sharedTime = Measure([&]() {
+                        Span<uint32_t const> visible = culler.Cull(Span<Frustum const>{ frustums.data(), frustums.size() }, packedBounds);
+                        Span<uint32_t const> masks = culler.GetFrustumMasks();
+                        for (uint32_t v = 0; v < viewCount; ++v)
+                        {
+                            shared[v].clear();
+                            for (size_t i = 0; i < visible.size(); ++i)
+                            {
+                                if ((masks[i] >> v) & 1)
+                                {
+                                    shared[v].push_back(visible[i]);
+                                }
+                            }
+                        }
+                    });
+
+                    table.push_back({ std::to_string(viewCount), Format(separateTime), Format(sharedTime), Format(separateTime / sharedTime), separate == shared ? "yes" : "NO" });
+                }
+
+                std::cout << count << " boxes, " << MatrixKernels::GetIsaName(MatrixKernels::GetIsa()) << std::endl;
+                Print({ "Views", "Separate culls (ms)", "Shared cull (ms)", "Speedup", "Same result" }, table);
+            }
+        }
+
+        ///
+        /// Compares keeping a render snapshot and a BVH up to date by rescanning the whole scene every frame, to only
+        /// revisiting the objects of the change journal, when nothing moves and when some of the objects move.
+        ///
+        void BenchmarkChangeJournal()
+        {
+            const uint32_t count = 100000;
+            const uint32_t frameCount = 30;
+
+            Scene scene;
+            GameObject * gameObjects = GameObject::CreateBatch(count);
+            Transform * transforms = Transform::CreateBatch(count);
+            MeshRenderer * renderers = MeshRenderer::CreateBatch(count);
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                transforms[i].SetLocalPosition(glm::vec3{ (float)(i % 400), 0, (float)(i / 400) });
+                gameObjects[i].AddComponent(transforms[i]);
+                gameObjects[i].AddComponent(renderers[i]);
+            }
+            scene.AddGameObjects(gameObjects, count);
+            SceneChangeJournal & journal = scene.GetChangeJournal();
+
+            RenderSnapshot rescanSnapshot;
+            RenderSnapshot journalSnapshot;
+            rescanSnapshot.Extract(scene);
+            journalSnapshot.Extract(scene);
+
+            Bvh rescanBvh;
+            Bvh journalBvh;
+            rescanBvh.Build(rescanSnapshot.GetWorldBounds(), count);
+            journalBvh.Build(journalSnapshot.GetWorldBounds(), count);
+            journal.EndFrame();
+
+            std::mt19937 random{ 1 };
+            std::uniform_int_distribution<uint32_t> objectDistribution{ 0, count - 1 };
+            std::uniform_real_distribution<float> offsetDistribution{ -0.5f, 0.5f };
+
+            Table table;
+            for (uint32_t movedCount : { 0u, count / 1000, count / 100, count / 10 })
+            {
+                double updateTime = 0;
+                double rescanTime = 0;
+                double journalTime = 0;
+                double rescanRefitTime = 0;
+                double journalRefitTime = 0;
+                bool isSame = true;
+                for (uint32_t frame = 0; frame < frameCount; ++frame)
+                {
+                    for (uint32_t i = 0; i < movedCount; ++i)
+                    {
+                        Transform & transform = transforms[objectDistribution(random)];
+                        transform.SetLocalPosition(transform.GetLocalPosition() + glm::vec3{ offsetDistribution(random), 0, offsetDistribution(random) });
+                    }
+
+                    // Both paths read the same world matrices.
+                    updateTime += Measure([&]() { scene.UpdateWorldMatrices(); }, 1);
+                    journalTime += Measure([&]() { journalSnapshot.Extract(scene); }, 1);
+                    journalRefitTime += Measure([&]() {
+                        if (journalSnapshot.IsFullyExtracted())
+                        {
+                            journalBvh.Refit(journalSnapshot.GetWorldBounds());
+                        }
+                        else
+                        {
+                            std::vector<uint32_t> const & updated = journalSnapshot.GetUpdatedObjects();
+                            journalBvh.Refit(journalSnapshot.GetWorldBounds(), Span<uint32_t const>{ updated.data(), updated.size() });
+                        }
+                    }, 1);
+
+                    rescanSnapshot.Reset();
+                    rescanTime += Measure([&]() { rescanSnapshot.Extract(scene); }, 1);
+                    rescanRefitTime += Measure([&]() { rescanBvh.Refit(rescanSnapshot.GetWorldBounds()); }, 1);
+
+                    isSame = isSame && memcmp(rescanSnapshot.GetWorldMatrices(), journalSnapshot.GetWorldMatrices(), count * sizeof(glm::mat4)) == 0 &&
+                        rescanBvh.GetCost() == journalBvh.GetCost();
+                    journal.EndFrame();
+                }
+
+                table.push_back({ std::to_string(movedCount), Format(updateTime / frameCount), Format(rescanTime / frameCount), Format(journalTime / frameCount), Format(rescanRefitTime / frameCount),
+                    Format(journalRefitTime / frameCount), Format((rescanTime + rescanRefitTime) / (journalTime + journalRefitTime)), isSame ? "yes" : "NO" });
+            }
+
+            std::cout << count << " objects, " << frameCount << " frames" << std::endl;
+            Print({ "Moved per frame", "World matrices (ms)", "Rescan extract (ms)", "Journal extract (ms)", "Rescan refit (ms)", "Journal refit (ms)", "Speedup", "Same result" }, table);
+        }
+
+        ///
+        /// Compares running the fixed-rate ticks between the frames on the render thread, to running them on the thread
+        /// of a SimulationLoop, in lag of the ticks behind their schedule and in time the frames wait for the states.
+        ///
+        void BenchmarkSimulationLoop()
+        {
+            const uint32_t count = 20000;
+            const uint32_t movedCount = count / 100;
+            const float timeStep = 1 / 60.0f;
+            const auto renderTime = std::chrono::milliseconds(8);
+            const auto duration = std::chrono::seconds(2);
+            typedef std::chrono::steady_clock Clock;
+
+            Scene scene;
+            GameObject * gameObjects = GameObject::CreateBatch(count);
+            Transform * transforms = Transform::CreateBatch(count);
+            MeshRenderer * renderers = MeshRenderer::CreateBatch(count);
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                transforms[i].SetLocalPosition(glm::vec3{ (float)(i % 200), 0, (float)(i / 200) });
+                gameObjects[i].AddComponent(transforms[i]);
+                gameObjects[i].AddComponent(renderers[i]);
+            }
+            scene.AddGameObjects(gameObjects, count);
+
+            // A few objects bob up and down.
+            auto step = [&](Scene &, double time, float) {
+                for (uint32_t i = 0; i < movedCount; ++i)
+                {
+                    Transform & transform = transforms[i * (count / movedCount)];
+                    glm::vec3 position = transform.GetLocalPosition();
+                    position.y = (float)sin(time + i);
+                    transform.SetLocalPosition(position);
+                }
+            };
+
+            // The render work is simulated by sleeping, as the render thread mostly waits for the GPU.
+            Table table;
+            {
+                // Ticks and frames alternate on one thread: each frame waits for the ticks that came due.
+                RenderSnapshot snapshot;
+                uint64_t tickCount = 0;
+                uint64_t frameCount = 0;
+                double lag = 0;
+                double maxLag = 0;
+                double waitTime = 0;
+                double maxWaitTime = 0;
+                Clock::time_point start = Clock::now();
+                Clock::time_point now = start;
+                for (; now - start < duration; now = Clock::now())
+                {
+                    double frameWaitTime = Measure([&]() {
+                        for (double tickTime = tickCount * (double)timeStep; tickTime <= std::chrono::duration<double>(now - start).count(); tickTime += timeStep)
+                        {
+                            double tickLag = 1000.0 * std::chrono::duration<double>(Clock::now() - start).count() - 1000.0 * tickTime;
+                            lag += tickLag;
+                            maxLag = (std::max)(maxLag, tickLag);
+                            step(scene, tickTime, timeStep);
+                            snapshot.Extract(scene);
+                            scene.GetChangeJournal().EndFrame();
+                            ++tickCount;
+                        }
+                    }, 1);
+                    waitTime += frameWaitTime;
+                    maxWaitTime = (std::max)(maxWaitTime, frameWaitTime);
+                    std::this_thread::sleep_for(renderTime);
+                    ++frameCount;
+                }
+
+                double seconds = std::chrono::duration<double>(now - start).count();
+                table.push_back({ "Sequential", Format(frameCount / seconds), Format(tickCount / seconds), Format(lag / tickCount), Format(maxLag),
+                    Format(waitTime / frameCount), Format(maxWaitTime), "-" });
+            }
+            {
+                SimulationLoop simulation{ scene, step, timeStep };
+                simulation.Start();
+                Clock::time_point start = Clock::now();
+                Clock::time_point now = start;
+                for (; now - start < duration; now = Clock::now())
+                {
+                    simulation.AcquireFrame();
+                    std::this_thread::sleep_for(renderTime);
+                }
+                simulation.Stop();
+
+                SimulationLoop::Stats stats = simulation.GetStats();
+                double seconds = std::chrono::duration<double>(now - start).count();
+                table.push_back({ "Simulation thread", Format(stats.frameCount / seconds), Format(stats.tickCount / seconds), Format(stats.lag / stats.tickCount),
+                    Format(stats.maxLag), Format(stats.waitTime / stats.frameCount), Format(stats.maxWaitTime), Format(stats.interpolateTime / stats.frameCount) });
+            }
+
+            std::cout << count << " objects, " << movedCount << " moved per tick, " << Format(1000.0 * timeStep) << " ms per tick, " << renderTime.count() << " ms per frame" << std::endl;
+            Print({ "Loop", "Frames per second", "Ticks per second", "Average lag (ms)", "Maximum lag (ms)", "Average render wait (ms)", "Maximum render wait (ms)", "Interpolation (ms)" }, table);
+        }
+
+        ///
+        /// The scene of the benchmarks of the render queue: objects at random positions with random meshes and
+        /// materials, the snapshot of the scene, a camera looking at them from outside and all the objects at their
+        /// first level.
+        ///
+        struct DrawScene
+        {
+            Scene scene;
+            RenderSnapshot snapshot;
+            CameraSnapshot camera{};
+            std::vector<uint32_t> objects;
+            std::vector<uint8_t> levels;
+        };
+
+        void CreateDrawScene(DrawScene & drawScene, uint32_t count, uint32_t meshCount, uint32_t materialCount)
+        {
+            GameObject * gameObjects = GameObject::CreateBatch(count);
+            Transform * transforms = Transform::CreateBatch(count);
+            MeshRenderer * renderers = MeshRenderer::CreateBatch(count);
+            std::mt19937 random{ 1 };
+            std::uniform_real_distribution<float> positionDistribution{ -500, 500 };
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                transforms[i].SetLocalPosition(glm::vec3{ positionDistribution(random), positionDistribution(random), positionDistribution(random) });
+                renderers[i].SetMeshId(random() % meshCount);
+                renderers[i].SetMaterialId(random() % materialCount);
+                gameObjects[i].AddComponent(transforms[i]);
+                gameObjects[i].AddComponent(renderers[i]);
+            }
+            drawScene.scene.AddGameObjects(gameObjects, count);
+
+            drawScene.snapshot.Extract(drawScene.scene);
+            drawScene.camera.viewMatrix = glm::lookAt(glm::vec3{ 0, 0, -600 }, glm::vec3{ 0, 0, 0 }, glm::vec3{ 0, 1, 0 });
+
+            drawScene.objects.resize(count);
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                drawScene.objects[i] = i;
+            }
+            drawScene.levels.assign(count, 0);
+        }
+
+        ///
+        /// Compares sorting the draw keys of the render queue with std::sort, to the radix sort on one thread and on
+        /// all of them, and counts the changes of state in the order of the culling and in the sorted order.
+        ///
+        void BenchmarkRenderQueue()
+        {
+            const uint32_t count = 200000;
+            const uint32_t pipelineCount = 16;
+            const uint32_t materialCount = 256;
+            const uint32_t meshCount = 1024;
+
+            DrawScene drawScene;
+            CreateDrawScene(drawScene, count, meshCount, materialCount);
+
+            // One material in 16 is transparent.
+            RenderQueue renderQueue;
+            for (MaterialId material = 0; material < materialCount; ++material)
+            {
+                renderQueue.SetMaterial(material, material % pipelineCount, material % 16 == 0 ? RenderQueue::Transparent : RenderQueue::Opaque);
+            }
+
+            renderQueue.Clear();
+            renderQueue.AddView(drawScene.snapshot, drawScene.camera, Span<uint32_t const>{ drawScene.objects.data(), count }, Span<uint8_t const>{ drawScene.levels.data(), count });
+
+            std::vector<uint64_t> keys(count);
+            Span<RenderQueue::Draw const> unsortedDraws = renderQueue.GetDraws(0);
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                keys[i] = unsortedDraws[i].key;
+            }
+            std::vector<std::pair<uint64_t, uint32_t>> pairs(count);
+            double stdSortTime = Measure([&]() {
+                for (uint32_t i = 0; i < count; ++i)
+                {
+                    pairs[i] = std::make_pair(keys[i], i);
+                }
+                std::sort(pairs.begin(), pairs.end());
+            });
+
+            // The queue keeps its draws in the order of the culling, so sorting again sorts the same keys.
+            ThreadPool singleThread{ 1 };
+            double singleThreadTime = Measure([&]() { renderQueue.Sort(singleThread); });
+
+            auto isSorted = [&]() {
+                Span<RenderQueue::Draw const> draws = renderQueue.GetDraws(0);
+                for (uint32_t i = 0; i < count; ++i)
+                {
+                    if (draws[i].key != pairs[i].first)
+                    {
+                        return "NO";
+                    }
+                }
+                return "yes";
+            };
+
+            Table table;
+            table.push_back({ "std::sort", "1", Format(stdSortTime), Format(1), "yes" });
+            table.push_back({ "Radix sort", "1", Format(singleThreadTime), Format(stdSortTime / singleThreadTime), isSorted() });
+            for (uint32_t threadCount = 2; threadCount <= std::thread::hardware_concurrency(); threadCount *= 2)
+            {
+                ThreadPool threadPool{ threadCount };
+                double time = Measure([&]() { renderQueue.Sort(threadPool); });
+                table.push_back({ "Radix sort", std::to_string(threadCount), Format(time), Format(stdSortTime / time), isSorted() });
+            }
+
+            RenderQueue::Stats const & stats = renderQueue.GetStats();
+            std::cout << count << " draws, " << pipelineCount << " pipelines, " << materialCount << " materials, " << meshCount << " meshes" << std::endl;
+            Print({ "Sort", "Threads", "Time (ms)", "Speedup", "Sorted" }, table);
+            Print({ "Order", "Pipeline changes", "Material changes", "Mesh changes" }, Table{
+                { "Culling", std::to_string(stats.unsortedChanges.pipelineCount), std::to_string(stats.unsortedChanges.materialCount), std::to_string(stats.unsortedChanges.meshCount) },
+                { "Sorted", std::to_string(stats.sortedChanges.pipelineCount), std::to_string(stats.sortedChanges.materialCount), std::to_string(stats.sortedChanges.meshCount) },
+            });
+        }
+
+        ///
+        /// Counts the draws left by merging the draws of the same mesh into instanced draws, in the order of the culling
+        /// and in the order of the render queue, with and without a limit of instances per binding of the instance
+        /// buffer, and measures the batching and the packing of the instances.
+        ///
+        void BenchmarkInstancing()
+        {
+            const uint32_t count = 200000;
+            const uint32_t materialCount = 16;
+            const uint32_t meshCount = 32;
+            const uint32_t limitedInstanceCount = 256;
+
+            DrawScene drawScene;
+            CreateDrawScene(drawScene, count, meshCount, materialCount);
+
+            RenderQueue renderQueue;
+            for (MaterialId material = 0; material < materialCount; ++material)
+            {
+                renderQueue.SetMaterial(material, material % 8, RenderQueue::Opaque);
+            }
+            renderQueue.AddView(drawScene.snapshot, drawScene.camera, Span<uint32_t const>{ drawScene.objects.data(), count }, Span<uint8_t const>{ drawScene.levels.data(), count });
+
+            InstanceBatcher batcher;
+            std::vector<InstanceBatcher::InstanceData> instances(count);
+            Table table;
+            auto addRow = [&](char const * order, uint32_t maxInstanceCount) {
+                batcher.SetMaxInstanceCount(maxInstanceCount);
+                double batchTime = Measure([&]() {
+                    batcher.Clear();
+                    batcher.AddView(renderQueue.GetDraws(0));
+                });
+                double packTime = Measure([&]() { batcher.Pack(drawScene.snapshot, instances.data()); });
+
+                // Every instance must get the matrix of its object, and every batch must stay within its binding.
+                bool isSame = batcher.GetInstanceCount() == count;
+                for (InstanceBatcher::Batch const & batch : batcher.GetBatches(0))
+                {
+                    isSame = isSame && batch.firstInstance >= batch.bindingOffset && batch.firstInstance + batch.instanceCount - batch.bindingOffset <= maxInstanceCount;
+                    for (uint32_t i = batch.firstInstance; i < batch.firstInstance + batch.instanceCount; ++i)
+                    {
+                        RenderQueue::Draw const & draw = renderQueue.GetDraws(0)[i];
+                        isSame = isSame && draw.mesh == batch.mesh && memcmp(&instances[i].worldMatrix, &drawScene.snapshot.GetWorldMatrices()[draw.object], sizeof(glm::mat4)) == 0;
+                    }
+                }
+
+                InstanceBatcher::Stats const & stats = batcher.GetStats();
+                table.push_back({ order, maxInstanceCount == UINT32_MAX ? "-" : std::to_string(maxInstanceCount), std::to_string(stats.drawCount), std::to_string(stats.batchCount),
+                    std::to_string(stats.splitCount), Format(batchTime), Format(packTime), isSame ? "yes" : "NO" });
+            };
+
+            // Before the sort, the queue returns the draws in the order of the culling.
+            addRow("Culling", UINT32_MAX);
+            renderQueue.Sort();
+            addRow("Render queue", UINT32_MAX);
+            addRow("Render queue", limitedInstanceCount);
+
+            std::cout << count << " objects, " << meshCount << " meshes, " << materialCount << " materials" << std::endl;
+            Print({ "Order", "Instances per binding", "Draws", "Instanced draws", "Splits", "Batching (ms)", "Packing (ms)", "Correct" }, table);
+        }
+
+        ///
+        /// Batches sorted draws of random meshes and materials, and registers the geometry of the meshes, as the draw
+        /// commands benchmarks expect them.
+        ///
+        void CreateDrawBatches(uint32_t maxInstanceCount, std::vector<RenderQueue::Draw> & draws, InstanceBatcher & batcher, DrawCommandBuilder & builder)
+        {
+            const uint32_t count = 200000;
+            const uint32_t materialCount = 64;
+            const uint32_t meshCount = 4096;
+
+            std::mt19937 random{ 1 };
+            draws.resize(count);
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                RenderQueue::Draw & draw = draws[i];
+                draw.object = i;
+                draw.material = random() % materialCount;
+                draw.pipeline = draw.material % 8;
+                draw.mesh = random() % meshCount;
+                draw.level = 0;
+                draw.key = ((uint64_t)draw.pipeline << 48) | ((uint64_t)draw.material << 32) | draw.mesh;
+            }
+            std::sort(draws.begin(), draws.end(), [](RenderQueue::Draw const & a, RenderQueue::Draw const & b) { return a.key < b.key; });
+
+            batcher.SetMaxInstanceCount(maxInstanceCount);
+            batcher.Clear();
+            batcher.AddView(Span<RenderQueue::Draw const>{ draws.data(), draws.size() });
+
+            for (MeshId mesh = 0; mesh < meshCount; ++mesh)
+            {
+                MeshGeometry geometry;
+                geometry.indexCount = 36 * (1 + mesh % 16);
+                geometry.firstIndex = mesh * 1024;
+                builder.SetMeshGeometry(mesh, 0, geometry);
+            }
+        }
+
+        ///
+        /// Measures the generation of the draw commands of the batches on one thread and on all of them, and counts the
+        /// draw calls that every path records. Recording needs a device, so its time is measured by the gpu-culling
+        /// benchmark.
+        ///
+        void BenchmarkDrawCommands()
+        {
+            const uint32_t maxDrawIndirectCount = 1u << 30;
+
+            std::vector<RenderQueue::Draw> draws;
+            InstanceBatcher batcher;
+            DrawCommandBuilder builder;
+            CreateDrawBatches(UINT32_MAX, draws, batcher, builder);
+
+            Table buildTable;
+            ThreadPool singleThread{ 1 };
+            double singleThreadTime = Measure([&]() { builder.Build(batcher, singleThread); });
+            buildTable.push_back({ "1", Format(singleThreadTime), Format(1) });
+            for (uint32_t threadCount = 2; threadCount <= std::thread::hardware_concurrency(); threadCount *= 2)
+            {
+                ThreadPool threadPool{ threadCount };
+                double time = Measure([&]() { builder.Build(batcher, threadPool); });
+                buildTable.push_back({ std::to_string(threadCount), Format(time), Format(singleThreadTime / time) });
+            }
+
+            builder.SetMaxDrawIndirectCount(maxDrawIndirectCount);
+            DrawCommandBuilder::Stats const & stats = builder.GetStats();
+            Table callTable = {
+                { "Direct", std::to_string(builder.GetCallCount(0, DrawCommandBuilder::Path::Direct)) },
+                { "Single draw indirect", std::to_string(builder.GetCallCount(0, DrawCommandBuilder::Path::SingleDrawIndirect)) },
+                { "Multi-draw indirect", std::to_string(builder.GetCallCount(0, DrawCommandBuilder::Path::MultiDrawIndirect)) },
+            };
+
+            std::cout << draws.size() << " objects, " << stats.commandCount << " instanced draws, " << stats.rangeCount << " state ranges" << std::endl;
+            Print({ "Threads", "Build (ms)", "Speedup" }, buildTable);
+            Print({ "Path", "Draw calls" }, callTable);
+        }
+
+        ///
+        /// Records the draws of the batches of the draw commands benchmark on every path supported by the device, into a
+        /// render pass with the instance pipeline bound, and prints the time of the recording of every path. The command
+        /// buffer is not submitted, since the geometry of the meshes is not loaded.
+        ///
+        void MeasureDrawRecording(VkCommandBuffer commandBuffer)
+        {
+            const uint32_t size = 64;
+
+            VulkanManager * vulkanManager = Application::GetInstance().GetVulkanManager();
+            GraphicsHelper * graphicsHelper = Application::GetInstance().GetGraphicsHelper();
+            VkDevice device = vulkanManager->GetDevice();
+            VkPhysicalDeviceFeatures const & features = vulkanManager->GetEnabledFeatures();
+
+            // The limits of the SceneRenderer.
+            VkPhysicalDeviceProperties properties;
+            vkGetPhysicalDeviceProperties(vulkanManager->GetPhysicalDevice(), &properties);
+            std::vector<RenderQueue::Draw> draws;
+            InstanceBatcher batcher;
+            DrawCommandBuilder builder;
+            CreateDrawBatches((uint32_t)(properties.limits.maxStorageBufferRange / sizeof(InstanceBatcher::InstanceData) / 64 * 64), draws, batcher, builder);
+            builder.SetMaxDrawIndirectCount(properties.limits.maxDrawIndirectCount);
+            builder.Build(batcher);
+
+            auto createAttachment = [&](VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspectMask, VkImage & image, VkDeviceMemory & memory, VkImageView & view) {
+                VkImageCreateInfo imageCreateInfo{};
+                imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+                imageCreateInfo.pNext = NULL;
+                imageCreateInfo.flags = 0;
+                imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+                imageCreateInfo.format = format;
+                imageCreateInfo.extent = VkExtent3D{ size, size, 1 };
+                imageCreateInfo.mipLevels = 1;
+                imageCreateInfo.arrayLayers = 1;
+                imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+                imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+                imageCreateInfo.usage = usage;
+                imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+                imageCreateInfo.queueFamilyIndexCount = 0;
+                imageCreateInfo.pQueueFamilyIndices = NULL;
+                imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                CheckResult(vkCreateImage(device, &imageCreateInfo, NULL, &image));
+                memory = AllocateAndBindImageMemory(image);
+
+                VkImageViewCreateInfo imageViewCreateInfo{};
+                imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+                imageViewCreateInfo.pNext = NULL;
+                imageViewCreateInfo.flags = 0;
+                imageViewCreateInfo.image = image;
+                imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+                imageViewCreateInfo.format = format;
+                imageViewCreateInfo.components = VkComponentMapping{ VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY };
+                imageViewCreateInfo.subresourceRange = VkImageSubresourceRange{ aspectMask, 0, 1, 0, 1 };
+                CheckResult(vkCreateImageView(device, &imageViewCreateInfo, NULL, &view));
+            };
+            VkImage colorImage;
+            VkDeviceMemory colorMemory;
+            VkImageView colorView;
+            createAttachment(Configuration::SceneColorFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT, colorImage, colorMemory, colorView);
+            VkImage depthImage;
+            VkDeviceMemory depthMemory;
+            VkImageView depthView;
+            createAttachment(Configuration::SceneDepthStencilFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT, depthImage, depthMemory, depthView);
+
+            // The attachments of the forward pass of the SceneRenderer, whose content doesn't matter.
+            std::array<VkAttachmentDescription, 2> attachments;
+            attachments[0].flags = 0;
+            attachments[0].format = Configuration::SceneColorFormat;
+            attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+            attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            attachments[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            attachments[1] = attachments[0];
+            attachments[1].format = Configuration::SceneDepthStencilFormat;
+            attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+            VkAttachmentReference colorAttachmentReference{ 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+            VkAttachmentReference depthAttachmentReference{ 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+            VkSubpassDescription subpass{};
+            subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+            subpass.colorAttachmentCount = 1;
+            subpass.pColorAttachments = &colorAttachmentReference;
+            subpass.pDepthStencilAttachment = &depthAttachmentReference;
+
+            VkRenderPassCreateInfo renderPassCreateInfo{};
+            renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+            renderPassCreateInfo.pNext = NULL;
+            renderPassCreateInfo.flags = 0;
+            renderPassCreateInfo.attachmentCount = (uint32_t)attachments.size();
+            renderPassCreateInfo.pAttachments = attachments.data();
+            renderPassCreateInfo.subpassCount = 1;
+            renderPassCreateInfo.pSubpasses = &subpass;
+            renderPassCreateInfo.dependencyCount = 0;
+            renderPassCreateInfo.pDependencies = NULL;
+            VkRenderPass renderPass;
+            CheckResult(vkCreateRenderPass(device, &renderPassCreateInfo, NULL, &renderPass));
+
+            std::array<VkImageView, 2> views = { colorView, depthView };
+            VkFramebufferCreateInfo framebufferCreateInfo{};
+            framebufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            framebufferCreateInfo.pNext = NULL;
+            framebufferCreateInfo.flags = 0;
+            framebufferCreateInfo.renderPass = renderPass;
+            framebufferCreateInfo.attachmentCount = (uint32_t)views.size();
+            framebufferCreateInfo.pAttachments = views.data();
+            framebufferCreateInfo.width = size;
+            framebufferCreateInfo.height = size;
+            framebufferCreateInfo.layers = 1;
+            VkFramebuffer framebuffer;
+            CheckResult(vkCreateFramebuffer(device, &framebufferCreateInfo, NULL, &framebuffer));
+
+            InstancePipelineGenerator pipeline{ renderPass, 0, false };
+
+            // The buffers are bound as the SceneRenderer binds them, but their content isn't written.
+            MappedBuffer instanceBuffer{ VK_BUFFER_USAGE_STORAGE_BUFFER_BIT };
+            instanceBuffer.Reserve(batcher.GetBufferInstanceCount() * sizeof(InstanceBatcher::InstanceData));
+            MappedBuffer indirectBuffer{ VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT };
+            indirectBuffer.Reserve(builder.GetCommands().size() * sizeof(VkDrawIndexedIndirectCommand));
+
+            VkDescriptorSetLayout descriptorSetLayout = pipeline.GetDescriptorSetLayout();
+            VkDescriptorSetAllocateInfo descriptorSetAllocInfo{};
+            descriptorSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            descriptorSetAllocInfo.pNext = NULL;
+            descriptorSetAllocInfo.descriptorPool = vulkanManager->GetDescriptorPool();
+            descriptorSetAllocInfo.descriptorSetCount = 1;
+            descriptorSetAllocInfo.pSetLayouts = &descriptorSetLayout;
+            VkDescriptorSet descriptorSet;
+            CheckResult(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &descriptorSet));
+
+            VkDescriptorBufferInfo bufferInfo{ instanceBuffer.GetBuffer(), 0, batcher.GetBindingInstanceCount() * sizeof(InstanceBatcher::InstanceData) };
+            VkWriteDescriptorSet writeDescriptorSet{};
+            writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writeDescriptorSet.pNext = NULL;
+            writeDescriptorSet.dstSet = descriptorSet;
+            writeDescriptorSet.dstBinding = 0;
+            writeDescriptorSet.dstArrayElement = 0;
+            writeDescriptorSet.descriptorCount = 1;
+            writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+            writeDescriptorSet.pImageInfo = NULL;
+            writeDescriptorSet.pBufferInfo = &bufferInfo;
+            writeDescriptorSet.pTexelBufferView = NULL;
+            vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, NULL);
+
+            // Every run records the whole command buffer, as the SceneRenderer does every frame.
+            Table table;
+            auto addRow = [&](char const * name, DrawCommandBuilder::Path path, bool isSupported) {
+                if (!isSupported)
+                {
+                    table.push_back({ name, std::to_string(builder.GetCallCount(0, path)), "-" });
+                    return;
+                }
+
+                double time = Measure([&]() {
+                    VkCommandBufferBeginInfo beginInfo{};
+                    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                    beginInfo.pNext = NULL;
+                    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+                    beginInfo.pInheritanceInfo = NULL;
+                    CheckResult(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+
+                    VkRenderPassBeginInfo renderPassBeginInfo{};
+                    renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+                    renderPassBeginInfo.pNext = NULL;
+                    renderPassBeginInfo.renderPass = renderPass;
+                    renderPassBeginInfo.framebuffer = framebuffer;
+                    renderPassBeginInfo.renderArea = VkRect2D{ { 0, 0 }, { size, size } };
+                    renderPassBeginInfo.clearValueCount = 0;
+                    renderPassBeginInfo.pClearValues = NULL;
+                    vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+                    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.GetPipeline());
+                    VkBuffer vertices = graphicsHelper->GetBoxVertices();
+                    VkDeviceSize offsets = 0;
+                    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices, &offsets);
+                    vkCmdBindIndexBuffer(commandBuffer, graphicsHelper->GetBoxIndices(), 0, VK_INDEX_TYPE_UINT32);
+                    VkViewport viewport{ 0, 0, (float)size, (float)size, 0, 1 };
+                    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+                    vkCmdSetScissor(commandBuffer, 0, 1, &renderPassBeginInfo.renderArea);
+                    glm::mat4 viewProjection{ 1 };
+                    vkCmdPushConstants(commandBuffer, pipeline.GetPipelineLayout(), VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &viewProjection);
+
+                    builder.Record(commandBuffer, 0, path, indirectBuffer.GetBuffer(), [&](DrawCommandBuilder::DrawRange const & range) {
+                        uint32_t offset = range.bindingOffset * sizeof(InstanceBatcher::InstanceData);
+                        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.GetPipelineLayout(), 0, 1, &descriptorSet, 1, &offset);
+                    });
+
+                    vkCmdEndRenderPass(commandBuffer);
+                    CheckResult(vkEndCommandBuffer(commandBuffer));
+                });
+                table.push_back({ name, std::to_string(builder.GetCallCount(0, path)), Format(time) });
+            };
+            addRow("Direct", DrawCommandBuilder::Path::Direct, true);
+            addRow("Single draw indirect", DrawCommandBuilder::Path::SingleDrawIndirect, features.drawIndirectFirstInstance == VK_TRUE);
+            addRow("Multi-draw indirect", DrawCommandBuilder::Path::MultiDrawIndirect, features.drawIndirectFirstInstance == VK_TRUE && features.multiDrawIndirect == VK_TRUE);
+
+            DrawCommandBuilder::Stats const & stats = builder.GetStats();
+            std::cout << draws.size() << " objects, " << stats.commandCount << " instanced draws, " << stats.rangeCount << " state ranges, up to "
+                << properties.limits.maxDrawIndirectCount << " draws per indirect call" << std::endl;
+            Print({ "Path", "Draw calls", "Recording (ms)" }, table);
+
+            CheckResult(vkFreeDescriptorSets(device, vulkanManager->GetDescriptorPool(), 1, &descriptorSet));
+            vkDestroyFramebuffer(device, framebuffer, NULL);
+            vkDestroyRenderPass(device, renderPass, NULL);
+            vkDestroyImageView(device, depthView, NULL);
+            vkFreeMemory(device, depthMemory, NULL);
+            vkDestroyImage(device, depthImage, NULL);
+            vkDestroyImageView(device, colorView, NULL);
+            vkFreeMemory(device, colorMemory, NULL);
+            vkDestroyImage(device, colorImage, NULL);
+        }
+
+        ///
+        /// Culls boxes partly hidden behind a wall with the GpuCuller, on the default device of the Application, and
+        /// compares the results with the reference culling of the CPU. Then measures the recording of the draws on every
+        /// path. Unlike the other benchmarks, it needs a Vulkan device, which may be a software one such as lavapipe, and
+        /// the compiled shaders.
+        ///
+        void BenchmarkGpuCulling()
+        {
+            const uint32_t width = 1280;
+            const uint32_t height = 720;
+            const uint32_t meshCount = 256;
+            const float wallDistance = 50;
+
+            VulkanManager * vulkanManager = Application::GetInstance().GetVulkanManager();
+            VkDevice device = vulkanManager->GetDevice();
+            VkQueue queue = vulkanManager->GetGraphicsQueue();
+
+            glm::mat4 projection = glm::perspective(glm::radians(60.0f), (float)width / height, 0.1f, 1000.0f);
+            glm::mat4 viewProjection = projection * glm::lookAt(glm::vec3{ 0, 0, 0 }, glm::vec3{ 0, 0, -1 }, glm::vec3{ 0, 1, 0 });
+            VkRect2D viewport{ { 0, 0 }, { width, height } };
+
+            // The wall covers the middle of the upper half of the view, with the far plane around it, as 24 bits depths.
+            // The viewport doesn't flip y, so the upper half of the view is on the last rows.
+            glm::vec4 wall = projection * glm::vec4{ 0, 0, -wallDistance, 1 };
+            uint32_t wallDepth = (uint32_t)std::lround(wall.z / wall.w * 16777215.0);
+            std::vector<uint32_t> texels(width * height);
+            std::vector<float> depths(width * height);
+            for (uint32_t y = 0; y < height; ++y)
+            {
+                for (uint32_t x = 0; x < width; ++x)
+                {
+                    bool isWall = x >= width / 4 && x < 3 * width / 4 && y >= height / 2 && y < 7 * height / 8;
+                    texels[y * width + x] = isWall ? wallDepth : 16777215;
+                    depths[y * width + x] = texels[y * width + x] / 16777215.0f;
+                }
+            }
+
+            VkImageCreateInfo imageCreateInfo{};
+            imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageCreateInfo.pNext = NULL;
+            imageCreateInfo.flags = 0;
+            imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageCreateInfo.format = Configuration::SceneDepthStencilFormat;
+            imageCreateInfo.extent = VkExtent3D{ width, height, 1 };
+            imageCreateInfo.mipLevels = 1;
+            imageCreateInfo.arrayLayers = 1;
+            imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageCreateInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+            imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            imageCreateInfo.queueFamilyIndexCount = 0;
+            imageCreateInfo.pQueueFamilyIndices = NULL;
+            imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            VkImage depthImage;
+            CheckResult(vkCreateImage(device, &imageCreateInfo, NULL, &depthImage));
+            VkDeviceMemory depthMemory = AllocateAndBindImageMemory(depthImage);
+
+            VkImageViewCreateInfo imageViewCreateInfo{};
+            imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            imageViewCreateInfo.pNext = NULL;
+            imageViewCreateInfo.flags = 0;
+            imageViewCreateInfo.image = depthImage;
+            imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            imageViewCreateInfo.format = Configuration::SceneDepthStencilFormat;
+            imageViewCreateInfo.components = VkComponentMapping{ VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY };
+            imageViewCreateInfo.subresourceRange = VkImageSubresourceRange{ VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+            VkImageView depthView;
+            CheckResult(vkCreateImageView(device, &imageViewCreateInfo, NULL, &depthView));
+
+            VkCommandBufferAllocateInfo allocateInfo{};
+            allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocateInfo.pNext = NULL;
+            allocateInfo.commandPool = vulkanManager->GetGraphicsCommandPool();
+            allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocateInfo.commandBufferCount = 1;
+            VkCommandBuffer commandBuffer;
+            CheckResult(vkAllocateCommandBuffers(device, &allocateInfo, &commandBuffer));
+
+            auto begin = [&]() {
+                VkCommandBufferBeginInfo beginInfo{};
+                beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                beginInfo.pNext = NULL;
+                beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+                beginInfo.pInheritanceInfo = NULL;
+                CheckResult(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+            };
+            auto submit = [&]() {
+                CheckResult(vkEndCommandBuffer(commandBuffer));
+                VkSubmitInfo submitInfo{};
+                submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+                submitInfo.pNext = NULL;
+                submitInfo.commandBufferCount = 1;
+                submitInfo.pCommandBuffers = &commandBuffer;
+                CheckResult(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+                CheckResult(vkQueueWaitIdle(queue));
+            };
+            auto transition = [&](VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccess, VkAccessFlags dstAccess) {
+                VkImageMemoryBarrier barrier{};
+                barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                barrier.pNext = NULL;
+                barrier.srcAccessMask = srcAccess;
+                barrier.dstAccessMask = dstAccess;
+                barrier.oldLayout = oldLayout;
+                barrier.newLayout = newLayout;
+                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.image = depthImage;
+                barrier.subresourceRange = VkImageSubresourceRange{ VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT, 0, 1, 0, 1 };
+                vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, NULL, 0, NULL, 1, &barrier);
+            };
+
+            // The depths are uploaded as if the render pass had drawn them, and the pyramid is built from them.
+            GpuCuller culler;
+            culler.SetDepthImage(depthImage, depthView, width, height);
+            culler.SetValidation(true);
+            {
+                MappedBuffer staging{ VK_BUFFER_USAGE_TRANSFER_SRC_BIT };
+                staging.Reserve(texels.size() * sizeof(uint32_t));
+                memcpy(staging.GetData(), texels.data(), texels.size() * sizeof(uint32_t));
+
+                VkBufferImageCopy region{};
+                region.imageSubresource = VkImageSubresourceLayers{ VK_IMAGE_ASPECT_DEPTH_BIT, 0, 0, 1 };
+                region.imageExtent = VkExtent3D{ width, height, 1 };
+
+                begin();
+                transition(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT);
+                vkCmdCopyBufferToImage(commandBuffer, staging.GetBuffer(), depthImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+                transition(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+                culler.RecordPyramid(commandBuffer);
+                submit();
+            }
+
+            HzbPyramid reference;
+            reference.Resize(width, height);
+
+            // A box behind the wall must be culled, and the same box below the center of the view must not.
+            {
+                GpuCullView view{};
+                view.viewProjection = viewProjection;
+                Frustum frustum = Frustum::FromMatrix(viewProjection);
+                std::copy(frustum.planes, frustum.planes + Frustum::PlaneCount, view.planes);
+                view.viewport = glm::vec4{ 0, 0, width, height };
+                view.levelCount = reference.GetLevelCount();
+                reference.Build(depths.data());
+
+                // Half way up the wall, at twice its distance.
+                float y = 0.375f * 2 * wallDistance / projection[1][1];
+                GpuCullInstance above{ glm::vec3{ 0, y, -2 * wallDistance }, 0, glm::vec3{ 1 }, 0 };
+                GpuCullInstance below{ glm::vec3{ 0, -y, -2 * wallDistance }, 0, glm::vec3{ 1 }, 0 };
+                bool isCorrect = !reference.IsVisible(view, above) && reference.IsVisible(view, below);
+                std::cout << "Box behind the wall culled, and the box below it kept: " << (isCorrect ? "yes" : "NO") << std::endl;
+            }
+
+            Table table;
+            for (uint32_t count : { 10000u, 100000u, 1000000u })
+            {
+                std::mt19937 random{ 1 };
+                std::uniform_real_distribution<float> xyDistribution{ -100, 100 };
+                std::uniform_real_distribution<float> zDistribution{ -300, -5 };
+                std::uniform_real_distribution<float> sizeDistribution{ 0.5f, 2 };
+                std::vector<Aabb> bounds(count);
+                std::vector<RenderQueue::Draw> draws(count);
+                for (uint32_t i = 0; i < count; ++i)
+                {
+                    glm::vec3 center{ xyDistribution(random), xyDistribution(random), zDistribution(random) };
+                    glm::vec3 extents = glm::vec3{ sizeDistribution(random) };
+                    bounds[i] = Aabb{ center - extents, center + extents };
+
+                    RenderQueue::Draw & draw = draws[i];
+                    draw.object = i;
+                    draw.material = 0;
+                    draw.pipeline = 0;
+                    draw.mesh = random() % meshCount;
+                    draw.level = 0;
+                    draw.key = draw.mesh;
+                }
+                std::sort(draws.begin(), draws.end(), [](RenderQueue::Draw const & a, RenderQueue::Draw const & b) { return a.key < b.key; });
+
+                InstanceBatcher batcher;
+                batcher.AddView(Span<RenderQueue::Draw const>{ draws.data(), draws.size() });
+                DrawCommandBuilder builder;
+                for (MeshId mesh = 0; mesh < meshCount; ++mesh)
+                {
+                    MeshGeometry geometry;
+                    geometry.indexCount = 36;
+                    geometry.firstIndex = mesh * 36;
+                    builder.SetMeshGeometry(mesh, 0, geometry);
+                }
+                builder.Build(batcher);
+
+                // The reference builds the pyramid and culls every instance on one thread.
+                GpuCullView referenceView{};
+                referenceView.viewProjection = viewProjection;
+                Frustum frustum = Frustum::FromMatrix(viewProjection);
+                std::copy(frustum.planes, frustum.planes + Frustum::PlaneCount, referenceView.planes);
+                referenceView.viewport = glm::vec4{ 0, 0, width, height };
+                referenceView.levelCount = reference.GetLevelCount();
+                uint32_t referenceVisibleCount = 0;
+                double referenceTime = Measure([&]() {
+                    reference.Build(depths.data());
+                    referenceVisibleCount = 0;
+                    for (uint32_t i = 0; i < count; ++i)
+                    {
+                        GpuCullInstance instance{ bounds[i].GetCenter(), 0, bounds[i].GetExtents(), 0 };
+                        referenceVisibleCount += reference.IsVisible(referenceView, instance) ? 1 : 0;
+                    }
+                });
+
+                // Every frame writes the inputs of the culling, runs it and waits for it, as the SceneRenderer would.
+                GpuCuller::View view{ viewProjection, viewport };
+                GpuCuller::Stats before = culler.GetStats();
+                double prepareTime = 0;
+                double frameTime = Measure([&]() {
+                    culler.Prepare(Span<GpuCuller::View const>{ &view, 1 }, bounds.data(), batcher, builder.GetCommands());
+                    prepareTime = culler.GetStats().prepareTime;
+                    begin();
+                    culler.RecordCulling(commandBuffer);
+                    transition(VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, 0, VK_ACCESS_SHADER_READ_BIT);
+                    submit();
+                    culler.Validate();
+                });
+
+                GpuCuller::Stats const & stats = culler.GetStats();
+                uint32_t frameCount = stats.validatedFrameCount - before.validatedFrameCount;
+                uint64_t visibleCount = (stats.visibleCount - before.visibleCount) / frameCount;
+                uint64_t errorCount = stats.wrongCulledCount - before.wrongCulledCount + stats.wrongVisibleCount - before.wrongVisibleCount +
+                    stats.pyramidMismatchCount - before.pyramidMismatchCount;
+                table.push_back({ std::to_string(count), std::to_string(referenceVisibleCount), std::to_string(visibleCount), Format(referenceTime), Format(prepareTime),
+                    Format(frameTime), visibleCount == referenceVisibleCount && errorCount == 0 ? "yes" : "NO" });
+            }
+
+            Print({ "Objects", "Visible (CPU)", "Visible (GPU)", "CPU culling (ms)", "GPU preparation (ms)", "GPU frame (ms)", "Same result" }, table);
+            culler.PrintStats();
+
+            MeasureDrawRecording(commandBuffer);
+
+            vkFreeCommandBuffers(device, vulkanManager->GetGraphicsCommandPool(), 1, &commandBuffer);
+            vkDestroyImageView(device, depthView, NULL);
+            vkFreeMemory(device, depthMemory, NULL);
+            vkDestroyImage(device, depthImage, NULL);
+        }
+
+        struct Benchmark
+        {
+            char const * name;
+            void (*function)();
+        };
+
+        Benchmark const s_Benchmarks[] =
+        {
+            { "transforms", BenchmarkTransforms },
+            { "hierarchy", BenchmarkHierarchy },
+            { "matrix-kernels", BenchmarkMatrixKernels },
+            { "pools", BenchmarkPools },
+            { "component-queries", BenchmarkComponentQueries },
+            { "hierarchy-edits", BenchmarkHierarchyEdits },
+            { "hierarchy-index", BenchmarkHierarchyIndex },
+            { "names", BenchmarkNames },
+            { "command-buffer", BenchmarkCommandBuffer },
+            { "scene-load", BenchmarkSceneLoad },
+            { "streaming", BenchmarkStreaming },
+            { "render-snapshot", BenchmarkRenderSnapshot },
+            { "bvh", BenchmarkBvh },
+            { "frustum-culling", BenchmarkFrustumCulling },
+            { "occlusion-culling", BenchmarkOcclusionCulling },
+            { "lod-selection", BenchmarkLodSelection },
+            { "multi-view", BenchmarkMultiView },
+            { "change-journal", BenchmarkChangeJournal },
+            { "simulation-loop", BenchmarkSimulationLoop },
+            { "render-queue", BenchmarkRenderQueue },
+            { "instancing", BenchmarkInstancing },
+            { "draw-commands", BenchmarkDrawCommands },
+            { "gpu-culling", BenchmarkGpuCulling },
+        };
+    }
+
+    bool RunBenchmark(char const * name)
+    {
+        for (auto const & benchmark : s_Benchmarks)
+        {
+            if (strcmp(benchmark.name, name) == 0)
+            {
+                std::cout << "Benchmark: " << benchmark.name << std::endl;
+                benchmark.function();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void ListBenchmarks()
+    {
+        std::cout << "Available benchmarks:" << std::endl;
+        for (auto const & benchmark : s_Benchmarks)
+        {
+            std::cout << "  " << benchmark.name << std::endl;
+        }
+    }
+} // VulkanDemo
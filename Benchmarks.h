@@ -0,0 +1,18 @@
+#pragma once
+
+namespace VulkanDemo
+{
+    ///
+    /// Runs the CPU benchmark with the given name and prints its results in the console. The benchmarks do not need a
+    /// Vulkan device, so they are run without creating the Application, except gpu-culling, which creates it to run on
+    /// its default device.
+    ///
+    /// @return false if there is no benchmark with that name.
+    ///
+    bool RunBenchmark(char const * name);
+
+    ///
+    /// Prints the names of the available benchmarks in the console.
+    ///
+    void ListBenchmarks();
+} // VulkanDemo
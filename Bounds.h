@@ -0,0 +1,243 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#include "AlignedAllocator.h"
+
+namespace VulkanDemo
+{
+    ///
+    /// Axis-aligned bounding box. An empty box has its minimum above its maximum, so that extending it by any point or
+    /// box gives that point or box.
+    ///
+    struct Aabb
+    {
+        glm::vec3 min;
+        glm::vec3 max;
+
+        Aabb() :
+            min{ (std::numeric_limits<float>::max)() },
+            max{ -(std::numeric_limits<float>::max)() }
+        {
+        }
+
+        Aabb(glm::vec3 const & min, glm::vec3 const & max) :
+            min{ min },
+            max{ max }
+        {
+        }
+
+        inline bool IsEmpty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+
+        inline glm::vec3 GetCenter() const { return (min + max) * 0.5f; }
+
+        ///
+        /// Returns the half size of the box along every axis.
+        ///
+        inline glm::vec3 GetExtents() const { return (max - min) * 0.5f; }
+
+        inline float GetSurfaceArea() const
+        {
+            glm::vec3 size = max - min;
+            return 2 * (size.x * size.y + size.y * size.z + size.z * size.x);
+        }
+
+        inline void Extend(glm::vec3 const & point)
+        {
+            min = (glm::min)(min, point);
+            max = (glm::max)(max, point);
+        }
+
+        inline void Extend(Aabb const & other)
+        {
+            min = (glm::min)(min, other.min);
+            max = (glm::max)(max, other.max);
+        }
+
+        inline bool Contains(glm::vec3 const & point) const
+        {
+            return point.x >= min.x && point.x <= max.x && point.y >= min.y && point.y <= max.y && point.z >= min.z && point.z <= max.z;
+        }
+
+        inline bool Overlaps(Aabb const & other) const
+        {
+            return min.x <= other.max.x && max.x >= other.min.x &&
+                min.y <= other.max.y && max.y >= other.min.y &&
+                min.z <= other.max.z && max.z >= other.min.z;
+        }
+
+        ///
+        /// Returns the smallest box containing this box transformed by the affine matrix. The extents are projected
+        /// onto the axes with the absolute values of the matrix, which avoids transforming the 8 corners.
+        ///
+        inline Aabb Transformed(glm::mat4 const & matrix) const
+        {
+            if (IsEmpty())
+            {
+                return *this;
+            }
+
+            glm::vec3 center = GetCenter();
+            glm::vec3 extents = GetExtents();
+
+            glm::vec3 worldCenter{ matrix[3][0], matrix[3][1], matrix[3][2] };
+            glm::vec3 worldExtents{ 0, 0, 0 };
+            for (int column = 0; column < 3; ++column)
+            {
+                for (int row = 0; row < 3; ++row)
+                {
+                    worldCenter[row] += matrix[column][row] * center[column];
+                    worldExtents[row] += std::abs(matrix[column][row]) * extents[column];
+                }
+            }
+            return Aabb{ worldCenter - worldExtents, worldCenter + worldExtents };
+        }
+    };
+
+    ///
+    /// Volume bounded by six planes, typically the view volume of a camera.
+    ///
+    struct Frustum
+    {
+        enum Plane
+        {
+            Left,
+            Right,
+            Bottom,
+            Top,
+            Near,
+            Far,
+            PlaneCount,
+        };
+
+        enum class Containment
+        {
+            Outside,
+            Intersecting,
+            Inside,
+        };
+
+        // Normals in xyz, pointing inside, and distances in w: a point p is inside a plane when dot(xyz, p) + w >= 0.
+        glm::vec4 planes[PlaneCount];
+
+        ///
+        /// Extracts the planes of a view-projection matrix as built by glm with GLM_FORCE_DEPTH_ZERO_TO_ONE, with the
+        /// depth going from 0 to w in clip space, as in Vulkan. The planes are normalized, so that the distances are in
+        /// world units.
+        ///
+        static Frustum FromMatrix(glm::mat4 const & viewProjection)
+        {
+            glm::vec4 rows[4];
+            for (int row = 0; row < 4; ++row)
+            {
+                rows[row] = glm::vec4{ viewProjection[0][row], viewProjection[1][row], viewProjection[2][row], viewProjection[3][row] };
+            }
+
+            Frustum frustum;
+            frustum.planes[Left] = rows[3] + rows[0];
+            frustum.planes[Right] = rows[3] - rows[0];
+            frustum.planes[Bottom] = rows[3] + rows[1];
+            frustum.planes[Top] = rows[3] - rows[1];
+            frustum.planes[Near] = rows[2];
+            frustum.planes[Far] = rows[3] - rows[2];
+            for (glm::vec4 & plane : frustum.planes)
+            {
+                plane /= glm::length(glm::vec3{ plane });
+            }
+            return frustum;
+        }
+
+        ///
+        /// Tells whether the box is outside, across the boundary, or inside the frustum. A box outside of none of the
+        /// planes but across several of them may be reported as intersecting while it is outside, near the corners.
+        ///
+        inline Containment Classify(Aabb const & box) const
+        {
+            glm::vec3 center = box.GetCenter();
+            glm::vec3 extents = box.GetExtents();
+
+            Containment containment = Containment::Inside;
+            for (glm::vec4 const & plane : planes)
+            {
+                float distance = glm::dot(glm::vec3{ plane }, center) + plane.w;
+                float radius = glm::dot(glm::abs(glm::vec3{ plane }), extents);
+                if (distance < -radius)
+                {
+                    return Containment::Outside;
+                }
+                if (distance < radius)
+                {
+                    containment = Containment::Intersecting;
+                }
+            }
+            return containment;
+        }
+
+        inline bool Intersects(Aabb const & box) const
+        {
+            return Classify(box) != Containment::Outside;
+        }
+    };
+
+    ///
+    /// Boxes stored as one array per coordinate of their centers and extents, as read by SIMD code. The arrays are
+    /// padded to a multiple of Padding elements, so that the last group of boxes can be loaded whole; the values of the
+    /// padding are finite but meaningless.
+    ///
+    class PackedBounds
+    {
+    public:
+        static const uint32_t Padding = 8;
+
+        enum Array
+        {
+            CenterX,
+            CenterY,
+            CenterZ,
+            ExtentX,
+            ExtentY,
+            ExtentZ,
+            ArrayCount,
+        };
+
+        inline uint32_t GetCount() const { return m_Count; }
+
+        void Resize(uint32_t count)
+        {
+            m_Count = count;
+            for (AlignedVector<float> & array : m_Arrays)
+            {
+                array.resize((count + Padding - 1) / Padding * Padding, 0.0f);
+            }
+        }
+
+        inline void Set(uint32_t index, Aabb const & box)
+        {
+            glm::vec3 center = box.GetCenter();
+            glm::vec3 extents = box.GetExtents();
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                m_Arrays[CenterX + axis][index] = center[axis];
+                m_Arrays[ExtentX + axis][index] = extents[axis];
+            }
+        }
+
+        inline Aabb Get(uint32_t index) const
+        {
+            glm::vec3 center{ m_Arrays[CenterX][index], m_Arrays[CenterY][index], m_Arrays[CenterZ][index] };
+            glm::vec3 extents{ m_Arrays[ExtentX][index], m_Arrays[ExtentY][index], m_Arrays[ExtentZ][index] };
+            return Aabb{ center - extents, center + extents };
+        }
+
+        inline float const * GetArray(Array array) const { return m_Arrays[array].data(); }
+
+    private:
+        AlignedVector<float>    m_Arrays[ArrayCount];
+        uint32_t                m_Count = 0;
+    };
+} // VulkanDemo
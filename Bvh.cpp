@@ -0,0 +1,695 @@
+#include "Bvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#include "ThreadPool.h"
+
+namespace VulkanDemo
+{
+    namespace
+    {
+        const uint32_t BinCount = 16;
+        const uint32_t MaxLeafSize = 4;
+
+        // Beyond this depth, nodes are split at the median, which bounds the depth of degenerate distributions.
+        const uint32_t MaxSahDepth = 64;
+
+        // Subtrees below this size are built by a single thread.
+        const uint32_t MinTaskSize = 4096;
+
+        // Costs of the surface area heuristic.
+        const float TraversalCost = 1;
+        const float IntersectionCost = 1;
+
+        const uint32_t InsideFlag = 0x80000000;
+
+        ///
+        /// Stack of a traversal, on the call stack unless the tree is unusually deep.
+        ///
+        template<typename T>
+        class TraversalStack
+        {
+        public:
+            inline bool IsEmpty() const { return m_Size == 0; }
+
+            inline void Push(T const & value)
+            {
+                if (m_Size < LocalCapacity)
+                {
+                    m_Local[m_Size] = value;
+                }
+                else
+                {
+                    m_Overflow.push_back(value);
+                }
+                ++m_Size;
+            }
+
+            inline T Pop()
+            {
+                --m_Size;
+                if (m_Size < LocalCapacity)
+                {
+                    return m_Local[m_Size];
+                }
+
+                T value = m_Overflow.back();
+                m_Overflow.pop_back();
+                return value;
+            }
+
+        private:
+            static const uint32_t LocalCapacity = 64;
+
+            T m_Local[LocalCapacity];
+            std::vector<T> m_Overflow;
+            uint32_t m_Size = 0;
+        };
+
+        inline float GetDistanceSquared(Aabb const & box, glm::vec3 const & point)
+        {
+            glm::vec3 offset = (glm::max)((glm::max)(box.min - point, glm::vec3{ 0 }), point - box.max);
+            return glm::dot(offset, offset);
+        }
+
+        inline uint32_t GetBin(float center, float minimum, float scale)
+        {
+            return (std::min)((uint32_t)((center - minimum) * scale), BinCount - 1);
+        }
+    }
+
+    // The items are partitioned with their box and center, which keeps the passes over them sequential.
+    struct Bvh::BuildItem
+    {
+        Aabb bounds;
+        glm::vec3 center;
+        uint32_t index;
+    };
+
+    struct Bvh::BuildContext
+    {
+        std::vector<BuildItem> items;
+        std::vector<Node> nodes;
+        uint32_t taskSize;
+    };
+
+    Bvh::Bvh()
+    {
+    }
+
+    Bvh::~Bvh()
+    {
+    }
+
+    void Bvh::Build(Aabb const * bounds, uint32_t count)
+    {
+        m_Nodes.clear();
+        m_Items.resize(count);
+        m_ItemBounds.resize(count);
+        m_IsDepthFirst = true;
+        m_AreLinksValid = false;
+        if (count == 0)
+        {
+            return;
+        }
+
+        ThreadPool & pool = ThreadPool::GetDefault();
+
+        // The root and at most count - 1 pairs of children.
+        BuildContext context;
+        context.items.resize(count);
+        context.nodes.resize(2 * count - 1);
+        pool.ParallelFor(count, 1024, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                context.items[i] = BuildItem{ bounds[i], bounds[i].GetCenter(), i };
+            }
+        });
+
+        // The top of the tree is split by this thread until the subtrees are small enough to balance the threads, then
+        // the subtrees are built in parallel. A subtree of n items has at most n - 1 pairs of children, which tells
+        // where the nodes of every subtree go.
+        uint32_t threadCount = pool.GetThreadCount();
+        context.taskSize = threadCount > 1 ? (std::max)(count / (threadCount * 8), MinTaskSize) : count;
+
+        std::vector<BuildTask> tasks;
+        uint32_t nextNode = 1;
+        BuildNode(context, 0, 0, count, nextNode, 0, &tasks);
+
+        std::vector<uint32_t> taskNodes(tasks.size());
+        for (size_t i = 0; i < tasks.size(); ++i)
+        {
+            taskNodes[i] = nextNode;
+            nextNode += 2 * (tasks[i].end - tasks[i].begin - 1);
+        }
+
+        pool.ParallelFor((uint32_t)tasks.size(), 1, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                BuildTask const & task = tasks[i];
+                BuildNode(context, task.node, task.begin, task.end, taskNodes[i], task.depth, nullptr);
+            }
+        });
+
+        Flatten(context.nodes);
+
+        pool.ParallelFor(count, 1024, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                m_Items[i] = context.items[i].index;
+                m_ItemBounds[i] = context.items[i].bounds;
+            }
+        });
+    }
+
+    void Bvh::BuildNode(BuildContext & context, uint32_t index, uint32_t begin, uint32_t end, uint32_t & nextNode, uint32_t depth, std::vector<BuildTask> * tasks)
+    {
+        if (tasks != nullptr && end - begin <= context.taskSize)
+        {
+            tasks->push_back(BuildTask{ index, begin, end, depth });
+            return;
+        }
+
+        Aabb bounds;
+        Aabb centerBounds;
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            bounds.Extend(context.items[i].bounds);
+            centerBounds.Extend(context.items[i].center);
+        }
+
+        Node & node = context.nodes[index];
+        node.bounds = bounds;
+
+        uint32_t middle = FindSplit(context, bounds, centerBounds, begin, end, depth);
+        if (middle == begin)
+        {
+            node.first = begin;
+            node.count = end - begin;
+            return;
+        }
+
+        uint32_t left = nextNode;
+        nextNode += 2;
+        node.first = left;
+        node.count = 0;
+
+        BuildNode(context, left, begin, middle, nextNode, depth + 1, tasks);
+        BuildNode(context, left + 1, middle, end, nextNode, depth + 1, tasks);
+    }
+
+    uint32_t Bvh::FindSplit(BuildContext & context, Aabb const & bounds, Aabb const & centerBounds, uint32_t begin, uint32_t end, uint32_t depth)
+    {
+        uint32_t count = end - begin;
+        if (count <= 1)
+        {
+            return begin;
+        }
+
+        BuildItem * items = context.items.data();
+        glm::vec3 extent = centerBounds.max - centerBounds.min;
+
+        if (depth >= MaxSahDepth)
+        {
+            if (count <= MaxLeafSize)
+            {
+                return begin;
+            }
+
+            int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+            uint32_t middle = begin + count / 2;
+            std::nth_element(items + begin, items + middle, items + end, [axis](BuildItem const & a, BuildItem const & b) {
+                return a.center[axis] < b.center[axis];
+            });
+            return middle;
+        }
+
+        struct Bin
+        {
+            Aabb bounds;
+            uint32_t count = 0;
+        };
+
+        float bestCost = (std::numeric_limits<float>::max)();
+        int bestAxis = -1;
+        uint32_t bestBin = 0;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            if (!(extent[axis] > 0))
+            {
+                continue;
+            }
+
+            float minimum = centerBounds.min[axis];
+            float scale = BinCount / extent[axis];
+
+            Bin bins[BinCount];
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                Bin & bin = bins[GetBin(items[i].center[axis], minimum, scale)];
+                bin.bounds.Extend(items[i].bounds);
+                ++bin.count;
+            }
+
+            // Cost of the right side of every split, the split after bin b leaving the bins above b on the right.
+            float rightCosts[BinCount];
+            Aabb rightBounds;
+            uint32_t rightCount = 0;
+            for (uint32_t b = BinCount - 1; b > 0; --b)
+            {
+                rightBounds.Extend(bins[b].bounds);
+                rightCount += bins[b].count;
+                rightCosts[b] = rightCount != 0 ? rightBounds.GetSurfaceArea() * rightCount : 0;
+            }
+
+            Aabb leftBounds;
+            uint32_t leftCount = 0;
+            for (uint32_t b = 0; b < BinCount - 1; ++b)
+            {
+                leftBounds.Extend(bins[b].bounds);
+                leftCount += bins[b].count;
+                if (leftCount == 0 || leftCount == count)
+                {
+                    continue;
+                }
+
+                float cost = leftBounds.GetSurfaceArea() * leftCount + rightCosts[b + 1];
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestBin = b;
+                }
+            }
+        }
+
+        if (bestAxis < 0)
+        {
+            // All the centers are at the same place, so any partition is as good.
+            return count <= MaxLeafSize ? begin : begin + count / 2;
+        }
+
+        float area = bounds.GetSurfaceArea();
+        float splitCost = TraversalCost + (area > 0 ? IntersectionCost * bestCost / area : 0);
+        if (count <= MaxLeafSize && count * IntersectionCost <= splitCost)
+        {
+            return begin;
+        }
+
+        float minimum = centerBounds.min[bestAxis];
+        float scale = BinCount / extent[bestAxis];
+        BuildItem * middle = std::partition(items + begin, items + end, [&](BuildItem const & item) {
+            return GetBin(item.center[bestAxis], minimum, scale) <= bestBin;
+        });
+        return (uint32_t)(middle - items);
+    }
+
+    void Bvh::Flatten(std::vector<Node> const & nodes)
+    {
+        m_Nodes.resize(nodes.size() + 1);
+        m_Nodes[0] = nodes[0];
+        m_Nodes[1] = Node{ Aabb{}, 0, 0 };
+
+        // Pairs of indices in the built nodes and in the flat nodes.
+        std::vector<std::pair<uint32_t, uint32_t>> stack;
+        stack.push_back(std::make_pair(0, 0));
+        uint32_t nextNode = 2;
+        while (!stack.empty())
+        {
+            auto indices = stack.back();
+            stack.pop_back();
+
+            Node const & node = nodes[indices.first];
+            if (node.IsLeaf())
+            {
+                continue;
+            }
+
+            uint32_t left = nextNode;
+            nextNode += 2;
+            m_Nodes[indices.second].first = left;
+            m_Nodes[left] = nodes[node.first];
+            m_Nodes[left + 1] = nodes[node.first + 1];
+
+            stack.push_back(std::make_pair(node.first + 1, left + 1));
+            stack.push_back(std::make_pair(node.first, left));
+        }
+        m_Nodes.resize(nextNode);
+    }
+
+    void Bvh::Refit(Aabb const * bounds, bool rotate)
+    {
+        if (m_Nodes.empty())
+        {
+            return;
+        }
+
+        ThreadPool::GetDefault().ParallelFor((uint32_t)m_Items.size(), 1024, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                m_ItemBounds[i] = bounds[m_Items[i]];
+            }
+        });
+
+        if (rotate || !m_IsDepthFirst)
+        {
+            RefitNode(0, rotate);
+            return;
+        }
+
+        // The children follow their parent, so a backward pass updates them first.
+        for (uint32_t i = (uint32_t)m_Nodes.size() - 1; i >= 2; --i)
+        {
+            UpdateBounds(i);
+        }
+        UpdateBounds(0);
+    }
+
+    void Bvh::Refit(Aabb const * bounds, Span<uint32_t const> items)
+    {
+        if (m_Nodes.empty())
+        {
+            return;
+        }
+
+        if (!m_AreLinksValid)
+        {
+            BuildLinks();
+        }
+
+        // A node whose box doesn't change leaves the boxes of its ancestors as they are, so the walk up from every item
+        // stops there. The ancestors shared by several items are still visited once per item.
+        for (uint32_t item : items)
+        {
+            uint32_t position = m_ItemPositions[item];
+            m_ItemBounds[position] = bounds[item];
+
+            uint32_t index = m_ItemLeaves[position];
+            while (true)
+            {
+                Aabb previous = m_Nodes[index].bounds;
+                UpdateBounds(index);
+                Aabb const & current = m_Nodes[index].bounds;
+                if (index == 0 || (current.min == previous.min && current.max == previous.max))
+                {
+                    break;
+                }
+                index = m_Parents[index];
+            }
+        }
+    }
+
+    void Bvh::BuildLinks()
+    {
+        m_Parents.resize(m_Nodes.size());
+        m_ItemPositions.resize(m_Items.size());
+        m_ItemLeaves.resize(m_Items.size());
+        for (uint32_t i = 0; i < (uint32_t)m_Items.size(); ++i)
+        {
+            m_ItemPositions[m_Items[i]] = i;
+        }
+
+        // Node 1 is unused, so the tree is walked from the root rather than swept.
+        std::vector<uint32_t> stack;
+        stack.push_back(0);
+        m_Parents[0] = 0;
+        while (!stack.empty())
+        {
+            uint32_t index = stack.back();
+            stack.pop_back();
+
+            Node const & node = m_Nodes[index];
+            if (node.IsLeaf())
+            {
+                std::fill(m_ItemLeaves.begin() + node.first, m_ItemLeaves.begin() + node.first + node.count, index);
+            }
+            else
+            {
+                m_Parents[node.first] = index;
+                m_Parents[node.first + 1] = index;
+                stack.push_back(node.first);
+                stack.push_back(node.first + 1);
+            }
+        }
+        m_AreLinksValid = true;
+    }
+
+    void Bvh::RefitNode(uint32_t index, bool rotate)
+    {
+        Node const & node = m_Nodes[index];
+        if (!node.IsLeaf())
+        {
+            RefitNode(node.first, rotate);
+            RefitNode(node.first + 1, rotate);
+            if (rotate && Rotate(index))
+            {
+                m_IsDepthFirst = false;
+                m_AreLinksValid = false;
+            }
+        }
+        UpdateBounds(index);
+    }
+
+    void Bvh::UpdateBounds(uint32_t index)
+    {
+        Node & node = m_Nodes[index];
+        if (node.IsLeaf())
+        {
+            Aabb bounds = m_ItemBounds[node.first];
+            for (uint32_t i = 1; i < node.count; ++i)
+            {
+                bounds.Extend(m_ItemBounds[node.first + i]);
+            }
+            node.bounds = bounds;
+        }
+        else
+        {
+            Aabb bounds = m_Nodes[node.first].bounds;
+            bounds.Extend(m_Nodes[node.first + 1].bounds);
+            node.bounds = bounds;
+        }
+    }
+
+    bool Bvh::Rotate(uint32_t index)
+    {
+        uint32_t children = m_Nodes[index].first;
+
+        // A child can be swapped with a child of its sibling, which shrinks the sibling by its other child alone.
+        float bestGain = 0;
+        uint32_t bestSibling = 0;
+        uint32_t bestNephew = 0;
+        for (uint32_t child = 0; child < 2; ++child)
+        {
+            Node const & sibling = m_Nodes[children + 1 - child];
+            if (sibling.IsLeaf())
+            {
+                continue;
+            }
+
+            float siblingArea = sibling.bounds.GetSurfaceArea();
+            for (uint32_t nephew = 0; nephew < 2; ++nephew)
+            {
+                Aabb bounds = m_Nodes[children + child].bounds;
+                bounds.Extend(m_Nodes[sibling.first + 1 - nephew].bounds);
+
+                float gain = siblingArea - bounds.GetSurfaceArea();
+                if (gain > bestGain)
+                {
+                    bestGain = gain;
+                    bestSibling = children + 1 - child;
+                    bestNephew = sibling.first + nephew;
+                }
+            }
+        }
+
+        // Ignores the gains due to rounding errors, which could swap the same nodes back and forth.
+        if (bestGain <= m_Nodes[index].bounds.GetSurfaceArea() * 1e-4f)
+        {
+            return false;
+        }
+
+        uint32_t child = bestSibling == children ? children + 1 : children;
+        std::swap(m_Nodes[child], m_Nodes[bestNephew]);
+        UpdateBounds(bestSibling);
+        return true;
+    }
+
+    float Bvh::GetCost() const
+    {
+        if (m_Nodes.empty())
+        {
+            return 0;
+        }
+
+        float rootArea = m_Nodes[0].bounds.GetSurfaceArea();
+        if (!(rootArea > 0))
+        {
+            return 0;
+        }
+
+        double cost = 0;
+        for (uint32_t i = 0; i < (uint32_t)m_Nodes.size(); ++i)
+        {
+            if (i == 1)
+            {
+                continue;
+            }
+
+            Node const & node = m_Nodes[i];
+            float area = node.bounds.GetSurfaceArea();
+            cost += node.IsLeaf() ? IntersectionCost * node.count * area : TraversalCost * area;
+        }
+        return (float)(cost / rootArea);
+    }
+
+    void Bvh::QueryOverlap(Aabb const & box, std::vector<uint32_t> & items) const
+    {
+        if (m_Nodes.empty())
+        {
+            return;
+        }
+
+        TraversalStack<uint32_t> stack;
+        stack.Push(0);
+        while (!stack.IsEmpty())
+        {
+            Node const & node = m_Nodes[stack.Pop()];
+            if (!node.bounds.Overlaps(box))
+            {
+                continue;
+            }
+
+            if (node.IsLeaf())
+            {
+                for (uint32_t i = node.first; i < node.first + node.count; ++i)
+                {
+                    if (m_ItemBounds[i].Overlaps(box))
+                    {
+                        items.push_back(m_Items[i]);
+                    }
+                }
+            }
+            else
+            {
+                stack.Push(node.first + 1);
+                stack.Push(node.first);
+            }
+        }
+    }
+
+    void Bvh::QueryFrustum(Frustum const & frustum, std::vector<uint32_t> & items) const
+    {
+        if (m_Nodes.empty())
+        {
+            return;
+        }
+
+        // The entries of the subtrees known to be inside have the InsideFlag.
+        TraversalStack<uint32_t> stack;
+        stack.Push(0);
+        while (!stack.IsEmpty())
+        {
+            uint32_t entry = stack.Pop();
+            Node const & node = m_Nodes[entry & ~InsideFlag];
+
+            bool isInside = (entry & InsideFlag) != 0;
+            if (!isInside)
+            {
+                Frustum::Containment containment = frustum.Classify(node.bounds);
+                if (containment == Frustum::Containment::Outside)
+                {
+                    continue;
+                }
+                isInside = containment == Frustum::Containment::Inside;
+            }
+
+            if (node.IsLeaf())
+            {
+                for (uint32_t i = node.first; i < node.first + node.count; ++i)
+                {
+                    if (isInside || frustum.Intersects(m_ItemBounds[i]))
+                    {
+                        items.push_back(m_Items[i]);
+                    }
+                }
+            }
+            else
+            {
+                uint32_t flag = isInside ? InsideFlag : 0;
+                stack.Push((node.first + 1) | flag);
+                stack.Push(node.first | flag);
+            }
+        }
+    }
+
+    bool Bvh::QueryNearest(glm::vec3 const & point, float maxDistance, uint32_t & item, float & distance) const
+    {
+        if (m_Nodes.empty())
+        {
+            return false;
+        }
+
+        struct Entry
+        {
+            uint32_t node;
+            float distanceSquared;
+        };
+
+        float bestDistanceSquared = maxDistance * maxDistance;
+        bool isFound = false;
+
+        // The nearest child is visited first, so that the farther one is likely pruned.
+        TraversalStack<Entry> stack;
+        stack.Push(Entry{ 0, GetDistanceSquared(m_Nodes[0].bounds, point) });
+        while (!stack.IsEmpty())
+        {
+            Entry entry = stack.Pop();
+            if (entry.distanceSquared > bestDistanceSquared)
+            {
+                continue;
+            }
+
+            Node const & node = m_Nodes[entry.node];
+            if (node.IsLeaf())
+            {
+                for (uint32_t i = node.first; i < node.first + node.count; ++i)
+                {
+                    float distanceSquared = GetDistanceSquared(m_ItemBounds[i], point);
+                    if (distanceSquared < bestDistanceSquared || (!isFound && distanceSquared <= bestDistanceSquared))
+                    {
+                        bestDistanceSquared = distanceSquared;
+                        item = m_Items[i];
+                        isFound = true;
+                    }
+                }
+            }
+            else
+            {
+                Entry left{ node.first, GetDistanceSquared(m_Nodes[node.first].bounds, point) };
+                Entry right{ node.first + 1, GetDistanceSquared(m_Nodes[node.first + 1].bounds, point) };
+                if (left.distanceSquared > right.distanceSquared)
+                {
+                    std::swap(left, right);
+                }
+
+                if (right.distanceSquared <= bestDistanceSquared)
+                {
+                    stack.Push(right);
+                }
+                if (left.distanceSquared <= bestDistanceSquared)
+                {
+                    stack.Push(left);
+                }
+            }
+        }
+
+        if (isFound)
+        {
+            distance = std::sqrt(bestDistanceSquared);
+        }
+        return isFound;
+    }
+} // VulkanDemo
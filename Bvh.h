@@ -0,0 +1,142 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "AlignedAllocator.h"
+#include "Bounds.h"
+#include "Span.h"
+
+namespace VulkanDemo
+{
+    ///
+    /// Bounding volume hierarchy over a set of boxes, such as the world bounds of a RenderSnapshot.
+    ///
+    /// The items are the indices of the boxes given to Build(). The tree is built with the surface area heuristic,
+    /// evaluated on bins of the box centers, which suits static objects. Moving objects keep the tree valid by refitting
+    /// the node bounds to their new boxes, optionally rotating subtrees to undo part of the degradation; the tree
+    /// should be rebuilt when GetCost() has grown too much, or when items are added or removed.
+    ///
+    /// The nodes are stored in a flat array of 32-byte nodes, in depth-first order, with the two children of a node
+    /// next to each other in the same cache line. The boxes of the items are copied in the order of the leaves.
+    ///
+    /// Usage Notes:
+    /// - The queries are const and can run concurrently with each other, but not with Build() or Refit().
+    /// - Build() and Refit() use the default thread pool, so they must not be called from a ThreadPool::ParallelFor().
+    ///
+    class Bvh
+    {
+    public:
+        Bvh();
+        ~Bvh();
+
+        ///
+        /// Builds the tree over the boxes, which must not be empty.
+        ///
+        void Build(Aabb const * bounds, uint32_t count);
+
+        ///
+        /// Updates the tree to new boxes of the same items, given in the order used by Build(). Rotations swap a child
+        /// of a node with a grandchild when it shrinks the surface of the child, and are worth it when the objects
+        /// travel far from where they were at the last build.
+        ///
+        void Refit(Aabb const * bounds, bool rotate = false);
+
+        ///
+        /// Updates the tree to the new boxes of some of the items, such as the objects that a RenderSnapshot updated,
+        /// the other items keeping their boxes. Only the ancestors of these items whose box changes are visited, so the
+        /// cost is proportional to the number of items rather than to the size of the tree.
+        ///
+        void Refit(Aabb const * bounds, Span<uint32_t const> items);
+
+        inline uint32_t GetItemCount() const { return (uint32_t)m_Items.size(); }
+        inline uint32_t GetNodeCount() const { return m_Nodes.empty() ? 0 : (uint32_t)m_Nodes.size() - 1; }
+        inline Aabb GetBounds() const { return m_Nodes.empty() ? Aabb{} : m_Nodes[0].bounds; }
+
+        ///
+        /// Returns the expected cost of a query by the surface area heuristic, relative to testing a single box. It
+        /// only grows with refits, so comparing it to its value after the last build tells when to rebuild.
+        ///
+        float GetCost() const;
+
+        ///
+        /// Appends the items whose box overlaps the given one to the vector, in no particular order.
+        ///
+        void QueryOverlap(Aabb const & box, std::vector<uint32_t> & items) const;
+
+        ///
+        /// Appends the items whose box intersects the frustum to the vector, in no particular order. The boxes of the
+        /// subtrees fully inside the frustum are not tested.
+        ///
+        void QueryFrustum(Frustum const & frustum, std::vector<uint32_t> & items) const;
+
+        ///
+        /// Finds the item whose box is the closest to the point, within maxDistance. The distance is 0 for the boxes
+        /// containing the point.
+        ///
+        /// @return false if no box is within maxDistance.
+        ///
+        bool QueryNearest(glm::vec3 const & point, float maxDistance, uint32_t & item, float & distance) const;
+
+    private:
+        Bvh(Bvh const & other) = delete;
+        void operator=(Bvh const & other) = delete;
+
+        struct Node
+        {
+            Aabb bounds;
+            uint32_t first;     // Leaf: position of the first item in m_Items. Otherwise: index of the left child, the right one follows.
+            uint32_t count;     // Number of items of a leaf, 0 otherwise.
+
+            inline bool IsLeaf() const { return count != 0; }
+        };
+
+        struct BuildTask
+        {
+            uint32_t node;
+            uint32_t begin;
+            uint32_t end;
+            uint32_t depth;
+        };
+
+        struct BuildItem;
+        struct BuildContext;
+
+        void BuildNode(BuildContext & context, uint32_t index, uint32_t begin, uint32_t end, uint32_t & nextNode, uint32_t depth, std::vector<BuildTask> * tasks);
+        uint32_t FindSplit(BuildContext & context, Aabb const & bounds, Aabb const & centerBounds, uint32_t begin, uint32_t end, uint32_t depth);
+
+        ///
+        /// Copies the nodes reachable from the root, allocating the pairs of children in depth-first order.
+        ///
+        void Flatten(std::vector<Node> const & nodes);
+
+        void RefitNode(uint32_t index, bool rotate);
+        void UpdateBounds(uint32_t index);
+
+        ///
+        /// Applies the best rotation under the node, if any shrinks a child.
+        ///
+        bool Rotate(uint32_t index);
+
+        ///
+        /// Finds the parent of every node and the leaf of every item, for the refits of some items.
+        ///
+        void BuildLinks();
+
+        // The root is at 0, and the pairs of children start at 2, so that they share a cache line.
+        AlignedVector<Node>     m_Nodes;
+        std::vector<uint32_t>   m_Items;
+        std::vector<Aabb>       m_ItemBounds;   // In the order of m_Items.
+
+        // Indicates whether every node precedes its children, which rotations break.
+        bool                    m_IsDepthFirst = true;
+
+        // Links from the items up to the root, built on demand and invalidated by builds and rotations.
+        bool                    m_AreLinksValid = false;
+        std::vector<uint32_t>   m_Parents;          // Indexed by node.
+        std::vector<uint32_t>   m_ItemPositions;    // Indexed by item, position in m_Items.
+        std::vector<uint32_t>   m_ItemLeaves;       // In the order of m_Items.
+    };
+} // VulkanDemo
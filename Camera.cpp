@@ -1,12 +1,61 @@
 #include "Camera.h"
 
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cstring>
+
+#include "GameObject.h"
+#include "Transform.h"
+
 namespace VulkanDemo
 {
-    Camera::Camera()
+    Camera::Camera() :
+        Component{ TypeId }
     {
     }
 
     Camera::~Camera()
     {
     }
+
+    glm::mat4 const & Camera::GetViewMatrix() const
+    {
+        Transform const * transform = GetGameObject() != nullptr ? GetGameObject()->GetTransform() : nullptr;
+        glm::mat4 const & localToWorld = transform != nullptr ? transform->GetLocalToWorldMatrix() : glm::mat4{ 1 };
+
+        // Compared bitwise, so that a NaN doesn't recompute the matrix every time.
+        if (m_IsViewDirty || memcmp(&localToWorld, &m_ViewSource, sizeof(glm::mat4)) != 0)
+        {
+            m_ViewSource = localToWorld;
+            m_ViewMatrix = transform != nullptr ? transform->GetWorldToLocalMatrix() : glm::mat4{ 1 };
+            m_IsViewDirty = false;
+            m_IsViewProjectionDirty = true;
+        }
+        return m_ViewMatrix;
+    }
+
+    glm::mat4 const & Camera::GetProjectionMatrix(float aspectRatio) const
+    {
+        if (m_IsProjectionDirty || aspectRatio != m_ProjectionAspectRatio)
+        {
+            m_ProjectionMatrix = glm::perspective(glm::radians(m_VerticalFieldOfView), aspectRatio, m_Near, m_Far);
+            m_ProjectionAspectRatio = aspectRatio;
+            m_IsProjectionDirty = false;
+            m_IsViewProjectionDirty = true;
+        }
+        return m_ProjectionMatrix;
+    }
+
+    glm::mat4 const & Camera::GetViewProjectionMatrix(float aspectRatio) const
+    {
+        // Both calls flag the product as outdated if they recompute their matrix.
+        glm::mat4 const & viewMatrix = GetViewMatrix();
+        glm::mat4 const & projectionMatrix = GetProjectionMatrix(aspectRatio);
+        if (m_IsViewProjectionDirty)
+        {
+            m_ViewProjectionMatrix = projectionMatrix * viewMatrix;
+            m_IsViewProjectionDirty = false;
+        }
+        return m_ViewProjectionMatrix;
+    }
 } // VulkanDemo
@@ -1,27 +1,72 @@
 #pragma once
 
+#include <glm/glm.hpp>
+
 #include "Component.h"
+#include "PoolAllocator.h"
 
 namespace VulkanDemo
 {
-    class Camera : public Component
+    ///
+    /// Perspective camera looking down the -z axis of the transform of its GameObject.
+    ///
+    /// The matrices are cached: the view matrix is only recomputed when the transform moved, the projection matrix when
+    /// a parameter or the aspect ratio changed, and the view-projection matrix when either of them was recomputed.
+    ///
+    class Camera : public Component, public Pooled<Camera>
     {
     public:
+        static constexpr char const * PoolName = "Camera";
+        static const ComponentType::Id TypeId = ComponentType::Camera;
+
         Camera();
         ~Camera();
 
         inline float GetNear() const { return m_Near; }
-        inline void SetNear(float near) { m_Near = near; }
+        inline void SetNear(float near) { m_Near = near; m_IsProjectionDirty = true; }
 
         inline float GetFar() const { return m_Far; }
-        inline void SetFar(float far) { m_Far = far; }
+        inline void SetFar(float far) { m_Far = far; m_IsProjectionDirty = true; }
 
         inline float GetVerticalFieldOfView() const { return m_VerticalFieldOfView; }
-        inline void SetVerticalFieldOfView(float vfov) { m_VerticalFieldOfView = vfov; }
+        inline void SetVerticalFieldOfView(float vfov) { m_VerticalFieldOfView = vfov; m_IsProjectionDirty = true; }
+
+        ///
+        /// Sets the width over the height of the image the camera is rendered to, for which the snapshots of the scene
+        /// carry its matrices. Defaults to 16 / 9.
+        ///
+        inline float GetAspectRatio() const { return m_AspectRatio; }
+        inline void SetAspectRatio(float aspectRatio) { m_AspectRatio = aspectRatio; }
+
+        ///
+        /// Returns the matrix transforming from the world space to the view space, the world-to-local matrix of the
+        /// transform. Identity without a transform.
+        ///
+        glm::mat4 const & GetViewMatrix() const;
+
+        ///
+        /// Returns the matrix transforming from the view space to the clip space, for a viewport of the given width over
+        /// height.
+        ///
+        glm::mat4 const & GetProjectionMatrix(float aspectRatio) const;
+
+        glm::mat4 const & GetViewProjectionMatrix(float aspectRatio) const;
 
     private:
         float m_Near = 0.1f;
         float m_Far = 100;
         float m_VerticalFieldOfView = 45; // In degrees.
+        float m_AspectRatio = 16 / 9.0f;
+
+        // The view matrix is up to date while the local-to-world matrix of the transform equals the one it was computed
+        // from.
+        mutable glm::mat4 m_ViewSource;
+        mutable glm::mat4 m_ViewMatrix;
+        mutable glm::mat4 m_ProjectionMatrix;
+        mutable glm::mat4 m_ViewProjectionMatrix;
+        mutable float m_ProjectionAspectRatio = 0;
+        mutable bool m_IsViewDirty = true;
+        mutable bool m_IsProjectionDirty = true;
+        mutable bool m_IsViewProjectionDirty = true;
     };
 } // VulkanDemo
@@ -1,10 +1,14 @@
 #include "Component.h"
 #include "GameObject.h"
+#include "Scene.h"
 
 namespace VulkanDemo
 {
-    Component::Component() :
-        m_GameObject{ nullptr }
+    Component::Component(ComponentType::Id typeId) :
+        m_GameObject{ nullptr },
+        m_TypeId{ typeId },
+        m_TypeIndex{ UINT32_MAX },
+        m_ComponentIndex{ UINT32_MAX }
     {
     }
 
@@ -15,4 +19,12 @@ namespace VulkanDemo
             m_GameObject->RemoveComponent(*this);
         }
     }
+
+    void Component::MarkChanged()
+    {
+        if (m_GameObject != nullptr && m_GameObject->GetScene() != nullptr)
+        {
+            m_GameObject->GetScene()->GetChangeJournal().Record(m_GameObject->GetHandle(), SceneChangeJournal::ComponentsChanged);
+        }
+    }
 } // VulkanDemo
@@ -1,25 +1,61 @@
 #pragma once
 
+#include "ComponentType.h"
 #include "Object.h"
+#include "SlotMap.h"
 
 namespace VulkanDemo
 {
+    class Component;
     class GameObject;
+    class Scene;
+
+    typedef SlotMapHandle<Component> ComponentHandle;
 
     class Component : public Object
     {
         friend GameObject;
+        friend Scene;
 
     public:
-        Component();
+        explicit Component(ComponentType::Id typeId);
         virtual ~Component();
 
         inline GameObject* GetGameObject() const { return m_GameObject; }
 
+        ///
+        /// Returns the type of the most derived component class. Unlike the dynamic type, it is still available while
+        /// the component is being destroyed.
+        ///
+        inline ComponentType::Id GetTypeId() const { return m_TypeId; }
+
+        ///
+        /// Returns the handle of the component in the scene of its GameObject. The handle is null when the component is
+        /// not part of a scene.
+        ///
+        inline ComponentHandle GetHandle() const { return m_Handle; }
+
+        ///
+        /// Returns the index of the component in Scene::GetComponentsOfType(), valid while the components of its type
+        /// in the scene don't change.
+        ///
+        inline uint32_t GetTypeIndex() const { return m_TypeIndex; }
+
+    protected:
+        ///
+        /// Records in the change journal of the scene that the state of the component changed, for the systems that
+        /// mirror it.
+        ///
+        void MarkChanged();
+
     private:
         Component(Component const &other) = delete;
         void operator=(Component const &other) = delete;
 
         GameObject* m_GameObject;
+        ComponentType::Id m_TypeId;
+        ComponentHandle m_Handle;
+        uint32_t m_TypeIndex; // Index in the storage of the type in the scene.
+        uint32_t m_ComponentIndex; // Index in the components of the GameObject.
     };
 } // VulkanDemo
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+
+namespace VulkanDemo
+{
+    ///
+    /// Registry of the component types. Every concrete component class has a compile-time identifier, exposed as its
+    /// static TypeId member, which indexes the per-type storage of the scene and the per-object lookup tables. New
+    /// component types must be added to the enumeration.
+    ///
+    struct ComponentType
+    {
+        enum Id : uint32_t
+        {
+            Transform,
+            Camera,
+            MeshRenderer,
+
+            Count
+        };
+
+        static_assert(Count <= 32, "The component masks are 32-bit wide.");
+
+        inline static uint32_t GetMask(Id id) { return 1u << id; }
+
+        static char const * GetName(Id id)
+        {
+            static char const * const names[] =
+            {
+                "Transform",
+                "Camera",
+                "MeshRenderer",
+            };
+            static_assert(sizeof(names) / sizeof(names[0]) == Count, "Missing component type name.");
+            return id < Count ? names[id] : "Unknown";
+        }
+    };
+} // VulkanDemo
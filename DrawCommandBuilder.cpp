@@ -0,0 +1,164 @@
+#include "DrawCommandBuilder.h"
+
+#include <algorithm>
+#include <cassert>
+#include <string>
+
+#include "ThreadPool.h"
+
+namespace VulkanDemo
+{
+    DrawCommandBuilder::DrawCommandBuilder()
+    {
+    }
+
+    DrawCommandBuilder::~DrawCommandBuilder()
+    {
+    }
+
+    void DrawCommandBuilder::SetMeshGeometry(MeshId mesh, uint32_t level, MeshGeometry const & geometry)
+    {
+        assert(level < LodSelector::MaxLevelCount);
+        size_t index = (size_t)mesh * LodSelector::MaxLevelCount + level;
+        if (index >= m_Geometries.size())
+        {
+            m_Geometries.resize(((size_t)mesh + 1) * LodSelector::MaxLevelCount);
+        }
+        m_Geometries[index] = geometry;
+    }
+
+    void DrawCommandBuilder::Build(InstanceBatcher const & batcher)
+    {
+        Build(batcher, ThreadPool::GetDefault());
+    }
+
+    void DrawCommandBuilder::Build(InstanceBatcher const & batcher, ThreadPool & threadPool)
+    {
+        Clock::time_point start = Clock::now();
+
+        m_Commands.clear();
+        m_ViewStarts.clear();
+        m_Ranges.clear();
+        m_Stats = Stats{};
+
+        MeshGeometry const emptyGeometry;
+        for (uint32_t view = 0; view < batcher.GetViewCount(); ++view)
+        {
+            Span<InstanceBatcher::Batch const> batches = batcher.GetBatches(view);
+            uint32_t firstCommand = (uint32_t)m_Commands.size();
+            m_Commands.resize(firstCommand + batches.size());
+
+            VkDrawIndexedIndirectCommand * commands = m_Commands.data() + firstCommand;
+            threadPool.ParallelFor((uint32_t)batches.size(), 256, [&](uint32_t begin, uint32_t end) {
+                for (uint32_t i = begin; i < end; ++i)
+                {
+                    InstanceBatcher::Batch const & batch = batches[i];
+                    size_t geometryIndex = (size_t)batch.mesh * LodSelector::MaxLevelCount + batch.level;
+                    MeshGeometry const & geometry = geometryIndex < m_Geometries.size() ? m_Geometries[geometryIndex] : emptyGeometry;
+
+                    VkDrawIndexedIndirectCommand & command = commands[i];
+                    command.indexCount = geometry.indexCount;
+                    command.instanceCount = batch.instanceCount;
+                    command.firstIndex = geometry.firstIndex;
+                    command.vertexOffset = geometry.vertexOffset;
+                    command.firstInstance = batch.firstInstance - batch.bindingOffset;
+                }
+            });
+
+            // The ranges only depend on the order of the batches, so they are found serially.
+            m_ViewStarts.push_back((uint32_t)m_Ranges.size());
+            for (uint32_t i = 0; i < (uint32_t)batches.size(); ++i)
+            {
+                InstanceBatcher::Batch const & batch = batches[i];
+                bool isNewRange = i == 0 || m_Ranges.back().pipeline != batch.pipeline || m_Ranges.back().material != batch.material ||
+                    m_Ranges.back().bindingOffset != batch.bindingOffset;
+                if (isNewRange)
+                {
+                    DrawRange range;
+                    range.pipeline = batch.pipeline;
+                    range.material = batch.material;
+                    range.bindingOffset = batch.bindingOffset;
+                    range.firstCommand = firstCommand + i;
+                    range.commandCount = 0;
+                    m_Ranges.push_back(range);
+                }
+                ++m_Ranges.back().commandCount;
+            }
+        }
+
+        m_Stats.commandCount = (uint32_t)m_Commands.size();
+        m_Stats.rangeCount = (uint32_t)m_Ranges.size();
+        m_Stats.buildTime = GetMilliseconds(start, Clock::now());
+    }
+
+    Span<DrawCommandBuilder::DrawRange const> DrawCommandBuilder::GetRanges(uint32_t view) const
+    {
+        assert(view < GetViewCount());
+        uint32_t begin = m_ViewStarts[view];
+        uint32_t end = view + 1 < GetViewCount() ? m_ViewStarts[view + 1] : (uint32_t)m_Ranges.size();
+        return Span<DrawRange const>{ m_Ranges.data() + begin, end - begin };
+    }
+
+    void DrawCommandBuilder::Record(VkCommandBuffer commandBuffer, uint32_t view, Path path, VkBuffer indirectBuffer, std::function<void(DrawRange const & range)> const & bindState)
+    {
+        assert(path == Path::Direct || indirectBuffer != VK_NULL_HANDLE);
+        Clock::time_point start = Clock::now();
+
+        const VkDeviceSize stride = sizeof(VkDrawIndexedIndirectCommand);
+        for (DrawRange const & range : GetRanges(view))
+        {
+            bindState(range);
+
+            switch (path)
+            {
+            case Path::Direct:
+                for (uint32_t i = range.firstCommand; i < range.firstCommand + range.commandCount; ++i)
+                {
+                    VkDrawIndexedIndirectCommand const & command = m_Commands[i];
+                    vkCmdDrawIndexed(commandBuffer, command.indexCount, command.instanceCount, command.firstIndex, command.vertexOffset, command.firstInstance);
+                }
+                break;
+
+            case Path::MultiDrawIndirect:
+                for (uint32_t first = range.firstCommand; first < range.firstCommand + range.commandCount; first += m_MaxDrawIndirectCount)
+                {
+                    uint32_t count = (std::min)(m_MaxDrawIndirectCount, range.firstCommand + range.commandCount - first);
+                    vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffer, first * stride, count, (uint32_t)stride);
+                }
+                break;
+
+            case Path::SingleDrawIndirect:
+                for (uint32_t i = range.firstCommand; i < range.firstCommand + range.commandCount; ++i)
+                {
+                    vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffer, i * stride, 1, (uint32_t)stride);
+                }
+                break;
+            }
+        }
+
+        m_Stats.callCount += GetCallCount(view, path);
+        m_Stats.recordTime += GetMilliseconds(start, Clock::now());
+    }
+
+    uint32_t DrawCommandBuilder::GetCallCount(uint32_t view, Path path) const
+    {
+        uint32_t callCount = 0;
+        for (DrawRange const & range : GetRanges(view))
+        {
+            callCount += path == Path::MultiDrawIndirect ? (range.commandCount + m_MaxDrawIndirectCount - 1) / m_MaxDrawIndirectCount : range.commandCount;
+        }
+        return callCount;
+    }
+
+    void DrawCommandBuilder::PrintStats() const
+    {
+        StatsRows rows = {
+            { "Commands", std::to_string(m_Stats.commandCount) },
+            { "State ranges", std::to_string(m_Stats.rangeCount) },
+            { "Build (ms)", FormatStat(m_Stats.buildTime) },
+            { "Draw calls", std::to_string(m_Stats.callCount) },
+            { "Recording (ms)", FormatStat(m_Stats.recordTime) },
+        };
+        PrintStatsTable("Draw commands", rows);
+    }
+} // VulkanDemo
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "Shared.h"
+
+#include "InstanceBatcher.h"
+#include "LodSelector.h"
+#include "Span.h"
+
+namespace VulkanDemo
+{
+    class ThreadPool;
+
+    ///
+    /// Range of the index and vertex buffers holding a level of detail of a mesh.
+    ///
+    struct MeshGeometry
+    {
+        uint32_t indexCount = 0;
+        uint32_t firstIndex = 0;
+        int32_t vertexOffset = 0;
+    };
+
+    ///
+    /// Turns the batches of a frame into draw commands, and records them either directly or indirectly.
+    ///
+    /// Every batch becomes a VkDrawIndexedIndirectCommand drawing the geometry of its mesh and level, from its first
+    /// instance relative to its binding offset, which is where the instance buffer is bound. The commands are generated
+    /// in parallel, then the consecutive commands sharing their pipeline, material and binding offset form the ranges
+    /// that Record() draws between two changes of state, in one of the following ways:
+    /// - Direct: one vkCmdDrawIndexed() per command, which needs no buffer nor feature.
+    /// - MultiDrawIndirect: one vkCmdDrawIndexedIndirect() per range, reading the commands from a buffer, in as many
+    ///   calls as maxDrawIndirectCount requires. Needs the multiDrawIndirect feature.
+    /// - SingleDrawIndirect: one vkCmdDrawIndexedIndirect() per command, for the devices without multiDrawIndirect.
+    /// Both indirect ways need the drawIndirectFirstInstance feature, since the instances of the batches follow each
+    /// other in the instance buffer; without it, the draws must be direct.
+    ///
+    /// Usage Notes:
+    /// - Build() must not be called from a ThreadPool::ParallelFor().
+    /// - The meshes without geometry for a level draw nothing.
+    ///
+    class DrawCommandBuilder
+    {
+    public:
+        enum class Path
+        {
+            Direct,
+            MultiDrawIndirect,
+            SingleDrawIndirect,
+        };
+
+        ///
+        /// Consecutive commands of a view drawn with the same state.
+        ///
+        struct DrawRange
+        {
+            PipelineId pipeline;
+            MaterialId material;
+            uint32_t bindingOffset; // First instance of the binding of the instance buffer.
+            uint32_t firstCommand;  // Index in the commands of all the views.
+            uint32_t commandCount;
+        };
+
+        struct Stats
+        {
+            uint32_t commandCount = 0;
+            uint32_t rangeCount = 0;
+            uint32_t callCount = 0;     // Draw calls recorded.
+            double buildTime = 0;       // In milliseconds.
+            double recordTime = 0;
+        };
+
+        DrawCommandBuilder();
+        ~DrawCommandBuilder();
+
+        ///
+        /// Sets the geometry of a level of detail of a mesh, below LodSelector::MaxLevelCount.
+        ///
+        void SetMeshGeometry(MeshId mesh, uint32_t level, MeshGeometry const & geometry);
+
+        ///
+        /// Sets the largest number of draws of an indirect call, from the limits of the device. Defaults to 1.
+        ///
+        inline void SetMaxDrawIndirectCount(uint32_t maxDrawIndirectCount) { m_MaxDrawIndirectCount = maxDrawIndirectCount; }
+
+        ///
+        /// Generates the commands of the batches of all the views, replacing the ones of the previous frame.
+        ///
+        void Build(InstanceBatcher const & batcher);
+        void Build(InstanceBatcher const & batcher, ThreadPool & threadPool);
+
+        ///
+        /// Returns the commands of all the views, to be copied to the indirect buffer.
+        ///
+        inline Span<VkDrawIndexedIndirectCommand const> GetCommands() const { return Span<VkDrawIndexedIndirectCommand const>{ m_Commands.data(), m_Commands.size() }; }
+
+        inline uint32_t GetViewCount() const { return (uint32_t)m_ViewStarts.size(); }
+        Span<DrawRange const> GetRanges(uint32_t view) const;
+
+        ///
+        /// Records the draws of a view. The indirect buffer holds the commands from its start, and is ignored by the
+        /// direct path. The state of every range, including the instance buffer from its binding offset, is bound by
+        /// bindState() before its draws.
+        ///
+        void Record(VkCommandBuffer commandBuffer, uint32_t view, Path path, VkBuffer indirectBuffer, std::function<void(DrawRange const & range)> const & bindState);
+
+        ///
+        /// Returns the number of draw calls that Record() issues for a view on a path.
+        ///
+        uint32_t GetCallCount(uint32_t view, Path path) const;
+
+        inline Stats const & GetStats() const { return m_Stats; }
+        void PrintStats() const;
+
+    private:
+        DrawCommandBuilder(DrawCommandBuilder const & other) = delete;
+        void operator=(DrawCommandBuilder const & other) = delete;
+
+        std::vector<MeshGeometry> m_Geometries; // Indexed by mesh then level.
+        uint32_t m_MaxDrawIndirectCount = 1;
+
+        std::vector<VkDrawIndexedIndirectCommand>   m_Commands;
+        std::vector<uint32_t>                       m_ViewStarts;   // First range of every view.
+        std::vector<DrawRange>                      m_Ranges;
+
+        Stats m_Stats;
+    };
+} // VulkanDemo
@@ -0,0 +1,316 @@
+#include "FrustumCuller.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "MatrixKernels.h"
+#include "Shared.h"
+#include "ThreadPool.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define FRUSTUM_CULLER_X86 1
+#else
+#define FRUSTUM_CULLER_X86 0
+#endif
+
+#if FRUSTUM_CULLER_X86
+#include <immintrin.h>
+#endif
+
+// MSVC allows any intrinsic in any function, other compilers need the functions to be tagged.
+#if FRUSTUM_CULLER_X86 && !defined(_MSC_VER)
+#define FRUSTUM_CULLER_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define FRUSTUM_CULLER_TARGET_AVX2
+#endif
+
+namespace VulkanDemo
+{
+    namespace
+    {
+        // Boxes culled by a single task, a multiple of the SIMD width.
+        const uint32_t ChunkSize = 16384;
+
+        static_assert(ChunkSize % PackedBounds::Padding == 0, "The chunks must start on a group of boxes.");
+
+        ///
+        /// Planes of the frustum, with the absolute values of the normals used to project the extents.
+        ///
+        struct Planes
+        {
+            float normals[Frustum::PlaneCount][3];
+            float distances[Frustum::PlaneCount];
+            float absNormals[Frustum::PlaneCount][3];
+        };
+
+        Planes MakePlanes(Frustum const & frustum)
+        {
+            Planes planes;
+            for (int p = 0; p < Frustum::PlaneCount; ++p)
+            {
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    planes.normals[p][axis] = frustum.planes[p][axis];
+                    planes.absNormals[p][axis] = std::abs(frustum.planes[p][axis]);
+                }
+                planes.distances[p] = frustum.planes[p].w;
+            }
+            return planes;
+        }
+
+        // All the variants compute the distances and the radii in the order of Frustum::Classify(), without fused
+        // multiply-adds, and write the index and the frustum mask of every box then advance only past the visible ones.
+        // The writes never go beyond the index of the box, so the chunks can write in place.
+
+        // Scalar
+
+        uint32_t CullScalar(Planes const * frustums, uint32_t frustumCount, PackedBounds const & bounds, uint32_t begin, uint32_t end, uint32_t * out, uint32_t * outMasks)
+        {
+            float const * centerX = bounds.GetArray(PackedBounds::CenterX);
+            float const * centerY = bounds.GetArray(PackedBounds::CenterY);
+            float const * centerZ = bounds.GetArray(PackedBounds::CenterZ);
+            float const * extentX = bounds.GetArray(PackedBounds::ExtentX);
+            float const * extentY = bounds.GetArray(PackedBounds::ExtentY);
+            float const * extentZ = bounds.GetArray(PackedBounds::ExtentZ);
+
+            uint32_t visibleCount = 0;
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                uint32_t mask = 0;
+                for (uint32_t f = 0; f < frustumCount; ++f)
+                {
+                    Planes const & planes = frustums[f];
+                    bool isVisible = true;
+                    for (int p = 0; p < Frustum::PlaneCount && isVisible; ++p)
+                    {
+                        float distance = planes.normals[p][0] * centerX[i] + planes.normals[p][1] * centerY[i] + planes.normals[p][2] * centerZ[i] + planes.distances[p];
+                        float radius = planes.absNormals[p][0] * extentX[i] + planes.absNormals[p][1] * extentY[i] + planes.absNormals[p][2] * extentZ[i];
+                        isVisible = !(distance < -radius);
+                    }
+                    mask |= (isVisible ? 1u : 0u) << f;
+                }
+
+                out[visibleCount] = i;
+                outMasks[visibleCount] = mask;
+                visibleCount += mask != 0 ? 1 : 0;
+            }
+            return visibleCount;
+        }
+
+#if FRUSTUM_CULLER_X86
+
+        // SSE
+
+        uint32_t CullSse(Planes const * frustums, uint32_t frustumCount, PackedBounds const & bounds, uint32_t begin, uint32_t end, uint32_t * out, uint32_t * outMasks)
+        {
+            float const * centerX = bounds.GetArray(PackedBounds::CenterX);
+            float const * centerY = bounds.GetArray(PackedBounds::CenterY);
+            float const * centerZ = bounds.GetArray(PackedBounds::CenterZ);
+            float const * extentX = bounds.GetArray(PackedBounds::ExtentX);
+            float const * extentY = bounds.GetArray(PackedBounds::ExtentY);
+            float const * extentZ = bounds.GetArray(PackedBounds::ExtentZ);
+
+            __m128 const zero = _mm_setzero_ps();
+
+            uint32_t visibleCount = 0;
+            for (uint32_t i = begin; i < end; i += 4)
+            {
+                __m128 cx = _mm_load_ps(centerX + i);
+                __m128 cy = _mm_load_ps(centerY + i);
+                __m128 cz = _mm_load_ps(centerZ + i);
+                __m128 ex = _mm_load_ps(extentX + i);
+                __m128 ey = _mm_load_ps(extentY + i);
+                __m128 ez = _mm_load_ps(extentZ + i);
+
+                // The bit f of the lanes is set if the frustum f sees the box.
+                __m128 masks = _mm_setzero_ps();
+                for (uint32_t f = 0; f < frustumCount; ++f)
+                {
+                    Planes const & planes = frustums[f];
+                    __m128 visible = _mm_cmpeq_ps(zero, zero);
+                    for (int p = 0; p < Frustum::PlaneCount; ++p)
+                    {
+                        __m128 distance = _mm_mul_ps(_mm_set1_ps(planes.normals[p][0]), cx);
+                        distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(planes.normals[p][1]), cy));
+                        distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(planes.normals[p][2]), cz));
+                        distance = _mm_add_ps(distance, _mm_set1_ps(planes.distances[p]));
+
+                        __m128 radius = _mm_mul_ps(_mm_set1_ps(planes.absNormals[p][0]), ex);
+                        radius = _mm_add_ps(radius, _mm_mul_ps(_mm_set1_ps(planes.absNormals[p][1]), ey));
+                        radius = _mm_add_ps(radius, _mm_mul_ps(_mm_set1_ps(planes.absNormals[p][2]), ez));
+
+                        visible = _mm_andnot_ps(_mm_cmplt_ps(distance, _mm_sub_ps(zero, radius)), visible);
+                        if (_mm_movemask_ps(visible) == 0)
+                        {
+                            break;
+                        }
+                    }
+
+                    masks = _mm_or_ps(masks, _mm_and_ps(visible, _mm_castsi128_ps(_mm_set1_epi32((int)(1u << f)))));
+                }
+
+                // The boxes of the padding are never visible.
+                uint32_t laneMasks[4];
+                _mm_storeu_ps((float *)laneMasks, masks);
+                for (uint32_t lane = 0; lane < 4; ++lane)
+                {
+                    out[visibleCount] = i + lane;
+                    outMasks[visibleCount] = laneMasks[lane];
+                    visibleCount += laneMasks[lane] != 0 && i + lane < end ? 1 : 0;
+                }
+            }
+            return visibleCount;
+        }
+
+        // AVX2
+
+        FRUSTUM_CULLER_TARGET_AVX2 uint32_t CullAvx2(Planes const * frustums, uint32_t frustumCount, PackedBounds const & bounds, uint32_t begin, uint32_t end, uint32_t * out, uint32_t * outMasks)
+        {
+            float const * centerX = bounds.GetArray(PackedBounds::CenterX);
+            float const * centerY = bounds.GetArray(PackedBounds::CenterY);
+            float const * centerZ = bounds.GetArray(PackedBounds::CenterZ);
+            float const * extentX = bounds.GetArray(PackedBounds::ExtentX);
+            float const * extentY = bounds.GetArray(PackedBounds::ExtentY);
+            float const * extentZ = bounds.GetArray(PackedBounds::ExtentZ);
+
+            __m256 const zero = _mm256_setzero_ps();
+
+            uint32_t visibleCount = 0;
+            for (uint32_t i = begin; i < end; i += 8)
+            {
+                __m256 cx = _mm256_load_ps(centerX + i);
+                __m256 cy = _mm256_load_ps(centerY + i);
+                __m256 cz = _mm256_load_ps(centerZ + i);
+                __m256 ex = _mm256_load_ps(extentX + i);
+                __m256 ey = _mm256_load_ps(extentY + i);
+                __m256 ez = _mm256_load_ps(extentZ + i);
+
+                // The bit f of the lanes is set if the frustum f sees the box.
+                __m256 masks = _mm256_setzero_ps();
+                for (uint32_t f = 0; f < frustumCount; ++f)
+                {
+                    Planes const & planes = frustums[f];
+                    __m256 visible = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+                    for (int p = 0; p < Frustum::PlaneCount; ++p)
+                    {
+                        __m256 distance = _mm256_mul_ps(_mm256_set1_ps(planes.normals[p][0]), cx);
+                        distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(planes.normals[p][1]), cy));
+                        distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(planes.normals[p][2]), cz));
+                        distance = _mm256_add_ps(distance, _mm256_set1_ps(planes.distances[p]));
+
+                        __m256 radius = _mm256_mul_ps(_mm256_set1_ps(planes.absNormals[p][0]), ex);
+                        radius = _mm256_add_ps(radius, _mm256_mul_ps(_mm256_set1_ps(planes.absNormals[p][1]), ey));
+                        radius = _mm256_add_ps(radius, _mm256_mul_ps(_mm256_set1_ps(planes.absNormals[p][2]), ez));
+
+                        visible = _mm256_andnot_ps(_mm256_cmp_ps(distance, _mm256_sub_ps(zero, radius), _CMP_LT_OQ), visible);
+                        if (_mm256_movemask_ps(visible) == 0)
+                        {
+                            break;
+                        }
+                    }
+
+                    masks = _mm256_or_ps(masks, _mm256_and_ps(visible, _mm256_castsi256_ps(_mm256_set1_epi32((int)(1u << f)))));
+                }
+
+                // The boxes of the padding are never visible.
+                uint32_t laneMasks[8];
+                _mm256_storeu_ps((float *)laneMasks, masks);
+                for (uint32_t lane = 0; lane < 8; ++lane)
+                {
+                    out[visibleCount] = i + lane;
+                    outMasks[visibleCount] = laneMasks[lane];
+                    visibleCount += laneMasks[lane] != 0 && i + lane < end ? 1 : 0;
+                }
+            }
+            return visibleCount;
+        }
+
+#endif // FRUSTUM_CULLER_X86
+
+        typedef uint32_t (*CullFunction)(Planes const *, uint32_t, PackedBounds const &, uint32_t, uint32_t, uint32_t *, uint32_t *);
+
+        CullFunction SelectCullFunction(MatrixKernels::Isa isa)
+        {
+            switch (isa)
+            {
+#if FRUSTUM_CULLER_X86
+            case MatrixKernels::Isa::Avx2:
+                return CullAvx2;
+            case MatrixKernels::Isa::Sse:
+                return CullSse;
+#endif
+            default:
+                return CullScalar;
+            }
+        }
+    }
+
+    FrustumCuller::FrustumCuller()
+    {
+    }
+
+    FrustumCuller::~FrustumCuller()
+    {
+    }
+
+    Span<uint32_t const> FrustumCuller::Cull(Frustum const & frustum, PackedBounds const & bounds)
+    {
+        return Cull(Span<Frustum const>{ &frustum, 1 }, bounds, ThreadPool::GetDefault());
+    }
+
+    Span<uint32_t const> FrustumCuller::Cull(Frustum const & frustum, PackedBounds const & bounds, ThreadPool & threadPool)
+    {
+        return Cull(Span<Frustum const>{ &frustum, 1 }, bounds, threadPool);
+    }
+
+    Span<uint32_t const> FrustumCuller::Cull(Span<Frustum const> frustums, PackedBounds const & bounds)
+    {
+        return Cull(frustums, bounds, ThreadPool::GetDefault());
+    }
+
+    Span<uint32_t const> FrustumCuller::Cull(Span<Frustum const> frustums, PackedBounds const & bounds, ThreadPool & threadPool)
+    {
+        if (frustums.size() > MaxFrustumCount)
+        {
+            Fail("More frustums than FrustumCuller::MaxFrustumCount.");
+        }
+
+        uint32_t count = bounds.GetCount();
+        uint32_t chunkCount = (count + ChunkSize - 1) / ChunkSize;
+        uint32_t paddedCount = (count + PackedBounds::Padding - 1) / PackedBounds::Padding * PackedBounds::Padding;
+        m_Visible.resize(paddedCount);
+        m_FrustumMasks.resize(paddedCount);
+        m_ChunkCounts.resize(chunkCount);
+
+        Planes planes[MaxFrustumCount];
+        uint32_t frustumCount = (uint32_t)frustums.size();
+        for (uint32_t f = 0; f < frustumCount; ++f)
+        {
+            planes[f] = MakePlanes(frustums[f]);
+        }
+
+        CullFunction cull = SelectCullFunction(MatrixKernels::GetIsa());
+        threadPool.ParallelFor(chunkCount, 1, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t chunk = begin; chunk < end; ++chunk)
+            {
+                uint32_t first = chunk * ChunkSize;
+                m_ChunkCounts[chunk] = cull(planes, frustumCount, bounds, first, (std::min)(first + ChunkSize, count), m_Visible.data() + first, m_FrustumMasks.data() + first);
+            }
+        });
+
+        uint32_t visibleCount = 0;
+        for (uint32_t chunk = 0; chunk < chunkCount; ++chunk)
+        {
+            uint32_t first = chunk * ChunkSize;
+            if (visibleCount != first)
+            {
+                memmove(m_Visible.data() + visibleCount, m_Visible.data() + first, m_ChunkCounts[chunk] * sizeof(uint32_t));
+                memmove(m_FrustumMasks.data() + visibleCount, m_FrustumMasks.data() + first, m_ChunkCounts[chunk] * sizeof(uint32_t));
+            }
+            visibleCount += m_ChunkCounts[chunk];
+        }
+        m_VisibleCount = visibleCount;
+        return Span<uint32_t const>{ m_Visible.data(), visibleCount };
+    }
+} // VulkanDemo
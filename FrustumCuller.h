@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "AlignedAllocator.h"
+#include "Bounds.h"
+#include "Span.h"
+
+namespace VulkanDemo
+{
+    class ThreadPool;
+
+    ///
+    /// Finds the boxes intersecting a frustum, such as the view of a camera, or any of several frustums.
+    ///
+    /// The boxes are tested against the six planes 4 (SSE) or 8 (AVX2) at a time, using the instruction set selected for
+    /// the MatrixKernels. The boxes are split in chunks culled in parallel, each writing its visible indices in place,
+    /// then the chunks are packed into one list. All the variants compute the same results, which are those of
+    /// Frustum::Intersects().
+    ///
+    /// With several frustums, every box is loaded once and tested against all of them, and the mask of the frustums
+    /// seeing it is kept along with its index, so that several views share a single pass.
+    ///
+    /// Usage Notes:
+    /// - Cull() must not be called from a ThreadPool::ParallelFor().
+    ///
+    class FrustumCuller
+    {
+    public:
+        static const uint32_t MaxFrustumCount = 32;
+
+        FrustumCuller();
+        ~FrustumCuller();
+
+        ///
+        /// Returns the indices of the visible boxes, in increasing order. The result is valid until the next call.
+        /// Uses the default thread pool.
+        ///
+        Span<uint32_t const> Cull(Frustum const & frustum, PackedBounds const & bounds);
+        Span<uint32_t const> Cull(Frustum const & frustum, PackedBounds const & bounds, ThreadPool & threadPool);
+
+        ///
+        /// Returns the indices of the boxes visible in any of the frustums, up to MaxFrustumCount, in increasing order.
+        /// GetFrustumMasks() tells which frustums see them. The result is valid until the next call.
+        ///
+        Span<uint32_t const> Cull(Span<Frustum const> frustums, PackedBounds const & bounds);
+        Span<uint32_t const> Cull(Span<Frustum const> frustums, PackedBounds const & bounds, ThreadPool & threadPool);
+
+        ///
+        /// Returns, for every box of the last result, a mask whose bit i is set if the frustum i sees the box.
+        ///
+        inline Span<uint32_t const> GetFrustumMasks() const { return Span<uint32_t const>{ m_FrustumMasks.data(), m_VisibleCount }; }
+
+    private:
+        FrustumCuller(FrustumCuller const & other) = delete;
+        void operator=(FrustumCuller const & other) = delete;
+
+        AlignedVector<uint32_t> m_Visible;
+        AlignedVector<uint32_t> m_FrustumMasks;
+        std::vector<uint32_t>   m_ChunkCounts;
+        uint32_t                m_VisibleCount = 0;
+    };
+} // VulkanDemo
@@ -1,36 +1,61 @@
 #include "GameObject.h"
 
+#include <algorithm>
 #include <cassert>
+#include <iterator>
+
+#include "Scene.h"
+#include "Transform.h"
 
 namespace VulkanDemo
 {
     GameObject::GameObject() : 
-        m_Parent{ nullptr }
+        m_ComponentsByType{},
+        m_ComponentMask{ 0 },
+        m_Parent{ nullptr },
+        m_FirstChild{ nullptr },
+        m_LastChild{ nullptr },
+        m_NextSibling{ nullptr },
+        m_PreviousSibling{ nullptr },
+        m_ChildCount{ 0 },
+        m_Transform{ nullptr },
+        m_Scene{ nullptr },
+        m_NameIndex{ 0 }
     {
     }
 
     GameObject::~GameObject()
     {
+        if (m_Scene != nullptr)
+        {
+            m_Scene->ForgetGameObject(*this);
+        }
+
         for (auto component : m_Components)
         {
             component->m_GameObject = nullptr;
             delete component;
         }
         m_Components.clear();
+        std::fill(std::begin(m_ComponentsByType), std::end(m_ComponentsByType), nullptr);
+        m_ComponentMask = 0;
+        m_Transform = nullptr;
 
         SetParent(nullptr);
-        for (auto child : m_Children)
+        while (m_FirstChild != nullptr)
         {
             // If the user wants a more fancy behaviour (ex: set their parent to mine), he can implement it before
             // destroying the objects. But by default, we don't want to alter the parent. There could be side
             // effects unknown at this level, and we don't want to force the user to undo what we did.
             //
-            // Don't call SetParent(nullptr) on the child from here, because it will attempt to modify children_
-            // while we are
-            // iterating over it.
-            child->m_Parent = nullptr;
+            // Don't call SetParent(nullptr) on the child from here: it would mark the hierarchy of a destroyed
+            // transform as changed.
+            GameObject* child = m_FirstChild;
+            child->UnlinkFromParent();
+            child->RecordChange(SceneChangeJournal::ParentChanged);
+            child->InvalidateWorldMatrices();
+            child->MarkHierarchyChanged();
         }
-        m_Children.clear();
     }
 
     ///
@@ -38,9 +63,41 @@ namespace VulkanDemo
     ///
     void GameObject::AddComponent(Component& component)
     {
-        m_Components.push_back(&component);
         assert(component.m_GameObject == nullptr);
+        component.m_ComponentIndex = (uint32_t)m_Components.size();
+        m_Components.push_back(&component);
         component.m_GameObject = this;
+
+        ComponentType::Id typeId = component.GetTypeId();
+        if (m_ComponentsByType[typeId] == nullptr)
+        {
+            m_ComponentsByType[typeId] = &component;
+            m_ComponentMask |= ComponentType::GetMask(typeId);
+        }
+
+        if (m_Scene != nullptr)
+        {
+            m_Scene->RegisterComponent(component);
+            RecordChange(SceneChangeJournal::ComponentsChanged);
+        }
+
+        if (typeId == ComponentType::Transform)
+        {
+            Transform * transform = static_cast<Transform *>(&component);
+
+            // Transforms of objects in a scene live in the store of that scene.
+            if (m_Scene != nullptr)
+            {
+                transform->MoveToStore(m_Scene->GetTransformStore());
+            }
+
+            if (m_Transform == nullptr)
+            {
+                m_Transform = transform;
+                InvalidateWorldMatrices();
+                MarkHierarchyChanged();
+            }
+        }
     }
 
     ///
@@ -48,12 +105,53 @@ namespace VulkanDemo
     ///
     void GameObject::RemoveComponent(const Component& component)
     {
-        auto iter = std::find(m_Components.begin(), m_Components.end(), &component);
-        if (iter != m_Components.end())
+        if (component.m_GameObject == this)
         {
-            assert((*iter)->m_GameObject == this);
-            (*iter)->m_GameObject = nullptr;
-            m_Components.erase(iter);
+            uint32_t index = component.m_ComponentIndex;
+            assert(m_Components[index] == &component);
+            Component* removed = m_Components[index];
+            removed->m_GameObject = nullptr;
+
+            if (m_Scene != nullptr)
+            {
+                m_Scene->UnregisterComponent(*removed);
+                RecordChange(SceneChangeJournal::ComponentsChanged);
+            }
+
+            // The Transform unregisters itself at the beginning of its destructor, so it is still complete here.
+            ComponentType::Id typeId = component.GetTypeId();
+            if (typeId == ComponentType::Transform)
+            {
+                Transform * transform = static_cast<Transform *>(removed);
+                transform->MoveToStore(TransformStore::GetDetachedStore());
+                transform->GetStore()->SetFlags(transform->GetStoreHandle(), TransformStore::AllDirty);
+            }
+
+            // Move the last component into the freed slot.
+            m_Components[index] = m_Components.back();
+            m_Components[index]->m_ComponentIndex = index;
+            m_Components.pop_back();
+            removed->m_ComponentIndex = UINT32_MAX;
+
+            if (m_ComponentsByType[typeId] == &component)
+            {
+                // The next component of the same type, if any, takes over.
+                auto next = std::find_if(m_Components.begin(), m_Components.end(), [typeId](Component* other) {
+                    return other->GetTypeId() == typeId;
+                });
+                m_ComponentsByType[typeId] = next != m_Components.end() ? *next : nullptr;
+                if (m_ComponentsByType[typeId] == nullptr)
+                {
+                    m_ComponentMask &= ~ComponentType::GetMask(typeId);
+                }
+
+                if (typeId == ComponentType::Transform)
+                {
+                    m_Transform = static_cast<Transform *>(m_ComponentsByType[typeId]);
+                    InvalidateWorldMatrices();
+                    MarkHierarchyChanged();
+                }
+            }
         }
     }
 
@@ -69,32 +167,29 @@ namespace VulkanDemo
 
         if (newParent != nullptr)
         {
-            // Prevent loops.
-            if (newParent == this || newParent->IsDescendantOf(*this))
+            // Prevent loops. A new parent can only be a descendant if this object has children.
+            if (newParent == this || (m_FirstChild != nullptr && newParent->IsDescendantOf(*this)))
             {
                 assert(false); // TODO: Log an error instead of asserting.
                 return;
             }
-
-            // Add this to the children of the new parent.
-            newParent->m_Children.push_back(this);
         }
 
-        // Remove this from the children of the old parent.
-        if (m_Parent != nullptr)
-        {
-            std::vector<GameObject*> & childrenOfOldParent = m_Parent->m_Children;
-            auto iter = std::find(childrenOfOldParent.begin(), childrenOfOldParent.end(), this);
-            assert(iter != childrenOfOldParent.end()); // We should be in the list of children of our parent.
-            childrenOfOldParent.erase(iter);
-        }
+        UnlinkFromParent();
+        LinkToParent(newParent);
 
-        // Set the new parent.
-        m_Parent = newParent;
+        RecordChange(SceneChangeJournal::ParentChanged);
+        InvalidateWorldMatrices();
+        MarkHierarchyChanged(true);
     }
 
     bool GameObject::IsDescendantOf(GameObject const & some) const
     {
+        if (m_Scene != nullptr && m_Scene == some.m_Scene)
+        {
+            return m_Scene->IsDescendantOf(*this, some);
+        }
+
         GameObject const * toTest = m_Parent;
         while (toTest != nullptr)
         {
@@ -107,4 +202,160 @@ namespace VulkanDemo
 
         return false;
     }
+
+    void GameObject::InvalidateWorldMatrices()
+    {
+        static thread_local std::vector<GameObject*> pending;
+        pending.clear();
+        pending.push_back(this);
+
+        while (!pending.empty())
+        {
+            GameObject* gameObject = pending.back();
+            pending.pop_back();
+
+            Transform* transform = gameObject->m_Transform;
+            if (transform != nullptr)
+            {
+                // Thanks to the invariant, an outdated descendant means that its whole subtree is outdated already. The
+                // subtree is still walked the first time its change is recorded during a frame, so that the journal
+                // holds all the moved objects.
+                bool isNewChange = gameObject->RecordChange(SceneChangeJournal::TransformChanged);
+                if (gameObject != this && transform->IsLocalToWorldDirty() && !isNewChange)
+                {
+                    continue;
+                }
+                transform->GetStore()->SetFlags(transform->GetStoreHandle(), TransformStore::AllDirty);
+            }
+
+            for (GameObject* child = gameObject->m_FirstChild; child != nullptr; child = child->m_NextSibling)
+            {
+                pending.push_back(child);
+            }
+        }
+    }
+
+    void GameObject::OnNameChanged(NameId oldName)
+    {
+        if (m_Scene != nullptr)
+        {
+            m_Scene->UnindexName(*this, oldName);
+            m_Scene->IndexName(*this);
+        }
+    }
+
+    bool GameObject::RecordChange(uint8_t flags)
+    {
+        return m_Scene != nullptr && m_Scene->GetChangeJournal().Record(m_Handle, flags);
+    }
+
+    void GameObject::MarkHierarchyChanged(bool isMoved)
+    {
+        if (m_Transform != nullptr)
+        {
+            m_Transform->GetStore()->MarkHierarchyChanged();
+        }
+        if (m_Scene != nullptr)
+        {
+            m_Scene->MarkHierarchyChanged(isMoved ? this : nullptr);
+        }
+    }
+
+    void GameObject::LinkToParent(GameObject* parent)
+    {
+        assert(m_Parent == nullptr);
+        if (parent == nullptr)
+        {
+            return;
+        }
+
+        m_Parent = parent;
+        m_PreviousSibling = parent->m_LastChild;
+        m_NextSibling = nullptr;
+        if (parent->m_LastChild != nullptr)
+        {
+            parent->m_LastChild->m_NextSibling = this;
+        }
+        else
+        {
+            parent->m_FirstChild = this;
+        }
+        parent->m_LastChild = this;
+        ++parent->m_ChildCount;
+    }
+
+    void GameObject::UnlinkFromParent()
+    {
+        if (m_Parent == nullptr)
+        {
+            return;
+        }
+
+        if (m_PreviousSibling != nullptr)
+        {
+            m_PreviousSibling->m_NextSibling = m_NextSibling;
+        }
+        else
+        {
+            m_Parent->m_FirstChild = m_NextSibling;
+        }
+
+        if (m_NextSibling != nullptr)
+        {
+            m_NextSibling->m_PreviousSibling = m_PreviousSibling;
+        }
+        else
+        {
+            m_Parent->m_LastChild = m_PreviousSibling;
+        }
+
+        assert(m_Parent->m_ChildCount > 0);
+        --m_Parent->m_ChildCount;
+        m_Parent = nullptr;
+        m_NextSibling = nullptr;
+        m_PreviousSibling = nullptr;
+    }
+
+    void GameObject::DestroyHierarchy(GameObject* root)
+    {
+        if (root == nullptr)
+        {
+            return;
+        }
+
+        root->SetParent(nullptr);
+
+        // Breadth-first traversal, following the links before they are cleared. Parents come before their children.
+        std::vector<GameObject*> subtree;
+        subtree.push_back(root);
+        for (size_t i = 0; i < subtree.size(); ++i)
+        {
+            for (GameObject* child = subtree[i]->m_FirstChild; child != nullptr; child = child->m_NextSibling)
+            {
+                subtree.push_back(child);
+            }
+        }
+
+        DeleteUnlinked(subtree.data(), subtree.size());
+    }
+
+    void GameObject::DeleteUnlinked(GameObject* const* gameObjects, size_t count)
+    {
+        // Without links, the destructors don't walk nor invalidate any other object of the set.
+        for (size_t i = 0; i < count; ++i)
+        {
+            GameObject* gameObject = gameObjects[i];
+            gameObject->m_Parent = nullptr;
+            gameObject->m_FirstChild = nullptr;
+            gameObject->m_LastChild = nullptr;
+            gameObject->m_NextSibling = nullptr;
+            gameObject->m_PreviousSibling = nullptr;
+            gameObject->m_ChildCount = 0;
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            delete gameObjects[i];
+        }
+    }
 } // VulkanDemo
@@ -3,12 +3,24 @@
 #include <vector>
 
 #include "Component.h"
+#include "PoolAllocator.h"
 
 namespace VulkanDemo
 {
-    class GameObject : public Object
+    class GameObject;
+    class Scene;
+    class Transform;
+
+    typedef SlotMapHandle<GameObject> GameObjectHandle;
+
+    class GameObject : public Object, public Pooled<GameObject>
     {
+        friend Scene;
+        friend Transform;
+
     public:
+        static constexpr char const * PoolName = "GameObject";
+
         GameObject();
         virtual ~GameObject();
 
@@ -16,23 +28,140 @@ namespace VulkanDemo
         void RemoveComponent(const Component& component);
         inline std::vector<Component*> const & GetComponents() const { return m_Components; }
 
+        ///
+        /// Returns the primary component of the given type, or nullptr, without scanning the list of components. The
+        /// primary component is the first one added, or after its removal another one of the same type.
+        ///
+        template<typename T>
+        inline T* GetComponent() const { return static_cast<T*>(m_ComponentsByType[T::TypeId]); }
+        inline Component* GetComponent(ComponentType::Id typeId) const { return m_ComponentsByType[typeId]; }
+
+        ///
+        /// Returns a mask with a bit set for every type of component attached to the object.
+        ///
+        inline uint32_t GetComponentMask() const { return m_ComponentMask; }
+        inline bool HasComponents(uint32_t mask) const { return (m_ComponentMask & mask) == mask; }
+
+        ///
+        /// Returns the primary Transform, or nullptr. This is the transform that takes part in the hierarchy.
+        ///
+        inline Transform* GetTransform() const { return m_Transform; }
+
         inline GameObject* GetParent() const { return m_Parent; }
         void SetParent(GameObject* parent);
 
-        inline std::vector<GameObject*> const & GetChildren() const { return m_Children; }
+        ///
+        /// Range over the children, in the order in which they were attached, usable in range-based for loops.
+        ///
+        class ChildRange
+        {
+        public:
+            class Iterator
+            {
+            public:
+                explicit Iterator(GameObject* current) : m_Current{ current } {}
+
+                inline GameObject* operator*() const { return m_Current; }
+                inline Iterator & operator++() { m_Current = m_Current->m_NextSibling; return *this; }
+                inline bool operator!=(Iterator const & other) const { return m_Current != other.m_Current; }
+                inline bool operator==(Iterator const & other) const { return m_Current == other.m_Current; }
+
+            private:
+                GameObject* m_Current;
+            };
+
+            explicit ChildRange(GameObject* first) : m_First{ first } {}
+
+            inline Iterator begin() const { return Iterator{ m_First }; }
+            inline Iterator end() const { return Iterator{ nullptr }; }
+
+        private:
+            GameObject* m_First;
+        };
+
+        inline ChildRange GetChildren() const { return ChildRange{ m_FirstChild }; }
+        inline GameObject* GetFirstChild() const { return m_FirstChild; }
+        inline GameObject* GetNextSibling() const { return m_NextSibling; }
+        inline GameObject* GetPreviousSibling() const { return m_PreviousSibling; }
+        inline uint32_t GetChildCount() const { return m_ChildCount; }
 
         ///
         /// Indicates whether the provided transform is strictly a descendant of this object. If the provided object is
         /// a descendant, the object on which this method is called shall be in its hierarchy of parents.
         ///
+        /// Takes constant time when both objects are in the same scene, whose hierarchy index stays valid across the
+        /// moves of subtrees within the scene, and walks the chain of parents otherwise. See Scene::IsDescendantOf().
+        ///
         bool IsDescendantOf(GameObject const & some) const;
 
+        ///
+        /// Returns the scene that owns this object, or nullptr if the object is not part of a scene.
+        ///
+        inline Scene* GetScene() const { return m_Scene; }
+
+        ///
+        /// Returns the handle of the object in its scene, or a null handle if the object is not part of a scene.
+        ///
+        inline GameObjectHandle GetHandle() const { return m_Handle; }
+
+        ///
+        /// Marks the cached world matrices of the transforms of this object and of all its descendants as outdated.
+        ///
+        void InvalidateWorldMatrices();
+
+        ///
+        /// Destroys the object and all its descendants, removing them from their scene. Unlike deleting the objects one
+        /// by one, which detaches and invalidates the children of every deleted object, this takes linear time whatever
+        /// the shape of the subtree.
+        ///
+        static void DestroyHierarchy(GameObject* root);
+
+    protected:
+        virtual void OnNameChanged(NameId oldName) override;
+
     private:
         GameObject(GameObject const &other) = delete;
         void operator=(GameObject const &other) = delete;
 
+        ///
+        /// Notifies the transform stores that the order of the transforms by depth may have changed.
+        ///
+        /// @param[in] isMoved  Whether only the parent of this object changed, which the scene handles incrementally.
+        ///
+        void MarkHierarchyChanged(bool isMoved = false);
+
+        ///
+        /// Records changes of the object in the journal of its scene, if any.
+        ///
+        /// @return true if some of the changes were not recorded yet during the current frame.
+        ///
+        bool RecordChange(uint8_t flags);
+
+        ///
+        /// Inserts this object at the end of the children of the parent, or unlinks it from the children of its
+        /// parent. Only the links are updated.
+        ///
+        void LinkToParent(GameObject* parent);
+        void UnlinkFromParent();
+
+        ///
+        /// Clears the hierarchy links of the objects, which must form a set closed under the parent and child
+        /// relations, before deleting them.
+        ///
+        static void DeleteUnlinked(GameObject* const* gameObjects, size_t count);
+
         std::vector<Component*> m_Components;
+        Component* m_ComponentsByType[ComponentType::Count];
+        uint32_t m_ComponentMask;
         GameObject* m_Parent;
-        std::vector<GameObject*> m_Children;
+        GameObject* m_FirstChild;
+        GameObject* m_LastChild;
+        GameObject* m_NextSibling;
+        GameObject* m_PreviousSibling;
+        uint32_t m_ChildCount;
+        Transform* m_Transform; // Same as m_ComponentsByType[ComponentType::Transform].
+        Scene* m_Scene;
+        GameObjectHandle m_Handle;
+        uint32_t m_NameIndex; // Position in the bucket of the name in the index of the scene.
     };
 } // VulkanDemo
@@ -0,0 +1,665 @@
+#include "GpuCuller.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <string>
+
+#include "Application.h"
+#include "ShaderLoader.h"
+#include "ThreadPool.h"
+#include "VulkanManager.h"
+
+namespace VulkanDemo
+{
+    namespace
+    {
+        // Work group sizes of cull.comp and hzb.comp.
+        const uint32_t CullGroupSize = 64;
+        const uint32_t HzbGroupSize = 8;
+
+        // Step of the depths of the depth buffer, stored as 24 bits normalized integers.
+        const float DepthStep = 1.0f / 16777215.0f;
+
+    }
+
+    GpuCuller::GpuCuller()
+    {
+        CreatePipelines();
+    }
+
+    GpuCuller::~GpuCuller()
+    {
+        DestroyAtlas();
+        DestroyPipelines();
+    }
+
+    void GpuCuller::SetDepthImage(VkImage image, VkImageView depthView, uint32_t width, uint32_t height)
+    {
+        m_DepthImage = image;
+        m_DepthView = depthView;
+
+        DestroyAtlas();
+        m_Pyramid.Resize(width, height);
+        m_GpuPyramid.Resize(width, height);
+        CreateAtlas();
+
+        m_IsPyramidBuilt = false;
+        m_IsDescriptorSetDirty = true;
+    }
+
+    void GpuCuller::Prepare(Span<View const> views, Aabb const * bounds, InstanceBatcher const & batcher, Span<VkDrawIndexedIndirectCommand const> commands)
+    {
+        Prepare(views, bounds, batcher, commands, ThreadPool::GetDefault());
+    }
+
+    void GpuCuller::Prepare(Span<View const> views, Aabb const * bounds, InstanceBatcher const & batcher, Span<VkDrawIndexedIndirectCommand const> commands, ThreadPool & threadPool)
+    {
+        assert(views.size() == batcher.GetViewCount());
+        Clock::time_point start = Clock::now();
+
+        m_InstanceCount = batcher.GetInstanceCount();
+        m_CommandCount = (uint32_t)commands.size();
+
+        m_CullViews.resize(views.size());
+        m_ViewInstances.clear();
+        for (uint32_t v = 0; v < (uint32_t)views.size(); ++v)
+        {
+            View const & view = views[v];
+            Frustum frustum = Frustum::FromMatrix(view.viewProjection);
+
+            GpuCullView & cullView = m_CullViews[v];
+            cullView = GpuCullView{};
+            cullView.viewProjection = view.viewProjection;
+            std::copy(frustum.planes, frustum.planes + Frustum::PlaneCount, cullView.planes);
+            cullView.viewport = glm::vec4{ (float)view.viewport.offset.x, (float)view.viewport.offset.y, (float)view.viewport.extent.width, (float)view.viewport.extent.height };
+            cullView.levelCount = m_IsPyramidBuilt ? m_Pyramid.GetLevelCount() : 0;
+
+            // The instances of the batches of a view follow each other.
+            Span<InstanceBatcher::Batch const> batches = batcher.GetBatches(v);
+            uint32_t firstInstance = batches.empty() ? 0 : batches[0].firstInstance;
+            uint32_t instanceCount = batches.empty() ? 0 : batches[batches.size() - 1].firstInstance + batches[batches.size() - 1].instanceCount - firstInstance;
+            m_ViewInstances.push_back(glm::uvec2{ firstInstance, instanceCount });
+        }
+
+        m_IsDescriptorSetDirty |= m_Views.Reserve(m_CullViews.size() * sizeof(GpuCullView));
+        m_IsDescriptorSetDirty |= m_Instances.Reserve(m_InstanceCount * sizeof(GpuCullInstance));
+        m_IsDescriptorSetDirty |= m_Commands.Reserve(m_CommandCount * sizeof(VkDrawIndexedIndirectCommand));
+        // The visible instances are bound as the instance buffer, whose binding range fits at the last binding offset.
+        m_IsDescriptorSetDirty |= m_VisibleInstances.Reserve(batcher.GetBufferInstanceCount() * sizeof(uint32_t));
+        m_CommandBindingOffsets.resize(m_CommandCount);
+        if (!m_CullViews.empty())
+        {
+            memcpy(m_Views.GetData(), m_CullViews.data(), m_CullViews.size() * sizeof(GpuCullView));
+        }
+
+        // The commands are written with their instances, which are written in order, as suits write-combined memory.
+        GpuCullInstance * instances = static_cast<GpuCullInstance *>(m_Instances.GetData());
+        VkDrawIndexedIndirectCommand * cullCommands = static_cast<VkDrawIndexedIndirectCommand *>(m_Commands.GetData());
+        uint32_t const * objects = batcher.GetInstanceObjects().data();
+        uint32_t firstCommand = 0;
+        for (uint32_t v = 0; v < batcher.GetViewCount(); ++v)
+        {
+            Span<InstanceBatcher::Batch const> batches = batcher.GetBatches(v);
+            threadPool.ParallelFor((uint32_t)batches.size(), 64, [&](uint32_t begin, uint32_t end) {
+                for (uint32_t i = begin; i < end; ++i)
+                {
+                    uint32_t command = firstCommand + i;
+                    cullCommands[command] = commands[command];
+                    cullCommands[command].instanceCount = 0;
+
+                    InstanceBatcher::Batch const & batch = batches[i];
+                    m_CommandBindingOffsets[command] = batch.bindingOffset;
+                    for (uint32_t instance = batch.firstInstance; instance < batch.firstInstance + batch.instanceCount; ++instance)
+                    {
+                        Aabb const & box = bounds[objects[instance]];
+                        GpuCullInstance & cullInstance = instances[instance];
+                        cullInstance.center = box.GetCenter();
+                        cullInstance.command = command;
+                        cullInstance.extents = box.GetExtents();
+                        cullInstance.bindingOffset = batch.bindingOffset;
+                    }
+                }
+            });
+            firstCommand += (uint32_t)batches.size();
+        }
+        assert(firstCommand == m_CommandCount);
+
+        if (m_IsDescriptorSetDirty)
+        {
+            UpdateDescriptorSet();
+        }
+
+        m_Stats.instanceCount = m_InstanceCount;
+        m_Stats.commandCount = m_CommandCount;
+        m_Stats.prepareTime = GetMilliseconds(start, Clock::now());
+    }
+
+    void GpuCuller::RecordCulling(VkCommandBuffer commandBuffer)
+    {
+        assert(m_Atlas != VK_NULL_HANDLE && !m_IsDescriptorSetDirty);
+
+        // The depth buffer still holds the previous frame, from which the tested pyramid was built.
+        m_IsValidationPending = m_IsValidationEnabled;
+        VkPipelineStageFlags sourceStages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        if (m_IsValidationPending && m_IsPyramidBuilt)
+        {
+            uint32_t width = m_Pyramid.GetDepthWidth();
+            uint32_t height = m_Pyramid.GetDepthHeight();
+            m_DepthReadback.Reserve(width * height * sizeof(uint32_t));
+            m_AtlasReadback.Reserve(m_Pyramid.GetAtlasWidth() * m_Pyramid.GetAtlasHeight() * sizeof(float));
+
+            VkImageMemoryBarrier depthBarrier{};
+            depthBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            depthBarrier.pNext = NULL;
+            depthBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            depthBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+            depthBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            depthBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            depthBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            depthBarrier.image = m_DepthImage;
+            depthBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+            depthBarrier.subresourceRange.baseMipLevel = 0;
+            depthBarrier.subresourceRange.levelCount = 1;
+            depthBarrier.subresourceRange.baseArrayLayer = 0;
+            depthBarrier.subresourceRange.layerCount = 1;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &depthBarrier);
+
+            VkBufferImageCopy region{};
+            region.bufferOffset = 0;
+            region.bufferRowLength = 0;
+            region.bufferImageHeight = 0;
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+            region.imageSubresource.mipLevel = 0;
+            region.imageSubresource.baseArrayLayer = 0;
+            region.imageSubresource.layerCount = 1;
+            region.imageOffset = VkOffset3D{ 0, 0, 0 };
+            region.imageExtent = VkExtent3D{ width, height, 1 };
+            vkCmdCopyImageToBuffer(commandBuffer, m_DepthImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_DepthReadback.GetBuffer(), 1, &region);
+
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageExtent = VkExtent3D{ m_Pyramid.GetAtlasWidth(), m_Pyramid.GetAtlasHeight(), 1 };
+            vkCmdCopyImageToBuffer(commandBuffer, m_Atlas, VK_IMAGE_LAYOUT_GENERAL, m_AtlasReadback.GetBuffer(), 1, &region);
+
+            sourceStages |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+        }
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_CullPipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_PipelineLayout, 0, 1, &m_DescriptorSet, 0, NULL);
+        for (uint32_t v = 0; v < (uint32_t)m_ViewInstances.size(); ++v)
+        {
+            PushConstants constants{ v, m_ViewInstances[v].x, m_ViewInstances[v].y };
+            if (constants.instanceCount != 0)
+            {
+                vkCmdPushConstants(commandBuffer, m_PipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+                vkCmdDispatch(commandBuffer, (constants.instanceCount + CullGroupSize - 1) / CullGroupSize, 1, 1);
+            }
+        }
+
+        // The draws read the commands and the visible instances, and the render pass overwrites the depth buffer.
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.pNext = NULL;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+        VkPipelineStageFlags destinationStages = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        vkCmdPipelineBarrier(commandBuffer, sourceStages, destinationStages, 0, 1, &barrier, 0, NULL, 0, NULL);
+    }
+
+    void GpuCuller::RecordPyramid(VkCommandBuffer commandBuffer)
+    {
+        assert(m_Atlas != VK_NULL_HANDLE && !m_IsDescriptorSetDirty);
+
+        std::array<VkImageMemoryBarrier, 2> imageBarriers;
+        for (VkImageMemoryBarrier & imageBarrier : imageBarriers)
+        {
+            imageBarrier = VkImageMemoryBarrier{};
+            imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            imageBarrier.pNext = NULL;
+            imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            imageBarrier.subresourceRange.baseMipLevel = 0;
+            imageBarrier.subresourceRange.levelCount = 1;
+            imageBarrier.subresourceRange.baseArrayLayer = 0;
+            imageBarrier.subresourceRange.layerCount = 1;
+        }
+
+        // The depth buffer becomes readable by hzb.comp.
+        imageBarriers[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        imageBarriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        imageBarriers[0].oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        imageBarriers[0].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+        imageBarriers[0].image = m_DepthImage;
+        imageBarriers[0].subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+
+        // The atlas was last read by the culling, and its copy for the validation.
+        imageBarriers[1].srcAccessMask = 0;
+        imageBarriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        imageBarriers[1].oldLayout = m_IsAtlasInitialized ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_UNDEFINED;
+        imageBarriers[1].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        imageBarriers[1].image = m_Atlas;
+        imageBarriers[1].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        m_IsAtlasInitialized = true;
+
+        VkPipelineStageFlags sourceStages = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+        vkCmdPipelineBarrier(commandBuffer, sourceStages, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0, NULL, (uint32_t)imageBarriers.size(), imageBarriers.data());
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_HzbPipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_PipelineLayout, 0, 1, &m_DescriptorSet, 0, NULL);
+
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.pNext = NULL;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+        for (uint32_t level = 0; level < m_Pyramid.GetLevelCount(); ++level)
+        {
+            // Every level reads the previous one.
+            if (level != 0)
+            {
+                vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, NULL, 0, NULL);
+            }
+
+            HzbPyramid::Level const & rectangle = m_Pyramid.GetLevels()[level];
+            PushConstants constants{ level, 0, 0 };
+            vkCmdPushConstants(commandBuffer, m_PipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+            vkCmdDispatch(commandBuffer, (rectangle.width + HzbGroupSize - 1) / HzbGroupSize, (rectangle.height + HzbGroupSize - 1) / HzbGroupSize, 1);
+        }
+
+        // The pyramid is read by the culling of the next frame, which also copies it for the validation, before the
+        // render pass overwrites the depth buffer. The host reads the results of the frame for the validation.
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+        VkPipelineStageFlags destinationStages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_HOST_BIT |
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, destinationStages, 0, 1, &barrier, 0, NULL, 0, NULL);
+
+        m_IsPyramidBuilt = true;
+    }
+
+    void GpuCuller::Validate()
+    {
+        if (!m_IsValidationPending)
+        {
+            return;
+        }
+        m_IsValidationPending = false;
+        Clock::time_point start = Clock::now();
+
+        // The pyramid is rebuilt from the depth buffer, whose depths are in the 24 low bits of every texel.
+        bool isOcclusionTested = !m_CullViews.empty() && m_CullViews[0].levelCount != 0;
+        if (isOcclusionTested)
+        {
+            uint32_t pixelCount = m_Pyramid.GetDepthWidth() * m_Pyramid.GetDepthHeight();
+            uint32_t const * texels = static_cast<uint32_t const *>(m_DepthReadback.GetData());
+            m_Depths.resize(pixelCount);
+            for (uint32_t i = 0; i < pixelCount; ++i)
+            {
+                m_Depths[i] = (texels[i] & 0xFFFFFF) * DepthStep;
+            }
+            m_Pyramid.Build(m_Depths.data());
+            m_GpuPyramid.SetAtlas(static_cast<float const *>(m_AtlasReadback.GetData()));
+
+            for (uint32_t level = 0; level < m_Pyramid.GetLevelCount(); ++level)
+            {
+                HzbPyramid::Level const & rectangle = m_Pyramid.GetLevels()[level];
+                for (uint32_t y = 0; y < rectangle.height; ++y)
+                {
+                    for (uint32_t x = 0; x < rectangle.width; ++x)
+                    {
+                        if (std::abs(m_Pyramid.GetDepth(level, x, y) - m_GpuPyramid.GetDepth(level, x, y)) > DepthStep)
+                        {
+                            ++m_Stats.pyramidMismatchCount;
+                        }
+                    }
+                }
+            }
+        }
+
+        // The instances drawn by every command must be its own, once each.
+        GpuCullInstance const * instances = static_cast<GpuCullInstance const *>(m_Instances.GetData());
+        VkDrawIndexedIndirectCommand const * commands = static_cast<VkDrawIndexedIndirectCommand const *>(m_Commands.GetData());
+        uint32_t const * visibleInstances = static_cast<uint32_t const *>(m_VisibleInstances.GetData());
+        m_IsGpuVisible.assign(m_InstanceCount, 0);
+        for (uint32_t command = 0; command < m_CommandCount; ++command)
+        {
+            // The commands and the visible instances are relative to the binding of the batch.
+            VkDrawIndexedIndirectCommand const & drawCommand = commands[command];
+            uint32_t bindingOffset = m_CommandBindingOffsets[command];
+            for (uint32_t i = bindingOffset + drawCommand.firstInstance; i < bindingOffset + drawCommand.firstInstance + drawCommand.instanceCount; ++i)
+            {
+                uint32_t instance = i < m_InstanceCount ? bindingOffset + visibleInstances[i] : m_InstanceCount;
+                if (instance >= m_InstanceCount || instances[instance].command != command || m_IsGpuVisible[instance] != 0)
+                {
+                    ++m_Stats.wrongVisibleCount;
+                    continue;
+                }
+                m_IsGpuVisible[instance] = 1;
+                ++m_Stats.visibleCount;
+            }
+        }
+
+        // The instances are culled on the CPU against the pyramid read back, so that the differences of the pyramids
+        // are only counted once.
+        for (uint32_t v = 0; v < (uint32_t)m_ViewInstances.size(); ++v)
+        {
+            for (uint32_t instance = m_ViewInstances[v].x; instance < m_ViewInstances[v].x + m_ViewInstances[v].y; ++instance)
+            {
+                bool isVisible = m_GpuPyramid.IsVisible(m_CullViews[v], instances[instance]);
+                if (isVisible && m_IsGpuVisible[instance] == 0)
+                {
+                    ++m_Stats.wrongCulledCount;
+                }
+                else if (!isVisible && m_IsGpuVisible[instance] != 0)
+                {
+                    ++m_Stats.wrongVisibleCount;
+                }
+            }
+        }
+
+        ++m_Stats.validatedFrameCount;
+        m_Stats.validateTime += GetMilliseconds(start, Clock::now());
+    }
+
+    void GpuCuller::PrintStats() const
+    {
+        StatsRows rows = {
+            { "Instances", std::to_string(m_Stats.instanceCount) },
+            { "Draw commands", std::to_string(m_Stats.commandCount) },
+            { "Preparation (ms)", FormatStat(m_Stats.prepareTime) },
+            { "Validated frames", std::to_string(m_Stats.validatedFrameCount) },
+            { "Visible instances", std::to_string(m_Stats.visibleCount) },
+            { "Pyramid mismatches", std::to_string(m_Stats.pyramidMismatchCount) },
+            { "Wrongly culled", std::to_string(m_Stats.wrongCulledCount) },
+            { "Wrongly visible", std::to_string(m_Stats.wrongVisibleCount) },
+            { "Validation (ms)", FormatStat(m_Stats.validateTime) },
+        };
+
+        PrintStatsTable("GPU culling", rows);
+    }
+
+    void GpuCuller::CreatePipelines()
+    {
+        VkDevice device = Application::GetInstance().GetVulkanManager()->GetDevice();
+
+        // The depth buffer is read texel by texel.
+        VkSamplerCreateInfo samplerCreateInfo{};
+        samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerCreateInfo.pNext = NULL;
+        samplerCreateInfo.flags = 0;
+        samplerCreateInfo.magFilter = VK_FILTER_NEAREST;
+        samplerCreateInfo.minFilter = VK_FILTER_NEAREST;
+        samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerCreateInfo.mipLodBias = 0;
+        samplerCreateInfo.anisotropyEnable = VK_FALSE;
+        samplerCreateInfo.maxAnisotropy = 0;
+        samplerCreateInfo.compareEnable = VK_FALSE;
+        samplerCreateInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+        samplerCreateInfo.minLod = 0;
+        samplerCreateInfo.maxLod = 0;
+        samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+        samplerCreateInfo.unnormalizedCoordinates = VK_FALSE;
+        CheckResult(vkCreateSampler(device, &samplerCreateInfo, NULL, &m_Sampler));
+
+        // Both shaders share the bindings: hzb.comp uses 0 to 2, and cull.comp 1 to 6.
+        std::array<VkDescriptorSetLayoutBinding, 7> bindings;
+        std::array<VkDescriptorType, 7> types = {
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,  // Depth buffer.
+            VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,           // Atlas of the pyramid.
+            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,          // Levels.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,          // Views.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,          // Instances.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,          // Commands.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,          // Visible instances.
+        };
+        for (uint32_t i = 0; i < (uint32_t)bindings.size(); ++i)
+        {
+            bindings[i].binding = i;
+            bindings[i].descriptorType = types[i];
+            bindings[i].descriptorCount = 1;
+            bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+            bindings[i].pImmutableSamplers = i == 0 ? &m_Sampler : NULL;
+        }
+
+        VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo{};
+        descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        descriptorSetLayoutCreateInfo.pNext = NULL;
+        descriptorSetLayoutCreateInfo.flags = 0;
+        descriptorSetLayoutCreateInfo.bindingCount = (uint32_t)bindings.size();
+        descriptorSetLayoutCreateInfo.pBindings = bindings.data();
+        CheckResult(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, NULL, &m_DescriptorSetLayout));
+
+        // The set has its own pool, since the shared one only holds samplers.
+        std::array<VkDescriptorPoolSize, 4> poolSizes;
+        poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        poolSizes[0].descriptorCount = 1;
+        poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        poolSizes[1].descriptorCount = 1;
+        poolSizes[2].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        poolSizes[2].descriptorCount = 1;
+        poolSizes[3].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        poolSizes[3].descriptorCount = 4;
+
+        VkDescriptorPoolCreateInfo descriptorPoolCreateInfo{};
+        descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        descriptorPoolCreateInfo.pNext = NULL;
+        descriptorPoolCreateInfo.flags = 0;
+        descriptorPoolCreateInfo.maxSets = 1;
+        descriptorPoolCreateInfo.poolSizeCount = (uint32_t)poolSizes.size();
+        descriptorPoolCreateInfo.pPoolSizes = poolSizes.data();
+        CheckResult(vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, NULL, &m_DescriptorPool));
+
+        VkDescriptorSetAllocateInfo descriptorSetAllocateInfo{};
+        descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        descriptorSetAllocateInfo.pNext = NULL;
+        descriptorSetAllocateInfo.descriptorPool = m_DescriptorPool;
+        descriptorSetAllocateInfo.descriptorSetCount = 1;
+        descriptorSetAllocateInfo.pSetLayouts = &m_DescriptorSetLayout;
+        CheckResult(vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &m_DescriptorSet));
+
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(PushConstants);
+
+        VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
+        pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutCreateInfo.pNext = NULL;
+        pipelineLayoutCreateInfo.flags = 0;
+        pipelineLayoutCreateInfo.setLayoutCount = 1;
+        pipelineLayoutCreateInfo.pSetLayouts = &m_DescriptorSetLayout;
+        pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+        pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+        CheckResult(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, NULL, &m_PipelineLayout));
+
+        ShaderLoader * shaderLoader = Application::GetInstance().GetShaderLoader();
+        std::array<VkComputePipelineCreateInfo, 2> pipelineCreateInfos;
+        std::array<VkShaderModule, 2> modules = { shaderLoader->GetHzbComp(), shaderLoader->GetCullComp() };
+        for (uint32_t i = 0; i < (uint32_t)pipelineCreateInfos.size(); ++i)
+        {
+            VkComputePipelineCreateInfo & pipelineCreateInfo = pipelineCreateInfos[i];
+            pipelineCreateInfo = VkComputePipelineCreateInfo{};
+            pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+            pipelineCreateInfo.pNext = NULL;
+            pipelineCreateInfo.flags = 0;
+            pipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+            pipelineCreateInfo.stage.pNext = NULL;
+            pipelineCreateInfo.stage.flags = 0;
+            pipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+            pipelineCreateInfo.stage.module = modules[i];
+            pipelineCreateInfo.stage.pName = "main";
+            pipelineCreateInfo.stage.pSpecializationInfo = NULL;
+            pipelineCreateInfo.layout = m_PipelineLayout;
+            pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+            pipelineCreateInfo.basePipelineIndex = -1;
+        }
+
+        std::array<VkPipeline, 2> pipelines;
+        CheckResult(vkCreateComputePipelines(device, VK_NULL_HANDLE, (uint32_t)pipelineCreateInfos.size(), pipelineCreateInfos.data(), NULL, pipelines.data()));
+        m_HzbPipeline = pipelines[0];
+        m_CullPipeline = pipelines[1];
+    }
+
+    void GpuCuller::DestroyPipelines()
+    {
+        VkDevice device = Application::GetInstance().GetVulkanManager()->GetDevice();
+
+        vkDestroyPipeline(device, m_CullPipeline, NULL);
+        m_CullPipeline = VK_NULL_HANDLE;
+
+        vkDestroyPipeline(device, m_HzbPipeline, NULL);
+        m_HzbPipeline = VK_NULL_HANDLE;
+
+        vkDestroyPipelineLayout(device, m_PipelineLayout, NULL);
+        m_PipelineLayout = VK_NULL_HANDLE;
+
+        // Destroying the pool frees the set.
+        vkDestroyDescriptorPool(device, m_DescriptorPool, NULL);
+        m_DescriptorPool = VK_NULL_HANDLE;
+        m_DescriptorSet = VK_NULL_HANDLE;
+
+        vkDestroyDescriptorSetLayout(device, m_DescriptorSetLayout, NULL);
+        m_DescriptorSetLayout = VK_NULL_HANDLE;
+
+        vkDestroySampler(device, m_Sampler, NULL);
+        m_Sampler = VK_NULL_HANDLE;
+    }
+
+    void GpuCuller::CreateAtlas()
+    {
+        VulkanManager * vulkanManager = Application::GetInstance().GetVulkanManager();
+        VkDevice device = vulkanManager->GetDevice();
+        uint32_t graphicsQueueFamilyIndex = vulkanManager->GetGraphicsQueueFamilyIndex();
+
+        VkImageCreateInfo imageCreateInfo{};
+        imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageCreateInfo.pNext = NULL;
+        imageCreateInfo.flags = 0;
+        imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageCreateInfo.format = VK_FORMAT_R32_SFLOAT;
+        imageCreateInfo.extent.width = m_Pyramid.GetAtlasWidth();
+        imageCreateInfo.extent.height = m_Pyramid.GetAtlasHeight();
+        imageCreateInfo.extent.depth = 1;
+        imageCreateInfo.mipLevels = 1;
+        imageCreateInfo.arrayLayers = 1;
+        imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageCreateInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageCreateInfo.queueFamilyIndexCount = 1;
+        imageCreateInfo.pQueueFamilyIndices = &graphicsQueueFamilyIndex;
+        imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        CheckResult(vkCreateImage(device, &imageCreateInfo, NULL, &m_Atlas));
+        m_AtlasMemory = AllocateAndBindImageMemory(m_Atlas);
+
+        VkImageViewCreateInfo imageViewCreateInfo{};
+        imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        imageViewCreateInfo.pNext = NULL;
+        imageViewCreateInfo.flags = 0;
+        imageViewCreateInfo.image = m_Atlas;
+        imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        imageViewCreateInfo.format = VK_FORMAT_R32_SFLOAT;
+        imageViewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+        imageViewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+        imageViewCreateInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+        imageViewCreateInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+        imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
+        imageViewCreateInfo.subresourceRange.levelCount = 1;
+        imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
+        imageViewCreateInfo.subresourceRange.layerCount = 1;
+        CheckResult(vkCreateImageView(device, &imageViewCreateInfo, NULL, &m_AtlasView));
+        m_IsAtlasInitialized = false;
+
+        // The rectangles of the levels, as the uvec4 of the shaders.
+        m_IsDescriptorSetDirty |= m_Levels.Reserve(HzbPyramid::MaxLevelCount * sizeof(HzbPyramid::Level));
+        memcpy(m_Levels.GetData(), m_Pyramid.GetLevels(), m_Pyramid.GetLevelCount() * sizeof(HzbPyramid::Level));
+    }
+
+    void GpuCuller::DestroyAtlas()
+    {
+        if (m_Atlas == VK_NULL_HANDLE)
+        {
+            return;
+        }
+
+        VkDevice device = Application::GetInstance().GetVulkanManager()->GetDevice();
+        vkDestroyImageView(device, m_AtlasView, NULL);
+        vkFreeMemory(device, m_AtlasMemory, NULL);
+        vkDestroyImage(device, m_Atlas, NULL);
+
+        m_AtlasView = VK_NULL_HANDLE;
+        m_AtlasMemory = VK_NULL_HANDLE;
+        m_Atlas = VK_NULL_HANDLE;
+    }
+
+    void GpuCuller::UpdateDescriptorSet()
+    {
+        assert(m_Atlas != VK_NULL_HANDLE && m_DepthView != VK_NULL_HANDLE);
+
+        // Every binding is rewritten whenever any of them changes, which happens when the buffers grow.
+        m_Views.Reserve(0);
+        m_Instances.Reserve(0);
+        m_Commands.Reserve(0);
+        m_VisibleInstances.Reserve(0);
+
+        VkDescriptorImageInfo depthInfo{};
+        depthInfo.sampler = VK_NULL_HANDLE;
+        depthInfo.imageView = m_DepthView;
+        depthInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+        VkDescriptorImageInfo atlasInfo{};
+        atlasInfo.sampler = VK_NULL_HANDLE;
+        atlasInfo.imageView = m_AtlasView;
+        atlasInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        std::array<VkDescriptorBufferInfo, 5> bufferInfos;
+        std::array<MappedBuffer const *, 5> buffers = { &m_Levels, &m_Views, &m_Instances, &m_Commands, &m_VisibleInstances };
+        for (uint32_t i = 0; i < (uint32_t)bufferInfos.size(); ++i)
+        {
+            bufferInfos[i].buffer = buffers[i]->GetBuffer();
+            bufferInfos[i].offset = 0;
+            bufferInfos[i].range = VK_WHOLE_SIZE;
+        }
+
+        std::array<VkWriteDescriptorSet, 7> writes;
+        for (uint32_t i = 0; i < (uint32_t)writes.size(); ++i)
+        {
+            VkWriteDescriptorSet & write = writes[i];
+            write = VkWriteDescriptorSet{};
+            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.pNext = NULL;
+            write.dstSet = m_DescriptorSet;
+            write.dstBinding = i;
+            write.dstArrayElement = 0;
+            write.descriptorCount = 1;
+            if (i == 0)
+            {
+                write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                write.pImageInfo = &depthInfo;
+            }
+            else if (i == 1)
+            {
+                write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+                write.pImageInfo = &atlasInfo;
+            }
+            else
+            {
+                write.descriptorType = i == 2 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                write.pBufferInfo = &bufferInfos[i - 2];
+            }
+        }
+
+        VkDevice device = Application::GetInstance().GetVulkanManager()->GetDevice();
+        vkUpdateDescriptorSets(device, (uint32_t)writes.size(), writes.data(), 0, NULL);
+        m_IsDescriptorSetDirty = false;
+    }
+} // VulkanDemo
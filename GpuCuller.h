@@ -0,0 +1,193 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "Shared.h"
+
+#include "Bounds.h"
+#include "HzbPyramid.h"
+#include "InstanceBatcher.h"
+#include "MappedBuffer.h"
+#include "Span.h"
+
+namespace VulkanDemo
+{
+    class ThreadPool;
+
+    ///
+    /// Culls the instances of the batches of a frame on the GPU, against the frustums of the views and the depth buffer
+    /// of the previous frame, and writes the draw commands of the visible instances.
+    ///
+    /// Prepare() writes the views, the world bounds of every instance and the commands of the batches, without their
+    /// instances, to mapped buffers. RecordCulling(), before the render pass, runs cull.comp over the instances of every
+    /// view: every visible instance increments the instance count of the command of its batch and writes its index to
+    /// the visible instances, from the first instance of the command. The commands thus draw their visible instances
+    /// packed, and the ones without visible instances draw nothing; the vertex shaders read the instance written at
+    /// gl_InstanceIndex. Like the commands, the visible instances and their indices are relative to the binding offset
+    /// of the batch, from which both instance buffers are bound. RecordPyramid(), after the render pass, builds the
+    /// pyramid of the depth buffer with hzb.comp, as laid out by HzbPyramid, which the culling of the next frame tests.
+    ///
+    /// The culling only takes the occlusion tests off the CPU: the levels of detail, the sort and the batching of the
+    /// instances are still computed on the CPU, and Prepare() writes the bounds of every instance. The instances are thus
+    /// expected to be culled coarsely on the CPU beforehand, as the SceneRenderer does against the frustums, so that
+    /// this cost grows with the objects in the views rather than with all of them. Since the depths are those of the
+    /// previous frame, an object coming out from behind an occluder
+    /// as the camera moves may be missing for a frame. Only the frustums are tested until the pyramid of the depth buffer
+    /// is built.
+    ///
+    /// When the validation is enabled, the depth buffer and the pyramid tested by the culling are copied to buffers,
+    /// from which Validate() rebuilds the pyramid on the CPU and culls every instance with HzbPyramid::IsVisible(),
+    /// counting the differences with the GPU.
+    ///
+    /// Usage Notes:
+    /// - SetDepthImage() is called before Prepare(), and again whenever the depth buffer is recreated.
+    /// - The depth image has the sampled and transfer source usages, and is in the depth attachment layout when
+    ///   RecordPyramid() is recorded.
+    /// - The commands are recorded with DrawCommandBuilder::Record() on an indirect path, from GetIndirectBuffer().
+    /// - The visible instances are bound from the binding offset of every batch, as the instance buffer is, with a
+    ///   range of InstanceBatcher::GetBindingInstanceCount() indices.
+    /// - The buffers must no longer be used by the GPU when Prepare() is called.
+    /// - Prepare() must not be called from a ThreadPool::ParallelFor().
+    ///
+    class GpuCuller
+    {
+    public:
+        ///
+        /// View culled against the area of the depth buffer it is drawn to.
+        ///
+        struct View
+        {
+            glm::mat4 viewProjection;
+            VkRect2D viewport;
+        };
+
+        struct Stats
+        {
+            uint32_t instanceCount = 0;         // Instances culled by the last frame.
+            uint32_t commandCount = 0;
+            double prepareTime = 0;             // In milliseconds.
+
+            // Totals of the validated frames.
+            uint32_t validatedFrameCount = 0;
+            uint64_t visibleCount = 0;          // Instances visible on the GPU.
+            uint64_t pyramidMismatchCount = 0;  // Texels of the pyramid off by more than a step of the depth buffer.
+            uint64_t wrongCulledCount = 0;      // Instances culled by the GPU but not by the CPU.
+            uint64_t wrongVisibleCount = 0;     // Instances drawn by the GPU but culled by the CPU, or drawn wrongly.
+            double validateTime = 0;
+        };
+
+        GpuCuller();
+        ~GpuCuller();
+
+        ///
+        /// Sets the depth buffer whose pyramid is tested, and a view of its depth aspect. The size is below
+        /// 2^HzbPyramid::MaxLevelCount.
+        ///
+        void SetDepthImage(VkImage image, VkImageView depthView, uint32_t width, uint32_t height);
+
+        ///
+        /// Makes the next frames copy the inputs of the culling for Validate(). Disabled by default.
+        ///
+        inline void SetValidation(bool isEnabled) { m_IsValidationEnabled = isEnabled; }
+
+        ///
+        /// Writes the inputs of the culling of the batches of all the views, the views being in the order of the views of
+        /// the batcher, and the commands of the batches, as built by a DrawCommandBuilder. The bounds are the world
+        /// bounds of the objects of the instances.
+        ///
+        void Prepare(Span<View const> views, Aabb const * bounds, InstanceBatcher const & batcher, Span<VkDrawIndexedIndirectCommand const> commands);
+        void Prepare(Span<View const> views, Aabb const * bounds, InstanceBatcher const & batcher, Span<VkDrawIndexedIndirectCommand const> commands, ThreadPool & threadPool);
+
+        ///
+        /// Records the culling of the prepared instances, before the draws. When the validation is enabled and the
+        /// pyramid is built, the depth image is left in the transfer source layout, which the render pass discards.
+        ///
+        void RecordCulling(VkCommandBuffer commandBuffer);
+
+        ///
+        /// Records the building of the pyramid of the depth buffer, after the draws.
+        ///
+        void RecordPyramid(VkCommandBuffer commandBuffer);
+
+        ///
+        /// Compares the results of the last culling with the CPU reference, once its command buffer is complete and
+        /// before the next Prepare(). Does nothing if the validation was disabled when the culling was recorded.
+        ///
+        void Validate();
+
+        inline VkBuffer GetIndirectBuffer() const { return m_Commands.GetBuffer(); }
+        inline VkBuffer GetVisibleInstanceBuffer() const { return m_VisibleInstances.GetBuffer(); }
+
+        inline Stats const & GetStats() const { return m_Stats; }
+        void PrintStats() const;
+
+    private:
+        GpuCuller(GpuCuller const & other) = delete;
+        void operator=(GpuCuller const & other) = delete;
+
+        ///
+        /// Parameters of the shaders: the level built by hzb.comp, or the instances culled by cull.comp.
+        ///
+        struct PushConstants
+        {
+            uint32_t view;
+            uint32_t firstInstance;
+            uint32_t instanceCount;
+        };
+
+        void CreatePipelines();
+        void DestroyPipelines();
+
+        void CreateAtlas();
+        void DestroyAtlas();
+
+        void UpdateDescriptorSet();
+
+        VkSampler m_Sampler = VK_NULL_HANDLE;
+        VkDescriptorSetLayout m_DescriptorSetLayout = VK_NULL_HANDLE;
+        VkDescriptorPool m_DescriptorPool = VK_NULL_HANDLE;
+        VkDescriptorSet m_DescriptorSet = VK_NULL_HANDLE;
+        VkPipelineLayout m_PipelineLayout = VK_NULL_HANDLE;
+        VkPipeline m_HzbPipeline = VK_NULL_HANDLE;
+        VkPipeline m_CullPipeline = VK_NULL_HANDLE;
+        bool m_IsDescriptorSetDirty = true;
+
+        VkImage m_DepthImage = VK_NULL_HANDLE;
+        VkImageView m_DepthView = VK_NULL_HANDLE;
+
+        // The layout of the pyramid, and its reference during the validation.
+        HzbPyramid m_Pyramid;
+        VkImage m_Atlas = VK_NULL_HANDLE;
+        VkDeviceMemory m_AtlasMemory = VK_NULL_HANDLE;
+        VkImageView m_AtlasView = VK_NULL_HANDLE;
+        bool m_IsAtlasInitialized = false;  // In the general layout.
+        bool m_IsPyramidBuilt = false;      // From the current depth buffer.
+
+        MappedBuffer m_Levels{ VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT };
+        MappedBuffer m_Views{ VK_BUFFER_USAGE_STORAGE_BUFFER_BIT };
+        MappedBuffer m_Instances{ VK_BUFFER_USAGE_STORAGE_BUFFER_BIT };
+        MappedBuffer m_Commands{ VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT };
+        MappedBuffer m_VisibleInstances{ VK_BUFFER_USAGE_STORAGE_BUFFER_BIT };
+
+        // Inputs of the last culling.
+        std::vector<GpuCullView> m_CullViews;
+        std::vector<glm::uvec2> m_ViewInstances;    // First instance and count of every view.
+        uint32_t m_InstanceCount = 0;
+        uint32_t m_CommandCount = 0;
+        std::vector<uint32_t> m_CommandBindingOffsets;  // Binding offset of the batch of every command.
+
+        // Validation.
+        bool m_IsValidationEnabled = false;
+        bool m_IsValidationPending = false;
+        MappedBuffer m_DepthReadback{ VK_BUFFER_USAGE_TRANSFER_DST_BIT };
+        MappedBuffer m_AtlasReadback{ VK_BUFFER_USAGE_TRANSFER_DST_BIT };
+        HzbPyramid m_GpuPyramid;
+        std::vector<float> m_Depths;
+        std::vector<uint8_t> m_IsGpuVisible;
+
+        Stats m_Stats;
+    };
+} // VulkanDemo
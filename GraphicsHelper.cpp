@@ -13,24 +13,15 @@ namespace VulkanDemo
 
     GraphicsHelper::~GraphicsHelper()
     {
-        VkDevice device = Application::GetInstance().GetVulkanManager()->GetDevice();
-
-        if (m_blitVertices != VK_NULL_HANDLE)
-        {
-            vkFreeMemory(device, m_blitVerticesMemory, NULL);
-            m_blitVerticesMemory = VK_NULL_HANDLE;
-
-            vkDestroyBuffer(device, m_blitVertices, NULL);
-            m_blitVertices = VK_NULL_HANDLE;
-        }
+        DestroyBuffer(m_blitVertices, m_blitVerticesMemory);
+        DestroyBuffer(m_boxVertices, m_boxVerticesMemory);
+        DestroyBuffer(m_boxIndices, m_boxIndicesMemory);
     }
 
     VkBuffer GraphicsHelper::GetBlitVertices()
     {
         if (m_blitVertices == VK_NULL_HANDLE)
         {
-            VkDevice device = Application::GetInstance().GetVulkanManager()->GetDevice();
-
             float vertices[4][4] =
             {
                 { -1,  1, 0, 1 },
@@ -38,28 +29,87 @@ namespace VulkanDemo
                 { -1, -1, 0, 1 },
                 {  1, -1, 0, 1 }
             };
+            m_blitVertices = CreateBuffer(vertices, sizeof(vertices), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, m_blitVerticesMemory);
+        }
+        return m_blitVertices;
+    }
 
-            // Create the buffer.
-            VkBufferCreateInfo bufferCreateInfo{};
-            bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-            bufferCreateInfo.pNext = NULL;
-            bufferCreateInfo.flags = 0;
-            bufferCreateInfo.size = sizeof(vertices);
-            bufferCreateInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-            bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-            bufferCreateInfo.queueFamilyIndexCount = 0;
-            bufferCreateInfo.pQueueFamilyIndices = nullptr;
-            CheckResult(vkCreateBuffer(device, &bufferCreateInfo, NULL, &m_blitVertices));
+    VkBuffer GraphicsHelper::GetBoxVertices()
+    {
+        if (m_boxVertices == VK_NULL_HANDLE)
+        {
+            // The bits of the index of a vertex tell its side on the x, y and z axes.
+            float vertices[8][4];
+            for (int i = 0; i < 8; ++i)
+            {
+                vertices[i][0] = (i & 1) != 0 ? 0.5f : -0.5f;
+                vertices[i][1] = (i & 2) != 0 ? 0.5f : -0.5f;
+                vertices[i][2] = (i & 4) != 0 ? 0.5f : -0.5f;
+                vertices[i][3] = 1;
+            }
+            m_boxVertices = CreateBuffer(vertices, sizeof(vertices), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, m_boxVerticesMemory);
+        }
+        return m_boxVertices;
+    }
 
-            // Allocate and bind memory.
-            m_blitVerticesMemory = AllocateAndBindBufferMemory(m_blitVertices);
+    VkBuffer GraphicsHelper::GetBoxIndices()
+    {
+        if (m_boxIndices == VK_NULL_HANDLE)
+        {
+            uint32_t indices[BoxIndexCount] =
+            {
+                0, 4, 6, 0, 6, 2,   // -x
+                1, 3, 7, 1, 7, 5,   // +x
+                0, 1, 5, 0, 5, 4,   // -y
+                2, 6, 7, 2, 7, 3,   // +y
+                0, 2, 3, 0, 3, 1,   // -z
+                4, 5, 7, 4, 7, 6,   // +z
+            };
+            m_boxIndices = CreateBuffer(indices, sizeof(indices), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, m_boxIndicesMemory);
+        }
+        return m_boxIndices;
+    }
+
+    VkBuffer GraphicsHelper::CreateBuffer(void const * data, VkDeviceSize size, VkBufferUsageFlags usage, VkDeviceMemory & memory)
+    {
+        VkDevice device = Application::GetInstance().GetVulkanManager()->GetDevice();
+
+        // Create the buffer.
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkBufferCreateInfo bufferCreateInfo{};
+        bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferCreateInfo.pNext = NULL;
+        bufferCreateInfo.flags = 0;
+        bufferCreateInfo.size = size;
+        bufferCreateInfo.usage = usage;
+        bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        bufferCreateInfo.queueFamilyIndexCount = 0;
+        bufferCreateInfo.pQueueFamilyIndices = nullptr;
+        CheckResult(vkCreateBuffer(device, &bufferCreateInfo, NULL, &buffer));
+
+        // Allocate and bind memory.
+        memory = AllocateAndBindBufferMemory(buffer);
+
+        // Set the data.
+        void* mappedData;
+        CheckResult(vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &mappedData));
+        memcpy(mappedData, data, (size_t)size);
+        vkUnmapMemory(device, memory);
 
-            // Set the data.
-            void* mappedData;
-            CheckResult(vkMapMemory(device, m_blitVerticesMemory, 0, VK_WHOLE_SIZE, 0, &mappedData));
-            memcpy(mappedData, vertices, sizeof(vertices));
-            vkUnmapMemory(device, m_blitVerticesMemory);
+        return buffer;
+    }
+
+    void GraphicsHelper::DestroyBuffer(VkBuffer & buffer, VkDeviceMemory & memory)
+    {
+        if (buffer != VK_NULL_HANDLE)
+        {
+            VkDevice device = Application::GetInstance().GetVulkanManager()->GetDevice();
+
+            vkFreeMemory(device, memory, NULL);
+            memory = VK_NULL_HANDLE;
+
+            vkDestroyBuffer(device, buffer, NULL);
+            buffer = VK_NULL_HANDLE;
         }
-        return m_blitVertices;
     }
 }
@@ -15,8 +15,23 @@ namespace VulkanDemo
         ///
         VkBuffer GetBlitVertices();
 
+        ///
+        /// Returns buffers holding the 8 vertices and the 32-bit indices of the 12 triangles of a box from -0.5 to 0.5
+        /// on every axis, like the default bounds of the MeshRenderers.
+        ///
+        VkBuffer GetBoxVertices();
+        VkBuffer GetBoxIndices();
+        static const uint32_t BoxIndexCount = 36;
+
     private:
+        VkBuffer CreateBuffer(void const * data, VkDeviceSize size, VkBufferUsageFlags usage, VkDeviceMemory & memory);
+        void DestroyBuffer(VkBuffer & buffer, VkDeviceMemory & memory);
+
         VkBuffer m_blitVertices = VK_NULL_HANDLE;
         VkDeviceMemory m_blitVerticesMemory = VK_NULL_HANDLE;
+        VkBuffer m_boxVertices = VK_NULL_HANDLE;
+        VkDeviceMemory m_boxVerticesMemory = VK_NULL_HANDLE;
+        VkBuffer m_boxIndices = VK_NULL_HANDLE;
+        VkDeviceMemory m_boxIndicesMemory = VK_NULL_HANDLE;
     };
 }
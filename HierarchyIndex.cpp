@@ -0,0 +1,179 @@
+#include "HierarchyIndex.h"
+
+#include <cassert>
+
+#include "Scene.h"
+
+namespace VulkanDemo
+{
+    namespace
+    {
+        // The labels are spread over [0, LabelRange).
+        uint64_t const LabelRange = uint64_t(1) << 63;
+
+        // Largest subtree relabeled by MoveSubtree().
+        uint64_t const MaxMovedCount = 64;
+
+        GameObject const * SkipOtherScenes(Scene const & scene, GameObject const * gameObject)
+        {
+            while (gameObject != nullptr && gameObject->GetScene() != &scene)
+            {
+                gameObject = gameObject->GetNextSibling();
+            }
+            return gameObject;
+        }
+
+        ///
+        /// Returns the object following current in the pre-order traversal of the subtree of root in the scene, or
+        /// nullptr at the end of the subtree.
+        ///
+        GameObject const * GetNextInSubtree(Scene const & scene, GameObject const & root, GameObject const * current)
+        {
+            GameObject const * next = SkipOtherScenes(scene, current->GetFirstChild());
+            while (next == nullptr && current != &root)
+            {
+                next = SkipOtherScenes(scene, current->GetNextSibling());
+                current = current->GetParent();
+            }
+            return next;
+        }
+    }
+
+    HierarchyIndex::HierarchyIndex()
+    {
+    }
+
+    HierarchyIndex::~HierarchyIndex()
+    {
+    }
+
+    void HierarchyIndex::Build(Scene const & scene, Span<GameObject * const> gameObjects, uint32_t slotCount)
+    {
+        m_Entries.assign(slotCount, Entry{ 0, 0 });
+        m_Order.clear();
+        m_Order.reserve(gameObjects.size());
+        m_Depths.clear();
+        m_Depths.reserve(gameObjects.size());
+        m_IsClosed = true;
+
+        // Iterative depth-first traversal. The stack holds the objects whose subtree is being numbered; their entry
+        // is completed when the traversal comes back to them.
+        std::vector<GameObject *> stack;
+        for (auto root : gameObjects)
+        {
+            GameObject * parent = root->GetParent();
+            if (parent != nullptr && parent->GetScene() == &scene)
+            {
+                continue;
+            }
+            m_IsClosed = m_IsClosed && parent == nullptr;
+
+            m_Entries[root->GetHandle().index].begin = (uint32_t)m_Order.size();
+            m_Order.push_back(root);
+            m_Depths.push_back(0);
+            stack.push_back(root);
+
+            GameObject * next = root->GetFirstChild();
+            while (!stack.empty())
+            {
+                // Skip the children living in other scenes.
+                while (next != nullptr && next->GetScene() != &scene)
+                {
+                    next = next->GetNextSibling();
+                }
+
+                if (next != nullptr)
+                {
+                    m_Entries[next->GetHandle().index].begin = (uint32_t)m_Order.size();
+                    m_Order.push_back(next);
+                    m_Depths.push_back((uint32_t)stack.size());
+                    stack.push_back(next);
+                    next = next->GetFirstChild();
+                }
+                else
+                {
+                    GameObject * done = stack.back();
+                    stack.pop_back();
+                    m_Entries[done->GetHandle().index].end = (uint32_t)m_Order.size();
+                    next = stack.empty() ? nullptr : done->GetNextSibling();
+                }
+            }
+        }
+
+        assert(m_Order.size() == gameObjects.size());
+
+        // The labels of the objects take the first half of the range, and the second half is left to the subtrees
+        // that become roots.
+        uint64_t const spacing = LabelRange / 2 / (m_Order.size() + 1);
+        m_Labels.assign(slotCount, Label{ 0, 0, 0, 0 });
+        for (auto gameObject : m_Order)
+        {
+            Entry const & entry = m_Entries[gameObject->GetHandle().index];
+            uint64_t begin = entry.begin * spacing;
+            m_Labels[gameObject->GetHandle().index] = Label{ begin, entry.end * spacing, begin + 1, begin + spacing };
+        }
+        m_Roots = Label{ 0, LabelRange, m_Order.size() * spacing, LabelRange };
+    }
+
+    bool HierarchyIndex::MoveSubtree(Scene const & scene, GameObject const & root)
+    {
+        GameObject const * parent = root.GetParent();
+        if (!m_IsClosed || (parent != nullptr && parent->GetScene() != &scene))
+        {
+            return false;
+        }
+
+        // Relabeling a large subtree costs more than the walks up the chains of parents that it saves, so that the
+        // index is rather rebuilt once these walks add up.
+        uint64_t count = 0;
+        for (GameObject const * current = &root; current != nullptr; current = GetNextInSubtree(scene, root, current))
+        {
+            if (++count > MaxMovedCount)
+            {
+                return false;
+            }
+        }
+
+        // Take half of the gap of the new parent, so that the next subtrees moved under it find room as well. The gap
+        // shrinks geometrically, and only runs out after many moves under the same parent.
+        Label & gap = parent != nullptr ? m_Labels[parent->GetHandle().index] : m_Roots;
+        uint64_t length = (gap.limit - gap.free) / 2;
+        uint64_t spacing = length / count;
+        if (spacing < 2)
+        {
+            return false;
+        }
+
+        AssignLabels(scene, root, gap.free, spacing);
+        gap.free += length;
+        return true;
+    }
+
+    void HierarchyIndex::AssignLabels(Scene const & scene, GameObject const & root, uint64_t begin, uint64_t spacing)
+    {
+        // Same traversal as GetNextInSubtree(), completing the label of every object when it is left.
+        uint64_t position = begin;
+        GameObject const * current = &root;
+        for (;;)
+        {
+            m_Labels[current->GetHandle().index] = Label{ position, 0, position + 1, position + spacing };
+            position += spacing;
+
+            GameObject const * next = SkipOtherScenes(scene, current->GetFirstChild());
+            while (next == nullptr)
+            {
+                m_Labels[current->GetHandle().index].end = position;
+                if (current == &root)
+                {
+                    return;
+                }
+                next = SkipOtherScenes(scene, current->GetNextSibling());
+                if (next == nullptr)
+                {
+                    current = current->GetParent();
+                }
+            }
+            current = next;
+        }
+    }
+} // VulkanDemo
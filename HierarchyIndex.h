@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "GameObject.h"
+#include "Span.h"
+
+namespace VulkanDemo
+{
+    class Scene;
+
+    ///
+    /// Pre-order numbering of the GameObjects of a scene.
+    ///
+    /// Every object gets the range [begin, end) of the positions of its subtree in the pre-order sequence, so that
+    /// a subtree is a contiguous slice of the sequence. The sequence is a snapshot: it must be rebuilt after any change
+    /// to the hierarchy or to the set of objects.
+    ///
+    /// The ancestry tests use labels numbered like the sequence but spaced out, every object keeping a gap in front of
+    /// its first child. MoveSubtree() relabels a subtree moved within the scene in that gap of its new parent, so that
+    /// the tests stay exact across reparents without a rebuild.
+    ///
+    /// The objects of the scene whose parent is in another scene, or in no scene, are indexed as roots. The ancestry
+    /// queries are therefore only exact when IsClosed() returns true, meaning that no object has such a parent.
+    ///
+    class HierarchyIndex
+    {
+    public:
+        HierarchyIndex();
+        ~HierarchyIndex();
+
+        ///
+        /// @param[in] gameObjects      All the objects of the scene.
+        /// @param[in] slotCount        Upper bound of the slot indices of the handles of the objects.
+        ///
+        void Build(Scene const & scene, Span<GameObject * const> gameObjects, uint32_t slotCount);
+
+        ///
+        /// Updates the ancestry labels of root and its descendants after root was moved under another parent of the
+        /// scene, or made a root, in time linear in the size of its subtree. The pre-order sequence is left as it was.
+        ///
+        /// @return false if the labels are not updated, because the new parent is in another scene or has no room
+        ///         left in its gap, or because the subtree is large enough that rebuilding the index later is
+        ///         cheaper. The index must then be rebuilt before the next ancestry test.
+        ///
+        bool MoveSubtree(Scene const & scene, GameObject const & root);
+
+        inline bool IsClosed() const { return m_IsClosed; }
+
+        ///
+        /// Indicates whether descendant is strictly below ancestor. Both objects must be part of the indexed scene.
+        ///
+        inline bool IsDescendantOf(GameObject const & descendant, GameObject const & ancestor) const
+        {
+            Label const & label = m_Labels[descendant.GetHandle().index];
+            Label const & ancestorLabel = m_Labels[ancestor.GetHandle().index];
+            return ancestorLabel.begin < label.begin && label.begin < ancestorLabel.end;
+        }
+
+        ///
+        /// Returns the object and all its descendants in the scene, in pre-order.
+        ///
+        inline Span<GameObject * const> GetSubtree(GameObject const & root) const
+        {
+            Entry const & entry = m_Entries[root.GetHandle().index];
+            return Span<GameObject * const>{ m_Order.data() + entry.begin, entry.end - entry.begin };
+        }
+
+        ///
+        /// Returns the whole pre-order sequence, and the depth of every position relative to its indexed root.
+        ///
+        inline Span<GameObject * const> GetOrder() const { return Span<GameObject * const>{ m_Order.data(), m_Order.size() }; }
+        inline Span<uint32_t const> GetDepths() const { return Span<uint32_t const>{ m_Depths.data(), m_Depths.size() }; }
+
+    private:
+        HierarchyIndex(HierarchyIndex const & other) = delete;
+        void operator=(HierarchyIndex const & other) = delete;
+
+        struct Entry
+        {
+            uint32_t begin;
+            uint32_t end;
+        };
+
+        // The subtree of an object spans [begin, end), and the labels in [free, limit) are still available for the
+        // subtrees moved under it.
+        struct Label
+        {
+            uint64_t begin;
+            uint64_t end;
+            uint64_t free;
+            uint64_t limit;
+        };
+
+        void AssignLabels(Scene const & scene, GameObject const & root, uint64_t begin, uint64_t spacing);
+
+        std::vector<Entry>          m_Entries;  // Indexed by the slot index of the handles.
+        std::vector<Label>          m_Labels;   // Indexed by the slot index of the handles.
+        Label                       m_Roots;    // Gap of the moved subtrees that become roots.
+        std::vector<GameObject *>   m_Order;
+        std::vector<uint32_t>       m_Depths;
+        bool                        m_IsClosed = true;
+    };
+} // VulkanDemo
@@ -0,0 +1,175 @@
+#include "HzbPyramid.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+namespace VulkanDemo
+{
+    HzbPyramid::HzbPyramid()
+    {
+    }
+
+    HzbPyramid::~HzbPyramid()
+    {
+    }
+
+    void HzbPyramid::Resize(uint32_t depthWidth, uint32_t depthHeight)
+    {
+        assert(depthWidth != 0 && depthHeight != 0);
+        assert(depthWidth < (1u << MaxLevelCount) && depthHeight < (1u << MaxLevelCount));
+
+        m_DepthWidth = depthWidth;
+        m_DepthHeight = depthHeight;
+        m_Levels.clear();
+
+        Level level{ 0, 0, (depthWidth + 1) / 2, (depthHeight + 1) / 2 };
+        m_Levels.push_back(level);
+        m_AtlasWidth = level.width;
+        m_AtlasHeight = level.height;
+
+        uint32_t columnHeight = 0;
+        while (level.width > 1 || level.height > 1)
+        {
+            level.width = (level.width + 1) / 2;
+            level.height = (level.height + 1) / 2;
+            level.x = m_Levels[0].width;
+            level.y = columnHeight;
+            m_Levels.push_back(level);
+            columnHeight += level.height;
+        }
+        if (m_Levels.size() > 1)
+        {
+            m_AtlasWidth += m_Levels[1].width;
+            m_AtlasHeight = (std::max)(m_AtlasHeight, columnHeight);
+        }
+
+        m_Atlas.assign(m_AtlasWidth * m_AtlasHeight, 1.0f);
+    }
+
+    void HzbPyramid::Build(float const * depths)
+    {
+        for (uint32_t level = 0; level < GetLevelCount(); ++level)
+        {
+            Level const & rectangle = m_Levels[level];
+            for (uint32_t y = 0; y < rectangle.height; ++y)
+            {
+                for (uint32_t x = 0; x < rectangle.width; ++x)
+                {
+                    // Same reduction as hzb.comp.
+                    float farthest;
+                    if (level == 0)
+                    {
+                        uint32_t x0 = 2 * x;
+                        uint32_t y0 = 2 * y;
+                        uint32_t x1 = (std::min)(x0 + 1, m_DepthWidth - 1);
+                        uint32_t y1 = (std::min)(y0 + 1, m_DepthHeight - 1);
+                        farthest = (std::max)((std::max)(depths[y0 * m_DepthWidth + x0], depths[y0 * m_DepthWidth + x1]),
+                            (std::max)(depths[y1 * m_DepthWidth + x0], depths[y1 * m_DepthWidth + x1]));
+                    }
+                    else
+                    {
+                        Level const & source = m_Levels[level - 1];
+                        uint32_t x0 = 2 * x;
+                        uint32_t y0 = 2 * y;
+                        uint32_t x1 = (std::min)(x0 + 1, source.width - 1);
+                        uint32_t y1 = (std::min)(y0 + 1, source.height - 1);
+                        farthest = (std::max)((std::max)(GetDepth(level - 1, x0, y0), GetDepth(level - 1, x1, y0)),
+                            (std::max)(GetDepth(level - 1, x0, y1), GetDepth(level - 1, x1, y1)));
+                    }
+                    m_Atlas[(rectangle.y + y) * m_AtlasWidth + rectangle.x + x] = farthest;
+                }
+            }
+        }
+    }
+
+    void HzbPyramid::SetAtlas(float const * atlas)
+    {
+        std::copy(atlas, atlas + m_Atlas.size(), m_Atlas.begin());
+    }
+
+    bool HzbPyramid::IsVisible(GpuCullView const & view, GpuCullInstance const & instance) const
+    {
+        // The expressions are those of cull.comp, whose results are precise, so that both compute the same values.
+        glm::vec3 const & center = instance.center;
+        glm::vec3 const & extents = instance.extents;
+        for (glm::vec4 const & plane : view.planes)
+        {
+            float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+            float radius = std::abs(plane.x) * extents.x + std::abs(plane.y) * extents.y + std::abs(plane.z) * extents.z;
+            if (distance < -radius)
+            {
+                return false;
+            }
+        }
+
+        if (view.levelCount == 0)
+        {
+            return true;
+        }
+        assert(view.levelCount <= GetLevelCount());
+
+        glm::mat4 const & matrix = view.viewProjection;
+        float minX = (std::numeric_limits<float>::max)();
+        float maxX = -(std::numeric_limits<float>::max)();
+        float minY = minX;
+        float maxY = maxX;
+        float nearest = 1;
+        for (int c = 0; c < 8; ++c)
+        {
+            glm::vec3 corner{
+                (c & 1) ? center.x + extents.x : center.x - extents.x,
+                (c & 2) ? center.y + extents.y : center.y - extents.y,
+                (c & 4) ? center.z + extents.z : center.z - extents.z,
+            };
+            glm::vec4 position = matrix[0] * corner.x + matrix[1] * corner.y + matrix[2] * corner.z + matrix[3];
+            if (position.z < 0 || position.w <= 0)
+            {
+                // Crosses the near plane.
+                return true;
+            }
+
+            float x = (position.x / position.w * 0.5f + 0.5f) * view.viewport.z + view.viewport.x;
+            float y = (position.y / position.w * 0.5f + 0.5f) * view.viewport.w + view.viewport.y;
+            float depth = position.z / position.w;
+            minX = (std::min)(minX, x);
+            maxX = (std::max)(maxX, x);
+            minY = (std::min)(minY, y);
+            maxY = (std::max)(maxY, y);
+            nearest = (std::min)(nearest, depth);
+        }
+
+        // The boxes leaving the viewport are left to the frustum test.
+        float right = view.viewport.x + view.viewport.z;
+        float bottom = view.viewport.y + view.viewport.w;
+        if (maxX < view.viewport.x || minX >= right || maxY < view.viewport.y || minY >= bottom)
+        {
+            return true;
+        }
+
+        // Pixels covered, then the finest level at which they are within 2x2 texels, pixel p being in the texel
+        // p >> (level + 1).
+        uint32_t x0 = (uint32_t)(std::max)(minX, view.viewport.x);
+        uint32_t x1 = (uint32_t)(std::min)(maxX, right - 1);
+        uint32_t y0 = (uint32_t)(std::max)(minY, view.viewport.y);
+        uint32_t y1 = (uint32_t)(std::min)(maxY, bottom - 1);
+        assert(x1 < m_DepthWidth && y1 < m_DepthHeight);
+
+        uint32_t level = 0;
+        while (level + 1 < view.levelCount && ((x1 >> (level + 1)) - (x0 >> (level + 1)) > 1 || (y1 >> (level + 1)) - (y0 >> (level + 1)) > 1))
+        {
+            ++level;
+        }
+
+        float farthest = 0;
+        for (uint32_t y = y0 >> (level + 1); y <= y1 >> (level + 1); ++y)
+        {
+            for (uint32_t x = x0 >> (level + 1); x <= x1 >> (level + 1); ++x)
+            {
+                farthest = (std::max)(farthest, GetDepth(level, x, y));
+            }
+        }
+        return !(nearest > farthest);
+    }
+} // VulkanDemo
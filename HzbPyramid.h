@@ -0,0 +1,119 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "Bounds.h"
+
+namespace VulkanDemo
+{
+    ///
+    /// Parameters of the culling of a view, as laid out in the buffer of views of cull.comp (std430).
+    ///
+    struct GpuCullView
+    {
+        glm::mat4 viewProjection;
+        glm::vec4 planes[Frustum::PlaneCount];  // As in Frustum.
+        glm::vec4 viewport;                     // Offset and size in pixels of the depth buffer.
+        uint32_t levelCount;                    // Levels of the pyramid to test against, 0 to only test the frustum.
+        uint32_t padding[3];
+    };
+
+    ///
+    /// Instance to cull, as laid out in the buffer of instances of cull.comp (std430).
+    ///
+    struct GpuCullInstance
+    {
+        glm::vec3 center;   // Of the world bounds.
+        uint32_t command;   // Draw command of the batch of the instance.
+        glm::vec3 extents;
+        uint32_t bindingOffset; // Of the batch of the instance.
+    };
+
+    static_assert(sizeof(GpuCullView) == 192, "GpuCullView must match the layout of cull.comp.");
+    static_assert(sizeof(GpuCullInstance) == 32, "GpuCullInstance must match the layout of cull.comp.");
+
+    ///
+    /// Hierarchy of the farthest depths of a depth buffer, as built on the GPU by hzb.comp, and the reference of the
+    /// tests of cull.comp on the CPU.
+    ///
+    /// The depths are those of the depth buffer, z / w for the projections of the cameras, from 0 at the near plane to 1
+    /// at the far plane. The rows are those of the framebuffer: the viewports of Vulkan don't flip y, so a point of clip
+    /// space is at (x / w * 0.5 + 0.5, y / w * 0.5 + 0.5) times the size of the viewport from its offset, y / w = -1
+    /// being the first row. Level 0 has half the size of the depth buffer, rounded up, and every level has half the
+    /// size of the previous one, down to 1x1. Every texel keeps the farthest of the 2x2 texels below, clamped at
+    /// the edges. All the levels are stored in one atlas, level 0 at its origin and the others in a column on its right,
+    /// since the mipmaps of an image round their sizes down, which would drop the last row or column of the odd levels.
+    ///
+    /// IsVisible() performs the tests of cull.comp with the same operations in the same order. A box is visible when it
+    /// intersects the frustum, as told by Frustum::Intersects(), and when it is not occluded: its nearest depth is not
+    /// behind the farthest depth of the at most 2x2 texels of the finest level covering its rectangle on the screen. The
+    /// boxes crossing the near plane or leaving the viewport are kept.
+    ///
+    class HzbPyramid
+    {
+    public:
+        static const uint32_t MaxLevelCount = 16;
+
+        ///
+        /// Rectangle of a level in the atlas, as laid out in the buffer of levels of the shaders.
+        ///
+        struct Level
+        {
+            uint32_t x;
+            uint32_t y;
+            uint32_t width;
+            uint32_t height;
+        };
+
+        HzbPyramid();
+        ~HzbPyramid();
+
+        ///
+        /// Lays out the levels for a depth buffer of the given size, below 2^MaxLevelCount.
+        ///
+        void Resize(uint32_t depthWidth, uint32_t depthHeight);
+
+        ///
+        /// Builds the levels from the depths of all the pixels, row by row.
+        ///
+        void Build(float const * depths);
+
+        ///
+        /// Copies the levels from an atlas of GetAtlasWidth() x GetAtlasHeight() texels, such as one read back from the
+        /// GPU.
+        ///
+        void SetAtlas(float const * atlas);
+
+        inline uint32_t GetDepthWidth() const { return m_DepthWidth; }
+        inline uint32_t GetDepthHeight() const { return m_DepthHeight; }
+        inline uint32_t GetAtlasWidth() const { return m_AtlasWidth; }
+        inline uint32_t GetAtlasHeight() const { return m_AtlasHeight; }
+        inline uint32_t GetLevelCount() const { return (uint32_t)m_Levels.size(); }
+        inline Level const * GetLevels() const { return m_Levels.data(); }
+
+        inline float GetDepth(uint32_t level, uint32_t x, uint32_t y) const
+        {
+            Level const & rectangle = m_Levels[level];
+            return m_Atlas[(rectangle.y + y) * m_AtlasWidth + rectangle.x + x];
+        }
+
+        ///
+        /// Tells whether cull.comp keeps the instance in the view, testing at most view.levelCount levels.
+        ///
+        bool IsVisible(GpuCullView const & view, GpuCullInstance const & instance) const;
+
+    private:
+        HzbPyramid(HzbPyramid const & other) = delete;
+        void operator=(HzbPyramid const & other) = delete;
+
+        uint32_t m_DepthWidth = 0;
+        uint32_t m_DepthHeight = 0;
+        uint32_t m_AtlasWidth = 0;
+        uint32_t m_AtlasHeight = 0;
+        std::vector<Level> m_Levels;
+        std::vector<float> m_Atlas;
+    };
+} // VulkanDemo
@@ -0,0 +1,124 @@
+#include "InstanceBatcher.h"
+
+#include <cassert>
+#include <string>
+
+#include "RenderSnapshot.h"
+#include "Shared.h"
+#include "ThreadPool.h"
+
+namespace VulkanDemo
+{
+    namespace
+    {
+        inline bool HasSameState(InstanceBatcher::Batch const & batch, RenderQueue::Draw const & draw)
+        {
+            return batch.pipeline == draw.pipeline && batch.material == draw.material && batch.mesh == draw.mesh && batch.level == draw.level;
+        }
+    }
+
+    InstanceBatcher::InstanceBatcher()
+    {
+    }
+
+    InstanceBatcher::~InstanceBatcher()
+    {
+    }
+
+    void InstanceBatcher::Clear()
+    {
+        m_ViewStarts.clear();
+        m_Batches.clear();
+        m_InstanceObjects.clear();
+        m_Stats = Stats{};
+    }
+
+    void InstanceBatcher::AddView(Span<RenderQueue::Draw const> draws)
+    {
+        assert(m_MaxInstanceCount != 0);
+        Clock::time_point start = Clock::now();
+
+        uint32_t firstBatch = (uint32_t)m_Batches.size();
+        m_ViewStarts.push_back(firstBatch);
+        for (RenderQueue::Draw const & draw : draws)
+        {
+            // The batches of the previous views are not extended, since they are drawn in another viewport.
+            uint32_t instance = (uint32_t)m_InstanceObjects.size();
+            bool isNewBatch = m_Batches.size() == firstBatch || !HasSameState(m_Batches.back(), draw);
+            if (!isNewBatch && instance % m_MaxInstanceCount == 0)
+            {
+                isNewBatch = true;
+                ++m_Stats.splitCount;
+            }
+
+            if (isNewBatch)
+            {
+                Batch batch;
+                batch.pipeline = draw.pipeline;
+                batch.material = draw.material;
+                batch.mesh = draw.mesh;
+                batch.level = draw.level;
+                batch.firstInstance = instance;
+                batch.instanceCount = 0;
+                batch.bindingOffset = instance / m_MaxInstanceCount * m_MaxInstanceCount;
+                m_Batches.push_back(batch);
+            }
+            ++m_Batches.back().instanceCount;
+            m_InstanceObjects.push_back(draw.object);
+        }
+
+        m_Stats.drawCount += (uint32_t)draws.size();
+        m_Stats.batchCount = (uint32_t)m_Batches.size();
+        m_Stats.batchTime += GetMilliseconds(start, Clock::now());
+    }
+
+    Span<InstanceBatcher::Batch const> InstanceBatcher::GetBatches(uint32_t view) const
+    {
+        assert(view < GetViewCount());
+        uint32_t begin = m_ViewStarts[view];
+        uint32_t end = view + 1 < GetViewCount() ? m_ViewStarts[view + 1] : (uint32_t)m_Batches.size();
+        return Span<Batch const>{ m_Batches.data() + begin, end - begin };
+    }
+
+    uint32_t InstanceBatcher::GetBufferInstanceCount() const
+    {
+        // The last binding starts at a multiple of the maximum instance count.
+        uint32_t instanceCount = GetInstanceCount();
+        return instanceCount == 0 ? 0 : (instanceCount - 1) / m_MaxInstanceCount * m_MaxInstanceCount + GetBindingInstanceCount();
+    }
+
+    void InstanceBatcher::Pack(RenderSnapshot const & snapshot, InstanceData * instances)
+    {
+        Pack(snapshot, instances, ThreadPool::GetDefault());
+    }
+
+    void InstanceBatcher::Pack(RenderSnapshot const & snapshot, InstanceData * instances, ThreadPool & threadPool)
+    {
+        Clock::time_point start = Clock::now();
+
+        // The instances are written in order, which suits the write-combined memory of mapped buffers.
+        glm::mat4 const * worldMatrices = snapshot.GetWorldMatrices();
+        uint32_t const * objects = m_InstanceObjects.data();
+        threadPool.ParallelFor(GetInstanceCount(), 256, [=](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                instances[i].worldMatrix = worldMatrices[objects[i]];
+            }
+        });
+
+        m_Stats.packTime += GetMilliseconds(start, Clock::now());
+    }
+
+    void InstanceBatcher::PrintStats() const
+    {
+        StatsRows rows = {
+            { "Draws", std::to_string(m_Stats.drawCount) },
+            { "Instanced draws", std::to_string(m_Stats.batchCount) },
+            { "Split batches", std::to_string(m_Stats.splitCount) },
+            { "Batching (ms)", FormatStat(m_Stats.batchTime) },
+            { "Packing (ms)", FormatStat(m_Stats.packTime) },
+        };
+
+        PrintStatsTable("Instancing", rows);
+    }
+} // VulkanDemo
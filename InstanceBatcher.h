@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "RenderQueue.h"
+#include "Span.h"
+
+namespace VulkanDemo
+{
+    class RenderSnapshot;
+    class ThreadPool;
+
+    ///
+    /// Merges the draws of the same mesh with the same state into instanced draws.
+    ///
+    /// The consecutive draws of a view sharing their pipeline, material, mesh and level of detail become a batch, drawn
+    /// with a single instanced draw. Since the render queue sorts the opaque draws by state, all the draws of a state
+    /// are consecutive; the transparent draws are only merged where consecutive, which keeps them back to front.
+    ///
+    /// The instances of all the batches are numbered in the order of the batches. Pack() writes their data, such as to a
+    /// buffer mapped for the frame, where the vertex shader reads them by instance index. Since a binding of the buffer
+    /// only reaches the maximum instance count, set from the limits of the device, the instances are split into
+    /// bindings of that many instances, and a run crossing the end of a binding is split. The buffer is bound from the
+    /// binding offset of a batch, and the batch draws from its first instance relative to it.
+    ///
+    /// Usage Notes:
+    /// - Pack() must not be called from a ThreadPool::ParallelFor().
+    ///
+    class InstanceBatcher
+    {
+    public:
+        ///
+        /// Data of an instance read by the shaders.
+        ///
+        struct InstanceData
+        {
+            glm::mat4 worldMatrix;
+        };
+
+        struct Batch
+        {
+            PipelineId pipeline;
+            MaterialId material;
+            MeshId mesh;
+            uint8_t level;
+            uint32_t firstInstance;     // In all the instances.
+            uint32_t instanceCount;
+            uint32_t bindingOffset;     // First instance of the binding of the instances of the batch.
+        };
+
+        struct Stats
+        {
+            uint32_t drawCount = 0;         // Draws before the batching, one per object.
+            uint32_t batchCount = 0;        // Instanced draws.
+            uint32_t splitCount = 0;        // Batches started because the binding of the previous one was full.
+            double batchTime = 0;           // In milliseconds.
+            double packTime = 0;
+        };
+
+        InstanceBatcher();
+        ~InstanceBatcher();
+
+        ///
+        /// Sets the largest number of instances of a binding of the instance buffer. Unlimited by default.
+        ///
+        inline void SetMaxInstanceCount(uint32_t maxInstanceCount) { m_MaxInstanceCount = maxInstanceCount; }
+        inline uint32_t GetMaxInstanceCount() const { return m_MaxInstanceCount; }
+
+        ///
+        /// Removes the batches of the previous frame.
+        ///
+        void Clear();
+
+        ///
+        /// Adds the batches of a view, from its draws in their order of submission. The views are numbered in the order
+        /// of the calls.
+        ///
+        void AddView(Span<RenderQueue::Draw const> draws);
+
+        inline uint32_t GetViewCount() const { return (uint32_t)m_ViewStarts.size(); }
+        Span<Batch const> GetBatches(uint32_t view) const;
+
+        ///
+        /// Total number of instances of the batches of all the views.
+        ///
+        inline uint32_t GetInstanceCount() const { return (uint32_t)m_InstanceObjects.size(); }
+
+        ///
+        /// Returns the number of instances in the range of a binding, and the number of instances of a buffer in which
+        /// this range fits from the binding offsets of all the batches.
+        ///
+        inline uint32_t GetBindingInstanceCount() const { return GetInstanceCount() < m_MaxInstanceCount ? GetInstanceCount() : m_MaxInstanceCount; }
+        uint32_t GetBufferInstanceCount() const;
+
+        ///
+        /// Returns the object in the snapshot of every instance.
+        ///
+        inline Span<uint32_t const> GetInstanceObjects() const { return Span<uint32_t const>{ m_InstanceObjects.data(), m_InstanceObjects.size() }; }
+
+        ///
+        /// Writes the data of the instances of all the views, which has room for GetInstanceCount() instances. The
+        /// snapshot must be the one the draws were made from.
+        ///
+        void Pack(RenderSnapshot const & snapshot, InstanceData * instances);
+        void Pack(RenderSnapshot const & snapshot, InstanceData * instances, ThreadPool & threadPool);
+
+        inline Stats const & GetStats() const { return m_Stats; }
+        void PrintStats() const;
+
+    private:
+        InstanceBatcher(InstanceBatcher const & other) = delete;
+        void operator=(InstanceBatcher const & other) = delete;
+
+        uint32_t m_MaxInstanceCount = UINT32_MAX;
+
+        std::vector<uint32_t>   m_ViewStarts;       // First batch of every view.
+        std::vector<Batch>      m_Batches;
+        std::vector<uint32_t>   m_InstanceObjects;  // Object in the snapshot of every instance.
+
+        Stats m_Stats;
+    };
+} // VulkanDemo
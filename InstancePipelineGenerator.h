@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Shared.h"
+
+namespace VulkanDemo
+{
+    ///
+    /// The purpose of this class is to help in the generation of a graphics pipeline intended to draw the instances of
+    /// the batches of the SceneRenderer in a constant color, with the depth test. It keeps ownership of the created
+    /// objects and handles their destruction properly.
+    ///
+    /// Usage Notes:
+    /// - Dynamic states that must be set externally: viewport and scissors.
+    /// - The vertices are positions of 4 floats.
+    /// - The instance buffer is bound to binding 0 as a dynamic storage buffer, from the binding offset of the batches.
+    /// - When the instances are culled by the GpuCuller, its visible instances are bound to binding 1 the same way, and
+    ///   the vertex shader draws the instance written at the instance index.
+    /// - The view-projection matrix is pushed as a constant.
+    ///
+    class InstancePipelineGenerator
+    {
+    public:
+        InstancePipelineGenerator(VkRenderPass renderPass, uint32_t subpass, bool isCulled);
+        ~InstancePipelineGenerator();
+
+        VkPipeline GetPipeline() const { return m_Pipeline; }
+        VkPipelineLayout GetPipelineLayout() const { return m_PipelineLayout; }
+        VkDescriptorSetLayout GetDescriptorSetLayout() const { return m_DescriptorSetLayout; }
+
+    private:
+        InstancePipelineGenerator & operator=(const InstancePipelineGenerator&) = delete;
+        InstancePipelineGenerator(const InstancePipelineGenerator&) = delete;
+
+        void CreatePipeline(VkRenderPass renderPass, uint32_t subpass, bool isCulled);
+        void DestroyPipeline();
+
+        VkPipeline m_Pipeline = VK_NULL_HANDLE;
+        VkPipelineLayout m_PipelineLayout = VK_NULL_HANDLE;
+        VkDescriptorSetLayout m_DescriptorSetLayout = VK_NULL_HANDLE;
+    };
+}
@@ -0,0 +1,276 @@
+#include "LodSelector.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "MatrixKernels.h"
+#include "RenderSnapshot.h"
+#include "Shared.h"
+#include "ThreadPool.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define LOD_SELECTOR_X86 1
+#else
+#define LOD_SELECTOR_X86 0
+#endif
+
+#if LOD_SELECTOR_X86
+#include <immintrin.h>
+#endif
+
+namespace VulkanDemo
+{
+    namespace
+    {
+        const uint8_t NoLevel = 0xFF;
+
+        ///
+        /// Inputs of the computation of the largest error allowed in the local space of the objects.
+        ///
+        struct ErrorParameters
+        {
+            glm::vec3 cameraPosition;
+            float nearPlane;
+            float errorPerDistance; // Largest error allowed at a distance of 1 with a scale of 1.
+        };
+
+        // Both variants compute, in the same order and without fused multiply-adds:
+        //     errorPerDistance * max(|center - camera| - |extents|, near) / sqrt(largest squared length of the axes)
+
+        void ComputeMaxErrorsScalar(ErrorParameters const & parameters, RenderSnapshot const & snapshot, uint32_t const * objects, uint32_t begin, uint32_t end, float * maxErrors)
+        {
+            PackedBounds const & bounds = snapshot.GetPackedWorldBounds();
+            float const * centerX = bounds.GetArray(PackedBounds::CenterX);
+            float const * centerY = bounds.GetArray(PackedBounds::CenterY);
+            float const * centerZ = bounds.GetArray(PackedBounds::CenterZ);
+            float const * extentX = bounds.GetArray(PackedBounds::ExtentX);
+            float const * extentY = bounds.GetArray(PackedBounds::ExtentY);
+            float const * extentZ = bounds.GetArray(PackedBounds::ExtentZ);
+            glm::mat4 const * worldMatrices = snapshot.GetWorldMatrices();
+
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                uint32_t object = objects[i];
+                float dx = centerX[object] - parameters.cameraPosition.x;
+                float dy = centerY[object] - parameters.cameraPosition.y;
+                float dz = centerZ[object] - parameters.cameraPosition.z;
+                float distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+                float radius = std::sqrt(extentX[object] * extentX[object] + extentY[object] * extentY[object] + extentZ[object] * extentZ[object]);
+                float nearest = (std::max)(distance - radius, parameters.nearPlane);
+
+                glm::mat4 const & matrix = worldMatrices[object];
+                float scales[3];
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    scales[axis] = matrix[axis].x * matrix[axis].x + matrix[axis].y * matrix[axis].y + matrix[axis].z * matrix[axis].z;
+                }
+                float scale = std::sqrt((std::max)((std::max)(scales[0], scales[1]), scales[2]));
+
+                maxErrors[i] = parameters.errorPerDistance * nearest / scale;
+            }
+        }
+
+#if LOD_SELECTOR_X86
+
+        void ComputeMaxErrorsSse(ErrorParameters const & parameters, RenderSnapshot const & snapshot, uint32_t const * objects, uint32_t begin, uint32_t end, float * maxErrors)
+        {
+            PackedBounds const & bounds = snapshot.GetPackedWorldBounds();
+            float const * centerX = bounds.GetArray(PackedBounds::CenterX);
+            float const * centerY = bounds.GetArray(PackedBounds::CenterY);
+            float const * centerZ = bounds.GetArray(PackedBounds::CenterZ);
+            float const * extentX = bounds.GetArray(PackedBounds::ExtentX);
+            float const * extentY = bounds.GetArray(PackedBounds::ExtentY);
+            float const * extentZ = bounds.GetArray(PackedBounds::ExtentZ);
+            glm::mat4 const * worldMatrices = snapshot.GetWorldMatrices();
+
+            __m128 const cameraX = _mm_set1_ps(parameters.cameraPosition.x);
+            __m128 const cameraY = _mm_set1_ps(parameters.cameraPosition.y);
+            __m128 const cameraZ = _mm_set1_ps(parameters.cameraPosition.z);
+            __m128 const nearPlane = _mm_set1_ps(parameters.nearPlane);
+            __m128 const errorPerDistance = _mm_set1_ps(parameters.errorPerDistance);
+
+            uint32_t i = begin;
+            for (; i + 4 <= end; i += 4)
+            {
+                uint32_t o0 = objects[i];
+                uint32_t o1 = objects[i + 1];
+                uint32_t o2 = objects[i + 2];
+                uint32_t o3 = objects[i + 3];
+
+                __m128 dx = _mm_sub_ps(_mm_setr_ps(centerX[o0], centerX[o1], centerX[o2], centerX[o3]), cameraX);
+                __m128 dy = _mm_sub_ps(_mm_setr_ps(centerY[o0], centerY[o1], centerY[o2], centerY[o3]), cameraY);
+                __m128 dz = _mm_sub_ps(_mm_setr_ps(centerZ[o0], centerZ[o1], centerZ[o2], centerZ[o3]), cameraZ);
+                __m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+
+                __m128 ex = _mm_setr_ps(extentX[o0], extentX[o1], extentX[o2], extentX[o3]);
+                __m128 ey = _mm_setr_ps(extentY[o0], extentY[o1], extentY[o2], extentY[o3]);
+                __m128 ez = _mm_setr_ps(extentZ[o0], extentZ[o1], extentZ[o2], extentZ[o3]);
+                __m128 radius = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, ex), _mm_mul_ps(ey, ey)), _mm_mul_ps(ez, ez)));
+                __m128 nearest = _mm_max_ps(_mm_sub_ps(distance, radius), nearPlane);
+
+                // The columns of the 4 matrices are transposed, giving the x, y and z of an axis of the 4 objects.
+                __m128 scale;
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    __m128 x = _mm_load_ps(&worldMatrices[o0][axis][0]);
+                    __m128 y = _mm_load_ps(&worldMatrices[o1][axis][0]);
+                    __m128 z = _mm_load_ps(&worldMatrices[o2][axis][0]);
+                    __m128 w = _mm_load_ps(&worldMatrices[o3][axis][0]);
+                    _MM_TRANSPOSE4_PS(x, y, z, w);
+                    __m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+                    scale = axis == 0 ? lengthSquared : _mm_max_ps(scale, lengthSquared);
+                }
+                scale = _mm_sqrt_ps(scale);
+
+                _mm_storeu_ps(maxErrors + i, _mm_div_ps(_mm_mul_ps(errorPerDistance, nearest), scale));
+            }
+
+            ComputeMaxErrorsScalar(parameters, snapshot, objects, i, end, maxErrors);
+        }
+
+#endif // LOD_SELECTOR_X86
+
+        typedef void (*ComputeMaxErrorsFunction)(ErrorParameters const &, RenderSnapshot const &, uint32_t const *, uint32_t, uint32_t, float *);
+
+        ComputeMaxErrorsFunction SelectComputeMaxErrorsFunction(MatrixKernels::Isa isa)
+        {
+#if LOD_SELECTOR_X86
+            if (isa != MatrixKernels::Isa::Scalar)
+            {
+                return ComputeMaxErrorsSse;
+            }
+#endif
+            return ComputeMaxErrorsScalar;
+        }
+
+        ///
+        /// Returns the coarsest level whose error is at most the given one, 0 if there is none.
+        ///
+        inline uint32_t FindCoarsestLevel(float const * errors, uint32_t levelCount, float maxError)
+        {
+            // The errors are sorted, so the number of levels under the maximum gives the coarsest of them.
+            uint32_t count = 0;
+            for (uint32_t level = 0; level < levelCount; ++level)
+            {
+                count += errors[level] <= maxError ? 1 : 0;
+            }
+            return count != 0 ? count - 1 : 0;
+        }
+    }
+
+    LodSelector::LodSelector()
+    {
+    }
+
+    LodSelector::~LodSelector()
+    {
+    }
+
+    void LodSelector::SetMeshLevels(MeshId mesh, Span<float const> errors)
+    {
+        if (errors.size() > MaxLevelCount)
+        {
+            Fail("A mesh has more levels of detail than LodSelector::MaxLevelCount.");
+        }
+
+        if (mesh >= m_MeshLevels.size())
+        {
+            m_MeshLevels.resize(mesh + 1);
+        }
+
+        // The errors of the mesh are replaced in place when they fit.
+        MeshLevels & levels = m_MeshLevels[mesh];
+        if (errors.size() > levels.count)
+        {
+            levels.first = (uint32_t)m_Errors.size();
+            m_Errors.resize(m_Errors.size() + errors.size());
+        }
+        levels.count = (uint32_t)errors.size();
+        std::copy(errors.begin(), errors.end(), m_Errors.begin() + levels.first);
+        std::sort(m_Errors.begin() + levels.first, m_Errors.begin() + levels.first + levels.count);
+    }
+
+    uint32_t LodSelector::GetMeshLevelCount(MeshId mesh) const
+    {
+        return mesh < m_MeshLevels.size() ? m_MeshLevels[mesh].count : 0;
+    }
+
+    Span<uint8_t const> LodSelector::Select(RenderSnapshot const & snapshot, CameraSnapshot const & camera, uint32_t viewportHeight, Span<uint32_t const> objects, uint32_t view)
+    {
+        return Select(snapshot, camera, viewportHeight, objects, view, ThreadPool::GetDefault());
+    }
+
+    Span<uint8_t const> LodSelector::Select(RenderSnapshot const & snapshot, CameraSnapshot const & camera, uint32_t viewportHeight, Span<uint32_t const> objects, uint32_t view, ThreadPool & threadPool)
+    {
+        uint32_t count = (uint32_t)objects.size();
+        m_MaxErrors.resize(count);
+        m_Levels.resize(count);
+        if (view >= m_PreviousLevels.size())
+        {
+            m_PreviousLevels.resize(view + 1);
+        }
+        ViewLevels & viewLevels = m_PreviousLevels[view];
+        if (viewLevels.scene != snapshot.GetSourceScene() || viewLevels.structureVersion != snapshot.GetStructureVersion() ||
+            viewLevels.levels.size() != snapshot.GetObjectCount())
+        {
+            viewLevels.levels.assign(snapshot.GetObjectCount(), NoLevel);
+            viewLevels.scene = snapshot.GetSourceScene();
+            viewLevels.structureVersion = snapshot.GetStructureVersion();
+        }
+        std::vector<uint8_t> & previousLevels = viewLevels.levels;
+
+        // An error e at the distance d covers e * viewportHeight / (2 * d * tan(fov / 2)) pixels.
+        ErrorParameters parameters;
+        parameters.cameraPosition = camera.position;
+        parameters.nearPlane = camera.nearPlane;
+        parameters.errorPerDistance = m_Threshold * std::exp2(m_Bias) * 2 * std::tan(glm::radians(camera.verticalFieldOfView) / 2) / (std::max)(viewportHeight, 1u);
+
+        ComputeMaxErrorsFunction computeMaxErrors = SelectComputeMaxErrorsFunction(MatrixKernels::GetIsa());
+        MeshId const * meshIds = snapshot.GetMeshIds();
+        float coarserFactor = 1 - m_Hysteresis;
+        float finerFactor = 1 + m_Hysteresis;
+        threadPool.ParallelFor(count, 256, [&](uint32_t begin, uint32_t end) {
+            computeMaxErrors(parameters, snapshot, objects.data(), begin, end, m_MaxErrors.data());
+
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                uint32_t object = objects[i];
+                MeshId mesh = meshIds[object];
+                if (mesh >= m_MeshLevels.size() || m_MeshLevels[mesh].count == 0)
+                {
+                    m_Levels[i] = 0;
+                    continue;
+                }
+
+                MeshLevels const & levels = m_MeshLevels[mesh];
+                float const * errors = m_Errors.data() + levels.first;
+                uint32_t previous = previousLevels[object];
+                uint32_t level;
+                if (previous == NoLevel)
+                {
+                    level = FindCoarsestLevel(errors, levels.count, m_MaxErrors[i]);
+                }
+                else
+                {
+                    // Going coarser needs the lower bound, going finer the upper one; in between, the level stays.
+                    uint32_t lowest = FindCoarsestLevel(errors, levels.count, m_MaxErrors[i] * coarserFactor);
+                    uint32_t highest = FindCoarsestLevel(errors, levels.count, m_MaxErrors[i] * finerFactor);
+                    level = (std::min)((std::max)(previous, lowest), highest);
+                }
+
+                m_Levels[i] = (uint8_t)level;
+                previousLevels[object] = (uint8_t)level;
+            }
+        });
+
+        return Span<uint8_t const>{ m_Levels.data(), m_Levels.size() };
+    }
+
+    void LodSelector::Reset()
+    {
+        for (ViewLevels & viewLevels : m_PreviousLevels)
+        {
+            std::fill(viewLevels.levels.begin(), viewLevels.levels.end(), NoLevel);
+        }
+    }
+} // VulkanDemo
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "AlignedAllocator.h"
+#include "MeshRenderer.h"
+#include "Span.h"
+
+namespace VulkanDemo
+{
+    class RenderSnapshot;
+    class Scene;
+    class ThreadPool;
+    struct CameraSnapshot;
+
+    ///
+    /// Picks the level of detail of the mesh of every visible object, from the size on screen of the geometric error of
+    /// its levels.
+    ///
+    /// Every mesh has a list of levels, from the finest (0) to the coarsest, with the largest distance between each level
+    /// and the full detail mesh, in the local space of the mesh. An object gets the coarsest level whose error, scaled by
+    /// the largest scale of its world matrix and projected at the nearest point of its bounding sphere, stays under the
+    /// threshold in pixels. The meshes without levels always get level 0.
+    ///
+    /// To avoid popping back and forth around the threshold, an object only switches to a coarser level once its error is
+    /// under the threshold reduced by the hysteresis, and only switches to a finer level once the error of its current
+    /// level is over the threshold increased by the hysteresis.
+    ///
+    /// The largest error allowed for every object is computed 4 objects at a time with SSE, or with scalar code if it is
+    /// the instruction set selected for the MatrixKernels, then the levels are looked up per object. The objects are
+    /// processed in parallel.
+    ///
+    /// Usage Notes:
+    /// - Select() must not be called from a ThreadPool::ParallelFor().
+    /// - The previous levels are kept per object index in the snapshot. They are forgotten when the snapshot comes from
+    ///   another scene or structure version, since the indices may then refer to other objects, so every object skips
+    ///   the hysteresis once after objects or components are added, removed or changed.
+    ///
+    class LodSelector
+    {
+    public:
+        static const uint32_t MaxLevelCount = 16;
+
+        LodSelector();
+        ~LodSelector();
+
+        ///
+        /// Sets the errors of the levels of the mesh, in increasing order. Up to MaxLevelCount levels, the first one
+        /// usually having no error.
+        ///
+        void SetMeshLevels(MeshId mesh, Span<float const> errors);
+        uint32_t GetMeshLevelCount(MeshId mesh) const;
+
+        ///
+        /// Sets the largest error allowed on screen, in pixels. Defaults to 1.
+        ///
+        inline void SetThreshold(float threshold) { m_Threshold = threshold; }
+        inline float GetThreshold() const { return m_Threshold; }
+
+        ///
+        /// Sets the fraction of the threshold by which the error must cross it to switch levels. Defaults to 0.1.
+        ///
+        inline void SetHysteresis(float hysteresis) { m_Hysteresis = hysteresis; }
+        inline float GetHysteresis() const { return m_Hysteresis; }
+
+        ///
+        /// Sets the global bias. Each unit doubles the allowed error, so positive biases select coarser levels, which
+        /// are cheaper to draw, and negative ones finer levels. Defaults to 0.
+        ///
+        inline void SetBias(float bias) { m_Bias = bias; }
+        inline float GetBias() const { return m_Bias; }
+
+        ///
+        /// Returns the levels of the objects seen by the camera, in the order of the objects, which are indices in the
+        /// snapshot such as the ones left by the culling. The viewport height is in pixels. Every view of the scene keeps
+        /// its own previous levels. The result is valid until the next call.
+        ///
+        Span<uint8_t const> Select(RenderSnapshot const & snapshot, CameraSnapshot const & camera, uint32_t viewportHeight, Span<uint32_t const> objects, uint32_t view = 0);
+        Span<uint8_t const> Select(RenderSnapshot const & snapshot, CameraSnapshot const & camera, uint32_t viewportHeight, Span<uint32_t const> objects, uint32_t view, ThreadPool & threadPool);
+
+        ///
+        /// Forgets the previous levels of all the views, so that the next selection applies no hysteresis.
+        ///
+        void Reset();
+
+    private:
+        LodSelector(LodSelector const & other) = delete;
+        void operator=(LodSelector const & other) = delete;
+
+        ///
+        /// Range of the errors of a mesh.
+        ///
+        struct MeshLevels
+        {
+            uint32_t first = 0;
+            uint32_t count = 0;
+        };
+
+        std::vector<MeshLevels> m_MeshLevels;   // Indexed by MeshId.
+        std::vector<float>      m_Errors;
+
+        float m_Threshold = 1;
+        float m_Hysteresis = 0.1f;
+        float m_Bias = 0;
+
+        AlignedVector<float>                m_MaxErrors;
+        std::vector<uint8_t>                m_Levels;
+        ///
+        /// Levels selected by a view at the last frame, indexed by object, NoLevel when unknown.
+        ///
+        struct ViewLevels
+        {
+            std::vector<uint8_t> levels;
+            Scene const * scene = nullptr;
+            uint64_t structureVersion = 0;
+        };
+
+        std::vector<ViewLevels>             m_PreviousLevels;   // Indexed by view.
+    };
+} // VulkanDemo
@@ -0,0 +1,67 @@
+#include "MappedBuffer.h"
+
+#include "Application.h"
+#include "VulkanManager.h"
+
+namespace VulkanDemo
+{
+    MappedBuffer::MappedBuffer(VkBufferUsageFlags usage) :
+        m_Usage{ usage }
+    {
+    }
+
+    MappedBuffer::~MappedBuffer()
+    {
+        Destroy();
+    }
+
+    bool MappedBuffer::Reserve(VkDeviceSize size)
+    {
+        if (m_Buffer != VK_NULL_HANDLE && size <= m_Size)
+        {
+            return false;
+        }
+
+        Destroy();
+        m_Size = 65536;
+        while (m_Size < size)
+        {
+            m_Size *= 2;
+        }
+
+        VkDevice device = Application::GetInstance().GetVulkanManager()->GetDevice();
+
+        VkBufferCreateInfo bufferCreateInfo{};
+        bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferCreateInfo.pNext = NULL;
+        bufferCreateInfo.flags = 0;
+        bufferCreateInfo.size = m_Size;
+        bufferCreateInfo.usage = m_Usage;
+        bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        bufferCreateInfo.queueFamilyIndexCount = 0;
+        bufferCreateInfo.pQueueFamilyIndices = nullptr;
+        CheckResult(vkCreateBuffer(device, &bufferCreateInfo, NULL, &m_Buffer));
+
+        m_Memory = AllocateAndBindBufferMemory(m_Buffer);
+        CheckResult(vkMapMemory(device, m_Memory, 0, VK_WHOLE_SIZE, 0, &m_Data));
+        return true;
+    }
+
+    void MappedBuffer::Destroy()
+    {
+        if (m_Buffer == VK_NULL_HANDLE)
+        {
+            return;
+        }
+
+        VkDevice device = Application::GetInstance().GetVulkanManager()->GetDevice();
+        vkUnmapMemory(device, m_Memory);
+        vkFreeMemory(device, m_Memory, NULL);
+        vkDestroyBuffer(device, m_Buffer, NULL);
+
+        m_Buffer = VK_NULL_HANDLE;
+        m_Memory = VK_NULL_HANDLE;
+        m_Data = nullptr;
+        m_Size = 0;
+    }
+} // VulkanDemo
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Shared.h"
+
+namespace VulkanDemo
+{
+    ///
+    /// Buffer in host visible memory, mapped while it exists, such as the buffers written by the CPU every frame or read
+    /// back from the GPU.
+    ///
+    /// The buffer grows by powers of two from 64KB, so that it is rarely recreated, and its content is lost when it is.
+    ///
+    /// Usage Notes:
+    /// - The GPU must no longer use the buffer when it grows, as when the single command buffer of the SceneRenderer is
+    ///   complete before the next frame.
+    ///
+    class MappedBuffer
+    {
+    public:
+        MappedBuffer(VkBufferUsageFlags usage);
+        ~MappedBuffer();
+
+        ///
+        /// Makes the buffer hold at least the given size, creating it on first use. Returns true when the buffer was
+        /// created, so that the descriptors referring to it must be updated.
+        ///
+        bool Reserve(VkDeviceSize size);
+
+        inline VkBuffer GetBuffer() const { return m_Buffer; }
+        inline void * GetData() const { return m_Data; }
+        inline VkDeviceSize GetSize() const { return m_Size; }
+
+    private:
+        MappedBuffer(MappedBuffer const & other) = delete;
+        void operator=(MappedBuffer const & other) = delete;
+
+        void Destroy();
+
+        VkBufferUsageFlags m_Usage;
+        VkBuffer m_Buffer = VK_NULL_HANDLE;
+        VkDeviceMemory m_Memory = VK_NULL_HANDLE;
+        void * m_Data = nullptr;
+        VkDeviceSize m_Size = 0;
+    };
+} // VulkanDemo
@@ -0,0 +1,121 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace VulkanDemo
+{
+    MappedFile::MappedFile()
+    {
+    }
+
+    MappedFile::~MappedFile()
+    {
+        Close();
+    }
+
+#ifdef _WIN32
+    bool MappedFile::Open(char const * path)
+    {
+        Close();
+
+        HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+        m_File = file;
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+        {
+            Close();
+            return false;
+        }
+
+        m_Mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (m_Mapping == NULL)
+        {
+            Close();
+            return false;
+        }
+
+        m_Data = static_cast<uint8_t const *>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+        if (m_Data == nullptr)
+        {
+            Close();
+            return false;
+        }
+        m_Size = (size_t)size.QuadPart;
+
+        return true;
+    }
+
+    void MappedFile::Close()
+    {
+        if (m_Data != nullptr)
+        {
+            UnmapViewOfFile(m_Data);
+        }
+        if (m_Mapping != nullptr)
+        {
+            CloseHandle(m_Mapping);
+        }
+        if (m_File != nullptr)
+        {
+            CloseHandle(m_File);
+        }
+
+        m_Data = nullptr;
+        m_Size = 0;
+        m_Mapping = nullptr;
+        m_File = nullptr;
+    }
+#else
+    bool MappedFile::Open(char const * path)
+    {
+        Close();
+
+        int file = open(path, O_RDONLY);
+        if (file < 0)
+        {
+            return false;
+        }
+
+        // The mapping keeps the file alive, so the descriptor is not needed anymore.
+        struct stat status;
+        void * data = MAP_FAILED;
+        if (fstat(file, &status) == 0 && status.st_size > 0)
+        {
+            data = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+        }
+        close(file);
+
+        if (data == MAP_FAILED)
+        {
+            return false;
+        }
+
+        m_Data = static_cast<uint8_t const *>(data);
+        m_Size = (size_t)status.st_size;
+        return true;
+    }
+
+    void MappedFile::Close()
+    {
+        if (m_Data != nullptr)
+        {
+            munmap(const_cast<uint8_t *>(m_Data), m_Size);
+        }
+
+        m_Data = nullptr;
+        m_Size = 0;
+    }
+#endif
+} // VulkanDemo
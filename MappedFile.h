@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace VulkanDemo
+{
+    ///
+    /// Read-only view of a whole file mapped in memory. Pages are loaded by the OS on first access, so opening a large
+    /// file is cheap and only the parts that are read cost I/O.
+    ///
+    class MappedFile
+    {
+    public:
+        MappedFile();
+        ~MappedFile();
+
+        ///
+        /// Maps the file, closing the previous one if any.
+        ///
+        /// @return false if the file could not be opened or mapped, or is empty, in which case the object is left closed.
+        ///
+        bool Open(char const * path);
+        void Close();
+
+        inline bool IsOpen() const { return m_Data != nullptr; }
+        inline uint8_t const * GetData() const { return m_Data; }
+        inline size_t GetSize() const { return m_Size; }
+
+    private:
+        MappedFile(MappedFile const & other) = delete;
+        void operator=(MappedFile const & other) = delete;
+
+        uint8_t const * m_Data = nullptr;
+        size_t m_Size = 0;
+
+#ifdef _WIN32
+        void * m_File = nullptr;
+        void * m_Mapping = nullptr;
+#endif
+    };
+} // VulkanDemo
@@ -0,0 +1,468 @@
+#include "MatrixKernels.h"
+
+#include <cassert>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define MATRIX_KERNELS_X86 1
+#else
+#define MATRIX_KERNELS_X86 0
+#endif
+
+#if MATRIX_KERNELS_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// MSVC allows any intrinsic in any function, other compilers need the functions to be tagged.
+#if MATRIX_KERNELS_X86 && !defined(_MSC_VER)
+#define MATRIX_KERNELS_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define MATRIX_KERNELS_TARGET_AVX2
+#endif
+
+namespace VulkanDemo
+{
+    namespace MatrixKernels
+    {
+        // The kernels read the vectors and quaternions as packed floats (quaternions as x, y, z, w).
+        static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "Unexpected glm::vec3 layout.");
+        static_assert(sizeof(glm::quat) == 4 * sizeof(float), "Unexpected glm::quat layout.");
+        static_assert(sizeof(glm::mat4) == 16 * sizeof(float), "Unexpected glm::mat4 layout.");
+
+        namespace
+        {
+            // Scalar
+
+            void ComposeTrsScalar(uint32_t count, glm::vec3 const * positions, glm::quat const * rotations, glm::vec3 const * scales, glm::mat4 * out)
+            {
+                for (uint32_t i = 0; i < count; ++i)
+                {
+                    glm::quat const & q = rotations[i];
+                    float xx = q.x * q.x;
+                    float yy = q.y * q.y;
+                    float zz = q.z * q.z;
+                    float xy = q.x * q.y;
+                    float xz = q.x * q.z;
+                    float yz = q.y * q.z;
+                    float wx = q.w * q.x;
+                    float wy = q.w * q.y;
+                    float wz = q.w * q.z;
+
+                    glm::vec3 const & s = scales[i];
+                    glm::vec3 const & p = positions[i];
+                    glm::mat4 & m = out[i];
+                    m[0][0] = (1.0f - 2.0f * (yy + zz)) * s.x;
+                    m[0][1] = (2.0f * (xy + wz)) * s.x;
+                    m[0][2] = (2.0f * (xz - wy)) * s.x;
+                    m[0][3] = 0.0f;
+                    m[1][0] = (2.0f * (xy - wz)) * s.y;
+                    m[1][1] = (1.0f - 2.0f * (xx + zz)) * s.y;
+                    m[1][2] = (2.0f * (yz + wx)) * s.y;
+                    m[1][3] = 0.0f;
+                    m[2][0] = (2.0f * (xz + wy)) * s.z;
+                    m[2][1] = (2.0f * (yz - wx)) * s.z;
+                    m[2][2] = (1.0f - 2.0f * (xx + yy)) * s.z;
+                    m[2][3] = 0.0f;
+                    m[3][0] = p.x;
+                    m[3][1] = p.y;
+                    m[3][2] = p.z;
+                    m[3][3] = 1.0f;
+                }
+            }
+
+            void MultiplyScalar(uint32_t count, glm::mat4 const * lhs, glm::mat4 const * rhs, glm::mat4 * out)
+            {
+                for (uint32_t i = 0; i < count; ++i)
+                {
+                    glm::mat4 const a = lhs[i];
+                    glm::mat4 const b = rhs[i];
+                    glm::mat4 r;
+                    for (int col = 0; col < 4; ++col)
+                    {
+                        for (int row = 0; row < 4; ++row)
+                        {
+                            r[col][row] = a[0][row] * b[col][0] + a[1][row] * b[col][1] + a[2][row] * b[col][2] + a[3][row] * b[col][3];
+                        }
+                    }
+                    out[i] = r;
+                }
+            }
+
+#if MATRIX_KERNELS_X86
+
+            // SSE
+
+            ///
+            /// Converts 4 packed vec3 (12 floats) into 3 registers holding the x, y and z components.
+            ///
+            inline void LoadVec3x4(float const * source, __m128 & x, __m128 & y, __m128 & z)
+            {
+                __m128 a = _mm_loadu_ps(source);     // x0 y0 z0 x1
+                __m128 b = _mm_loadu_ps(source + 4); // y1 z1 x2 y2
+                __m128 c = _mm_loadu_ps(source + 8); // z2 x3 y3 z3
+
+                x = _mm_shuffle_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 3, 0, 0)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(0, 1, 0, 2)), _MM_SHUFFLE(2, 0, 2, 0));
+                y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 0, 1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(0, 2, 0, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+                z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 1, 0, 2)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(0, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+            }
+
+            inline void StoreColumnx4(float * out, int column, __m128 r0, __m128 r1, __m128 r2, __m128 r3)
+            {
+                _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+                _mm_storeu_ps(out + 0 * 16 + column * 4, r0);
+                _mm_storeu_ps(out + 1 * 16 + column * 4, r1);
+                _mm_storeu_ps(out + 2 * 16 + column * 4, r2);
+                _mm_storeu_ps(out + 3 * 16 + column * 4, r3);
+            }
+
+            void ComposeTrsSse(uint32_t count, glm::vec3 const * positions, glm::quat const * rotations, glm::vec3 const * scales, glm::mat4 * out)
+            {
+                __m128 const zero = _mm_setzero_ps();
+                __m128 const one = _mm_set1_ps(1.0f);
+                __m128 const two = _mm_set1_ps(2.0f);
+
+                uint32_t i = 0;
+                for (; i + 4 <= count; i += 4)
+                {
+                    __m128 qx = _mm_loadu_ps(&rotations[i + 0].x);
+                    __m128 qy = _mm_loadu_ps(&rotations[i + 1].x);
+                    __m128 qz = _mm_loadu_ps(&rotations[i + 2].x);
+                    __m128 qw = _mm_loadu_ps(&rotations[i + 3].x);
+                    _MM_TRANSPOSE4_PS(qx, qy, qz, qw);
+
+                    __m128 px, py, pz, sx, sy, sz;
+                    LoadVec3x4(&positions[i].x, px, py, pz);
+                    LoadVec3x4(&scales[i].x, sx, sy, sz);
+
+                    __m128 xx = _mm_mul_ps(qx, qx);
+                    __m128 yy = _mm_mul_ps(qy, qy);
+                    __m128 zz = _mm_mul_ps(qz, qz);
+                    __m128 xy = _mm_mul_ps(qx, qy);
+                    __m128 xz = _mm_mul_ps(qx, qz);
+                    __m128 yz = _mm_mul_ps(qy, qz);
+                    __m128 wx = _mm_mul_ps(qw, qx);
+                    __m128 wy = _mm_mul_ps(qw, qy);
+                    __m128 wz = _mm_mul_ps(qw, qz);
+
+                    __m128 m00 = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+                    __m128 m01 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx);
+                    __m128 m02 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx);
+                    __m128 m10 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy);
+                    __m128 m11 = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+                    __m128 m12 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy);
+                    __m128 m20 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz);
+                    __m128 m21 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz);
+                    __m128 m22 = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+
+                    float * destination = &out[i][0][0];
+                    StoreColumnx4(destination, 0, m00, m01, m02, zero);
+                    StoreColumnx4(destination, 1, m10, m11, m12, zero);
+                    StoreColumnx4(destination, 2, m20, m21, m22, zero);
+                    StoreColumnx4(destination, 3, px, py, pz, one);
+                }
+
+                ComposeTrsScalar(count - i, positions + i, rotations + i, scales + i, out + i);
+            }
+
+            void MultiplySse(uint32_t count, glm::mat4 const * lhs, glm::mat4 const * rhs, glm::mat4 * out)
+            {
+                for (uint32_t i = 0; i < count; ++i)
+                {
+                    float const * a = &lhs[i][0][0];
+                    float const * b = &rhs[i][0][0];
+
+                    __m128 a0 = _mm_loadu_ps(a + 0);
+                    __m128 a1 = _mm_loadu_ps(a + 4);
+                    __m128 a2 = _mm_loadu_ps(a + 8);
+                    __m128 a3 = _mm_loadu_ps(a + 12);
+
+                    __m128 b0 = _mm_loadu_ps(b + 0);
+                    __m128 b1 = _mm_loadu_ps(b + 4);
+                    __m128 b2 = _mm_loadu_ps(b + 8);
+                    __m128 b3 = _mm_loadu_ps(b + 12);
+
+                    __m128 columns[4] = { b0, b1, b2, b3 };
+                    float * r = &out[i][0][0];
+                    for (int col = 0; col < 4; ++col)
+                    {
+                        __m128 bc = columns[col];
+                        __m128 sum = _mm_mul_ps(a0, _mm_shuffle_ps(bc, bc, _MM_SHUFFLE(0, 0, 0, 0)));
+                        sum = _mm_add_ps(sum, _mm_mul_ps(a1, _mm_shuffle_ps(bc, bc, _MM_SHUFFLE(1, 1, 1, 1))));
+                        sum = _mm_add_ps(sum, _mm_mul_ps(a2, _mm_shuffle_ps(bc, bc, _MM_SHUFFLE(2, 2, 2, 2))));
+                        sum = _mm_add_ps(sum, _mm_mul_ps(a3, _mm_shuffle_ps(bc, bc, _MM_SHUFFLE(3, 3, 3, 3))));
+                        _mm_storeu_ps(r + col * 4, sum);
+                    }
+                }
+            }
+
+            // AVX2
+
+            ///
+            /// Transposes the 4x4 blocks held in the low and high halves of the registers.
+            ///
+            MATRIX_KERNELS_TARGET_AVX2 inline void Transpose4x4x2(__m256 & r0, __m256 & r1, __m256 & r2, __m256 & r3)
+            {
+                __m256 t0 = _mm256_unpacklo_ps(r0, r1);
+                __m256 t1 = _mm256_unpacklo_ps(r2, r3);
+                __m256 t2 = _mm256_unpackhi_ps(r0, r1);
+                __m256 t3 = _mm256_unpackhi_ps(r2, r3);
+                r0 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+                r1 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+                r2 = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+                r3 = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2));
+            }
+
+            MATRIX_KERNELS_TARGET_AVX2 void ComposeTrsAvx2(uint32_t count, glm::vec3 const * positions, glm::quat const * rotations, glm::vec3 const * scales, glm::mat4 * out)
+            {
+                __m256 const zero = _mm256_setzero_ps();
+                __m256 const one = _mm256_set1_ps(1.0f);
+                __m256 const two = _mm256_set1_ps(2.0f);
+
+                // The in-lane transposes process the objects in the order 0 2 4 6 | 1 3 5 7, so the vec3 components
+                // are gathered in that order too.
+                __m256i const vec3Indices = _mm256_setr_epi32(0, 6, 12, 18, 3, 9, 15, 21);
+
+                uint32_t i = 0;
+                for (; i + 8 <= count; i += 8)
+                {
+                    float const * q = &rotations[i].x;
+                    __m256 qx = _mm256_loadu_ps(q + 0);
+                    __m256 qy = _mm256_loadu_ps(q + 8);
+                    __m256 qz = _mm256_loadu_ps(q + 16);
+                    __m256 qw = _mm256_loadu_ps(q + 24);
+                    Transpose4x4x2(qx, qy, qz, qw);
+
+                    float const * p = &positions[i].x;
+                    __m256 px = _mm256_i32gather_ps(p + 0, vec3Indices, 4);
+                    __m256 py = _mm256_i32gather_ps(p + 1, vec3Indices, 4);
+                    __m256 pz = _mm256_i32gather_ps(p + 2, vec3Indices, 4);
+
+                    float const * s = &scales[i].x;
+                    __m256 sx = _mm256_i32gather_ps(s + 0, vec3Indices, 4);
+                    __m256 sy = _mm256_i32gather_ps(s + 1, vec3Indices, 4);
+                    __m256 sz = _mm256_i32gather_ps(s + 2, vec3Indices, 4);
+
+                    __m256 xx = _mm256_mul_ps(qx, qx);
+                    __m256 yy = _mm256_mul_ps(qy, qy);
+                    __m256 zz = _mm256_mul_ps(qz, qz);
+                    __m256 xy = _mm256_mul_ps(qx, qy);
+                    __m256 xz = _mm256_mul_ps(qx, qz);
+                    __m256 yz = _mm256_mul_ps(qy, qz);
+                    __m256 wx = _mm256_mul_ps(qw, qx);
+                    __m256 wy = _mm256_mul_ps(qw, qy);
+                    __m256 wz = _mm256_mul_ps(qw, qz);
+
+                    __m256 c0[4] =
+                    {
+                        _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(yy, zz))), sx),
+                        _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xy, wz)), sx),
+                        _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xz, wy)), sx),
+                        zero,
+                    };
+                    __m256 c1[4] =
+                    {
+                        _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xy, wz)), sy),
+                        _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, zz))), sy),
+                        _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(yz, wx)), sy),
+                        zero,
+                    };
+                    __m256 c2[4] =
+                    {
+                        _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xz, wy)), sz),
+                        _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(yz, wx)), sz),
+                        _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, yy))), sz),
+                        zero,
+                    };
+                    __m256 c3[4] = { px, py, pz, one };
+
+                    // After the transposes, register k holds the column of object 2k in its low half and the column
+                    // of object 2k + 1 in its high half.
+                    Transpose4x4x2(c0[0], c0[1], c0[2], c0[3]);
+                    Transpose4x4x2(c1[0], c1[1], c1[2], c1[3]);
+                    Transpose4x4x2(c2[0], c2[1], c2[2], c2[3]);
+                    Transpose4x4x2(c3[0], c3[1], c3[2], c3[3]);
+
+                    float * destination = &out[i][0][0];
+                    for (int k = 0; k < 4; ++k)
+                    {
+                        float * even = destination + (2 * k) * 16;
+                        float * odd = destination + (2 * k + 1) * 16;
+                        _mm256_storeu_ps(even + 0, _mm256_permute2f128_ps(c0[k], c1[k], 0x20));
+                        _mm256_storeu_ps(even + 8, _mm256_permute2f128_ps(c2[k], c3[k], 0x20));
+                        _mm256_storeu_ps(odd + 0, _mm256_permute2f128_ps(c0[k], c1[k], 0x31));
+                        _mm256_storeu_ps(odd + 8, _mm256_permute2f128_ps(c2[k], c3[k], 0x31));
+                    }
+                }
+
+                ComposeTrsScalar(count - i, positions + i, rotations + i, scales + i, out + i);
+            }
+
+            MATRIX_KERNELS_TARGET_AVX2 void MultiplyAvx2(uint32_t count, glm::mat4 const * lhs, glm::mat4 const * rhs, glm::mat4 * out)
+            {
+                for (uint32_t i = 0; i < count; ++i)
+                {
+                    float const * a = &lhs[i][0][0];
+                    float const * b = &rhs[i][0][0];
+
+                    // Each register holds two columns, so the columns of the left matrix are duplicated in both halves.
+                    __m256 a0 = _mm256_broadcast_ps(reinterpret_cast<__m128 const *>(a + 0));
+                    __m256 a1 = _mm256_broadcast_ps(reinterpret_cast<__m128 const *>(a + 4));
+                    __m256 a2 = _mm256_broadcast_ps(reinterpret_cast<__m128 const *>(a + 8));
+                    __m256 a3 = _mm256_broadcast_ps(reinterpret_cast<__m128 const *>(a + 12));
+
+                    __m256 b01 = _mm256_loadu_ps(b + 0);
+                    __m256 b23 = _mm256_loadu_ps(b + 8);
+
+                    __m256 r01 = _mm256_mul_ps(a0, _mm256_permute_ps(b01, _MM_SHUFFLE(0, 0, 0, 0)));
+                    r01 = _mm256_add_ps(r01, _mm256_mul_ps(a1, _mm256_permute_ps(b01, _MM_SHUFFLE(1, 1, 1, 1))));
+                    r01 = _mm256_add_ps(r01, _mm256_mul_ps(a2, _mm256_permute_ps(b01, _MM_SHUFFLE(2, 2, 2, 2))));
+                    r01 = _mm256_add_ps(r01, _mm256_mul_ps(a3, _mm256_permute_ps(b01, _MM_SHUFFLE(3, 3, 3, 3))));
+
+                    __m256 r23 = _mm256_mul_ps(a0, _mm256_permute_ps(b23, _MM_SHUFFLE(0, 0, 0, 0)));
+                    r23 = _mm256_add_ps(r23, _mm256_mul_ps(a1, _mm256_permute_ps(b23, _MM_SHUFFLE(1, 1, 1, 1))));
+                    r23 = _mm256_add_ps(r23, _mm256_mul_ps(a2, _mm256_permute_ps(b23, _MM_SHUFFLE(2, 2, 2, 2))));
+                    r23 = _mm256_add_ps(r23, _mm256_mul_ps(a3, _mm256_permute_ps(b23, _MM_SHUFFLE(3, 3, 3, 3))));
+
+                    float * r = &out[i][0][0];
+                    _mm256_storeu_ps(r + 0, r01);
+                    _mm256_storeu_ps(r + 8, r23);
+                }
+            }
+
+            void Cpuid(int leaf, int subleaf, int registers[4])
+            {
+#if defined(_MSC_VER)
+                __cpuidex(registers, leaf, subleaf);
+#else
+                unsigned int a, b, c, d;
+                __cpuid_count(leaf, subleaf, a, b, c, d);
+                registers[0] = (int)a;
+                registers[1] = (int)b;
+                registers[2] = (int)c;
+                registers[3] = (int)d;
+#endif
+            }
+
+            bool IsAvxStateEnabled()
+            {
+#if defined(_MSC_VER)
+                return (_xgetbv(0) & 0x6) == 0x6;
+#else
+                unsigned int eax, edx;
+                __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+                return (eax & 0x6) == 0x6;
+#endif
+            }
+
+            Isa DetectIsa()
+            {
+                int registers[4];
+                Cpuid(0, 0, registers);
+                int maxLeaf = registers[0];
+
+                Cpuid(1, 0, registers);
+                bool hasSse2 = (registers[3] & (1 << 26)) != 0;
+                bool hasOsxsave = (registers[2] & (1 << 27)) != 0;
+                bool hasAvx = (registers[2] & (1 << 28)) != 0;
+
+                bool hasAvx2 = false;
+                if (maxLeaf >= 7 && hasOsxsave && hasAvx && IsAvxStateEnabled())
+                {
+                    Cpuid(7, 0, registers);
+                    hasAvx2 = (registers[1] & (1 << 5)) != 0;
+                }
+
+                if (hasAvx2)
+                {
+                    return Isa::Avx2;
+                }
+                if (hasSse2)
+                {
+                    return Isa::Sse;
+                }
+                return Isa::Scalar;
+            }
+
+#else
+
+            Isa DetectIsa()
+            {
+                return Isa::Scalar;
+            }
+
+#endif // MATRIX_KERNELS_X86
+
+            struct Kernels
+            {
+                Isa isa;
+                void (*composeTrs)(uint32_t, glm::vec3 const *, glm::quat const *, glm::vec3 const *, glm::mat4 *);
+                void (*multiply)(uint32_t, glm::mat4 const *, glm::mat4 const *, glm::mat4 *);
+            };
+
+            Kernels SelectKernels(Isa isa)
+            {
+                switch (isa)
+                {
+#if MATRIX_KERNELS_X86
+                case Isa::Avx2:
+                    return { Isa::Avx2, ComposeTrsAvx2, MultiplyAvx2 };
+                case Isa::Sse:
+                    return { Isa::Sse, ComposeTrsSse, MultiplySse };
+#endif
+                default:
+                    return { Isa::Scalar, ComposeTrsScalar, MultiplyScalar };
+                }
+            }
+
+            Kernels & GetKernels()
+            {
+                static Kernels kernels = SelectKernels(GetSupportedIsa());
+                return kernels;
+            }
+        }
+
+        Isa GetSupportedIsa()
+        {
+            static Isa isa = DetectIsa();
+            return isa;
+        }
+
+        Isa GetIsa()
+        {
+            return GetKernels().isa;
+        }
+
+        void SetIsa(Isa isa)
+        {
+            assert(isa <= GetSupportedIsa());
+            GetKernels() = SelectKernels(isa);
+        }
+
+        char const * GetIsaName(Isa isa)
+        {
+            switch (isa)
+            {
+            case Isa::Avx2:
+                return "AVX2";
+            case Isa::Sse:
+                return "SSE";
+            default:
+                return "Scalar";
+            }
+        }
+
+        void ComposeTrs(uint32_t count, glm::vec3 const * positions, glm::quat const * rotations, glm::vec3 const * scales, glm::mat4 * out)
+        {
+            GetKernels().composeTrs(count, positions, rotations, scales, out);
+        }
+
+        void Multiply(uint32_t count, glm::mat4 const * lhs, glm::mat4 const * rhs, glm::mat4 * out)
+        {
+            GetKernels().multiply(count, lhs, rhs, out);
+        }
+    } // MatrixKernels
+} // VulkanDemo
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstdint>
+
+namespace VulkanDemo
+{
+    ///
+    /// Batch kernels building and combining 4x4 matrices, with SSE and AVX2 variants selected at runtime.
+    ///
+    /// All the variants perform the same operations in the same order, without fused multiply-adds, so they produce
+    /// bit-identical results. Partial batches are processed with the scalar variant.
+    ///
+    namespace MatrixKernels
+    {
+        enum class Isa
+        {
+            Scalar,
+            Sse,
+            Avx2,
+        };
+
+        ///
+        /// Returns the best instruction set supported by the CPU, as reported by CPUID.
+        ///
+        Isa GetSupportedIsa();
+
+        ///
+        /// Returns the instruction set used by the kernels. Defaults to GetSupportedIsa().
+        ///
+        Isa GetIsa();
+
+        ///
+        /// Forces the kernels to use the given instruction set, which must be supported. Not thread-safe: intended to
+        /// compare the variants.
+        ///
+        void SetIsa(Isa isa);
+
+        char const * GetIsaName(Isa isa);
+
+        ///
+        /// out[i] = translate(positions[i]) * mat4_cast(rotations[i]) * scale(scales[i])
+        ///
+        void ComposeTrs(uint32_t count, glm::vec3 const * positions, glm::quat const * rotations, glm::vec3 const * scales, glm::mat4 * out);
+
+        ///
+        /// out[i] = lhs[i] * rhs[i]. The output may alias either input.
+        ///
+        void Multiply(uint32_t count, glm::mat4 const * lhs, glm::mat4 const * rhs, glm::mat4 * out);
+    } // MatrixKernels
+} // VulkanDemo
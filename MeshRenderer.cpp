@@ -0,0 +1,13 @@
+#include "MeshRenderer.h"
+
+namespace VulkanDemo
+{
+    MeshRenderer::MeshRenderer() :
+        Component{ TypeId }
+    {
+    }
+
+    MeshRenderer::~MeshRenderer()
+    {
+    }
+} // VulkanDemo
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+
+#include "Bounds.h"
+#include "Component.h"
+#include "PoolAllocator.h"
+
+namespace VulkanDemo
+{
+    typedef uint32_t MeshId;
+    typedef uint32_t MaterialId;
+
+    ///
+    /// Draws a mesh with a material at the transform of its GameObject. Meshes and materials are referred to by
+    /// identifier; the renderer resolves them. The local bounds enclose the mesh in the local space of the transform.
+    /// The setters record the change in the journal of the scene, so that the render snapshot picks it up.
+    ///
+    class MeshRenderer : public Component, public Pooled<MeshRenderer>
+    {
+    public:
+        static constexpr char const * PoolName = "MeshRenderer";
+        static const ComponentType::Id TypeId = ComponentType::MeshRenderer;
+
+        MeshRenderer();
+        ~MeshRenderer();
+
+        inline MeshId GetMeshId() const { return m_MeshId; }
+        inline void SetMeshId(MeshId meshId) { m_MeshId = meshId; MarkChanged(); }
+
+        inline MaterialId GetMaterialId() const { return m_MaterialId; }
+        inline void SetMaterialId(MaterialId materialId) { m_MaterialId = materialId; MarkChanged(); }
+
+        inline Aabb const & GetLocalBounds() const { return m_LocalBounds; }
+        inline void SetLocalBounds(Aabb const & localBounds) { m_LocalBounds = localBounds; MarkChanged(); }
+
+        ///
+        /// Box hiding the objects behind it, in the same space as the local bounds. The mesh must cover the whole box,
+        /// since the objects behind it are not drawn. Empty, as by default, when the mesh is not an occluder.
+        ///
+        inline Aabb const & GetOccluderBounds() const { return m_OccluderBounds; }
+        inline void SetOccluderBounds(Aabb const & occluderBounds) { m_OccluderBounds = occluderBounds; MarkChanged(); }
+
+    private:
+        MeshId m_MeshId = 0;
+        MaterialId m_MaterialId = 0;
+        Aabb m_LocalBounds{ glm::vec3{ -0.5f, -0.5f, -0.5f }, glm::vec3{ 0.5f, 0.5f, 0.5f } };
+        Aabb m_OccluderBounds;
+    };
+} // VulkanDemo
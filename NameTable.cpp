@@ -0,0 +1,188 @@
+#include "NameTable.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace VulkanDemo
+{
+    const NameId NameTable::EmptyName;
+    const uint32_t NameTable::PageShift;
+    const uint32_t NameTable::PageSize;
+    const uint32_t NameTable::MaxPageCount;
+    const size_t NameTable::ArenaBlockSize;
+
+    NameTable::NameTable() :
+        m_Count{ 1 }
+    {
+        for (auto & page : m_Pages)
+        {
+            page.store(nullptr, std::memory_order_relaxed);
+        }
+
+        Entry * firstPage = new Entry[PageSize];
+        firstPage[EmptyName] = Entry{ "", 0, Hash("", 0) };
+        m_Pages[0].store(firstPage, std::memory_order_release);
+
+        m_Slots.assign(1024, EmptyName);
+    }
+
+    NameTable::~NameTable()
+    {
+        for (auto & page : m_Pages)
+        {
+            delete[] page.load(std::memory_order_relaxed);
+        }
+        for (auto block : m_ArenaBlocks)
+        {
+            delete[] block;
+        }
+    }
+
+    NameTable & NameTable::GetInstance()
+    {
+        // Never destroyed, so that names stay valid during the static destructors.
+        static NameTable * instance = new NameTable();
+        return *instance;
+    }
+
+    NameId NameTable::Intern(char const * string, size_t length)
+    {
+        if (length == 0)
+        {
+            return EmptyName;
+        }
+
+        uint32_t hash = Hash(string, length);
+
+        std::lock_guard<std::mutex> lock{ m_Mutex };
+
+        uint32_t slot = FindSlot(string, length, hash);
+        if (m_Slots[slot] != EmptyName)
+        {
+            return m_Slots[slot];
+        }
+
+        NameId id = m_Count.load(std::memory_order_relaxed);
+        uint32_t pageIndex = id >> PageShift;
+        if (pageIndex >= MaxPageCount)
+        {
+            assert(false); // TODO: Log an error instead of asserting.
+            return EmptyName;
+        }
+
+        Entry * page = m_Pages[pageIndex].load(std::memory_order_relaxed);
+        if (page == nullptr)
+        {
+            page = new Entry[PageSize];
+            m_Pages[pageIndex].store(page, std::memory_order_release);
+        }
+        page[id & (PageSize - 1)] = Entry{ CopyToArena(string, length), (uint32_t)length, hash };
+        m_Count.store(id + 1, std::memory_order_release);
+
+        m_Slots[slot] = id;
+
+        // Keep the load factor under 1/2.
+        if (2 * (size_t)(id + 1) > m_Slots.size())
+        {
+            Rehash(2 * m_Slots.size());
+        }
+
+        return id;
+    }
+
+    NameId NameTable::Find(char const * string, size_t length) const
+    {
+        if (length == 0)
+        {
+            return EmptyName;
+        }
+
+        uint32_t hash = Hash(string, length);
+
+        std::lock_guard<std::mutex> lock{ m_Mutex };
+        return m_Slots[FindSlot(string, length, hash)];
+    }
+
+    size_t NameTable::GetArenaSize() const
+    {
+        std::lock_guard<std::mutex> lock{ m_Mutex };
+
+        size_t size = 0;
+        for (size_t i = 0; i < m_ArenaBlocks.size(); ++i)
+        {
+            size += i + 1 < m_ArenaBlocks.size() ? ArenaBlockSize : m_ArenaUsed;
+        }
+        return size;
+    }
+
+    uint32_t NameTable::Hash(char const * string, size_t length)
+    {
+        // FNV-1a.
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < length; ++i)
+        {
+            hash ^= (uint8_t)string[i];
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    uint32_t NameTable::FindSlot(char const * string, size_t length, uint32_t hash) const
+    {
+        uint32_t mask = (uint32_t)m_Slots.size() - 1;
+        uint32_t slot = hash & mask;
+        while (true)
+        {
+            NameId id = m_Slots[slot];
+            if (id == EmptyName)
+            {
+                return slot;
+            }
+
+            Entry const & entry = GetEntry(id);
+            if (entry.hash == hash && entry.length == length && memcmp(entry.string, string, length) == 0)
+            {
+                return slot;
+            }
+
+            slot = (slot + 1) & mask;
+        }
+    }
+
+    char const * NameTable::CopyToArena(char const * string, size_t length)
+    {
+        size_t size = length + 1;
+        if (m_ArenaBlocks.empty() || m_ArenaUsed + size > ArenaBlockSize)
+        {
+            // Long strings get a block of their own, which becomes the last block.
+            m_ArenaBlocks.push_back(new char[std::max(size, ArenaBlockSize)]);
+            m_ArenaUsed = 0;
+        }
+
+        char * copy = m_ArenaBlocks.back() + m_ArenaUsed;
+        memcpy(copy, string, length);
+        copy[length] = '\0';
+        m_ArenaUsed += size;
+        return copy;
+    }
+
+    void NameTable::Rehash(size_t capacity)
+    {
+        std::vector<NameId> slots(capacity, EmptyName);
+        uint32_t mask = (uint32_t)capacity - 1;
+
+        uint32_t count = m_Count.load(std::memory_order_relaxed);
+        for (NameId id = 1; id < count; ++id)
+        {
+            uint32_t slot = GetEntry(id).hash & mask;
+            while (slots[slot] != EmptyName)
+            {
+                slot = (slot + 1) & mask;
+            }
+            slots[slot] = id;
+        }
+
+        m_Slots.swap(slots);
+    }
+} // VulkanDemo
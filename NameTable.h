@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace VulkanDemo
+{
+    typedef uint32_t NameId;
+
+    ///
+    /// Global table of interned strings.
+    ///
+    /// Interning a string returns a small integer identifier shared by all the equal strings, so that names are compared
+    /// and hashed as integers. The characters are copied once into an arena and never move nor get released, so the
+    /// pointers returned by GetString() remain valid until the end of the program.
+    ///
+    /// Interning and Find() are serialized by a mutex. GetString() and GetLength() don't lock.
+    ///
+    class NameTable
+    {
+    public:
+        static const NameId EmptyName = 0;
+
+        static NameTable & GetInstance();
+
+        NameId Intern(char const * string, size_t length);
+        inline NameId Intern(char const * string) { return Intern(string, strlen(string)); }
+        inline NameId Intern(std::string const & string) { return Intern(string.data(), string.size()); }
+
+        ///
+        /// Returns the identifier of a string that was already interned, or EmptyName, without interning it.
+        ///
+        NameId Find(char const * string, size_t length) const;
+        inline NameId Find(char const * string) const { return Find(string, strlen(string)); }
+        inline NameId Find(std::string const & string) const { return Find(string.data(), string.size()); }
+
+        ///
+        /// Returns the null-terminated string of the identifier.
+        ///
+        inline char const * GetString(NameId id) const { return GetEntry(id).string; }
+        inline uint32_t GetLength(NameId id) const { return GetEntry(id).length; }
+
+        inline uint32_t GetCount() const { return m_Count.load(std::memory_order_acquire); }
+
+        ///
+        /// Returns the number of bytes reserved for the characters.
+        ///
+        size_t GetArenaSize() const;
+
+    private:
+        NameTable();
+        ~NameTable();
+
+        NameTable(NameTable const & other) = delete;
+        void operator=(NameTable const & other) = delete;
+
+        struct Entry
+        {
+            char const *    string;
+            uint32_t        length;
+            uint32_t        hash;
+        };
+
+        // The entries are stored in fixed-size pages which never move, so that they can be read without locking.
+        static const uint32_t PageShift = 12;
+        static const uint32_t PageSize = 1 << PageShift;
+        static const uint32_t MaxPageCount = 4096;
+        static const size_t ArenaBlockSize = 64 * 1024;
+
+        inline Entry const & GetEntry(NameId id) const
+        {
+            return m_Pages[id >> PageShift].load(std::memory_order_acquire)[id & (PageSize - 1)];
+        }
+
+        static uint32_t Hash(char const * string, size_t length);
+
+        ///
+        /// Returns the slot of the hash table holding the string, or the empty slot where it would be inserted. The
+        /// mutex must be locked.
+        ///
+        uint32_t FindSlot(char const * string, size_t length, uint32_t hash) const;
+
+        char const * CopyToArena(char const * string, size_t length);
+        void Rehash(size_t capacity);
+
+        std::atomic<Entry *>        m_Pages[MaxPageCount];
+        std::atomic<uint32_t>       m_Count;
+
+        mutable std::mutex          m_Mutex;
+        std::vector<NameId>         m_Slots;        // Open addressing, EmptyName marks a free slot.
+        std::vector<char *>         m_ArenaBlocks;
+        size_t                      m_ArenaUsed = 0; // In the last block.
+    };
+} // VulkanDemo
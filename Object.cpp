@@ -1,18 +1,29 @@
 #include "Object.h"
 
-#include <sstream>
-
 namespace VulkanDemo
 {
-    Object::Object()
+    Object::Object() :
+        m_Name{ NameTable::EmptyName }
     {
-        static int sInstanceCounter = 0;
-        std::ostringstream oss;
-        oss << "Object" << sInstanceCounter++;
-        m_Name = oss.str();
     }
 
     Object::~Object()
     {
     }
+
+    void Object::SetName(NameId name)
+    {
+        if (name == m_Name)
+        {
+            return;
+        }
+
+        NameId oldName = m_Name;
+        m_Name = name;
+        OnNameChanged(oldName);
+    }
+
+    void Object::OnNameChanged(NameId oldName)
+    {
+    }
 } // VulkanDemo
@@ -2,6 +2,8 @@
 
 #include <string>
 
+#include "NameTable.h"
+
 namespace VulkanDemo
 {
     class Object
@@ -10,13 +12,26 @@ namespace VulkanDemo
         Object();
         virtual ~Object();
 
-        inline std::string const & GetName() const { return m_Name; }
-        inline void SetName(std::string const &name) { m_Name = name; }
+        ///
+        /// The name is interned in the NameTable. Objects have an empty name until one is assigned.
+        ///
+        inline NameId GetNameId() const { return m_Name; }
+        inline char const * GetName() const { return NameTable::GetInstance().GetString(m_Name); }
+
+        void SetName(NameId name);
+        inline void SetName(char const * name) { SetName(NameTable::GetInstance().Intern(name)); }
+        inline void SetName(std::string const & name) { SetName(NameTable::GetInstance().Intern(name)); }
+
+    protected:
+        ///
+        /// Called after the name changed.
+        ///
+        virtual void OnNameChanged(NameId oldName);
 
     private:
         Object(Object const &other) = delete;
         void operator=(Object const &other) = delete;
 
-        std::string m_Name;
+        NameId m_Name;
     };
 } // VulkanDemo
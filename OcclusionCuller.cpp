@@ -0,0 +1,528 @@
+#include "OcclusionCuller.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <utility>
+
+#include "MatrixKernels.h"
+#include "RenderSnapshot.h"
+#include "Shared.h"
+#include "ThreadPool.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define OCCLUSION_CULLER_X86 1
+#else
+#define OCCLUSION_CULLER_X86 0
+#endif
+
+#if OCCLUSION_CULLER_X86
+#include <immintrin.h>
+#endif
+
+namespace VulkanDemo
+{
+    namespace
+    {
+        // Tiles rasterized by a single task. The width is a multiple of the SIMD width.
+        const int32_t TileWidth = 64;
+        const int32_t TileHeight = 32;
+
+        // Corners of the faces of a box, counterclockwise seen from outside. Corner c is at the maximum of the box
+        // along x if (c & 1), along y if (c & 2), and along z if (c & 4).
+        const uint8_t FaceCorners[6][4] = {
+            { 0, 4, 6, 2 },
+            { 1, 3, 7, 5 },
+            { 0, 1, 5, 4 },
+            { 2, 6, 7, 3 },
+            { 0, 2, 3, 1 },
+            { 4, 5, 7, 6 },
+        };
+
+        inline float GetDistanceSquared(Aabb const & box, glm::vec3 const & point)
+        {
+            glm::vec3 offset = (glm::max)((glm::max)(box.min - point, glm::vec3{ 0 }), point - box.max);
+            return glm::dot(offset, offset);
+        }
+    }
+
+    OcclusionCuller::OcclusionCuller(uint32_t width, uint32_t height) :
+        m_Width{ ((std::max)(width, 1u) + 3) & ~3u },
+        m_Height{ (std::max)(height, 1u) }
+    {
+        m_TileCountX = (m_Width + TileWidth - 1) / TileWidth;
+        m_TileCountY = (m_Height + TileHeight - 1) / TileHeight;
+        m_TileFaces.resize(m_TileCountX * m_TileCountY);
+
+        glm::uvec2 size{ m_Width, m_Height };
+        while (true)
+        {
+            m_LevelSizes.push_back(size);
+            m_Levels.emplace_back(size.x * size.y, 0.0f);
+            if (size.x == 1 && size.y == 1)
+            {
+                break;
+            }
+            size = glm::uvec2{ (size.x + 1) / 2, (size.y + 1) / 2 };
+        }
+    }
+
+    OcclusionCuller::~OcclusionCuller()
+    {
+    }
+
+    void OcclusionCuller::RenderOccluders(RenderSnapshot const & snapshot, CameraSnapshot const & camera, float aspectRatio)
+    {
+        RenderOccluders(snapshot, camera, aspectRatio, ThreadPool::GetDefault());
+    }
+
+    void OcclusionCuller::RenderOccluders(RenderSnapshot const & snapshot, CameraSnapshot const & camera, float aspectRatio, ThreadPool & threadPool)
+    {
+        Clock::time_point start = Clock::now();
+        m_Stats = Stats{};
+
+        m_ViewProjection = camera.GetViewProjectionMatrix(aspectRatio);
+        SelectOccluders(snapshot, camera, Frustum::FromMatrix(m_ViewProjection));
+
+        uint32_t occluderCount = (uint32_t)m_Occluders.size();
+        m_Faces.resize(occluderCount * 6);
+        threadPool.ParallelFor(occluderCount, 1, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                SetupFaces(snapshot, m_Occluders[i], &m_Faces[i * 6]);
+            }
+        });
+
+        // Every tile gets the faces touching it.
+        for (std::vector<uint32_t> & faces : m_TileFaces)
+        {
+            faces.clear();
+        }
+        for (uint32_t i = 0; i < (uint32_t)m_Faces.size(); ++i)
+        {
+            Face const & face = m_Faces[i];
+            if (face.vertexCount == 0)
+            {
+                continue;
+            }
+
+            ++m_Stats.faceCount;
+            for (int32_t ty = face.minY / TileHeight; ty <= (face.maxY - 1) / TileHeight; ++ty)
+            {
+                for (int32_t tx = face.minX / TileWidth; tx <= (face.maxX - 1) / TileWidth; ++tx)
+                {
+                    m_TileFaces[ty * m_TileCountX + tx].push_back(i);
+                }
+            }
+        }
+
+        threadPool.ParallelFor((uint32_t)m_TileFaces.size(), 1, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t tile = begin; tile < end; ++tile)
+            {
+                RasterizeTile(tile);
+            }
+        });
+        m_Stats.occluderCount = occluderCount;
+
+        Clock::time_point rasterizeEnd = Clock::now();
+        m_Stats.rasterizeTime = GetMilliseconds(start, rasterizeEnd);
+
+        BuildHierarchy(threadPool);
+        m_Stats.hierarchyTime = GetMilliseconds(rasterizeEnd, Clock::now());
+    }
+
+    void OcclusionCuller::SelectOccluders(RenderSnapshot const & snapshot, CameraSnapshot const & camera, Frustum const & frustum)
+    {
+        // The occluders in view are ranked by their size over their distance, squared, which favors the ones covering
+        // the most pixels.
+        std::vector<OccluderSnapshot> const & occluders = snapshot.GetOccluders();
+        std::vector<std::pair<float, uint32_t>> scores;
+        scores.reserve(occluders.size());
+        for (uint32_t i = 0; i < (uint32_t)occluders.size(); ++i)
+        {
+            Aabb bounds = occluders[i].bounds.Transformed(snapshot.GetWorldMatrices()[occluders[i].object]);
+            if (!frustum.Intersects(bounds))
+            {
+                continue;
+            }
+
+            glm::vec3 extents = bounds.GetExtents();
+            float distanceSquared = (std::max)(GetDistanceSquared(bounds, camera.position), camera.nearPlane * camera.nearPlane);
+            scores.push_back(std::make_pair(glm::dot(extents, extents) / distanceSquared, i));
+        }
+
+        if (scores.size() > m_MaxOccluderCount)
+        {
+            std::nth_element(scores.begin(), scores.begin() + m_MaxOccluderCount, scores.end(), [](std::pair<float, uint32_t> const & a, std::pair<float, uint32_t> const & b) {
+                return a.first > b.first;
+            });
+            scores.resize(m_MaxOccluderCount);
+        }
+
+        m_Occluders.clear();
+        for (auto const & score : scores)
+        {
+            m_Occluders.push_back(score.second);
+        }
+    }
+
+    void OcclusionCuller::SetupFaces(RenderSnapshot const & snapshot, uint32_t occluder, Face * faces) const
+    {
+        OccluderSnapshot const & snapshotOccluder = snapshot.GetOccluders()[occluder];
+        glm::mat4 const & worldMatrix = snapshot.GetWorldMatrices()[snapshotOccluder.object];
+        glm::mat4 matrix = m_ViewProjection * worldMatrix;
+
+        Aabb const & box = snapshotOccluder.bounds;
+        glm::vec4 corners[8];
+        for (int c = 0; c < 8; ++c)
+        {
+            glm::vec3 corner{ (c & 1) ? box.max.x : box.min.x, (c & 2) ? box.max.y : box.min.y, (c & 4) ? box.max.z : box.min.z };
+            corners[c] = matrix * glm::vec4{ corner, 1 };
+        }
+
+        // Seen from the front, the faces are counterclockwise with y going up, so clockwise on the screen, unless the
+        // transform mirrors them.
+        bool isMirrored = glm::determinant(glm::mat3{ worldMatrix }) < 0;
+
+        for (int f = 0; f < 6; ++f)
+        {
+            Face & face = faces[f];
+            face.vertexCount = 0;
+
+            // Clips the face by the near plane, z >= 0 in clip space.
+            glm::vec4 clipped[MaxFaceVertexCount];
+            uint32_t clippedCount = 0;
+            for (int k = 0; k < 4; ++k)
+            {
+                glm::vec4 const & current = corners[FaceCorners[f][k]];
+                glm::vec4 const & next = corners[FaceCorners[f][(k + 1) % 4]];
+                float currentDistance = current.z;
+                float nextDistance = next.z;
+                if (currentDistance >= 0)
+                {
+                    clipped[clippedCount++] = current;
+                }
+                if ((currentDistance >= 0) != (nextDistance >= 0))
+                {
+                    clipped[clippedCount++] = current + (next - current) * (currentDistance / (currentDistance - nextDistance));
+                }
+            }
+            if (clippedCount < 3)
+            {
+                continue;
+            }
+
+            float x[MaxFaceVertexCount];
+            float y[MaxFaceVertexCount];
+            float z[MaxFaceVertexCount];
+            float area = 0;
+            for (uint32_t k = 0; k < clippedCount; ++k)
+            {
+                float inverseW = 1 / clipped[k].w;
+                x[k] = (clipped[k].x * inverseW * 0.5f + 0.5f) * m_Width;
+                y[k] = (0.5f - clipped[k].y * inverseW * 0.5f) * m_Height;
+                z[k] = inverseW;
+            }
+            for (uint32_t k = 0; k < clippedCount; ++k)
+            {
+                uint32_t next = (k + 1) % clippedCount;
+                area += x[k] * y[next] - x[next] * y[k];
+            }
+
+            bool isFront = isMirrored ? area > 0 : area < 0;
+            if (!isFront)
+            {
+                continue;
+            }
+
+            // The vertices are stored counterclockwise on the screen, so that the inside of every edge is on its left.
+            for (uint32_t k = 0; k < clippedCount; ++k)
+            {
+                uint32_t source = area < 0 ? clippedCount - 1 - k : k;
+                face.x[k] = x[source];
+                face.y[k] = y[source];
+            }
+
+            // The inverse depth is linear on the screen. Its plane is taken from the largest triangle of the fan.
+            uint32_t best = 1;
+            float bestDeterminant = 0;
+            for (uint32_t k = 1; k + 1 < clippedCount; ++k)
+            {
+                float determinant = (x[k] - x[0]) * (y[k + 1] - y[0]) - (x[k + 1] - x[0]) * (y[k] - y[0]);
+                if (std::abs(determinant) > std::abs(bestDeterminant))
+                {
+                    bestDeterminant = determinant;
+                    best = k;
+                }
+            }
+            if (bestDeterminant == 0)
+            {
+                continue;
+            }
+
+            float dx1 = x[best] - x[0];
+            float dy1 = y[best] - y[0];
+            float dz1 = z[best] - z[0];
+            float dx2 = x[best + 1] - x[0];
+            float dy2 = y[best + 1] - y[0];
+            float dz2 = z[best + 1] - z[0];
+            face.a = (dz1 * dy2 - dz2 * dy1) / bestDeterminant;
+            face.b = (dx1 * dz2 - dx2 * dz1) / bestDeterminant;
+            face.c = z[0] - face.a * x[0] - face.b * y[0];
+
+            float minX = face.x[0];
+            float maxX = face.x[0];
+            float minY = face.y[0];
+            float maxY = face.y[0];
+            for (uint32_t k = 1; k < clippedCount; ++k)
+            {
+                minX = (std::min)(minX, face.x[k]);
+                maxX = (std::max)(maxX, face.x[k]);
+                minY = (std::min)(minY, face.y[k]);
+                maxY = (std::max)(maxY, face.y[k]);
+            }
+            face.minX = (int32_t)(std::max)(std::floor(minX), 0.0f);
+            face.maxX = (int32_t)(std::min)(std::ceil(maxX), (float)m_Width);
+            face.minY = (int32_t)(std::max)(std::floor(minY), 0.0f);
+            face.maxY = (int32_t)(std::min)(std::ceil(maxY), (float)m_Height);
+            if (face.minX < face.maxX && face.minY < face.maxY)
+            {
+                face.vertexCount = clippedCount;
+            }
+        }
+    }
+
+    void OcclusionCuller::RasterizeTile(uint32_t tile)
+    {
+        int32_t tileMinX = (int32_t)(tile % m_TileCountX) * TileWidth;
+        int32_t tileMinY = (int32_t)(tile / m_TileCountX) * TileHeight;
+        int32_t tileMaxX = (std::min)(tileMinX + TileWidth, (int32_t)m_Width);
+        int32_t tileMaxY = (std::min)(tileMinY + TileHeight, (int32_t)m_Height);
+
+        float * depths = m_Levels[0].data();
+        for (int32_t y = tileMinY; y < tileMaxY; ++y)
+        {
+            std::fill(depths + y * m_Width + tileMinX, depths + y * m_Width + tileMaxX, 0.0f);
+        }
+
+        bool isScalar = MatrixKernels::GetIsa() == MatrixKernels::Isa::Scalar;
+        for (uint32_t index : m_TileFaces[tile])
+        {
+            Face const & face = m_Faces[index];
+
+            // The groups of 4 pixels start on multiples of 4, which the tiles do too.
+            int32_t minX = (std::max)(face.minX, tileMinX) & ~3;
+            int32_t maxX = (std::min)(face.maxX, tileMaxX);
+            int32_t minY = (std::max)(face.minY, tileMinY);
+            int32_t maxY = (std::min)(face.maxY, tileMaxY);
+
+            // Edge functions a * x + b * y + c, positive inside. They are lowered by their largest variation within half
+            // a pixel, so that they are only positive at the centers of the pixels entirely inside the face. Likewise,
+            // the depth is the farthest within the pixel.
+            float edgeA[MaxFaceVertexCount];
+            float edgeB[MaxFaceVertexCount];
+            float edgeC[MaxFaceVertexCount];
+            uint32_t edgeCount = face.vertexCount;
+            for (uint32_t k = 0; k < edgeCount; ++k)
+            {
+                uint32_t next = (k + 1) % edgeCount;
+                edgeA[k] = face.y[k] - face.y[next];
+                edgeB[k] = face.x[next] - face.x[k];
+                edgeC[k] = -(edgeA[k] * face.x[k] + edgeB[k] * face.y[k]) - 0.5f * (std::abs(edgeA[k]) + std::abs(edgeB[k]));
+            }
+            float depthC = face.c - 0.5f * (std::abs(face.a) + std::abs(face.b));
+
+#if OCCLUSION_CULLER_X86
+            if (!isScalar)
+            {
+                __m128 const offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+                __m128 const zero = _mm_setzero_ps();
+                for (int32_t y = minY; y < maxY; ++y)
+                {
+                    float centerY = y + 0.5f;
+                    float * row = depths + y * m_Width;
+
+                    __m128 rowEdges[MaxFaceVertexCount];
+                    for (uint32_t k = 0; k < edgeCount; ++k)
+                    {
+                        rowEdges[k] = _mm_set1_ps(edgeB[k] * centerY + edgeC[k]);
+                    }
+                    __m128 rowDepth = _mm_set1_ps(face.b * centerY + depthC);
+
+                    for (int32_t x = minX; x < maxX; x += 4)
+                    {
+                        __m128 centerX = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+                        __m128 inside = _mm_cmpeq_ps(zero, zero);
+                        for (uint32_t k = 0; k < edgeCount; ++k)
+                        {
+                            __m128 edge = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(edgeA[k]), centerX), rowEdges[k]);
+                            inside = _mm_and_ps(inside, _mm_cmpge_ps(edge, zero));
+                        }
+
+                        // Masked out pixels get 0, which never wins over the stored depth.
+                        __m128 depth = _mm_and_ps(inside, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(face.a), centerX), rowDepth));
+                        _mm_store_ps(row + x, _mm_max_ps(_mm_load_ps(row + x), depth));
+                    }
+                }
+                continue;
+            }
+#endif
+
+            for (int32_t y = minY; y < maxY; ++y)
+            {
+                float centerY = y + 0.5f;
+                float * row = depths + y * m_Width;
+                for (int32_t x = minX; x < maxX; ++x)
+                {
+                    float centerX = x + 0.5f;
+                    bool isInside = true;
+                    for (uint32_t k = 0; k < edgeCount; ++k)
+                    {
+                        isInside = isInside && edgeA[k] * centerX + (edgeB[k] * centerY + edgeC[k]) >= 0;
+                    }
+                    if (isInside)
+                    {
+                        row[x] = (std::max)(row[x], face.a * centerX + (face.b * centerY + depthC));
+                    }
+                }
+            }
+        }
+    }
+
+    void OcclusionCuller::BuildHierarchy(ThreadPool & threadPool)
+    {
+        for (size_t level = 1; level < m_Levels.size(); ++level)
+        {
+            glm::uvec2 sourceSize = m_LevelSizes[level - 1];
+            glm::uvec2 size = m_LevelSizes[level];
+            float const * source = m_Levels[level - 1].data();
+            float * destination = m_Levels[level].data();
+
+            threadPool.ParallelFor(size.y, 1, [&](uint32_t begin, uint32_t end) {
+                for (uint32_t y = begin; y < end; ++y)
+                {
+                    uint32_t y0 = 2 * y;
+                    uint32_t y1 = (std::min)(y0 + 1, sourceSize.y - 1);
+                    for (uint32_t x = 0; x < size.x; ++x)
+                    {
+                        uint32_t x0 = 2 * x;
+                        uint32_t x1 = (std::min)(x0 + 1, sourceSize.x - 1);
+                        float farthest = (std::min)(source[y0 * sourceSize.x + x0], source[y0 * sourceSize.x + x1]);
+                        farthest = (std::min)(farthest, (std::min)(source[y1 * sourceSize.x + x0], source[y1 * sourceSize.x + x1]));
+                        destination[y * size.x + x] = farthest;
+                    }
+                }
+            });
+        }
+    }
+
+    bool OcclusionCuller::IsOccluded(Aabb const & box) const
+    {
+        float minX = (std::numeric_limits<float>::max)();
+        float maxX = -(std::numeric_limits<float>::max)();
+        float minY = minX;
+        float maxY = maxX;
+        float nearest = 0;
+        for (int c = 0; c < 8; ++c)
+        {
+            glm::vec3 corner{ (c & 1) ? box.max.x : box.min.x, (c & 2) ? box.max.y : box.min.y, (c & 4) ? box.max.z : box.min.z };
+            glm::vec4 position = m_ViewProjection * glm::vec4{ corner, 1 };
+            if (position.z < 0 || position.w <= 0)
+            {
+                // Crosses the near plane.
+                return false;
+            }
+
+            float inverseW = 1 / position.w;
+            float x = (position.x * inverseW * 0.5f + 0.5f) * m_Width;
+            float y = (0.5f - position.y * inverseW * 0.5f) * m_Height;
+            minX = (std::min)(minX, x);
+            maxX = (std::max)(maxX, x);
+            minY = (std::min)(minY, y);
+            maxY = (std::max)(maxY, y);
+            nearest = (std::max)(nearest, inverseW);
+        }
+
+        // The boxes off the screen are left to the frustum culling.
+        if (maxX < 0 || minX >= m_Width || maxY < 0 || minY >= m_Height)
+        {
+            return false;
+        }
+
+        uint32_t x0 = (uint32_t)(std::max)(minX, 0.0f);
+        uint32_t x1 = (std::min)((uint32_t)(std::max)(maxX, 0.0f), m_Width - 1);
+        uint32_t y0 = (uint32_t)(std::max)(minY, 0.0f);
+        uint32_t y1 = (std::min)((uint32_t)(std::max)(maxY, 0.0f), m_Height - 1);
+
+        // The finest level at which the pixels of the box are within 2x2 texels.
+        uint32_t level = 0;
+        while (level + 1 < m_Levels.size() && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1))
+        {
+            ++level;
+        }
+
+        glm::uvec2 size = m_LevelSizes[level];
+        float const * depths = m_Levels[level].data();
+        float farthest = (std::numeric_limits<float>::max)();
+        for (uint32_t y = y0 >> level; y <= y1 >> level; ++y)
+        {
+            for (uint32_t x = x0 >> level; x <= x1 >> level; ++x)
+            {
+                farthest = (std::min)(farthest, depths[y * size.x + x]);
+            }
+        }
+        return nearest < farthest;
+    }
+
+    Span<uint32_t const> OcclusionCuller::Cull(Span<uint32_t const> candidates, Aabb const * bounds)
+    {
+        return Cull(candidates, bounds, ThreadPool::GetDefault());
+    }
+
+    Span<uint32_t const> OcclusionCuller::Cull(Span<uint32_t const> candidates, Aabb const * bounds, ThreadPool & threadPool)
+    {
+        Clock::time_point start = Clock::now();
+
+        uint32_t count = (uint32_t)candidates.size();
+        m_IsVisible.resize(count);
+        threadPool.ParallelFor(count, 64, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                m_IsVisible[i] = IsOccluded(bounds[candidates[i]]) ? 0 : 1;
+            }
+        });
+
+        m_Visible.clear();
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            if (m_IsVisible[i] != 0)
+            {
+                m_Visible.push_back(candidates[i]);
+            }
+        }
+
+        m_Stats.testedCount = count;
+        m_Stats.occludedCount = count - (uint32_t)m_Visible.size();
+        m_Stats.testTime = GetMilliseconds(start, Clock::now());
+        return Span<uint32_t const>{ m_Visible.data(), m_Visible.size() };
+    }
+
+    void OcclusionCuller::PrintStats() const
+    {
+        double cullRate = m_Stats.testedCount != 0 ? 100.0 * m_Stats.occludedCount / m_Stats.testedCount : 0;
+        StatsRows rows = {
+            { "Depth buffer", std::to_string(m_Width) + "x" + std::to_string(m_Height) },
+            { "Occluders", std::to_string(m_Stats.occluderCount) },
+            { "Front faces", std::to_string(m_Stats.faceCount) },
+            { "Objects tested", std::to_string(m_Stats.testedCount) },
+            { "Objects occluded", std::to_string(m_Stats.occludedCount) },
+            { "Cull rate (%)", FormatStat(cullRate) },
+            { "Rasterization (ms)", FormatStat(m_Stats.rasterizeTime) },
+            { "Hierarchy (ms)", FormatStat(m_Stats.hierarchyTime) },
+            { "Tests (ms)", FormatStat(m_Stats.testTime) },
+            { "Total (ms)", FormatStat(m_Stats.rasterizeTime + m_Stats.hierarchyTime + m_Stats.testTime) },
+        };
+
+        PrintStatsTable("Occlusion culling", rows);
+    }
+} // VulkanDemo
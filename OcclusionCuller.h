@@ -0,0 +1,144 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "AlignedAllocator.h"
+#include "Bounds.h"
+#include "Span.h"
+
+namespace VulkanDemo
+{
+    class RenderSnapshot;
+    class ThreadPool;
+    struct CameraSnapshot;
+
+    ///
+    /// Finds the objects hidden behind occluders, on the CPU.
+    ///
+    /// RenderOccluders() picks the occluders of a snapshot that cover the most of the view, and rasterizes the front
+    /// faces of their boxes into a low resolution buffer of inverse view depths (1 / w, 0 being infinitely far), in
+    /// tiles processed in parallel, 4 pixels at a time with SSE. Every level of the hierarchy built on top of it keeps
+    /// the farthest depth of the 2x2 texels below. Cull() then projects the bounds of every candidate object, and
+    /// discards the ones whose nearest point is behind the farthest occluder of the at most 2x2 texels covering them.
+    ///
+    /// The test is conservative: a pixel is only covered by an occluder face that covers it entirely, at the farthest
+    /// depth of the face within the pixel, and the objects crossing the near plane are kept.
+    ///
+    /// Usage Notes:
+    /// - RenderOccluders() and Cull() must not be called from a ThreadPool::ParallelFor().
+    ///
+    class OcclusionCuller
+    {
+    public:
+        struct Stats
+        {
+            uint32_t occluderCount = 0;     // Rasterized occluders.
+            uint32_t faceCount = 0;         // Rasterized front faces.
+            uint32_t testedCount = 0;
+            uint32_t occludedCount = 0;
+            double rasterizeTime = 0;       // In milliseconds, as the times below.
+            double hierarchyTime = 0;
+            double testTime = 0;
+        };
+
+        ///
+        /// @param[in] width, height    Size of the depth buffer. The width is rounded up to a multiple of 4.
+        ///
+        OcclusionCuller(uint32_t width = 256, uint32_t height = 128);
+        ~OcclusionCuller();
+
+        ///
+        /// Sets the number of occluders rasterized per frame. Defaults to 256.
+        ///
+        inline void SetMaxOccluderCount(uint32_t maxOccluderCount) { m_MaxOccluderCount = maxOccluderCount; }
+
+        ///
+        /// Rasterizes the occluders of the snapshot seen from the camera, and builds the depth hierarchy.
+        ///
+        void RenderOccluders(RenderSnapshot const & snapshot, CameraSnapshot const & camera, float aspectRatio);
+        void RenderOccluders(RenderSnapshot const & snapshot, CameraSnapshot const & camera, float aspectRatio, ThreadPool & threadPool);
+
+        ///
+        /// Returns the candidates whose bounds are not hidden by the occluders, in their order. The candidates are
+        /// indices in the bounds, typically the objects left by the frustum culling. The result is valid until the next
+        /// call.
+        ///
+        Span<uint32_t const> Cull(Span<uint32_t const> candidates, Aabb const * bounds);
+        Span<uint32_t const> Cull(Span<uint32_t const> candidates, Aabb const * bounds, ThreadPool & threadPool);
+
+        ///
+        /// Tells whether the box is hidden by the occluders rendered last.
+        ///
+        bool IsOccluded(Aabb const & box) const;
+
+        inline uint32_t GetWidth() const { return m_Width; }
+        inline uint32_t GetHeight() const { return m_Height; }
+
+        ///
+        /// Returns the inverse depth of the pixel, x going right and y going down. 0 when no occluder covers it.
+        ///
+        inline float GetInverseDepth(uint32_t x, uint32_t y) const { return m_Levels[0][y * m_Width + x]; }
+
+        ///
+        /// Returns the statistics of the last frame.
+        ///
+        inline Stats const & GetStats() const { return m_Stats; }
+        void PrintStats() const;
+
+    private:
+        OcclusionCuller(OcclusionCuller const & other) = delete;
+        void operator=(OcclusionCuller const & other) = delete;
+
+        static const uint32_t MaxFaceVertexCount = 5;
+
+        ///
+        /// Face of an occluder in screen space, clipped by the near plane.
+        ///
+        struct Face
+        {
+            float x[MaxFaceVertexCount];
+            float y[MaxFaceVertexCount];
+            uint32_t vertexCount;   // 0 for the back faces and the faces behind the camera.
+
+            // Inverse depth: a * x + b * y + c.
+            float a;
+            float b;
+            float c;
+
+            // Pixels touched, as [minX, maxX) x [minY, maxY).
+            int32_t minX;
+            int32_t maxX;
+            int32_t minY;
+            int32_t maxY;
+        };
+
+        void SelectOccluders(RenderSnapshot const & snapshot, CameraSnapshot const & camera, Frustum const & frustum);
+        void SetupFaces(RenderSnapshot const & snapshot, uint32_t occluder, Face * faces) const;
+        void RasterizeTile(uint32_t tile);
+        void BuildHierarchy(ThreadPool & threadPool);
+
+        uint32_t m_Width;
+        uint32_t m_Height;
+        uint32_t m_TileCountX;
+        uint32_t m_TileCountY;
+        uint32_t m_MaxOccluderCount = 256;
+
+        glm::mat4 m_ViewProjection;
+
+        // Level 0 is the depth buffer. Each level has half the size of the previous one, rounded up.
+        std::vector<AlignedVector<float>>   m_Levels;
+        std::vector<glm::uvec2>             m_LevelSizes;
+
+        // Scratch of the frame.
+        std::vector<uint32_t>               m_Occluders;    // Indices in the occluders of the snapshot.
+        std::vector<Face>                   m_Faces;        // 6 per occluder.
+        std::vector<std::vector<uint32_t>>  m_TileFaces;
+        std::vector<uint8_t>                m_IsVisible;
+        std::vector<uint32_t>               m_Visible;
+
+        Stats m_Stats;
+    };
+} // VulkanDemo
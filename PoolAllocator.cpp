@@ -0,0 +1,210 @@
+#include "PoolAllocator.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace VulkanDemo
+{
+    PoolAllocator::PoolAllocator(char const * name, size_t slotSize, size_t slotAlignment, uint32_t slotsPerBlock) :
+        m_Name{ name },
+        m_SlotSize{ std::max(slotSize, sizeof(FreeSlot)) },
+        m_SlotsPerBlock{ slotsPerBlock }
+    {
+        assert(slotAlignment <= alignof(std::max_align_t));
+        assert(m_SlotSize % slotAlignment == 0);
+
+        std::lock_guard<std::mutex> lock{ GetRegistryMutex() };
+        GetRegistry().push_back(this);
+    }
+
+    PoolAllocator::~PoolAllocator()
+    {
+        {
+            std::lock_guard<std::mutex> lock{ GetRegistryMutex() };
+            auto & registry = GetRegistry();
+            registry.erase(std::find(registry.begin(), registry.end(), this));
+        }
+
+        assert(m_Stats.liveObjects == 0);
+        for (auto const & block : m_Blocks)
+        {
+            ::operator delete(block.begin);
+        }
+    }
+
+    void * PoolAllocator::Allocate()
+    {
+        std::lock_guard<std::mutex> lock{ m_Mutex };
+
+        auto hasRoom = [](Block const & block) { return block.freeList != nullptr || block.cursor != block.end; };
+
+        if (m_CurrentBlock >= m_Blocks.size() || !hasRoom(m_Blocks[m_CurrentBlock]))
+        {
+            auto iter = std::find_if(m_Blocks.begin(), m_Blocks.end(), hasRoom);
+            if (iter != m_Blocks.end())
+            {
+                m_CurrentBlock = iter - m_Blocks.begin();
+            }
+            else
+            {
+                AddBlock(m_SlotsPerBlock);
+            }
+        }
+
+        Block & block = m_Blocks[m_CurrentBlock];
+        void * slot;
+        if (block.freeList != nullptr)
+        {
+            slot = block.freeList;
+            block.freeList = block.freeList->next;
+        }
+        else
+        {
+            slot = block.cursor;
+            block.cursor += m_SlotSize;
+        }
+
+        ++block.liveCount;
+        OnAllocated(1);
+        return slot;
+    }
+
+    void PoolAllocator::Free(void * slot)
+    {
+        if (slot == nullptr)
+        {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock{ m_Mutex };
+
+        Block & block = FindBlock(slot);
+        FreeSlot * freeSlot = static_cast<FreeSlot *>(slot);
+        freeSlot->next = block.freeList;
+        block.freeList = freeSlot;
+        OnFreed(block, 1);
+    }
+
+    void * PoolAllocator::AllocateContiguous(uint32_t count)
+    {
+        if (count == 0)
+        {
+            return nullptr;
+        }
+
+        std::lock_guard<std::mutex> lock{ m_Mutex };
+
+        // First fit among the untouched ends of the blocks.
+        size_t size = count * m_SlotSize;
+        auto iter = std::find_if(m_Blocks.begin(), m_Blocks.end(), [size](Block const & block) {
+            return (size_t)(block.end - block.cursor) >= size;
+        });
+        Block & block = iter != m_Blocks.end() ? *iter : AddBlock(std::max(count, m_SlotsPerBlock));
+
+        void * slots = block.cursor;
+        block.cursor += size;
+        block.liveCount += count;
+        OnAllocated(count);
+        return slots;
+    }
+
+    void PoolAllocator::FreeContiguous(void * slots, uint32_t count)
+    {
+        if (slots == nullptr || count == 0)
+        {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock{ m_Mutex };
+
+        Block & block = FindBlock(slots);
+        uint8_t * first = static_cast<uint8_t *>(slots);
+        assert(first + count * m_SlotSize <= block.end);
+
+        // Chain the slots in address order, so that the next allocations walk through memory linearly.
+        FreeSlot * next = block.freeList;
+        for (uint32_t i = count; i > 0; --i)
+        {
+            FreeSlot * freeSlot = reinterpret_cast<FreeSlot *>(first + (i - 1) * m_SlotSize);
+            freeSlot->next = next;
+            next = freeSlot;
+        }
+        block.freeList = next;
+        OnFreed(block, count);
+    }
+
+    PoolAllocator::Stats PoolAllocator::GetStats() const
+    {
+        std::lock_guard<std::mutex> lock{ m_Mutex };
+        return m_Stats;
+    }
+
+    PoolAllocator::Block & PoolAllocator::AddBlock(uint32_t slotCount)
+    {
+        size_t blockSize = slotCount * m_SlotSize;
+
+        Block block;
+        block.begin = static_cast<uint8_t *>(::operator new(blockSize));
+        block.end = block.begin + blockSize;
+        block.cursor = block.begin;
+        block.freeList = nullptr;
+        block.liveCount = 0;
+
+        auto iter = std::upper_bound(m_Blocks.begin(), m_Blocks.end(), block.begin, [](uint8_t const * begin, Block const & other) {
+            return begin < other.begin;
+        });
+        iter = m_Blocks.insert(iter, block);
+        m_CurrentBlock = iter - m_Blocks.begin();
+
+        m_Stats.reservedBytes += blockSize;
+        m_Stats.blockCount = m_Blocks.size();
+
+        return m_Blocks[m_CurrentBlock];
+    }
+
+    PoolAllocator::Block & PoolAllocator::FindBlock(void const * slot)
+    {
+        auto iter = std::upper_bound(m_Blocks.begin(), m_Blocks.end(), static_cast<uint8_t const *>(slot), [](uint8_t const * address, Block const & block) {
+            return address < block.begin;
+        });
+        assert(iter != m_Blocks.begin());
+        --iter;
+        assert(static_cast<uint8_t const *>(slot) < iter->end);
+        return *iter;
+    }
+
+    void PoolAllocator::OnAllocated(uint32_t count)
+    {
+        m_Stats.liveObjects += count;
+        m_Stats.liveBytes += count * m_SlotSize;
+        m_Stats.peakLiveObjects = std::max(m_Stats.peakLiveObjects, m_Stats.liveObjects);
+        m_Stats.peakLiveBytes = std::max(m_Stats.peakLiveBytes, m_Stats.liveBytes);
+    }
+
+    void PoolAllocator::OnFreed(Block & block, uint32_t count)
+    {
+        assert(block.liveCount >= count);
+        block.liveCount -= count;
+        if (block.liveCount == 0)
+        {
+            // The whole block is available again for batches.
+            block.cursor = block.begin;
+            block.freeList = nullptr;
+        }
+
+        m_Stats.liveObjects -= count;
+        m_Stats.liveBytes -= count * m_SlotSize;
+    }
+
+    std::vector<PoolAllocator *> & PoolAllocator::GetRegistry()
+    {
+        static std::vector<PoolAllocator *> registry;
+        return registry;
+    }
+
+    std::mutex & PoolAllocator::GetRegistryMutex()
+    {
+        static std::mutex mutex;
+        return mutex;
+    }
+} // VulkanDemo
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace VulkanDemo
+{
+    ///
+    /// Allocator of fixed-size slots, carved out of large blocks.
+    ///
+    /// Every block keeps its own free list and count of live slots. Batches of contiguous slots are carved from the
+    /// untouched end of a block, or from a dedicated block when they don't fit, so a batch is laid out like an array
+    /// whose elements can still be freed one by one. A block whose slots are all freed becomes untouched again and can
+    /// host new batches. Blocks are only released when the pool is destroyed.
+    ///
+    /// All the methods are thread-safe.
+    ///
+    class PoolAllocator
+    {
+    public:
+        struct Stats
+        {
+            size_t liveObjects = 0;
+            size_t liveBytes = 0;
+            size_t reservedBytes = 0;
+            size_t peakLiveObjects = 0;
+            size_t peakLiveBytes = 0;
+            size_t blockCount = 0;
+        };
+
+        ///
+        /// @param[in] name             Name reported in the statistics. Must outlive the pool.
+        /// @param[in] slotSize         Size of a slot, a multiple of the alignment.
+        /// @param[in] slotAlignment    Alignment of the slots, at most the one of the default operator new.
+        /// @param[in] slotsPerBlock    Number of slots reserved at once when the pool runs out of memory.
+        ///
+        PoolAllocator(char const * name, size_t slotSize, size_t slotAlignment, uint32_t slotsPerBlock = 1024);
+        ~PoolAllocator();
+
+        void * Allocate();
+        void Free(void * slot);
+
+        ///
+        /// Allocates count contiguous slots, spaced by the slot size.
+        ///
+        void * AllocateContiguous(uint32_t count);
+
+        ///
+        /// Frees count contiguous slots, such as a batch returned by AllocateContiguous().
+        ///
+        void FreeContiguous(void * slots, uint32_t count);
+
+        inline char const * GetName() const { return m_Name; }
+        inline size_t GetSlotSize() const { return m_SlotSize; }
+
+        Stats GetStats() const;
+
+        ///
+        /// Calls the function for every pool alive, in creation order.
+        ///
+        template<typename Function>
+        static void ForEachPool(Function function)
+        {
+            std::lock_guard<std::mutex> lock{ GetRegistryMutex() };
+            for (auto pool : GetRegistry())
+            {
+                function(*pool);
+            }
+        }
+
+    private:
+        PoolAllocator(PoolAllocator const & other) = delete;
+        void operator=(PoolAllocator const & other) = delete;
+
+        struct FreeSlot
+        {
+            FreeSlot * next;
+        };
+
+        struct Block
+        {
+            uint8_t *   begin;
+            uint8_t *   end;
+            uint8_t *   cursor;     // Start of the untouched slots.
+            FreeSlot *  freeList;   // Freed slots before the cursor.
+            uint32_t    liveCount;
+        };
+
+        ///
+        /// The mutex must be locked for all the following methods.
+        ///
+        Block & AddBlock(uint32_t slotCount);
+        Block & FindBlock(void const * slot);
+        void OnAllocated(uint32_t count);
+        void OnFreed(Block & block, uint32_t count);
+
+        static std::vector<PoolAllocator *> & GetRegistry();
+        static std::mutex & GetRegistryMutex();
+
+        char const *            m_Name;
+        size_t                  m_SlotSize;
+        uint32_t                m_SlotsPerBlock;
+
+        mutable std::mutex      m_Mutex;
+        std::vector<Block>      m_Blocks;           // Sorted by address.
+        size_t                  m_CurrentBlock = 0; // Block used by Allocate() until it is full.
+        Stats                   m_Stats;
+    };
+
+    ///
+    /// Base class routing the allocations of T through a pool reserved to T.
+    ///
+    /// Usage Notes:
+    /// - Derive T from Pooled<T>, and declare a static constexpr PoolName string in T. Classes deriving from T have a
+    ///   different size, and fall back to the default heap.
+    /// - Arrays of T can't be created with new[]: use CreateBatch() instead. The objects of a batch can be destroyed
+    ///   together with DestroyBatch(), or one by one with delete.
+    ///
+    template<typename T>
+    class Pooled
+    {
+    public:
+        static void * operator new(size_t size)
+        {
+            return size == sizeof(T) ? GetPool().Allocate() : ::operator new(size);
+        }
+
+        static void operator delete(void * pointer, size_t size)
+        {
+            if (size == sizeof(T))
+            {
+                GetPool().Free(pointer);
+            }
+            else
+            {
+                ::operator delete(pointer);
+            }
+        }
+
+        static void * operator new[](size_t size) = delete;
+        static void operator delete[](void * pointer) = delete;
+
+        ///
+        /// Default-constructs count objects in contiguous slots.
+        ///
+        static T * CreateBatch(uint32_t count)
+        {
+            T * objects = static_cast<T *>(GetPool().AllocateContiguous(count));
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                ::new (objects + i) T();
+            }
+            return objects;
+        }
+
+        ///
+        /// Destroys count objects created by CreateBatch(), in reverse order, and frees their slots at once.
+        ///
+        static void DestroyBatch(T * objects, uint32_t count)
+        {
+            for (uint32_t i = count; i > 0; --i)
+            {
+                objects[i - 1].~T();
+            }
+            GetPool().FreeContiguous(objects, count);
+        }
+
+        static PoolAllocator & GetPool()
+        {
+            // Never destroyed, so that objects outliving the static destructors can still be freed.
+            static PoolAllocator * pool = new PoolAllocator(T::PoolName, sizeof(T), alignof(T));
+            return *pool;
+        }
+    };
+} // VulkanDemo
@@ -0,0 +1,350 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "RenderSnapshot.h"
+#include "Shared.h"
+#include "ThreadPool.h"
+
+namespace VulkanDemo
+{
+    namespace
+    {
+        const uint32_t DepthBits = 18;
+        const uint32_t PipelineBits = 10;
+        const uint32_t MaterialBits = 14;
+        const uint32_t MeshBits = 16;
+        const uint32_t LevelBits = 4;
+
+        const uint32_t RadixBits = 8;
+        const uint32_t DigitCount = 1 << RadixBits;
+        const uint32_t ByteCount = 8;
+
+        // Below this number of keys per thread, splitting the sort costs more than it saves.
+        const uint32_t MinKeysPerChunk = 16384;
+
+        inline uint64_t Field(uint32_t value, uint32_t bits)
+        {
+            return value & ((1u << bits) - 1);
+        }
+
+        ///
+        /// Returns the exponent and the top of the mantissa of the depth, which sort as the depth does since it is
+        /// positive.
+        ///
+        inline uint32_t QuantizeDepth(float depth)
+        {
+            depth = (std::max)(depth, 0.0f);
+            uint32_t bits;
+            memcpy(&bits, &depth, sizeof(bits));
+            return bits >> (31 - DepthBits);
+        }
+
+        inline uint32_t GetDigit(uint64_t key, uint32_t byte)
+        {
+            return (uint32_t)(key >> (byte * RadixBits)) & (DigitCount - 1);
+        }
+
+        ///
+        /// Counts the changes of state from the previous draw, which is null for the first draw of the frame.
+        ///
+        inline void CountStateChange(RenderQueue::Draw const & draw, RenderQueue::Draw const * previous, RenderQueue::StateChanges & changes)
+        {
+            changes.pipelineCount += previous == nullptr || draw.pipeline != previous->pipeline ? 1 : 0;
+            changes.materialCount += previous == nullptr || draw.material != previous->material ? 1 : 0;
+            changes.meshCount += previous == nullptr || draw.mesh != previous->mesh ? 1 : 0;
+        }
+
+        // The passes of the radix sort take their arrays as arguments, so that the compiler knows that the counters
+        // don't alias the loop bounds.
+
+        void CountAllDigits(uint64_t const * keys, uint32_t begin, uint32_t end, uint32_t * histograms)
+        {
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                uint64_t key = keys[i];
+                for (uint32_t byte = 0; byte < ByteCount; ++byte)
+                {
+                    ++histograms[byte * DigitCount + GetDigit(key, byte)];
+                }
+            }
+        }
+
+        void CountDigits(uint64_t const * keys, uint32_t begin, uint32_t end, uint32_t byte, uint32_t * histogram)
+        {
+            std::fill(histogram, histogram + DigitCount, 0);
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                ++histogram[GetDigit(keys[i], byte)];
+            }
+        }
+
+        void ScatterKeys(uint64_t const * keys, uint32_t const * values, uint32_t begin, uint32_t end, uint32_t byte, uint32_t * offsets, uint64_t * outKeys, uint32_t * outValues)
+        {
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                uint64_t key = keys[i];
+                uint32_t position = offsets[GetDigit(key, byte)]++;
+                outKeys[position] = key;
+                outValues[position] = values[i];
+            }
+        }
+    }
+
+    RenderQueue::RenderQueue()
+    {
+    }
+
+    RenderQueue::~RenderQueue()
+    {
+    }
+
+    void RenderQueue::SetMaterial(MaterialId material, PipelineId pipeline, Pass pass)
+    {
+        if (material >= m_Materials.size())
+        {
+            m_Materials.resize(material + 1);
+        }
+        m_Materials[material].pipeline = pipeline;
+        m_Materials[material].pass = pass;
+    }
+
+    void RenderQueue::Clear()
+    {
+        m_ViewStarts.clear();
+        m_UnsortedDraws.clear();
+        m_Draws.clear();
+        m_Stats = Stats{};
+    }
+
+    void RenderQueue::AddView(RenderSnapshot const & snapshot, CameraSnapshot const & camera, Span<uint32_t const> objects, Span<uint8_t const> levels)
+    {
+        assert(objects.size() == levels.size());
+        Clock::time_point start = Clock::now();
+
+        uint32_t first = (uint32_t)m_UnsortedDraws.size();
+        uint32_t count = (uint32_t)objects.size();
+        m_ViewStarts.push_back(first);
+        m_UnsortedDraws.resize(first + count);
+
+        PackedBounds const & bounds = snapshot.GetPackedWorldBounds();
+        float const * centerX = bounds.GetArray(PackedBounds::CenterX);
+        float const * centerY = bounds.GetArray(PackedBounds::CenterY);
+        float const * centerZ = bounds.GetArray(PackedBounds::CenterZ);
+        MeshId const * meshes = snapshot.GetMeshIds();
+        MaterialId const * materials = snapshot.GetMaterialIds();
+
+        // The depth is the opposite of the z coordinate in the space of the camera.
+        glm::mat4 const & viewMatrix = camera.viewMatrix;
+        glm::vec4 depthRow{ -viewMatrix[0][2], -viewMatrix[1][2], -viewMatrix[2][2], -viewMatrix[3][2] };
+
+        Draw * draws = m_UnsortedDraws.data() + first;
+        ThreadPool::GetDefault().ParallelFor(count, 256, [&](uint32_t begin, uint32_t end) {
+            MaterialState const defaultState;
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                uint32_t object = objects[i];
+                Draw & draw = draws[i];
+                draw.object = object;
+                draw.mesh = meshes[object];
+                draw.material = materials[object];
+                draw.level = levels[i];
+
+                MaterialState const & state = draw.material < m_Materials.size() ? m_Materials[draw.material] : defaultState;
+                draw.pipeline = state.pipeline;
+
+                uint64_t stateKey =
+                    (Field(state.pipeline, PipelineBits) << (MaterialBits + MeshBits + LevelBits)) |
+                    (Field(draw.material, MaterialBits) << (MeshBits + LevelBits)) |
+                    (Field(draw.mesh, MeshBits) << LevelBits) |
+                    Field(draw.level, LevelBits);
+                float depth = depthRow.x * centerX[object] + depthRow.y * centerY[object] + depthRow.z * centerZ[object] + depthRow.w;
+                uint64_t depthKey = QuantizeDepth(depth);
+
+                uint64_t passKey = (uint64_t)state.pass << 62;
+                if (state.pass == Transparent)
+                {
+                    draw.key = passKey | ((((1u << DepthBits) - 1) - depthKey) << (62 - DepthBits)) | stateKey;
+                }
+                else
+                {
+                    draw.key = passKey | (stateKey << DepthBits) | depthKey;
+                }
+            }
+        });
+
+        ++m_Stats.viewCount;
+        m_Stats.drawCount += count;
+        m_Stats.buildTime += GetMilliseconds(start, Clock::now());
+    }
+
+    void RenderQueue::Sort()
+    {
+        Sort(ThreadPool::GetDefault());
+    }
+
+    void RenderQueue::Sort(ThreadPool & threadPool)
+    {
+        Clock::time_point start = Clock::now();
+
+        uint32_t count = (uint32_t)m_UnsortedDraws.size();
+        m_Keys.resize(count);
+        m_Values.resize(count);
+        m_TempKeys.resize(count);
+        m_TempValues.resize(count);
+        m_Draws.resize(count);
+
+        // The changes of state are counted by the passes that copy the draws anyway, so that they cost next to nothing.
+        StateChanges unsortedChanges;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            m_Keys[i] = m_UnsortedDraws[i].key;
+            m_Values[i] = i;
+            CountStateChange(m_UnsortedDraws[i], i == 0 ? nullptr : &m_UnsortedDraws[i - 1], unsortedChanges);
+        }
+        m_Stats.unsortedChanges = unsortedChanges;
+
+        for (uint32_t view = 0; view < GetViewCount(); ++view)
+        {
+            uint32_t end = view + 1 < GetViewCount() ? m_ViewStarts[view + 1] : count;
+            RadixSort(m_ViewStarts[view], end, threadPool);
+        }
+
+        // The previous draw of every draw is read from the unsorted draws, since another task may be writing it.
+        std::mutex mutex;
+        StateChanges sortedChanges;
+        threadPool.ParallelFor(count, 256, [&](uint32_t begin, uint32_t end) {
+            StateChanges changes;
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                m_Draws[i] = m_UnsortedDraws[m_Values[i]];
+                CountStateChange(m_Draws[i], i == 0 ? nullptr : &m_UnsortedDraws[m_Values[i - 1]], changes);
+            }
+
+            std::lock_guard<std::mutex> lock{ mutex };
+            sortedChanges.pipelineCount += changes.pipelineCount;
+            sortedChanges.materialCount += changes.materialCount;
+            sortedChanges.meshCount += changes.meshCount;
+        });
+        m_Stats.sortedChanges = sortedChanges;
+        m_Stats.sortTime += GetMilliseconds(start, Clock::now());
+    }
+
+    Span<RenderQueue::Draw const> RenderQueue::GetDraws(uint32_t view) const
+    {
+        assert(view < GetViewCount());
+        std::vector<Draw> const & draws = m_Draws.size() == m_UnsortedDraws.size() ? m_Draws : m_UnsortedDraws;
+        uint32_t begin = m_ViewStarts[view];
+        uint32_t end = view + 1 < GetViewCount() ? m_ViewStarts[view + 1] : (uint32_t)draws.size();
+        return Span<Draw const>{ draws.data() + begin, end - begin };
+    }
+
+    void RenderQueue::RadixSort(uint32_t begin, uint32_t end, ThreadPool & threadPool)
+    {
+        uint32_t count = end - begin;
+        if (count < 2)
+        {
+            return;
+        }
+
+        uint32_t chunkCount = (std::max)((std::min)(threadPool.GetThreadCount(), count / MinKeysPerChunk), 1u);
+        uint32_t chunkSize = (count + chunkCount - 1) / chunkCount;
+        m_Histograms.assign(chunkCount * ByteCount * DigitCount, 0);
+
+        uint64_t * keys = m_Keys.data() + begin;
+        uint32_t * values = m_Values.data() + begin;
+        uint64_t * tempKeys = m_TempKeys.data() + begin;
+        uint32_t * tempValues = m_TempValues.data() + begin;
+
+        // The histograms of all the bytes tell which ones vary between the keys.
+        threadPool.ParallelFor(chunkCount, 1, [&](uint32_t firstChunk, uint32_t lastChunk) {
+            for (uint32_t chunk = firstChunk; chunk < lastChunk; ++chunk)
+            {
+                CountAllDigits(keys, chunk * chunkSize, (std::min)((chunk + 1) * chunkSize, count), m_Histograms.data() + chunk * ByteCount * DigitCount);
+            }
+        });
+
+        bool isVarying[ByteCount];
+        for (uint32_t byte = 0; byte < ByteCount; ++byte)
+        {
+            isVarying[byte] = true;
+            for (uint32_t digit = 0; digit < DigitCount && isVarying[byte]; ++digit)
+            {
+                uint32_t digitCount = 0;
+                for (uint32_t chunk = 0; chunk < chunkCount; ++chunk)
+                {
+                    digitCount += m_Histograms[(chunk * ByteCount + byte) * DigitCount + digit];
+                }
+                isVarying[byte] = digitCount != count;
+            }
+        }
+
+        // Every pass counts the digits of every chunk in the current order, then the chunks scatter their keys, each
+        // digit of a chunk going after the same digit of the previous chunks, which keeps the sort stable.
+        bool isSwapped = false;
+        for (uint32_t byte = 0; byte < ByteCount; ++byte)
+        {
+            if (!isVarying[byte])
+            {
+                continue;
+            }
+
+            threadPool.ParallelFor(chunkCount, 1, [&](uint32_t firstChunk, uint32_t lastChunk) {
+                for (uint32_t chunk = firstChunk; chunk < lastChunk; ++chunk)
+                {
+                    CountDigits(keys, chunk * chunkSize, (std::min)((chunk + 1) * chunkSize, count), byte, m_Histograms.data() + chunk * DigitCount);
+                }
+            });
+
+            uint32_t offset = 0;
+            for (uint32_t digit = 0; digit < DigitCount; ++digit)
+            {
+                for (uint32_t chunk = 0; chunk < chunkCount; ++chunk)
+                {
+                    uint32_t & entry = m_Histograms[chunk * DigitCount + digit];
+                    uint32_t digitCount = entry;
+                    entry = offset;
+                    offset += digitCount;
+                }
+            }
+
+            threadPool.ParallelFor(chunkCount, 1, [&](uint32_t firstChunk, uint32_t lastChunk) {
+                for (uint32_t chunk = firstChunk; chunk < lastChunk; ++chunk)
+                {
+                    ScatterKeys(keys, values, chunk * chunkSize, (std::min)((chunk + 1) * chunkSize, count), byte, m_Histograms.data() + chunk * DigitCount, tempKeys, tempValues);
+                }
+            });
+
+            std::swap(keys, tempKeys);
+            std::swap(values, tempValues);
+            isSwapped = !isSwapped;
+        }
+
+        if (isSwapped)
+        {
+            // The temporary arrays hold the sorted range.
+            std::copy(keys, keys + count, tempKeys);
+            std::copy(values, values + count, tempValues);
+        }
+    }
+
+    void RenderQueue::PrintStats() const
+    {
+        StatsRows rows = {
+            { "Views", std::to_string(m_Stats.viewCount) },
+            { "Draws", std::to_string(m_Stats.drawCount) },
+            { "Pipeline changes", std::to_string(m_Stats.unsortedChanges.pipelineCount) + " -> " + std::to_string(m_Stats.sortedChanges.pipelineCount) },
+            { "Material changes", std::to_string(m_Stats.unsortedChanges.materialCount) + " -> " + std::to_string(m_Stats.sortedChanges.materialCount) },
+            { "Mesh changes", std::to_string(m_Stats.unsortedChanges.meshCount) + " -> " + std::to_string(m_Stats.sortedChanges.meshCount) },
+            { "Build (ms)", FormatStat(m_Stats.buildTime) },
+            { "Sort (ms)", FormatStat(m_Stats.sortTime) },
+        };
+
+        PrintStatsTable("Render queue", rows);
+    }
+} // VulkanDemo
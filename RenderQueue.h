@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "MeshRenderer.h"
+#include "Span.h"
+
+namespace VulkanDemo
+{
+    class RenderSnapshot;
+    class ThreadPool;
+    struct CameraSnapshot;
+
+    typedef uint32_t PipelineId;
+
+    ///
+    /// Orders the draws of a frame to minimize the changes of state between them.
+    ///
+    /// Every draw gets a 64-bit key, sorted in increasing order, made of the following fields from the most significant
+    /// bits:
+    /// - Opaque pass:      pass (2 bits), pipeline (10), material (14), mesh (16), level of detail (4), depth (18).
+    /// - Transparent pass: pass (2 bits), inverted depth (18), pipeline (10), material (14), mesh (16), level (4).
+    /// So the opaque objects are grouped by state then drawn front to back, for the early depth test, and the transparent
+    /// objects are drawn back to front after them, for the blending. The depth is the distance of the center of the
+    /// bounds along the view axis, quantized by keeping the exponent and the top of the mantissa of the float, which
+    /// is precise near the camera whatever the depth range. The identifiers are truncated to the width of their fields,
+    /// which only costs extra changes of state in scenes with more of them.
+    ///
+    /// The keys are sorted with an LSD radix sort on bytes, in parallel, skipping the bytes that are the same for all
+    /// the draws, such as the pass of a frame without transparent objects.
+    ///
+    /// Usage Notes:
+    /// - Sort() must not be called from a ThreadPool::ParallelFor().
+    ///
+    class RenderQueue
+    {
+    public:
+        enum Pass : uint8_t
+        {
+            Opaque = 0,
+            Transparent = 1,
+        };
+
+        ///
+        /// Draw of an object, with its state resolved.
+        ///
+        struct Draw
+        {
+            uint64_t key;
+            uint32_t object;    // Index in the snapshot.
+            MeshId mesh;
+            MaterialId material;
+            PipelineId pipeline;
+            uint8_t level;
+        };
+
+        ///
+        /// Changes of state between the consecutive draws of the frame, counting the first draw as a change.
+        ///
+        struct StateChanges
+        {
+            uint32_t pipelineCount = 0;
+            uint32_t materialCount = 0;
+            uint32_t meshCount = 0;
+        };
+
+        struct Stats
+        {
+            uint32_t viewCount = 0;
+            uint32_t drawCount = 0;
+            StateChanges unsortedChanges;   // In the order of the culling.
+            StateChanges sortedChanges;
+            double buildTime = 0;           // In milliseconds.
+            double sortTime = 0;
+        };
+
+        RenderQueue();
+        ~RenderQueue();
+
+        ///
+        /// Sets the pipeline drawing the material and its pass. The materials not set are opaque and use pipeline 0.
+        ///
+        void SetMaterial(MaterialId material, PipelineId pipeline, Pass pass);
+
+        ///
+        /// Removes the draws of the previous frame.
+        ///
+        void Clear();
+
+        ///
+        /// Adds the draws of a view: the objects seen by the camera, which are indices in the snapshot, at their levels
+        /// of detail. The views are numbered in the order of the calls.
+        ///
+        void AddView(RenderSnapshot const & snapshot, CameraSnapshot const & camera, Span<uint32_t const> objects, Span<uint8_t const> levels);
+
+        ///
+        /// Sorts the draws of every view.
+        ///
+        void Sort();
+        void Sort(ThreadPool & threadPool);
+
+        inline uint32_t GetViewCount() const { return (uint32_t)m_ViewStarts.size(); }
+
+        ///
+        /// Returns the draws of a view, in their order of submission once sorted, or in the order of AddView() before.
+        ///
+        Span<Draw const> GetDraws(uint32_t view) const;
+
+        inline Stats const & GetStats() const { return m_Stats; }
+        void PrintStats() const;
+
+    private:
+        RenderQueue(RenderQueue const & other) = delete;
+        void operator=(RenderQueue const & other) = delete;
+
+        struct MaterialState
+        {
+            PipelineId pipeline = 0;
+            Pass pass = Opaque;
+        };
+
+        ///
+        /// Sorts the keys of a range of the draws, with the indices of the draws as values.
+        ///
+        void RadixSort(uint32_t begin, uint32_t end, ThreadPool & threadPool);
+
+        std::vector<MaterialState> m_Materials; // Indexed by MaterialId.
+
+        std::vector<uint32_t>   m_ViewStarts;   // First draw of every view.
+        std::vector<Draw>       m_UnsortedDraws;
+        std::vector<Draw>       m_Draws;
+
+        std::vector<uint64_t>   m_Keys;
+        std::vector<uint32_t>   m_Values;
+        std::vector<uint64_t>   m_TempKeys;
+        std::vector<uint32_t>   m_TempValues;
+        std::vector<uint32_t>   m_Histograms;   // Per chunk of the keys, then per byte, then per digit.
+
+        Stats m_Stats;
+    };
+} // VulkanDemo
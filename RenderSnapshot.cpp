@@ -0,0 +1,304 @@
+#include "RenderSnapshot.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "Camera.h"
+#include "GameObject.h"
+#include "Scene.h"
+#include "ThreadPool.h"
+#include "Transform.h"
+
+namespace VulkanDemo
+{
+    glm::mat4 CameraSnapshot::GetProjectionMatrix(float aspectRatio) const
+    {
+        if (aspectRatio == this->aspectRatio)
+        {
+            return projectionMatrix;
+        }
+        return glm::perspective(glm::radians(verticalFieldOfView), aspectRatio, nearPlane, farPlane);
+    }
+
+    glm::mat4 CameraSnapshot::GetViewProjectionMatrix(float aspectRatio) const
+    {
+        if (aspectRatio == this->aspectRatio)
+        {
+            return viewProjectionMatrix;
+        }
+        return GetProjectionMatrix(aspectRatio) * viewMatrix;
+    }
+
+    Frustum CameraSnapshot::GetFrustum(float aspectRatio) const
+    {
+        return Frustum::FromMatrix(GetViewProjectionMatrix(aspectRatio));
+    }
+
+    RenderSnapshot::RenderSnapshot()
+    {
+    }
+
+    RenderSnapshot::~RenderSnapshot()
+    {
+    }
+
+    void RenderSnapshot::Extract(Scene & scene)
+    {
+        // Afterwards, reading the world matrices of the scene doesn't modify anything, so it is safe in parallel.
+        scene.UpdateWorldMatrices();
+
+        SceneChangeJournal const & journal = scene.GetChangeJournal();
+        bool isKnown = m_Scene == &scene && journal.IsKnownSince(m_JournalFrame);
+        if (isKnown && journal.GetVersion() == m_JournalVersion)
+        {
+            // Nothing changed since the last extraction.
+            m_IsFullyExtracted = false;
+            m_UpdatedObjects.clear();
+        }
+        else if (isKnown && (journal.GetFlagsSince(m_JournalFrame) & (SceneChangeJournal::Created | SceneChangeJournal::Destroyed | SceneChangeJournal::ComponentsChanged)) == 0)
+        {
+            // The renderers of the scene are the same, at the same indices.
+            ExtractMovedObjects(scene, m_JournalFrame);
+        }
+        else
+        {
+            ExtractAllObjects(scene);
+        }
+        m_Scene = &scene;
+        m_SourceScene = &scene;
+        m_JournalFrame = journal.GetFrameIndex();
+        m_JournalVersion = journal.GetVersion();
+        m_StructureVersion = journal.GetStructureVersion();
+
+        // The cameras cache their matrices lazily, so they are extracted serially.
+        m_Cameras.clear();
+        for (auto & match : scene.Query<Transform, Camera>())
+        {
+            Transform & transform = match.Get<Transform>();
+            Camera & camera = match.Get<Camera>();
+
+            // The matrices of the cameras are cached, so most of them cost no computation.
+            CameraSnapshot snapshot;
+            snapshot.viewMatrix = camera.GetViewMatrix();
+            snapshot.projectionMatrix = camera.GetProjectionMatrix(camera.GetAspectRatio());
+            snapshot.viewProjectionMatrix = camera.GetViewProjectionMatrix(camera.GetAspectRatio());
+            snapshot.aspectRatio = camera.GetAspectRatio();
+            snapshot.position = glm::vec3{ transform.GetLocalToWorldMatrix()[3] };
+            snapshot.nearPlane = camera.GetNear();
+            snapshot.farPlane = camera.GetFar();
+            snapshot.verticalFieldOfView = camera.GetVerticalFieldOfView();
+            m_Cameras.push_back(snapshot);
+        }
+    }
+
+    void RenderSnapshot::ExtractAllObjects(Scene & scene)
+    {
+        Span<Component * const> renderers = scene.GetComponentsOfType(ComponentType::MeshRenderer);
+        Span<GameObject * const> owners = scene.GetOwnersOfType(ComponentType::MeshRenderer);
+        uint32_t count = (uint32_t)renderers.size();
+        m_WorldMatrices.resize(count);
+        m_WorldBounds.resize(count);
+        m_PackedWorldBounds.Resize(count);
+        m_MeshIds.resize(count);
+        m_MaterialIds.resize(count);
+
+        // The occluders are few, so every range collects its own and appends them at the end.
+        m_Occluders.clear();
+        std::mutex occluderMutex;
+
+        ThreadPool::GetDefault().ParallelFor(count, 64, [&](uint32_t begin, uint32_t end) {
+            std::vector<OccluderSnapshot> occluders;
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                MeshRenderer const * renderer = static_cast<MeshRenderer const *>(renderers[i]);
+                Transform const * transform = owners[i]->GetTransform();
+                glm::mat4 const & worldMatrix = transform != nullptr ? transform->GetLocalToWorldMatrix() : glm::mat4{ 1 };
+
+                m_WorldMatrices[i] = worldMatrix;
+                m_WorldBounds[i] = renderer->GetLocalBounds().Transformed(worldMatrix);
+                m_PackedWorldBounds.Set(i, m_WorldBounds[i]);
+                m_MeshIds[i] = renderer->GetMeshId();
+                m_MaterialIds[i] = renderer->GetMaterialId();
+                if (!renderer->GetOccluderBounds().IsEmpty())
+                {
+                    occluders.push_back(OccluderSnapshot{ i, renderer->GetOccluderBounds() });
+                }
+            }
+
+            if (!occluders.empty())
+            {
+                std::lock_guard<std::mutex> lock{ occluderMutex };
+                m_Occluders.insert(m_Occluders.end(), occluders.begin(), occluders.end());
+            }
+        });
+        std::sort(m_Occluders.begin(), m_Occluders.end(), [](OccluderSnapshot const & a, OccluderSnapshot const & b) {
+            return a.object < b.object;
+        });
+
+        m_IsFullyExtracted = true;
+        m_UpdatedObjects.clear();
+    }
+
+    void RenderSnapshot::ExtractMovedObjects(Scene & scene, uint64_t sinceFrame)
+    {
+        m_Changes.clear();
+        scene.GetChangeJournal().GetChangesSince(sinceFrame, m_Changes);
+
+        // Copying the objects one by one misses the caches at every step, while copying all of them streams through
+        // memory, which wins once a tenth or so of the objects moved.
+        if (m_Changes.size() > GetObjectCount() / FullExtractionRatio)
+        {
+            ExtractAllObjects(scene);
+            return;
+        }
+
+        // The moved descendants are in the journal too, so every change only concerns the renderers of its object.
+        m_UpdatedObjects.clear();
+        for (SceneChangeJournal::Change const & change : m_Changes)
+        {
+            if ((change.flags & SceneChangeJournal::TransformChanged) == 0)
+            {
+                continue;
+            }
+
+            GameObject const * gameObject = scene.GetGameObject(change.gameObject);
+            if (gameObject == nullptr || !gameObject->HasComponents(ComponentType::GetMask(ComponentType::MeshRenderer)))
+            {
+                continue;
+            }
+
+            for (Component const * component : gameObject->GetComponents())
+            {
+                if (component->GetTypeId() == ComponentType::MeshRenderer)
+                {
+                    m_UpdatedObjects.push_back(component->GetTypeIndex());
+                }
+            }
+        }
+
+        // An object may have moved during several frames.
+        std::sort(m_UpdatedObjects.begin(), m_UpdatedObjects.end());
+        m_UpdatedObjects.erase(std::unique(m_UpdatedObjects.begin(), m_UpdatedObjects.end()), m_UpdatedObjects.end());
+
+        Span<Component * const> renderers = scene.GetComponentsOfType(ComponentType::MeshRenderer);
+        Span<GameObject * const> owners = scene.GetOwnersOfType(ComponentType::MeshRenderer);
+        ThreadPool::GetDefault().ParallelFor((uint32_t)m_UpdatedObjects.size(), 64, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t j = begin; j < end; ++j)
+            {
+                uint32_t i = m_UpdatedObjects[j];
+                MeshRenderer const * renderer = static_cast<MeshRenderer const *>(renderers[i]);
+                Transform const * transform = owners[i]->GetTransform();
+                glm::mat4 const & worldMatrix = transform != nullptr ? transform->GetLocalToWorldMatrix() : glm::mat4{ 1 };
+
+                m_WorldMatrices[i] = worldMatrix;
+                m_WorldBounds[i] = renderer->GetLocalBounds().Transformed(worldMatrix);
+                m_PackedWorldBounds.Set(i, m_WorldBounds[i]);
+            }
+        });
+        m_IsFullyExtracted = false;
+    }
+
+    void RenderSnapshot::Interpolate(RenderSnapshot const & previous, RenderSnapshot const & next, float alpha)
+    {
+        assert(this != &previous && this != &next);
+
+        bool isBlended = previous.m_Scene != nullptr && previous.m_Scene == next.m_Scene && previous.m_StructureVersion == next.m_StructureVersion;
+        uint32_t count = next.GetObjectCount();
+        m_WorldMatrices.resize(count);
+        m_WorldBounds.resize(count);
+        m_PackedWorldBounds.Resize(count);
+        m_MeshIds.assign(next.m_MeshIds.begin(), next.m_MeshIds.end());
+        m_MaterialIds.assign(next.m_MaterialIds.begin(), next.m_MaterialIds.end());
+        m_Occluders.assign(next.m_Occluders.begin(), next.m_Occluders.end());
+
+        ThreadPool::GetDefault().ParallelFor(count, 64, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                glm::mat4 const & nextMatrix = next.m_WorldMatrices[i];
+                if (!isBlended || memcmp(&previous.m_WorldMatrices[i], &nextMatrix, sizeof(glm::mat4)) == 0)
+                {
+                    m_WorldMatrices[i] = nextMatrix;
+                    m_WorldBounds[i] = next.m_WorldBounds[i];
+                }
+                else
+                {
+                    glm::mat4 const & previousMatrix = previous.m_WorldMatrices[i];
+                    for (int column = 0; column < 4; ++column)
+                    {
+                        m_WorldMatrices[i][column] = previousMatrix[column] + (nextMatrix[column] - previousMatrix[column]) * alpha;
+                    }
+
+                    Aabb bounds = previous.m_WorldBounds[i];
+                    bounds.Extend(next.m_WorldBounds[i]);
+                    m_WorldBounds[i] = bounds;
+                }
+                m_PackedWorldBounds.Set(i, m_WorldBounds[i]);
+            }
+        });
+
+        m_Cameras.assign(next.m_Cameras.begin(), next.m_Cameras.end());
+        if (isBlended && previous.m_Cameras.size() == next.m_Cameras.size())
+        {
+            for (size_t i = 0; i < m_Cameras.size(); ++i)
+            {
+                CameraSnapshot const & previousCamera = previous.m_Cameras[i];
+                CameraSnapshot & camera = m_Cameras[i];
+                for (int column = 0; column < 4; ++column)
+                {
+                    camera.viewMatrix[column] = previousCamera.viewMatrix[column] + (camera.viewMatrix[column] - previousCamera.viewMatrix[column]) * alpha;
+                }
+                camera.viewProjectionMatrix = camera.projectionMatrix * camera.viewMatrix;
+                camera.position = previousCamera.position + (camera.position - previousCamera.position) * alpha;
+            }
+        }
+
+        m_FrameIndex = next.m_FrameIndex;
+        m_Time = isBlended ? previous.m_Time + (next.m_Time - previous.m_Time) * alpha : next.m_Time;
+        m_Scene = nullptr;
+        m_SourceScene = next.m_SourceScene;
+        m_StructureVersion = next.m_StructureVersion;
+        m_IsFullyExtracted = true;
+        m_UpdatedObjects.clear();
+    }
+
+    RenderSnapshotBuffer::RenderSnapshotBuffer()
+    {
+    }
+
+    RenderSnapshotBuffer::~RenderSnapshotBuffer()
+    {
+    }
+
+    void RenderSnapshotBuffer::Publish()
+    {
+        std::unique_lock<std::mutex> lock{ m_Mutex };
+        m_ReleaseCondition.wait(lock, [this]() { return !m_IsFrontAcquired; });
+
+        m_Snapshots[m_BackIndex].m_FrameIndex = ++m_PublishedCount;
+        m_BackIndex ^= 1;
+    }
+
+    RenderSnapshot const * RenderSnapshotBuffer::AcquireFront()
+    {
+        std::lock_guard<std::mutex> lock{ m_Mutex };
+        if (m_PublishedCount == 0)
+        {
+            return nullptr;
+        }
+
+        m_IsFrontAcquired = true;
+        return &m_Snapshots[m_BackIndex ^ 1];
+    }
+
+    void RenderSnapshotBuffer::ReleaseFront()
+    {
+        {
+            std::lock_guard<std::mutex> lock{ m_Mutex };
+            m_IsFrontAcquired = false;
+        }
+        m_ReleaseCondition.notify_one();
+    }
+} // VulkanDemo
@@ -0,0 +1,215 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "AlignedAllocator.h"
+#include "Bounds.h"
+#include "MeshRenderer.h"
+#include "SceneChangeJournal.h"
+
+namespace VulkanDemo
+{
+    class Scene;
+
+    ///
+    /// Parameters of a camera, as seen by the renderer.
+    ///
+    struct CameraSnapshot
+    {
+        glm::mat4 viewMatrix;       // World to camera.
+        glm::mat4 projectionMatrix;
+        glm::mat4 viewProjectionMatrix;
+        glm::vec3 position;
+        float nearPlane;
+        float farPlane;
+        float verticalFieldOfView;  // In degrees.
+        float aspectRatio = 0;      // Of the projection matrices, 0 when they are not set.
+
+        ///
+        /// Return the matrices of the snapshot for its aspect ratio, which is the one of the camera, and compute them
+        /// for other ones.
+        ///
+        glm::mat4 GetProjectionMatrix(float aspectRatio) const;
+        glm::mat4 GetViewProjectionMatrix(float aspectRatio) const;
+        Frustum GetFrustum(float aspectRatio) const;
+    };
+
+    ///
+    /// Occluder box of a drawn object, in the local space of the object.
+    ///
+    struct OccluderSnapshot
+    {
+        uint32_t object;
+        Aabb bounds;
+    };
+
+    ///
+    /// Copy of the state of a scene needed to render a frame, so that the renderer never reads the objects that the
+    /// simulation mutates.
+    ///
+    /// The drawn objects are stored as parallel arrays, one entry per MeshRenderer of the scene, in no particular
+    /// order. Once extracted, a snapshot is not modified until it is extracted again, which lets the renderer read it
+    /// from another thread.
+    ///
+    class RenderSnapshot
+    {
+    public:
+        RenderSnapshot();
+        ~RenderSnapshot();
+
+        ///
+        /// Brings the world matrices of the scene up to date and copies the render state of its objects and cameras.
+        /// The objects are copied in parallel with the default thread pool. The arrays keep their capacity, so that
+        /// extracting every frame doesn't allocate.
+        ///
+        /// When the snapshot was last extracted from the same scene, only the objects that moved since then are copied,
+        /// as told by the change journal of the scene. All of them are copied again if objects or components were
+        /// added, removed or changed, or if the journal no longer knows the changes since the last extraction.
+        ///
+        void Extract(Scene & scene);
+
+        ///
+        /// Indicates whether the last Extract() copied all the objects. Otherwise, only the objects returned by
+        /// GetUpdatedObjects(), in increasing order, differ from the previous extraction into this snapshot, so that
+        /// the systems mirroring the snapshot, such as GPU buffers, can update only those.
+        ///
+        inline bool IsFullyExtracted() const { return m_IsFullyExtracted; }
+        inline std::vector<uint32_t> const & GetUpdatedObjects() const { return m_UpdatedObjects; }
+
+        ///
+        /// Forgets the last extraction, so that the next one copies all the objects.
+        ///
+        inline void Reset() { m_Scene = nullptr; }
+
+        ///
+        /// Makes this snapshot the state between two snapshots of the same scene, alpha going from 0 at the previous one
+        /// to 1 at the next one. The world matrices and cameras are blended linearly, which is exact for translations
+        /// and close enough for the small rotations between two simulation ticks, and the world bounds enclose both
+        /// states. If objects or components changed between the two snapshots, the next one is copied as is.
+        ///
+        /// The snapshot is not extracted from the scene afterwards, so the next Extract() into it copies all the
+        /// objects.
+        ///
+        void Interpolate(RenderSnapshot const & previous, RenderSnapshot const & next, float alpha);
+
+        inline uint32_t GetObjectCount() const { return (uint32_t)m_MeshIds.size(); }
+        inline glm::mat4 const * GetWorldMatrices() const { return m_WorldMatrices.data(); }
+        inline Aabb const * GetWorldBounds() const { return m_WorldBounds.data(); }
+        inline PackedBounds const & GetPackedWorldBounds() const { return m_PackedWorldBounds; }
+        inline MeshId const * GetMeshIds() const { return m_MeshIds.data(); }
+        inline MaterialId const * GetMaterialIds() const { return m_MaterialIds.data(); }
+
+        ///
+        /// Returns the occluders of the objects, in the order of the objects.
+        ///
+        inline std::vector<OccluderSnapshot> const & GetOccluders() const { return m_Occluders; }
+
+        inline std::vector<CameraSnapshot> const & GetCameras() const { return m_Cameras; }
+
+        ///
+        /// Number of the frame, counting from 1, assigned by RenderSnapshotBuffer::Publish() or the SimulationLoop.
+        ///
+        inline uint64_t GetFrameIndex() const { return m_FrameIndex; }
+
+        ///
+        /// Time of the simulation at which the state was extracted, in seconds, assigned by the SimulationLoop.
+        ///
+        inline double GetTime() const { return m_Time; }
+
+        ///
+        /// Snapshots of the same scene at the same structure version, interpolated ones included, have the same objects
+        /// at the same indices, so that the state kept per object index across frames stays valid.
+        ///
+        inline Scene const * GetSourceScene() const { return m_SourceScene; }
+        inline uint64_t GetStructureVersion() const { return m_StructureVersion; }
+
+    private:
+        friend class RenderSnapshotBuffer;
+        friend class SimulationLoop;
+
+        RenderSnapshot(RenderSnapshot const & other) = delete;
+        void operator=(RenderSnapshot const & other) = delete;
+
+        // Beyond one moved object in this many, all the objects are copied again.
+        static const uint32_t FullExtractionRatio = 8;
+
+        ///
+        /// Copies all the objects of the scene.
+        ///
+        void ExtractAllObjects(Scene & scene);
+
+        ///
+        /// Copies the objects that moved since the given frame of the change journal of the scene.
+        ///
+        void ExtractMovedObjects(Scene & scene, uint64_t sinceFrame);
+
+        AlignedVector<glm::mat4>        m_WorldMatrices;
+        std::vector<Aabb>               m_WorldBounds;
+        PackedBounds                    m_PackedWorldBounds;    // The world bounds again, for the culling.
+        std::vector<MeshId>             m_MeshIds;
+        std::vector<MaterialId>         m_MaterialIds;
+        std::vector<OccluderSnapshot>   m_Occluders;
+        std::vector<CameraSnapshot>     m_Cameras;
+        uint64_t                        m_FrameIndex = 0;
+        double                          m_Time = 0;
+        Scene const *                   m_SourceScene = nullptr;
+
+        // Source of the last extraction, to only copy the changes at the next one.
+        Scene const *                   m_Scene = nullptr;
+        uint64_t                        m_JournalFrame = 0;
+        uint64_t                        m_JournalVersion = 0;
+        uint64_t                        m_StructureVersion = 0;
+        bool                            m_IsFullyExtracted = true;
+        std::vector<uint32_t>           m_UpdatedObjects;
+        std::vector<SceneChangeJournal::Change> m_Changes;
+    };
+
+    ///
+    /// Pair of snapshots letting the simulation extract frame N + 1 while the renderer draws frame N.
+    ///
+    /// The simulation thread fills the back snapshot and publishes it. The render thread acquires the latest published
+    /// snapshot and releases it once the draw commands are recorded. Publishing waits for the release, since the front
+    /// snapshot becomes the next back snapshot.
+    ///
+    class RenderSnapshotBuffer
+    {
+    public:
+        RenderSnapshotBuffer();
+        ~RenderSnapshotBuffer();
+
+        ///
+        /// Returns the snapshot to fill. Only the simulation thread may use it, until Publish().
+        ///
+        inline RenderSnapshot & GetBackSnapshot() { return m_Snapshots[m_BackIndex]; }
+
+        ///
+        /// Makes the back snapshot the one returned to the renderer, blocking while the renderer holds the previous
+        /// one.
+        ///
+        void Publish();
+
+        ///
+        /// Returns the latest published snapshot, or nullptr if nothing was published yet. The same snapshot is
+        /// returned again if nothing was published since; the frame index tells them apart.
+        ///
+        RenderSnapshot const * AcquireFront();
+        void ReleaseFront();
+
+    private:
+        RenderSnapshotBuffer(RenderSnapshotBuffer const & other) = delete;
+        void operator=(RenderSnapshotBuffer const & other) = delete;
+
+        RenderSnapshot          m_Snapshots[2];
+        uint32_t                m_BackIndex = 0;
+        uint64_t                m_PublishedCount = 0;
+        bool                    m_IsFrontAcquired = false;
+
+        std::mutex              m_Mutex;
+        std::condition_variable m_ReleaseCondition;
+    };
+} // VulkanDemo
@@ -1,6 +1,10 @@
 #include "Scene.h"
 
-#include "GameObject.h"
+#include <algorithm>
+#include <cassert>
+
+#include "ThreadPool.h"
+#include "Transform.h"
 
 namespace VulkanDemo
 {
@@ -10,26 +14,335 @@ namespace VulkanDemo
 
     Scene::~Scene()
     {
+        // The objects are detached first, so that their destruction doesn't modify the containers being iterated.
+        for (auto component : m_Components)
+        {
+            component->m_Handle = ComponentHandle{};
+            component->m_TypeIndex = UINT32_MAX;
+        }
+        m_Components.Clear();
+        for (auto & storage : m_ComponentsByType)
+        {
+            storage.components.clear();
+            storage.owners.clear();
+        }
+        m_GameObjectsByName.clear();
+
+        // Cut the links with the objects outside of the scene, so that the remaining links stay within the objects
+        // being deleted.
+        for (auto gameObject : m_GameObjects)
+        {
+            GameObject * parent = gameObject->GetParent();
+            if (parent != nullptr && parent->m_Scene != this)
+            {
+                gameObject->SetParent(nullptr);
+            }
+
+            GameObject * child = gameObject->GetFirstChild();
+            while (child != nullptr)
+            {
+                GameObject * next = child->GetNextSibling();
+                if (child->m_Scene != this)
+                {
+                    child->SetParent(nullptr);
+                }
+                child = next;
+            }
+        }
+
         for (auto gameObject : m_GameObjects)
         {
-            delete gameObject;
+            gameObject->m_Scene = nullptr;
+            gameObject->m_Handle = GameObjectHandle{};
         }
-        m_GameObjects.clear();
+
+        // Every object has its own slot in the pool, even when it was created as part of a batch.
+        std::vector<GameObject *> gameObjects{ m_GameObjects.begin(), m_GameObjects.end() };
+        m_GameObjects.Clear();
+        GameObject::DeleteUnlinked(gameObjects.data(), gameObjects.size());
     }
 
     void Scene::AddGameObjects(GameObject * gameObjects, int count)
     {
+        m_GameObjects.Reserve(m_GameObjects.size() + count);
+        ReserveNameIndex(count);
         for (int i = 0; i < count; ++i)
         {
-            m_GameObjects.insert(gameObjects + i);
+            AttachGameObject(gameObjects[i]);
+        }
+        MarkHierarchyChanged();
+    }
+
+    void Scene::AddGameObjects(GameObject * const * gameObjects, size_t count)
+    {
+        m_GameObjects.Reserve(m_GameObjects.size() + (uint32_t)count);
+        ReserveNameIndex(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            AttachGameObject(*gameObjects[i]);
+        }
+        MarkHierarchyChanged();
+    }
+
+    void Scene::AttachGameObject(GameObject & gameObject)
+    {
+        assert(gameObject.m_Scene == nullptr);
+
+        gameObject.m_Handle = m_GameObjects.Insert(&gameObject);
+        gameObject.m_Scene = this;
+        m_ChangeJournal.Record(gameObject.m_Handle, SceneChangeJournal::Created);
+        IndexName(gameObject);
+        for (auto component : gameObject.GetComponents())
+        {
+            RegisterComponent(*component);
+        }
+        MoveTransforms(gameObject, m_TransformStore);
+    }
+
+    void Scene::ReserveComponents(ComponentType::Id typeId, size_t count)
+    {
+        TypeStorage & storage = m_ComponentsByType[typeId];
+        size_t required = storage.components.size() + count;
+        if (required > storage.components.capacity())
+        {
+            size_t capacity = std::max(required, 2 * storage.components.capacity());
+            storage.components.reserve(capacity);
+            storage.owners.reserve(capacity);
         }
+        m_Components.Reserve(m_Components.size() + (uint32_t)count);
     }
 
     void Scene::RemoveGameObjects(GameObject * gameObjects, int count)
     {
         for (int i = 0; i < count; ++i)
         {
-            m_GameObjects.erase(gameObjects + i);
+            GameObject * gameObject = gameObjects + i;
+            if (gameObject->m_Scene == this && m_GameObjects.Erase(gameObject->m_Handle))
+            {
+                m_ChangeJournal.Record(gameObject->m_Handle, SceneChangeJournal::Destroyed);
+                for (auto component : gameObject->GetComponents())
+                {
+                    UnregisterComponent(*component);
+                }
+                UnindexName(*gameObject, gameObject->GetNameId());
+                gameObject->m_Handle = GameObjectHandle{};
+                gameObject->m_Scene = nullptr;
+                MoveTransforms(*gameObject, TransformStore::GetDetachedStore());
+            }
+        }
+        MarkHierarchyChanged();
+    }
+
+    void Scene::UpdateWorldMatrices()
+    {
+        // The world matrices only become outdated through changes that the journal records.
+        if (m_ChangeJournal.GetVersion() == m_WorldMatricesVersion)
+        {
+            return;
+        }
+
+        // When few transforms moved, and no object came with outdated matrices, updating them one by one beats
+        // sweeping the whole store.
+        bool isSparse = false;
+        if (m_ChangeJournal.IsKnownSince(m_WorldMatricesFrame) &&
+            (m_ChangeJournal.GetFlagsSince(m_WorldMatricesFrame) & (SceneChangeJournal::Created | SceneChangeJournal::ComponentsChanged)) == 0)
+        {
+            m_Changes.clear();
+            m_ChangeJournal.GetChangesSince(m_WorldMatricesFrame, m_Changes);
+            isSparse = m_Changes.size() < m_TransformStore.GetCount() / SparseUpdateRatio;
+        }
+
+        if (isSparse)
+        {
+            for (SceneChangeJournal::Change const & change : m_Changes)
+            {
+                GameObject * gameObject = (change.flags & SceneChangeJournal::TransformChanged) != 0 ? GetGameObject(change.gameObject) : nullptr;
+                if (gameObject == nullptr)
+                {
+                    continue;
+                }
+
+                for (auto component : gameObject->GetComponents())
+                {
+                    if (component->GetTypeId() == Transform::TypeId)
+                    {
+                        static_cast<Transform *>(component)->GetLocalToWorldMatrix();
+                    }
+                }
+            }
+        }
+        else
+        {
+            m_TransformStore.UpdateWorldMatrices(ThreadPool::GetDefault());
+        }
+        m_WorldMatricesVersion = m_ChangeJournal.GetVersion();
+        m_WorldMatricesFrame = m_ChangeJournal.GetFrameIndex();
+    }
+
+    void Scene::ForgetGameObject(GameObject & gameObject)
+    {
+        assert(gameObject.m_Scene == this);
+        m_ChangeJournal.Record(gameObject.m_Handle, SceneChangeJournal::Destroyed);
+        m_GameObjects.Erase(gameObject.m_Handle);
+        for (auto component : gameObject.GetComponents())
+        {
+            UnregisterComponent(*component);
+        }
+        UnindexName(gameObject, gameObject.GetNameId());
+        gameObject.m_Handle = GameObjectHandle{};
+        gameObject.m_Scene = nullptr;
+        MarkHierarchyChanged();
+    }
+
+    GameObject * Scene::FindGameObject(NameId name) const
+    {
+        auto iter = m_GameObjectsByName.find(name);
+        return iter != m_GameObjectsByName.end() ? iter->second.front() : nullptr;
+    }
+
+    GameObject * Scene::FindGameObject(char const * name) const
+    {
+        NameId id = NameTable::GetInstance().Find(name);
+        return id != NameTable::EmptyName ? FindGameObject(id) : nullptr;
+    }
+
+    void Scene::FindGameObjects(NameId name, std::vector<GameObject *> & result) const
+    {
+        auto iter = m_GameObjectsByName.find(name);
+        if (iter != m_GameObjectsByName.end())
+        {
+            result.insert(result.end(), iter->second.begin(), iter->second.end());
+        }
+    }
+
+    void Scene::ReserveNameIndex(size_t count)
+    {
+        // Growing geometrically up front avoids rehashing repeatedly while a large batch is indexed.
+        size_t required = m_GameObjectsByName.size() + count;
+        if (required > m_GameObjectsByName.bucket_count() * m_GameObjectsByName.max_load_factor())
+        {
+            m_GameObjectsByName.reserve(std::max(required, 2 * m_GameObjectsByName.size()));
+        }
+    }
+
+    void Scene::IndexName(GameObject & gameObject)
+    {
+        if (gameObject.GetNameId() != NameTable::EmptyName)
+        {
+            std::vector<GameObject *> & bucket = m_GameObjectsByName[gameObject.GetNameId()];
+            gameObject.m_NameIndex = (uint32_t)bucket.size();
+            bucket.push_back(&gameObject);
+        }
+    }
+
+    void Scene::UnindexName(GameObject & gameObject, NameId name)
+    {
+        auto iter = m_GameObjectsByName.find(name);
+        if (iter == m_GameObjectsByName.end())
+        {
+            return;
+        }
+
+        // Swap with the last object of the bucket. Empty buckets are erased, so that the lookups never see them.
+        std::vector<GameObject *> & bucket = iter->second;
+        assert(gameObject.m_NameIndex < bucket.size() && bucket[gameObject.m_NameIndex] == &gameObject);
+        GameObject * last = bucket.back();
+        bucket[gameObject.m_NameIndex] = last;
+        last->m_NameIndex = gameObject.m_NameIndex;
+        bucket.pop_back();
+        if (bucket.empty())
+        {
+            m_GameObjectsByName.erase(iter);
+        }
+    }
+
+    HierarchyIndex const & Scene::GetHierarchyIndex()
+    {
+        if (m_IsHierarchyIndexDirty)
+        {
+            m_HierarchyIndex.Build(*this, GetAllGameObjects(), m_GameObjects.GetSlotCount());
+            m_IsHierarchyIndexDirty = false;
+            m_IsAncestryDirty = false;
+        }
+        return m_HierarchyIndex;
+    }
+
+    bool Scene::IsDescendantOf(GameObject const & descendant, GameObject const & ancestor)
+    {
+        assert(descendant.m_Scene == this && ancestor.m_Scene == this);
+        if (!m_IsAncestryDirty && m_HierarchyIndex.IsClosed())
+        {
+            return m_HierarchyIndex.IsDescendantOf(descendant, ancestor);
+        }
+
+        GameObject const * toTest = descendant.m_Parent;
+        size_t walkLength = 0;
+        while (toTest != nullptr && toTest != &ancestor)
+        {
+            toTest = toTest->m_Parent;
+            ++walkLength;
+        }
+
+        // Rebuilding is linear in the number of objects, so the walks pay for it.
+        m_AncestryWalkLength += walkLength;
+        if (m_IsAncestryDirty && m_AncestryWalkLength >= m_GameObjects.size())
+        {
+            GetHierarchyIndex();
+        }
+        return toTest != nullptr;
+    }
+
+    void Scene::MarkHierarchyChanged(GameObject const * movedRoot)
+    {
+        m_TransformStore.MarkHierarchyChanged();
+        m_IsHierarchyIndexDirty = true;
+        if (!m_IsAncestryDirty && (movedRoot == nullptr || !m_HierarchyIndex.MoveSubtree(*this, *movedRoot)))
+        {
+            m_IsAncestryDirty = true;
+            m_AncestryWalkLength = 0;
+        }
+    }
+
+    void Scene::RegisterComponent(Component & component)
+    {
+        assert(component.m_Handle.IsNull());
+        component.m_Handle = m_Components.Insert(&component);
+
+        TypeStorage & storage = m_ComponentsByType[component.GetTypeId()];
+        component.m_TypeIndex = (uint32_t)storage.components.size();
+        storage.components.push_back(&component);
+        storage.owners.push_back(component.GetGameObject());
+    }
+
+    void Scene::UnregisterComponent(Component & component)
+    {
+        m_Components.Erase(component.m_Handle);
+        component.m_Handle = ComponentHandle{};
+
+        // Move the last component of the type into the freed slot.
+        TypeStorage & storage = m_ComponentsByType[component.GetTypeId()];
+        uint32_t index = component.m_TypeIndex;
+        uint32_t last = (uint32_t)storage.components.size() - 1;
+        assert(index <= last && storage.components[index] == &component);
+        if (index != last)
+        {
+            storage.components[index] = storage.components[last];
+            storage.owners[index] = storage.owners[last];
+            storage.components[index]->m_TypeIndex = index;
+        }
+        storage.components.pop_back();
+        storage.owners.pop_back();
+        component.m_TypeIndex = UINT32_MAX;
+    }
+
+    void Scene::MoveTransforms(GameObject & gameObject, TransformStore & store)
+    {
+        for (auto component : gameObject.GetComponents())
+        {
+            if (component->GetTypeId() == Transform::TypeId)
+            {
+                static_cast<Transform *>(component)->MoveToStore(store);
+            }
         }
     }
 }
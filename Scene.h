@@ -1,21 +1,34 @@
 #pragma once
 
-#include <unordered_set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ComponentType.h"
+#include "GameObject.h"
+#include "HierarchyIndex.h"
+#include "SceneChangeJournal.h"
+#include "SceneQuery.h"
+#include "SlotMap.h"
+#include "Span.h"
+#include "TransformStore.h"
 
 namespace VulkanDemo
 {
-    class GameObject;
-
     class Scene
     {
+        friend GameObject;
+
     public:
         Scene();
         ~Scene();
 
         ///
-        /// The scene becomes the owner of the GameObjects.
+        /// The scene becomes the owner of the GameObjects, which must have been created either one by one with new, or
+        /// with GameObject::CreateBatch().
         ///
         void AddGameObjects(GameObject * gameObjects, int count);
+        void AddGameObjects(GameObject * const * gameObjects, size_t count);
 
         ///
         /// The caller becomes the owner of the GameObjects.
@@ -23,11 +36,165 @@ namespace VulkanDemo
         void RemoveGameObjects(GameObject * gameObjects, int count);
 
         ///
-        /// Returns a reference to the internal list of  GameObjects.
+        /// Returns the GameObjects of the scene, packed in a dense array. The order is not stable: removing an object
+        /// moves the last one into its place. The span is invalidated by the addition or removal of GameObjects.
+        ///
+        inline Span<GameObject * const> GetAllGameObjects() const { return m_GameObjects.GetValues(); }
+
+        ///
+        /// Returns the components of the GameObjects of the scene, packed in a dense array, with the same validity rules
+        /// as GetAllGameObjects().
+        ///
+        inline Span<Component * const> GetAllComponents() const { return m_Components.GetValues(); }
+
+        ///
+        /// Resolves a handle, returning nullptr if the object was removed from the scene or destroyed.
+        ///
+        inline GameObject * GetGameObject(GameObjectHandle handle) const { auto value = m_GameObjects.Get(handle); return value != nullptr ? *value : nullptr; }
+        inline Component * GetComponent(ComponentHandle handle) const { auto value = m_Components.Get(handle); return value != nullptr ? *value : nullptr; }
+
+        ///
+        /// Returns an object of the scene with the given name, or nullptr. Takes constant time. The string overload
+        /// doesn't intern the name.
+        ///
+        GameObject * FindGameObject(NameId name) const;
+        GameObject * FindGameObject(char const * name) const;
+
+        ///
+        /// Appends all the objects of the scene with the given name to the result.
+        ///
+        void FindGameObjects(NameId name, std::vector<GameObject *> & result) const;
+
+        ///
+        /// Reserves room for components of the given type, to add them in bulk.
+        ///
+        void ReserveComponents(ComponentType::Id typeId, size_t count);
+
+        ///
+        /// Returns the components of the given type in the scene, packed in a dense array, and their GameObjects at the
+        /// same indices. The order is not stable, and the spans are invalidated by the addition or removal of components.
+        ///
+        inline Span<Component * const> GetComponentsOfType(ComponentType::Id typeId) const { return Span<Component * const>{ m_ComponentsByType[typeId].components.data(), m_ComponentsByType[typeId].components.size() }; }
+        inline Span<GameObject * const> GetOwnersOfType(ComponentType::Id typeId) const { return Span<GameObject * const>{ m_ComponentsByType[typeId].owners.data(), m_ComponentsByType[typeId].owners.size() }; }
+
+        ///
+        /// Returns a range over the GameObjects having components of all the types Ts. For example:
+        ///
+        ///     for (auto & match : scene.Query<Transform, Camera>())
+        ///     {
+        ///         glm::mat4 const & view = match.Get<Transform>().GetWorldToLocalMatrix();
+        ///         float verticalFieldOfView = match.Get<Camera>().GetVerticalFieldOfView();
+        ///     }
+        ///
+        template<typename... Ts>
+        inline SceneQuery<Ts...> Query() const
+        {
+            return SceneQuery<Ts...>{ [this](ComponentType::Id typeId) {
+                return std::make_pair(GetComponentsOfType(typeId), GetOwnersOfType(typeId));
+            } };
+        }
+
+        ///
+        /// Returns the pre-order index of the hierarchy of the scene, rebuilding it if the hierarchy changed since the
+        /// last call. The rebuild is linear in the number of objects.
+        ///
+        HierarchyIndex const & GetHierarchyIndex();
+
+        ///
+        /// Indicates whether descendant is strictly below ancestor, both being objects of the scene. The ancestry labels
+        /// of the hierarchy index answer in constant time, and moving subtrees within the scene keeps them up to date.
+        /// After other changes, the parent chains are walked until the walks cost as much as rebuilding the index,
+        /// which is then rebuilt.
+        ///
+        bool IsDescendantOf(GameObject const & descendant, GameObject const & ancestor);
+
+        ///
+        /// Invalidates the hierarchy index and the level ordering of the transform store. GameObject calls it whenever
+        /// the parent of an object of the scene, or the set of objects, changes. When only the parent of movedRoot
+        /// changed, the ancestry labels of its subtree are updated instead of invalidated.
+        ///
+        void MarkHierarchyChanged(GameObject const * movedRoot = nullptr);
+
+        ///
+        /// Returns the object and all its descendants in the scene, in pre-order, as a contiguous range. For example, a
+        /// whole subtree can be processed with a linear sweep:
+        ///
+        ///     for (auto gameObject : scene.GetSubtree(root)) { ... }
+        ///
+        /// The range is invalidated by any change to the hierarchy.
+        ///
+        inline Span<GameObject * const> GetSubtree(GameObject const & root) { return GetHierarchyIndex().GetSubtree(root); }
+
+        ///
+        /// Returns the store holding the transforms of the GameObjects of the scene.
+        ///
+        inline TransformStore & GetTransformStore() { return m_TransformStore; }
+        inline TransformStore const & GetTransformStore() const { return m_TransformStore; }
+
+        ///
+        /// Brings all the outdated world matrices of the scene up to date, using the default thread pool. Nothing is
+        /// done if no change was recorded in the journal since the last update, and only the moved transforms are
+        /// visited when they are few.
+        ///
+        void UpdateWorldMatrices();
+
+        ///
+        /// Returns the journal of the changes of the objects of the scene. The owner of the frame loop calls EndFrame()
+        /// on it once per frame.
         ///
-        inline std::unordered_set<GameObject *> const & GetAllGameObjects() const { return m_GameObjects; }
+        inline SceneChangeJournal & GetChangeJournal() { return m_ChangeJournal; }
+        inline SceneChangeJournal const & GetChangeJournal() const { return m_ChangeJournal; }
 
     private:
-        std::unordered_set<GameObject *> m_GameObjects;
+        static void MoveTransforms(GameObject & gameObject, TransformStore & store);
+
+        void AttachGameObject(GameObject & gameObject);
+
+        ///
+        /// Removes an object being destroyed, without moving its transforms out of the store of the scene.
+        ///
+        void ForgetGameObject(GameObject & gameObject);
+
+        ///
+        /// Maintain the index of the objects by name. Objects with an empty name are not indexed.
+        ///
+        void IndexName(GameObject & gameObject);
+        void UnindexName(GameObject & gameObject, NameId name);
+        void ReserveNameIndex(size_t count);
+
+        void RegisterComponent(Component & component);
+        void UnregisterComponent(Component & component);
+
+        Scene(Scene const &other) = delete;
+        void operator=(Scene const &other) = delete;
+
+        SlotMap<GameObject *, GameObject> m_GameObjects;
+        SlotMap<Component *, Component> m_Components;
+
+        struct TypeStorage
+        {
+            std::vector<Component *> components;
+            std::vector<GameObject *> owners;
+        };
+        TypeStorage m_ComponentsByType[ComponentType::Count];
+
+        // Every object knows its position in the bucket of its name, so that it is removed in constant time.
+        std::unordered_map<NameId, std::vector<GameObject *>> m_GameObjectsByName;
+
+        TransformStore m_TransformStore;
+
+        HierarchyIndex m_HierarchyIndex;
+        bool m_IsHierarchyIndexDirty = true;    // The pre-order sequence is outdated.
+        bool m_IsAncestryDirty = true;          // The ancestry labels are outdated as well.
+        size_t m_AncestryWalkLength = 0;        // Parents walked by the ancestry tests since the labels are outdated.
+
+        // Below one moved transform in this many, the world matrices are updated one by one. Sweeping the flags of the
+        // store is fast, so only very few moves are worth it.
+        static const uint32_t SparseUpdateRatio = 256;
+
+        SceneChangeJournal m_ChangeJournal;
+        std::vector<SceneChangeJournal::Change> m_Changes;
+        uint64_t m_WorldMatricesVersion = UINT64_MAX; // State of the journal at the last update of the world matrices.
+        uint64_t m_WorldMatricesFrame = 0;
     };
 } // VulkanDemo
@@ -0,0 +1,96 @@
+#include "SceneChangeJournal.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace VulkanDemo
+{
+    const uint32_t SceneChangeJournal::HistoryLength;
+    const uint32_t SceneChangeJournal::NoChange;
+
+    SceneChangeJournal::SceneChangeJournal()
+    {
+    }
+
+    SceneChangeJournal::~SceneChangeJournal()
+    {
+    }
+
+    bool SceneChangeJournal::Record(GameObjectHandle gameObject, uint8_t flags)
+    {
+        assert(!gameObject.IsNull());
+        ++m_Version;
+        if ((flags & (Created | Destroyed | ComponentsChanged)) != 0)
+        {
+            ++m_StructureVersion;
+        }
+
+        if (gameObject.index >= m_SlotChanges.size())
+        {
+            m_SlotChanges.resize(std::max<size_t>(gameObject.index + 1, 2 * m_SlotChanges.size()), NoChange);
+        }
+
+        Frame & frame = GetFrame(m_FrameIndex);
+        frame.flags |= flags;
+
+        // The entry of the slot may belong to a destroyed object whose slot was reused.
+        uint32_t & entry = m_SlotChanges[gameObject.index];
+        if (entry != NoChange && frame.changes[entry].gameObject == gameObject)
+        {
+            Change & change = frame.changes[entry];
+            bool isNew = (flags & ~change.flags) != 0;
+            change.flags |= flags;
+            return isNew;
+        }
+
+        entry = (uint32_t)frame.changes.size();
+        frame.changes.push_back(Change{ gameObject, flags });
+        return true;
+    }
+
+    uint8_t SceneChangeJournal::GetFlags(GameObjectHandle gameObject) const
+    {
+        if (gameObject.index >= m_SlotChanges.size() || m_SlotChanges[gameObject.index] == NoChange)
+        {
+            return 0;
+        }
+
+        Change const & change = GetFrame(m_FrameIndex).changes[m_SlotChanges[gameObject.index]];
+        return change.gameObject == gameObject ? change.flags : 0;
+    }
+
+    uint8_t SceneChangeJournal::GetFlagsSince(uint64_t frame) const
+    {
+        assert(IsKnownSince(frame));
+        uint8_t flags = 0;
+        for (uint64_t i = frame; i <= m_FrameIndex; ++i)
+        {
+            flags |= GetFrame(i).flags;
+        }
+        return flags;
+    }
+
+    void SceneChangeJournal::GetChangesSince(uint64_t frame, std::vector<Change> & changes) const
+    {
+        assert(IsKnownSince(frame));
+        for (uint64_t i = frame; i <= m_FrameIndex; ++i)
+        {
+            Span<Change const> frameChanges = GetFrameChanges(i);
+            changes.insert(changes.end(), frameChanges.begin(), frameChanges.end());
+        }
+    }
+
+    void SceneChangeJournal::EndFrame()
+    {
+        for (Change const & change : GetFrame(m_FrameIndex).changes)
+        {
+            m_SlotChanges[change.gameObject.index] = NoChange;
+        }
+
+        // The list of the oldest frame is reused, keeping its capacity.
+        ++m_FrameIndex;
+        Frame & frame = GetFrame(m_FrameIndex);
+        frame.changes.clear();
+        frame.flags = 0;
+    }
+} // VulkanDemo
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "GameObject.h"
+#include "Span.h"
+
+namespace VulkanDemo
+{
+    ///
+    /// Record of the GameObjects of a scene that changed during the current frame and the few previous ones, so that
+    /// the systems mirroring the scene, such as the render snapshot, a BVH or GPU buffers, only revisit those objects.
+    ///
+    /// Every frame has a list with one entry per changed object, holding the union of its changes, and a table indexed
+    /// by the slots of the handles finds the entry of an object of the current frame. Recording and looking up a change
+    /// take constant time, and EndFrame() is linear in the number of changes, so a frame in which nothing changes costs
+    /// nothing.
+    ///
+    /// A moved transform records the change for the object and all its descendants. Once an object was destroyed, its
+    /// slot may be reused by another object within the same frame; the two have their own entries.
+    ///
+    /// Usage Notes:
+    /// - The consumers remember the frame at which they last read the journal, and read the changes since that frame.
+    ///   Only the last HistoryLength frames are kept; older consumers must rescan the whole scene.
+    /// - The journal is not thread safe. It is modified along with the scene.
+    ///
+    class SceneChangeJournal
+    {
+    public:
+        static const uint32_t HistoryLength = 4;
+
+        enum Flags : uint8_t
+        {
+            Created             = 1 << 0,   // Added to the scene.
+            Destroyed           = 1 << 1,   // Removed from the scene, or destroyed.
+            TransformChanged    = 1 << 2,   // The world matrix of the object, or of one of its ancestors, changed.
+            ComponentsChanged   = 1 << 3,   // A component was added or removed, or reported a change of its state.
+            ParentChanged       = 1 << 4,
+            AllChanges          = Created | Destroyed | TransformChanged | ComponentsChanged | ParentChanged,
+        };
+
+        struct Change
+        {
+            GameObjectHandle gameObject;
+            uint8_t flags;
+        };
+
+        SceneChangeJournal();
+        ~SceneChangeJournal();
+
+        ///
+        /// Adds changes of an object to the current frame.
+        ///
+        /// @return true if some of the flags were not recorded yet for the object during the current frame.
+        ///
+        bool Record(GameObjectHandle gameObject, uint8_t flags);
+
+        ///
+        /// Returns the changes of the object recorded during the current frame.
+        ///
+        uint8_t GetFlags(GameObjectHandle gameObject) const;
+
+        ///
+        /// Returns the changes of the current frame, one per object, in the order of their first record.
+        ///
+        inline Span<Change const> GetChanges() const { return GetFrameChanges(m_FrameIndex); }
+
+        ///
+        /// Returns the number of the current frame, starting at 0.
+        ///
+        inline uint64_t GetFrameIndex() const { return m_FrameIndex; }
+
+        ///
+        /// Returns a number that grows with every record, telling the consumers whether anything was recorded since
+        /// they last looked.
+        ///
+        inline uint64_t GetVersion() const { return m_Version; }
+
+        ///
+        /// Returns a number that grows with every object or component added, removed or changed, so that two copies
+        /// of the scene taken at the same structure version have the same objects in the same order.
+        ///
+        inline uint64_t GetStructureVersion() const { return m_StructureVersion; }
+
+        ///
+        /// Indicates whether the changes of the frames from the given one to the current one are still known.
+        ///
+        inline bool IsKnownSince(uint64_t frame) const { return frame <= m_FrameIndex && m_FrameIndex - frame < HistoryLength; }
+
+        ///
+        /// Returns the union of the changes of the frames from the given one to the current one, which must be known.
+        ///
+        uint8_t GetFlagsSince(uint64_t frame) const;
+
+        ///
+        /// Appends the changes of the frames from the given one to the current one, which must be known, to the
+        /// vector. An object changed during several of these frames appears once per frame.
+        ///
+        void GetChangesSince(uint64_t frame, std::vector<Change> & changes) const;
+
+        ///
+        /// Starts a new frame, forgetting the oldest one.
+        ///
+        void EndFrame();
+
+    private:
+        SceneChangeJournal(SceneChangeJournal const & other) = delete;
+        void operator=(SceneChangeJournal const & other) = delete;
+
+        static const uint32_t NoChange = UINT32_MAX;
+
+        struct Frame
+        {
+            std::vector<Change> changes;
+            uint8_t flags = 0;      // Union of the changes.
+        };
+
+        inline Frame & GetFrame(uint64_t frame) { return m_Frames[frame % HistoryLength]; }
+        inline Frame const & GetFrame(uint64_t frame) const { return m_Frames[frame % HistoryLength]; }
+        inline Span<Change const> GetFrameChanges(uint64_t frame) const { Frame const & data = GetFrame(frame); return Span<Change const>{ data.changes.data(), data.changes.size() }; }
+
+        Frame                   m_Frames[HistoryLength];
+        std::vector<uint32_t>   m_SlotChanges;      // Indexed by the slot of the handles, entry of the current frame or NoChange.
+        uint64_t                m_FrameIndex = 0;
+        uint64_t                m_Version = 0;
+        uint64_t                m_StructureVersion = 0;
+    };
+} // VulkanDemo
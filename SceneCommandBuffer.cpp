@@ -0,0 +1,275 @@
+#include "SceneCommandBuffer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+
+#include "GameObject.h"
+#include "Scene.h"
+
+namespace VulkanDemo
+{
+    const uint32_t SceneCommandBuffer::NoInitializer;
+
+    SceneCommandBuffer::SceneCommandBuffer()
+    {
+        // Identifiers are never reused, so that the logs cached by the threads for a destroyed buffer can't be
+        // mistaken for the logs of a new one.
+        static std::atomic<uint64_t> nextId{ 0 };
+        m_Id = nextId++;
+    }
+
+    SceneCommandBuffer::~SceneCommandBuffer()
+    {
+        assert(GetCommandCount() == 0);
+    }
+
+    GameObject * SceneCommandBuffer::CreateGameObject()
+    {
+        GameObject * gameObject = new GameObject();
+
+        Command command{};
+        command.type = CommandType::CreateGameObject;
+        command.gameObject = gameObject;
+        GetLog().commands.push_back(command);
+
+        return gameObject;
+    }
+
+    void SceneCommandBuffer::DestroyGameObject(GameObject * gameObject)
+    {
+        Command command{};
+        command.type = CommandType::DestroyGameObject;
+        command.gameObject = gameObject;
+        GetLog().commands.push_back(command);
+    }
+
+    void SceneCommandBuffer::SetParent(GameObject * gameObject, GameObject * parent)
+    {
+        Command command{};
+        command.type = CommandType::SetParent;
+        command.gameObject = gameObject;
+        command.parent = parent;
+        GetLog().commands.push_back(command);
+    }
+
+    void SceneCommandBuffer::AddComponent(GameObject * gameObject, ComponentType::Id typeId, ComponentFactory factory, std::function<void(Component &)> initializer)
+    {
+        Log & log = GetLog();
+
+        Command command{};
+        command.type = CommandType::AddComponent;
+        command.componentType = typeId;
+        command.gameObject = gameObject;
+        command.factory = factory;
+        command.initializer = NoInitializer;
+        if (initializer)
+        {
+            command.initializer = (uint32_t)log.initializers.size();
+            log.initializers.push_back(std::move(initializer));
+        }
+        log.commands.push_back(command);
+    }
+
+    void SceneCommandBuffer::RemoveComponent(GameObject * gameObject, Component * component)
+    {
+        Command command{};
+        command.type = CommandType::RemoveComponent;
+        command.componentType = component->GetTypeId();
+        command.gameObject = gameObject;
+        command.component = component;
+        GetLog().commands.push_back(command);
+    }
+
+    void SceneCommandBuffer::Playback(Scene & scene)
+    {
+        struct Entry
+        {
+            Command const * command;
+            Log const * log;
+        };
+
+        // Group by phase, and by component type within the component phases, with a counting sort. The sort is
+        // stable, so the logs keep their order, and the logs are in creation order.
+        auto key = [](Command const & command) {
+            bool hasComponentType = command.type == CommandType::AddComponent || command.type == CommandType::RemoveComponent;
+            return (uint32_t)command.type * (ComponentType::Count + 1) + (hasComponentType ? command.componentType : ComponentType::Count);
+        };
+        static const uint32_t KeyCount = ((uint32_t)CommandType::DestroyGameObject + 1) * (ComponentType::Count + 1);
+
+        size_t offsets[KeyCount + 1] = {};
+        for (auto const & log : m_Logs)
+        {
+            for (auto const & command : log->commands)
+            {
+                ++offsets[key(command) + 1];
+            }
+        }
+        for (uint32_t i = 1; i <= KeyCount; ++i)
+        {
+            offsets[i] += offsets[i - 1];
+        }
+
+        std::vector<Entry> entries(offsets[KeyCount]);
+        for (auto const & log : m_Logs)
+        {
+            for (auto const & command : log->commands)
+            {
+                entries[offsets[key(command)]++] = Entry{ &command, log.get() };
+            }
+        }
+
+        // The destroy commands come last. An object may have been destroyed by several threads.
+        std::vector<GameObject *> destroyedObjects;
+        for (auto iter = entries.rbegin(); iter != entries.rend() && iter->command->type == CommandType::DestroyGameObject; ++iter)
+        {
+            destroyedObjects.push_back(iter->command->gameObject);
+        }
+        std::sort(destroyedObjects.begin(), destroyedObjects.end());
+        destroyedObjects.erase(std::unique(destroyedObjects.begin(), destroyedObjects.end()), destroyedObjects.end());
+
+        auto begin = entries.begin();
+        while (begin != entries.end())
+        {
+            CommandType type = begin->command->type;
+            auto end = std::find_if(begin, entries.end(), [type](Entry const & entry) { return entry.command->type != type; });
+            size_t count = end - begin;
+
+            switch (type)
+            {
+            case CommandType::CreateGameObject:
+            {
+                std::vector<GameObject *> gameObjects(count);
+                for (size_t i = 0; i < count; ++i)
+                {
+                    gameObjects[i] = begin[i].command->gameObject;
+                }
+                scene.AddGameObjects(gameObjects.data(), gameObjects.size());
+                break;
+            }
+
+            case CommandType::AddComponent:
+            {
+                uint32_t countByType[ComponentType::Count] = {};
+                for (auto iter = begin; iter != end; ++iter)
+                {
+                    ++countByType[iter->command->componentType];
+                }
+                for (uint32_t typeId = 0; typeId < ComponentType::Count; ++typeId)
+                {
+                    scene.ReserveComponents((ComponentType::Id)typeId, countByType[typeId]);
+                }
+
+                for (auto iter = begin; iter != end; ++iter)
+                {
+                    Command const & command = *iter->command;
+                    Component * component = command.factory();
+                    if (command.initializer != NoInitializer)
+                    {
+                        iter->log->initializers[command.initializer](*component);
+                    }
+                    command.gameObject->AddComponent(*component);
+                }
+                break;
+            }
+
+            case CommandType::SetParent:
+                for (auto iter = begin; iter != end; ++iter)
+                {
+                    iter->command->gameObject->SetParent(iter->command->parent);
+                }
+                break;
+
+            case CommandType::RemoveComponent:
+            {
+                // A component may have been removed by several threads, and the components of the destroyed objects
+                // are deleted with them. Sorting by component within a type keeps the types grouped.
+                std::vector<Command const *> commands(count);
+                for (size_t i = 0; i < count; ++i)
+                {
+                    commands[i] = begin[i].command;
+                }
+                std::sort(commands.begin(), commands.end(), [](Command const * a, Command const * b) {
+                    return a->componentType != b->componentType ? a->componentType < b->componentType : a->component < b->component;
+                });
+                commands.erase(std::unique(commands.begin(), commands.end(), [](Command const * a, Command const * b) {
+                    return a->component == b->component;
+                }), commands.end());
+
+                for (auto command : commands)
+                {
+                    assert(command->component->GetGameObject() == command->gameObject);
+                    if (std::binary_search(destroyedObjects.begin(), destroyedObjects.end(), command->gameObject))
+                    {
+                        continue;
+                    }
+                    command->gameObject->RemoveComponent(*command->component);
+                    delete command->component;
+                }
+                break;
+            }
+
+            case CommandType::DestroyGameObject:
+                for (auto gameObject : destroyedObjects)
+                {
+                    delete gameObject;
+                }
+                break;
+            }
+
+            begin = end;
+        }
+
+        for (auto & log : m_Logs)
+        {
+            log->commands.clear();
+            log->initializers.clear();
+        }
+    }
+
+    size_t SceneCommandBuffer::GetCommandCount() const
+    {
+        std::lock_guard<std::mutex> lock{ m_Mutex };
+
+        size_t count = 0;
+        for (auto const & log : m_Logs)
+        {
+            count += log->commands.size();
+        }
+        return count;
+    }
+
+    SceneCommandBuffer::Log & SceneCommandBuffer::GetLog()
+    {
+        struct CachedLog
+        {
+            uint64_t bufferId;
+            Log * log;
+        };
+        static thread_local std::vector<CachedLog> cache;
+
+        for (auto const & cached : cache)
+        {
+            if (cached.bufferId == m_Id)
+            {
+                return *cached.log;
+            }
+        }
+
+        // Forget the oldest buffers. If one of them is still alive, the thread gets a new log, created after the
+        // previous one, which preserves the order of its commands.
+        static const size_t MaxCachedLogs = 16;
+        if (cache.size() >= MaxCachedLogs)
+        {
+            cache.erase(cache.begin());
+        }
+
+        Log * log = new Log();
+        {
+            std::lock_guard<std::mutex> lock{ m_Mutex };
+            m_Logs.push_back(std::unique_ptr<Log>(log));
+        }
+        cache.push_back(CachedLog{ m_Id, log });
+        return *log;
+    }
+} // VulkanDemo
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "ComponentType.h"
+
+namespace VulkanDemo
+{
+    class Component;
+    class GameObject;
+    class Scene;
+
+    ///
+    /// Records structural changes of a scene from any thread, to apply them later at a sync point with Playback().
+    ///
+    /// Every thread appends to its own log, so recording takes no lock after the first command of a thread. Playback
+    /// applies the commands by phase rather than in submission order, so that the changes to every container are
+    /// batched together:
+    ///
+    /// 1. the created objects are added to the scene,
+    /// 2. the components are created and added, grouped by type,
+    /// 3. the parents are changed,
+    /// 4. the components are removed and destroyed,
+    /// 5. the objects are destroyed.
+    ///
+    /// Within a phase, the commands of a thread keep their order. The order between threads is unspecified.
+    ///
+    /// Usage Notes:
+    /// - Recording and playback must not overlap. The scene must not be modified concurrently with the playback.
+    /// - The objects returned by CreateGameObject() are only known to the recording thread until the playback. They can
+    ///   be named and given a parent that is not in a scene yet, but components must be added through the buffer.
+    /// - A command must not refer to an object destroyed by an earlier playback.
+    ///
+    class SceneCommandBuffer
+    {
+    public:
+        SceneCommandBuffer();
+        ~SceneCommandBuffer();
+
+        ///
+        /// Creates an object which will be added to the scene during the playback.
+        ///
+        GameObject * CreateGameObject();
+
+        ///
+        /// Destroys the object and its components during the playback. Its children are detached.
+        ///
+        void DestroyGameObject(GameObject * gameObject);
+
+        void SetParent(GameObject * gameObject, GameObject * parent);
+
+        ///
+        /// Creates a component of type T during the playback, calls the initializer on it, if any, and adds it to the
+        /// object.
+        ///
+        template<typename T>
+        void AddComponent(GameObject * gameObject, std::function<void(T &)> initializer = nullptr)
+        {
+            std::function<void(Component &)> erased;
+            if (initializer)
+            {
+                erased = [initializer](Component & component) { initializer(static_cast<T &>(component)); };
+            }
+            AddComponent(gameObject, T::TypeId, [] { return static_cast<Component *>(new T()); }, std::move(erased));
+        }
+
+        ///
+        /// Removes the component from its object and destroys it during the playback. The component may be removed by
+        /// several threads, or belong to an object destroyed by the same playback.
+        ///
+        void RemoveComponent(GameObject * gameObject, Component * component);
+
+        ///
+        /// Applies and clears all the recorded commands.
+        ///
+        void Playback(Scene & scene);
+
+        ///
+        /// Returns the number of commands recorded since the last playback. Must not be called while recording.
+        ///
+        size_t GetCommandCount() const;
+
+    private:
+        SceneCommandBuffer(SceneCommandBuffer const & other) = delete;
+        void operator=(SceneCommandBuffer const & other) = delete;
+
+        enum class CommandType : uint8_t
+        {
+            CreateGameObject,
+            AddComponent,
+            SetParent,
+            RemoveComponent,
+            DestroyGameObject,
+        };
+
+        typedef Component * (*ComponentFactory)();
+
+        struct Command
+        {
+            CommandType         type;
+            ComponentType::Id   componentType;
+            GameObject *        gameObject;
+            GameObject *        parent;
+            Component *         component;
+            ComponentFactory    factory;
+            uint32_t            initializer; // Index in the initializers of the log, or NoInitializer.
+        };
+
+        struct Log
+        {
+            std::vector<Command> commands;
+            std::vector<std::function<void(Component &)>> initializers;
+        };
+
+        static const uint32_t NoInitializer = UINT32_MAX;
+
+        void AddComponent(GameObject * gameObject, ComponentType::Id typeId, ComponentFactory factory, std::function<void(Component &)> initializer);
+
+        ///
+        /// Returns the log of the calling thread, creating it on the first call.
+        ///
+        Log & GetLog();
+
+        uint64_t                            m_Id;
+        mutable std::mutex                  m_Mutex;
+        std::vector<std::unique_ptr<Log>>   m_Logs;
+    };
+} // VulkanDemo
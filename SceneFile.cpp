@@ -0,0 +1,326 @@
+#include "SceneFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "Camera.h"
+#include "GameObject.h"
+#include "MappedFile.h"
+#include "NameTable.h"
+#include "Scene.h"
+#include "Transform.h"
+
+namespace VulkanDemo
+{
+    namespace SceneFile
+    {
+        namespace
+        {
+            static const uint64_t TableAlignment = 16;
+            static const uint32_t SavedComponentMask = ComponentType::GetMask(ComponentType::Transform) | ComponentType::GetMask(ComponentType::Camera);
+
+            static_assert(sizeof(glm::vec3) == 12 && sizeof(glm::quat) == 16, "The file stores the glm types as they are in memory.");
+
+            ///
+            /// Pointers to the tables of a mapped file.
+            ///
+            struct Contents
+            {
+                Header const * header;
+                uint32_t const * parents;
+                NameRecord const * names;
+                uint32_t const * componentMasks;
+                glm::vec3 const * localPositions;
+                glm::quat const * localRotations;
+                glm::vec3 const * localScales;
+                CameraRecord const * cameras;
+                char const * strings;
+                uint64_t stringsSize;
+            };
+
+            inline uint64_t Align(uint64_t offset)
+            {
+                return (offset + TableAlignment - 1) & ~(TableAlignment - 1);
+            }
+
+            ///
+            /// Turns the range of a table into a pointer, checking that it lies in the file and holds count values.
+            ///
+            template<typename T>
+            bool ResolveTable(MappedFile const & file, Header const & header, Table table, uint64_t count, T const * & values)
+            {
+                TableRange const & range = header.tables[table];
+                if (range.offset % TableAlignment != 0 || range.offset > file.GetSize() || range.size > file.GetSize() - range.offset)
+                {
+                    return false;
+                }
+                if (range.size != count * sizeof(T))
+                {
+                    return false;
+                }
+
+                values = reinterpret_cast<T const *>(file.GetData() + range.offset);
+                return true;
+            }
+
+            ///
+            /// Fixes up the pointers to the tables and checks the references between them, so that loading can trust
+            /// the data.
+            ///
+            bool Resolve(MappedFile const & file, Contents & contents)
+            {
+                if (file.GetSize() < sizeof(Header))
+                {
+                    return false;
+                }
+
+                Header const & header = *reinterpret_cast<Header const *>(file.GetData());
+                if (header.magic != Magic || header.version != Version || header.tableCount != TableCount)
+                {
+                    return false;
+                }
+                contents.header = &header;
+
+                uint32_t objectCount = header.objectCount;
+                contents.stringsSize = header.tables[Strings].size;
+                if (!ResolveTable(file, header, Parents, objectCount, contents.parents) ||
+                    !ResolveTable(file, header, Names, objectCount, contents.names) ||
+                    !ResolveTable(file, header, ComponentMasks, objectCount, contents.componentMasks) ||
+                    !ResolveTable(file, header, LocalPositions, header.transformCount, contents.localPositions) ||
+                    !ResolveTable(file, header, LocalRotations, header.transformCount, contents.localRotations) ||
+                    !ResolveTable(file, header, LocalScales, header.transformCount, contents.localScales) ||
+                    !ResolveTable(file, header, Cameras, header.cameraCount, contents.cameras) ||
+                    !ResolveTable(file, header, Strings, contents.stringsSize, contents.strings))
+                {
+                    return false;
+                }
+
+                uint32_t transformCount = 0;
+                uint32_t cameraCount = 0;
+                for (uint32_t i = 0; i < objectCount; ++i)
+                {
+                    // Parents precede their children, which also rules out cycles.
+                    uint32_t parent = contents.parents[i];
+                    if (parent != NoParent && parent >= i)
+                    {
+                        return false;
+                    }
+
+                    NameRecord const & name = contents.names[i];
+                    if (name.offset > contents.stringsSize || name.length > contents.stringsSize - name.offset)
+                    {
+                        return false;
+                    }
+
+                    uint32_t mask = contents.componentMasks[i];
+                    if ((mask & ~SavedComponentMask) != 0)
+                    {
+                        return false;
+                    }
+                    transformCount += (mask & ComponentType::GetMask(ComponentType::Transform)) != 0 ? 1 : 0;
+                    cameraCount += (mask & ComponentType::GetMask(ComponentType::Camera)) != 0 ? 1 : 0;
+                }
+
+                return transformCount == header.transformCount && cameraCount == header.cameraCount;
+            }
+
+            template<typename T>
+            void WriteTable(std::vector<uint8_t> & buffer, Header & header, Table table, T const * values, size_t count)
+            {
+                uint64_t offset = Align(buffer.size());
+                uint64_t size = count * sizeof(T);
+                buffer.resize((size_t)(offset + size));
+                if (size > 0)
+                {
+                    memcpy(buffer.data() + offset, values, (size_t)size);
+                }
+
+                header.tables[table].offset = offset;
+                header.tables[table].size = size;
+            }
+        }
+
+        bool Save(Scene & scene, char const * path)
+        {
+            Span<GameObject * const> order = scene.GetHierarchyIndex().GetOrder();
+            uint32_t objectCount = (uint32_t)order.size();
+
+            // Index of every object in the file, by slot of its handle.
+            uint32_t slotCount = 0;
+            for (GameObject * gameObject : order)
+            {
+                slotCount = std::max(slotCount, gameObject->GetHandle().index + 1);
+            }
+            std::vector<uint32_t> fileIndices(slotCount, NoParent);
+
+            std::vector<uint32_t> parents(objectCount);
+            std::vector<NameRecord> names(objectCount);
+            std::vector<uint32_t> componentMasks(objectCount);
+            std::vector<glm::vec3> localPositions;
+            std::vector<glm::quat> localRotations;
+            std::vector<glm::vec3> localScales;
+            std::vector<CameraRecord> cameras;
+            std::vector<char> strings;
+            std::unordered_map<NameId, NameRecord> savedNames;
+
+            NameTable & nameTable = NameTable::GetInstance();
+            for (uint32_t i = 0; i < objectCount; ++i)
+            {
+                GameObject * gameObject = order[i];
+                fileIndices[gameObject->GetHandle().index] = i;
+
+                GameObject * parent = gameObject->GetParent();
+                parents[i] = parent != nullptr && parent->GetScene() == &scene ? fileIndices[parent->GetHandle().index] : NoParent;
+
+                // Every distinct name is stored once.
+                NameId name = gameObject->GetNameId();
+                auto savedName = savedNames.find(name);
+                if (savedName == savedNames.end())
+                {
+                    NameRecord record{ (uint32_t)strings.size(), nameTable.GetLength(name) };
+                    char const * string = nameTable.GetString(name);
+                    strings.insert(strings.end(), string, string + record.length);
+                    savedName = savedNames.emplace(name, record).first;
+                }
+                names[i] = savedName->second;
+
+                uint32_t mask = 0;
+                if (Transform * transform = gameObject->GetTransform())
+                {
+                    mask |= ComponentType::GetMask(ComponentType::Transform);
+                    localPositions.push_back(transform->GetLocalPosition());
+                    localRotations.push_back(transform->GetLocalRotation());
+                    localScales.push_back(transform->GetLocalScale());
+                }
+                if (Camera * camera = gameObject->GetComponent<Camera>())
+                {
+                    mask |= ComponentType::GetMask(ComponentType::Camera);
+                    cameras.push_back(CameraRecord{ camera->GetNear(), camera->GetFar(), camera->GetVerticalFieldOfView() });
+                }
+                componentMasks[i] = mask;
+            }
+
+            Header header = {};
+            header.magic = Magic;
+            header.version = Version;
+            header.objectCount = objectCount;
+            header.transformCount = (uint32_t)localPositions.size();
+            header.cameraCount = (uint32_t)cameras.size();
+            header.tableCount = TableCount;
+
+            std::vector<uint8_t> buffer(sizeof(Header));
+            WriteTable(buffer, header, Parents, parents.data(), parents.size());
+            WriteTable(buffer, header, Names, names.data(), names.size());
+            WriteTable(buffer, header, ComponentMasks, componentMasks.data(), componentMasks.size());
+            WriteTable(buffer, header, LocalPositions, localPositions.data(), localPositions.size());
+            WriteTable(buffer, header, LocalRotations, localRotations.data(), localRotations.size());
+            WriteTable(buffer, header, LocalScales, localScales.data(), localScales.size());
+            WriteTable(buffer, header, Cameras, cameras.data(), cameras.size());
+            WriteTable(buffer, header, Strings, strings.data(), strings.size());
+            memcpy(buffer.data(), &header, sizeof(Header));
+
+            std::ofstream file;
+            file.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+            if (!file.is_open())
+            {
+                return false;
+            }
+            file.write(reinterpret_cast<char const *>(buffer.data()), buffer.size());
+            return file.good();
+        }
+
+        bool Instantiate(MappedFile const & file, TransformStore & store, GameObject * & gameObjects, uint32_t & count)
+        {
+            gameObjects = nullptr;
+            count = 0;
+
+            Contents contents;
+            if (!Resolve(file, contents))
+            {
+                return false;
+            }
+
+            Header const & header = *contents.header;
+            uint32_t objectCount = header.objectCount;
+            if (objectCount == 0)
+            {
+                return true;
+            }
+
+            gameObjects = GameObject::CreateBatch(objectCount);
+            count = objectCount;
+
+            NameTable & nameTable = NameTable::GetInstance();
+            for (uint32_t i = 0; i < objectCount; ++i)
+            {
+                NameRecord const & name = contents.names[i];
+                if (name.length > 0)
+                {
+                    gameObjects[i].SetName(nameTable.Intern(contents.strings + name.offset, name.length));
+                }
+            }
+
+            // The local values are copied from the mapping into the store, which is the only copy. The components are
+            // added before the hierarchy is linked, so that adding a transform doesn't walk a subtree.
+            Transform * transforms = nullptr;
+            if (header.transformCount > 0)
+            {
+                transforms = Transform::CreateBatch(store, header.transformCount, contents.localPositions,
+                    contents.localRotations, contents.localScales);
+            }
+            Camera * cameras = header.cameraCount > 0 ? Camera::CreateBatch(header.cameraCount) : nullptr;
+
+            uint32_t transformIndex = 0;
+            uint32_t cameraIndex = 0;
+            for (uint32_t i = 0; i < objectCount; ++i)
+            {
+                uint32_t mask = contents.componentMasks[i];
+                if ((mask & ComponentType::GetMask(ComponentType::Transform)) != 0)
+                {
+                    gameObjects[i].AddComponent(transforms[transformIndex++]);
+                }
+                if ((mask & ComponentType::GetMask(ComponentType::Camera)) != 0)
+                {
+                    CameraRecord const & record = contents.cameras[cameraIndex];
+                    Camera & camera = cameras[cameraIndex++];
+                    camera.SetNear(record.nearPlane);
+                    camera.SetFar(record.farPlane);
+                    camera.SetVerticalFieldOfView(record.verticalFieldOfView);
+                    gameObjects[i].AddComponent(camera);
+                }
+            }
+
+            // In pre-order, an object has no children yet when it is linked, so every link takes constant time.
+            for (uint32_t i = 0; i < objectCount; ++i)
+            {
+                uint32_t parent = contents.parents[i];
+                if (parent != NoParent)
+                {
+                    gameObjects[i].SetParent(&gameObjects[parent]);
+                }
+            }
+
+            return true;
+        }
+
+        bool Load(char const * path, Scene & scene)
+        {
+            MappedFile file;
+            GameObject * gameObjects;
+            uint32_t count;
+            if (!file.Open(path) || !Instantiate(file, scene.GetTransformStore(), gameObjects, count))
+            {
+                return false;
+            }
+
+            scene.AddGameObjects(gameObjects, (int)count);
+            return true;
+        }
+    } // SceneFile
+} // VulkanDemo
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+
+namespace VulkanDemo
+{
+    class GameObject;
+    class MappedFile;
+    class Scene;
+    class TransformStore;
+
+    ///
+    /// Binary scene format, designed to be memory-mapped and loaded without parsing.
+    ///
+    /// A file is a header followed by flat tables, one value per object in the same order for the per-object tables.
+    /// Every reference is an offset from the start of the file or an index in a table, so the file can be mapped at
+    /// any address: loading only turns the offsets of the header into pointers. Objects are stored in pre-order, so a
+    /// parent always precedes its children, and the transforms are stored as the arrays of local values of the
+    /// TransformStore, which are copied into the store of the scene at once.
+    ///
+    /// The values are stored in the memory layout of the machine (little-endian, glm types) and the tables are aligned
+    /// on 16 bytes. Only the primary transform and the first camera of every object are saved.
+    ///
+    namespace SceneFile
+    {
+        static const uint32_t Magic = 0x43534456; // "VDSC"
+        static const uint32_t Version = 1;
+
+        enum Table : uint32_t
+        {
+            Parents,            // uint32_t per object: index of the parent, or NoParent.
+            Names,              // NameRecord per object.
+            ComponentMasks,     // uint32_t per object: ComponentType masks of the saved components.
+            LocalPositions,     // glm::vec3 per object having a transform, in the order of the objects.
+            LocalRotations,     // glm::quat per object having a transform.
+            LocalScales,        // glm::vec3 per object having a transform.
+            Cameras,            // CameraRecord per object having a camera.
+            Strings,            // Characters of the names, not null-terminated.
+            TableCount,
+        };
+
+        static const uint32_t NoParent = UINT32_MAX;
+
+        struct TableRange
+        {
+            uint64_t offset;
+            uint64_t size;
+        };
+
+        struct Header
+        {
+            uint32_t magic;
+            uint32_t version;
+            uint32_t objectCount;
+            uint32_t transformCount;
+            uint32_t cameraCount;
+            uint32_t tableCount;
+            TableRange tables[TableCount];
+        };
+
+        struct NameRecord
+        {
+            uint32_t offset;    // In the string table.
+            uint32_t length;    // 0 for an empty name.
+        };
+
+        struct CameraRecord
+        {
+            float nearPlane;
+            float farPlane;
+            float verticalFieldOfView;
+        };
+
+        ///
+        /// Saves the GameObjects of the scene. Parents that are not part of the scene are not saved, their children
+        /// become roots.
+        ///
+        /// @return false if the file could not be written.
+        ///
+        bool Save(Scene & scene, char const * path);
+
+        ///
+        /// Checks a mapped file and creates its objects in pre-order, with their hierarchy and components, without
+        /// adding them to a scene. The transforms are allocated in the given store. The objects are created with
+        /// GameObject::CreateBatch(); gameObjects is nullptr when the file has no object.
+        ///
+        /// Only thread-safe systems are used, so this can run on a background thread as long as the store is not used
+        /// by another thread.
+        ///
+        /// @return false if the file is not a valid scene file, in which case nothing is created.
+        ///
+        bool Instantiate(MappedFile const & file, TransformStore & store, GameObject * & gameObjects, uint32_t & count);
+
+        ///
+        /// Maps the file, checks it, and adds its objects to the scene. Nothing is added if the file is not valid.
+        ///
+        /// @return false if the file could not be mapped, has another version, or is not a valid scene file.
+        ///
+        bool Load(char const * path, Scene & scene);
+    } // SceneFile
+} // VulkanDemo
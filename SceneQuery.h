@@ -0,0 +1,104 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+#include "ComponentType.h"
+#include "GameObject.h"
+#include "Span.h"
+
+namespace VulkanDemo
+{
+    ///
+    /// Range over the GameObjects of a scene having at least one component of each of the types Ts.
+    ///
+    /// The iteration walks the dense storage of the rarest of the types, and skips the owners missing one of the other
+    /// types by testing their component mask. An object having several components of the rarest type is visited once
+    /// per component; the other types resolve to the first component of that type.
+    ///
+    /// The range is invalidated by the addition or removal of components in the scene.
+    ///
+    template<typename... Ts>
+    class SceneQuery
+    {
+    public:
+        class Iterator
+        {
+        public:
+            Iterator(SceneQuery const & query, uint32_t index) : m_Query{ &query }, m_Index{ index } { SkipMismatches(); }
+
+            inline GameObject & GetGameObject() const { return *m_Query->m_Owners[m_Index]; }
+
+            template<typename T>
+            inline T & Get() const
+            {
+                Component * component = T::TypeId == m_Query->m_DrivingType ? m_Query->m_Components[m_Index] : GetGameObject().GetComponent(T::TypeId);
+                return *static_cast<T *>(component);
+            }
+
+            inline Iterator & operator*() { return *this; }
+            inline Iterator & operator++() { ++m_Index; SkipMismatches(); return *this; }
+            inline bool operator!=(Iterator const & other) const { return m_Index != other.m_Index; }
+            inline bool operator==(Iterator const & other) const { return m_Index == other.m_Index; }
+
+        private:
+            inline void SkipMismatches()
+            {
+                while (m_Index < m_Query->m_Owners.size() && !m_Query->m_Owners[m_Index]->HasComponents(m_Query->m_Mask))
+                {
+                    ++m_Index;
+                }
+            }
+
+            SceneQuery const * m_Query;
+            uint32_t m_Index;
+        };
+
+        ///
+        /// @param[in] getStorage   Callable returning the components of a type and their owners, as a pair of spans.
+        ///
+        template<typename GetStorage>
+        explicit SceneQuery(GetStorage getStorage)
+        {
+            ComponentType::Id const typeIds[] = { Ts::TypeId... };
+            m_DrivingType = typeIds[0];
+            m_Mask = 0;
+            for (auto typeId : typeIds)
+            {
+                m_Mask |= ComponentType::GetMask(typeId);
+                if (getStorage(typeId).first.size() < getStorage(m_DrivingType).first.size())
+                {
+                    m_DrivingType = typeId;
+                }
+            }
+
+            auto storage = getStorage(m_DrivingType);
+            m_Components = storage.first;
+            m_Owners = storage.second;
+        }
+
+        inline Iterator begin() const { return Iterator{ *this, 0 }; }
+        inline Iterator end() const { return Iterator{ *this, (uint32_t)m_Owners.size() }; }
+
+        ///
+        /// Calls function(GameObject &, Ts &...) for every match.
+        ///
+        template<typename Function>
+        void ForEach(Function function) const
+        {
+            for (auto & match : *this)
+            {
+                function(match.GetGameObject(), match.template Get<Ts>()...);
+            }
+        }
+
+    private:
+        static_assert(sizeof...(Ts) > 0, "A query needs at least one component type.");
+
+        ComponentType::Id m_DrivingType;
+        uint32_t m_Mask;
+        Span<Component * const> m_Components;
+        Span<GameObject * const> m_Owners;
+    };
+} // VulkanDemo
@@ -2,10 +2,13 @@
 
 #include <array>
 #include <cassert>
+#include <cstring>
 
 #include "Application.h"
 #include "Configuration.h"
-#include "Scene.h"
+#include "GraphicsHelper.h"
+#include "InstancePipelineGenerator.h"
+#include "RenderSnapshot.h"
 #include "VulkanManager.h"
 
 namespace VulkanDemo
@@ -15,7 +18,25 @@ namespace VulkanDemo
     {
         m_VulkanManager = Application::GetInstance().GetVulkanManager();
 
+        // The instance buffer is bound at the binding offset of every batch, with a dynamic offset, and the shaders
+        // index it within the range of a binding. A multiple of 64 instances keeps the offsets of the instance data and
+        // of the visible instances of the GPU culling aligned, since minStorageBufferOffsetAlignment is at most 256.
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(m_VulkanManager->GetPhysicalDevice(), &properties);
+        uint32_t maxInstanceCount = properties.limits.maxStorageBufferRange / sizeof(InstanceBatcher::InstanceData) / 64 * 64;
+        m_InstanceBatcher.SetMaxInstanceCount(maxInstanceCount);
+
+        // Without multiDrawIndirect, maxDrawIndirectCount is 1.
+        VkPhysicalDeviceFeatures const & features = m_VulkanManager->GetEnabledFeatures();
+        m_DrawCommandBuilder.SetMaxDrawIndirectCount(properties.limits.maxDrawIndirectCount);
+        if (features.drawIndirectFirstInstance)
+        {
+            m_DrawPath = features.multiDrawIndirect ? DrawCommandBuilder::Path::MultiDrawIndirect : DrawCommandBuilder::Path::SingleDrawIndirect;
+        }
+
         CreateForwardRenderPass();
+        m_InstancePipeline = new InstancePipelineGenerator(m_ForwardRenderPass, 0, false);
+        CreateDescriptorSet();
         CreateCommandBuffer();
         CreateSynchronization();
     }
@@ -27,8 +48,14 @@ namespace VulkanDemo
             DestroyFramebuffer();
         }
 
+        delete m_GpuCuller;
+        m_GpuCuller = nullptr;
+
         DestroySynchronization();
         DestroyCommandBuffer();
+        DestroyDescriptorSet();
+        delete m_InstancePipeline;
+        m_InstancePipeline = nullptr;
         DestroyForwardRenderpass();
 
         m_VulkanManager = nullptr;
@@ -40,8 +67,17 @@ namespace VulkanDemo
         CheckResult(vkWaitForFences(m_VulkanManager->GetDevice(), 1, &m_Fence, VK_TRUE, UINT64_MAX));
         CheckResult(vkResetFences(m_VulkanManager->GetDevice(), 1, &m_Fence));
 
+        // The results of the culling of the previous frame are complete.
+        if (m_GpuCuller != nullptr)
+        {
+            m_GpuCuller->Validate();
+        }
+
         UpdateFramebuffer(renderInfo.width, renderInfo.height);
 
+        CullViews(renderInfo);
+        BatchDraws(renderInfo);
+
         // Compute the command buffer.
         {
             VkCommandBufferBeginInfo commandBufferBeginInfo{};
@@ -51,6 +87,12 @@ namespace VulkanDemo
             commandBufferBeginInfo.pInheritanceInfo = NULL;
             CheckResult(vkBeginCommandBuffer(m_CommandBuffer, &commandBufferBeginInfo));
 
+            // The culling tests the depth buffer before the render pass clears it.
+            if (m_GpuCuller != nullptr)
+            {
+                m_GpuCuller->RecordCulling(m_CommandBuffer);
+            }
+
             std::array<VkClearValue, 2> clearValues;
             clearValues[0].color.float32[0] = 1;
             clearValues[0].color.float32[1] = 1;
@@ -72,10 +114,18 @@ namespace VulkanDemo
             renderPassBeginInfo.pClearValues = clearValues.data();
             vkCmdBeginRenderPass(m_CommandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-            // TODO: Render the objects according to the camera.
+            if (m_InstanceBatcher.GetInstanceCount() != 0)
+            {
+                RecordDraws();
+            }
 
             vkCmdEndRenderPass(m_CommandBuffer);
 
+            if (m_GpuCuller != nullptr)
+            {
+                m_GpuCuller->RecordPyramid(m_CommandBuffer);
+            }
+
             CheckResult(vkEndCommandBuffer(m_CommandBuffer));
         }
 
@@ -111,6 +161,244 @@ namespace VulkanDemo
         renderResult.waitSemaphore = m_Semaphore;
     }
 
+    void SceneRenderer::CullViews(SceneRenderInfo const & renderInfo)
+    {
+        m_RenderQueue.Clear();
+        if (renderInfo.snapshot == nullptr || renderInfo.snapshot->GetCameras().empty())
+        {
+            m_Views.clear();
+            return;
+        }
+        RenderSnapshot const & snapshot = *renderInfo.snapshot;
+
+        m_Views = renderInfo.views;
+        if (m_Views.empty())
+        {
+            SceneView view{};
+            view.camera = 0;
+            view.viewport.extent.width = (uint32_t)m_Width;
+            view.viewport.extent.height = (uint32_t)m_Height;
+            m_Views.push_back(view);
+        }
+        if (m_Views.size() > FrustumCuller::MaxFrustumCount)
+        {
+            Fail("More views than FrustumCuller::MaxFrustumCount.");
+        }
+
+        // The objects are culled against the frustums of all the views in a single pass. With the GPU culling, this
+        // coarse pass spares the levels of detail, the sort and the batching of the objects out of the views.
+        m_Frustums.clear();
+        m_ViewProjections.clear();
+        for (SceneView const & view : m_Views)
+        {
+            CameraSnapshot const & camera = snapshot.GetCameras()[view.camera];
+            float aspectRatio = (float)view.viewport.extent.width / view.viewport.extent.height;
+            m_Frustums.push_back(camera.GetFrustum(aspectRatio));
+            m_ViewProjections.push_back(camera.GetViewProjectionMatrix(aspectRatio));
+        }
+        Span<uint32_t const> inFrustums = m_FrustumCuller.Cull(Span<Frustum const>{ m_Frustums.data(), m_Frustums.size() }, snapshot.GetPackedWorldBounds());
+        Span<uint32_t const> frustumMasks = m_FrustumCuller.GetFrustumMasks();
+
+        // The occlusion and the levels of detail depend on the point of view, so they are computed per view. The
+        // GpuCuller tests the occlusion of the instances itself.
+        for (uint32_t v = 0; v < (uint32_t)m_Views.size(); ++v)
+        {
+            SceneView const & view = m_Views[v];
+            CameraSnapshot const & camera = snapshot.GetCameras()[view.camera];
+
+            m_ViewObjects.clear();
+            for (size_t i = 0; i < inFrustums.size(); ++i)
+            {
+                if ((frustumMasks[i] >> v) & 1)
+                {
+                    m_ViewObjects.push_back(inFrustums[i]);
+                }
+            }
+
+            Span<uint32_t const> visibleObjects{ m_ViewObjects.data(), m_ViewObjects.size() };
+            if (m_GpuCuller == nullptr)
+            {
+                m_OcclusionCuller.RenderOccluders(snapshot, camera, (float)view.viewport.extent.width / view.viewport.extent.height);
+                visibleObjects = m_OcclusionCuller.Cull(visibleObjects, snapshot.GetWorldBounds());
+            }
+            Span<uint8_t const> visibleLevels = m_LodSelector.Select(snapshot, camera, view.viewport.extent.height, visibleObjects, v);
+            m_RenderQueue.AddView(snapshot, camera, visibleObjects, visibleLevels);
+        }
+
+        m_RenderQueue.Sort();
+    }
+
+    void SceneRenderer::PrintStats() const
+    {
+        m_RenderQueue.PrintStats();
+        m_DrawCommandBuilder.PrintStats();
+    }
+
+    void SceneRenderer::SetDrawPath(DrawCommandBuilder::Path drawPath)
+    {
+        VkPhysicalDeviceFeatures const & features = m_VulkanManager->GetEnabledFeatures();
+        if (drawPath != DrawCommandBuilder::Path::Direct && !features.drawIndirectFirstInstance)
+        {
+            Fail("The indirect draws need the drawIndirectFirstInstance feature.");
+        }
+        if (drawPath == DrawCommandBuilder::Path::MultiDrawIndirect && !features.multiDrawIndirect)
+        {
+            Fail("The multi-draw indirect path needs the multiDrawIndirect feature.");
+        }
+        if (drawPath == DrawCommandBuilder::Path::Direct && m_GpuCuller != nullptr)
+        {
+            Fail("The GPU culling needs an indirect path.");
+        }
+        m_DrawPath = drawPath;
+    }
+
+    void SceneRenderer::SetGpuCulling(bool isEnabled)
+    {
+        if (isEnabled == (m_GpuCuller != nullptr))
+        {
+            return;
+        }
+
+        if (isEnabled && m_DrawPath == DrawCommandBuilder::Path::Direct)
+        {
+            Fail("The GPU culling needs an indirect path.");
+        }
+
+        // The last frame may still use the buffers of the culler and the instance pipeline.
+        CheckResult(vkWaitForFences(m_VulkanManager->GetDevice(), 1, &m_Fence, VK_TRUE, UINT64_MAX));
+        if (isEnabled)
+        {
+            m_GpuCuller = new GpuCuller();
+            if (m_IsInitialized)
+            {
+                m_GpuCuller->SetDepthImage(m_ForwardDepthStencilImage, m_ForwardDepthSampledView, (uint32_t)m_Width, (uint32_t)m_Height);
+            }
+        }
+        else
+        {
+            delete m_GpuCuller;
+            m_GpuCuller = nullptr;
+        }
+
+        // The culled instances are drawn through the visible instances of the culler.
+        DestroyDescriptorSet();
+        delete m_InstancePipeline;
+        m_InstancePipeline = new InstancePipelineGenerator(m_ForwardRenderPass, 0, isEnabled);
+        CreateDescriptorSet();
+    }
+
+    void SceneRenderer::BatchDraws(SceneRenderInfo const & renderInfo)
+    {
+        m_InstanceBatcher.Clear();
+        for (uint32_t v = 0; v < m_RenderQueue.GetViewCount(); ++v)
+        {
+            m_InstanceBatcher.AddView(m_RenderQueue.GetDraws(v));
+        }
+        m_DrawCommandBuilder.Build(m_InstanceBatcher);
+
+        if (m_InstanceBatcher.GetInstanceCount() != 0)
+        {
+            // The range of the binding of the last batches fits in the buffer.
+            m_InstanceBuffer.Reserve(m_InstanceBatcher.GetBufferInstanceCount() * sizeof(InstanceBatcher::InstanceData));
+            m_InstanceBatcher.Pack(*renderInfo.snapshot, static_cast<InstanceBatcher::InstanceData *>(m_InstanceBuffer.GetData()));
+        }
+
+        Span<VkDrawIndexedIndirectCommand const> commands = m_DrawCommandBuilder.GetCommands();
+        if (m_GpuCuller != nullptr)
+        {
+            // The culling writes the commands, with the instance counts of the visible instances.
+            m_GpuViews.clear();
+            for (size_t v = 0; v < m_Views.size(); ++v)
+            {
+                m_GpuViews.push_back(GpuCuller::View{ m_ViewProjections[v], m_Views[v].viewport });
+            }
+            Aabb const * bounds = renderInfo.snapshot != nullptr ? renderInfo.snapshot->GetWorldBounds() : nullptr;
+            m_GpuCuller->Prepare(Span<GpuCuller::View const>{ m_GpuViews.data(), m_GpuViews.size() }, bounds, m_InstanceBatcher, commands);
+        }
+        else if (m_DrawPath != DrawCommandBuilder::Path::Direct && !commands.empty())
+        {
+            m_IndirectBuffer.Reserve(commands.size() * sizeof(VkDrawIndexedIndirectCommand));
+            memcpy(m_IndirectBuffer.GetData(), commands.data(), commands.size() * sizeof(VkDrawIndexedIndirectCommand));
+        }
+    }
+
+    void SceneRenderer::RecordDraws()
+    {
+        // The instance buffers may have been recreated, and their binding range follows the instance count.
+        uint32_t bindingCount = m_GpuCuller != nullptr ? 2 : 1;
+        {
+            std::array<VkDescriptorBufferInfo, 2> bufferInfos;
+            bufferInfos[0].buffer = m_InstanceBuffer.GetBuffer();
+            bufferInfos[0].offset = 0;
+            bufferInfos[0].range = m_InstanceBatcher.GetBindingInstanceCount() * sizeof(InstanceBatcher::InstanceData);
+            if (m_GpuCuller != nullptr)
+            {
+                bufferInfos[1].buffer = m_GpuCuller->GetVisibleInstanceBuffer();
+                bufferInfos[1].offset = 0;
+                bufferInfos[1].range = m_InstanceBatcher.GetBindingInstanceCount() * sizeof(uint32_t);
+            }
+
+            std::array<VkWriteDescriptorSet, 2> writeDescriptorSets;
+            for (uint32_t i = 0; i < bindingCount; ++i)
+            {
+                writeDescriptorSets[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                writeDescriptorSets[i].pNext = NULL;
+                writeDescriptorSets[i].dstSet = m_InstanceDescriptorSet;
+                writeDescriptorSets[i].dstBinding = i;
+                writeDescriptorSets[i].dstArrayElement = 0;
+                writeDescriptorSets[i].descriptorCount = 1;
+                writeDescriptorSets[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+                writeDescriptorSets[i].pImageInfo = NULL;
+                writeDescriptorSets[i].pBufferInfo = &bufferInfos[i];
+                writeDescriptorSets[i].pTexelBufferView = NULL;
+            }
+
+            vkUpdateDescriptorSets(m_VulkanManager->GetDevice(), bindingCount, writeDescriptorSets.data(), 0, NULL);
+        }
+
+        // The pipelines and the materials of the ranges are not created yet, so every batch is drawn with the instance
+        // pipeline, and only the binding of the instance buffer changes between the ranges.
+        vkCmdBindPipeline(m_CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_InstancePipeline->GetPipeline());
+
+        GraphicsHelper * graphicsHelper = Application::GetInstance().GetGraphicsHelper();
+        VkBuffer vertices = graphicsHelper->GetBoxVertices();
+        VkDeviceSize offsets = 0;
+        vkCmdBindVertexBuffers(m_CommandBuffer, 0, 1, &vertices, &offsets);
+        vkCmdBindIndexBuffer(m_CommandBuffer, graphicsHelper->GetBoxIndices(), 0, VK_INDEX_TYPE_UINT32);
+
+        // The GPU culling writes the commands with the counts of the visible instances.
+        VkBuffer indirectBuffer = VK_NULL_HANDLE;
+        if (m_GpuCuller != nullptr)
+        {
+            indirectBuffer = m_GpuCuller->GetIndirectBuffer();
+        }
+        else if (m_DrawPath != DrawCommandBuilder::Path::Direct)
+        {
+            indirectBuffer = m_IndirectBuffer.GetBuffer();
+        }
+        for (uint32_t v = 0; v < m_DrawCommandBuilder.GetViewCount(); ++v)
+        {
+            VkRect2D const & area = m_Views[v].viewport;
+
+            VkViewport viewport{};
+            viewport.x = (float)area.offset.x;
+            viewport.y = (float)area.offset.y;
+            viewport.width = (float)area.extent.width;
+            viewport.height = (float)area.extent.height;
+            viewport.minDepth = 0;
+            viewport.maxDepth = 1;
+            vkCmdSetViewport(m_CommandBuffer, 0, 1, &viewport);
+            vkCmdSetScissor(m_CommandBuffer, 0, 1, &area);
+
+            vkCmdPushConstants(m_CommandBuffer, m_InstancePipeline->GetPipelineLayout(), VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &m_ViewProjections[v]);
+
+            m_DrawCommandBuilder.Record(m_CommandBuffer, v, m_DrawPath, indirectBuffer, [this, bindingCount](DrawCommandBuilder::DrawRange const & range) {
+                std::array<uint32_t, 2> dynamicOffsets = { range.bindingOffset * (uint32_t)sizeof(InstanceBatcher::InstanceData), range.bindingOffset * (uint32_t)sizeof(uint32_t) };
+                vkCmdBindDescriptorSets(m_CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_InstancePipeline->GetPipelineLayout(), 0, 1, &m_InstanceDescriptorSet, bindingCount, dynamicOffsets.data());
+            });
+        }
+    }
+
     void SceneRenderer::CreateForwardRenderPass()
     {
         std::array<VkAttachmentDescription, 2> attachments;
@@ -157,6 +445,16 @@ namespace VulkanDemo
         forwardSubpass.preserveAttachmentCount = 0;
         forwardSubpass.pPreserveAttachments = NULL;
 
+        // The depth buffer is cleared once the previous frame built its pyramid and the culling of this frame read it.
+        VkSubpassDependency externalDependency{};
+        externalDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+        externalDependency.dstSubpass = 0;
+        externalDependency.srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        externalDependency.dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        externalDependency.srcAccessMask = 0;
+        externalDependency.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        externalDependency.dependencyFlags = 0;
+
         VkRenderPassCreateInfo renderPassCreateInfo{};
         renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
         renderPassCreateInfo.pNext = NULL;
@@ -165,8 +463,8 @@ namespace VulkanDemo
         renderPassCreateInfo.pAttachments = attachments.data();
         renderPassCreateInfo.subpassCount = 1;
         renderPassCreateInfo.pSubpasses = &forwardSubpass;
-        renderPassCreateInfo.dependencyCount = 0;
-        renderPassCreateInfo.pDependencies = NULL;
+        renderPassCreateInfo.dependencyCount = 1;
+        renderPassCreateInfo.pDependencies = &externalDependency;
 
         CheckResult(vkCreateRenderPass(m_VulkanManager->GetDevice(), &renderPassCreateInfo, NULL, &m_ForwardRenderPass));
     }
@@ -261,7 +559,7 @@ namespace VulkanDemo
             depthStencilImageCreateInfo.arrayLayers = 1;
             depthStencilImageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
             depthStencilImageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-            depthStencilImageCreateInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+            depthStencilImageCreateInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
             depthStencilImageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
             depthStencilImageCreateInfo.queueFamilyIndexCount = 1;
             depthStencilImageCreateInfo.pQueueFamilyIndices = &graphicsQueueFamilyIndex;;
@@ -287,6 +585,15 @@ namespace VulkanDemo
             depthStencilImageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
             depthStencilImageViewCreateInfo.subresourceRange.layerCount = 1;
             CheckResult(vkCreateImageView(m_VulkanManager->GetDevice(), &depthStencilImageViewCreateInfo, NULL, &m_ForwardDepthStencilImageView));
+
+            // The depth is sampled without the stencil.
+            depthStencilImageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+            CheckResult(vkCreateImageView(m_VulkanManager->GetDevice(), &depthStencilImageViewCreateInfo, NULL, &m_ForwardDepthSampledView));
+
+            if (m_GpuCuller != nullptr)
+            {
+                m_GpuCuller->SetDepthImage(m_ForwardDepthStencilImage, m_ForwardDepthSampledView, (uint32_t)width, (uint32_t)height);
+            }
         }
 
         // Framebuffer
@@ -313,6 +620,7 @@ namespace VulkanDemo
 
         vkDestroyFramebuffer(m_VulkanManager->GetDevice(), m_ForwardFramebuffer, NULL);
 
+        vkDestroyImageView(m_VulkanManager->GetDevice(), m_ForwardDepthSampledView, NULL);
         vkDestroyImageView(m_VulkanManager->GetDevice(), m_ForwardDepthStencilImageView, NULL);
         vkFreeMemory(m_VulkanManager->GetDevice(), m_ForwardDepthStencilMemory, NULL);
         vkDestroyImage(m_VulkanManager->GetDevice(), m_ForwardDepthStencilImage, NULL);
@@ -341,6 +649,26 @@ namespace VulkanDemo
         m_CommandBuffer = VK_NULL_HANDLE;
     }
 
+    void SceneRenderer::CreateDescriptorSet()
+    {
+        VkDescriptorSetLayout descriptorSetLayout = m_InstancePipeline->GetDescriptorSetLayout();
+
+        VkDescriptorSetAllocateInfo descriptorSetAllocInfo{};
+        descriptorSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        descriptorSetAllocInfo.pNext = NULL;
+        descriptorSetAllocInfo.descriptorPool = m_VulkanManager->GetDescriptorPool();
+        descriptorSetAllocInfo.descriptorSetCount = 1;
+        descriptorSetAllocInfo.pSetLayouts = &descriptorSetLayout;
+
+        CheckResult(vkAllocateDescriptorSets(m_VulkanManager->GetDevice(), &descriptorSetAllocInfo, &m_InstanceDescriptorSet));
+    }
+
+    void SceneRenderer::DestroyDescriptorSet()
+    {
+        CheckResult(vkFreeDescriptorSets(m_VulkanManager->GetDevice(), m_VulkanManager->GetDescriptorPool(), 1, &m_InstanceDescriptorSet));
+        m_InstanceDescriptorSet = VK_NULL_HANDLE;
+    }
+
     void SceneRenderer::CreateSynchronization()
     {
         VkSemaphoreCreateInfo semaphoreCreateInfo{};
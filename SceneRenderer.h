@@ -1,15 +1,36 @@
 #pragma once
 
+#include <vector>
+
 #include "Shared.h"
 
+#include "DrawCommandBuilder.h"
+#include "FrustumCuller.h"
+#include "GpuCuller.h"
+#include "InstanceBatcher.h"
+#include "LodSelector.h"
+#include "OcclusionCuller.h"
+#include "RenderQueue.h"
+
 namespace VulkanDemo
 {
-    class Scene;
+    class InstancePipelineGenerator;
+    class RenderSnapshot;
     class VulkanManager;
 
+    ///
+    /// Area of the rendered image showing what a camera of the snapshot sees.
+    ///
+    struct SceneView
+    {
+        uint32_t camera;    // Index in the cameras of the snapshot.
+        VkRect2D viewport;  // In pixels, within the rendered image.
+    };
+
     struct SceneRenderInfo
     {
-        Scene * scene;
+        RenderSnapshot const * snapshot; // State of the scene to render, which must not change during Render().
+        std::vector<SceneView> views; // Empty to show the first camera over the whole image.
         int width;
         int height;
         VkSemaphore waitSemaphore; // Signaled when we can begin rendering.
@@ -34,6 +55,52 @@ namespace VulkanDemo
 
         void Render(const SceneRenderInfo & renderInfo, SceneRenderResult & renderResult);
 
+        ///
+        /// Returns the selector of the levels of detail, where the levels of the meshes are registered.
+        ///
+        inline LodSelector & GetLodSelector() { return m_LodSelector; }
+
+        ///
+        /// Returns the queue ordering the draws of the frame, where the pipelines and passes of the materials are
+        /// registered.
+        ///
+        inline RenderQueue & GetRenderQueue() { return m_RenderQueue; }
+
+        inline InstanceBatcher const & GetInstanceBatcher() const { return m_InstanceBatcher; }
+
+        ///
+        /// Returns the builder of the draw commands, where the geometry of the meshes is registered. The meshes are not
+        /// loaded yet: their geometry is a range of the box buffers of the GraphicsHelper, drawn in a constant color.
+        ///
+        inline DrawCommandBuilder & GetDrawCommandBuilder() { return m_DrawCommandBuilder; }
+
+        ///
+        /// Sets how the draws are recorded, to compare the paths. Defaults to the fastest path supported by the device.
+        /// The indirect paths need the drawIndirectFirstInstance feature, and MultiDrawIndirect the multiDrawIndirect
+        /// feature.
+        ///
+        void SetDrawPath(DrawCommandBuilder::Path drawPath);
+        inline DrawCommandBuilder::Path GetDrawPath() const { return m_DrawPath; }
+
+        ///
+        /// Sets whether the instances are culled on the GPU, against the frustums of the views and the depth buffer of the
+        /// previous frame, instead of against the occluders on the CPU. The CPU still culls the objects against the
+        /// frustums. The draws are then recorded on an indirect path, from the indirect buffer of the GpuCuller, and the
+        /// vertex shader reads the instances from its visible instances. Disabled by default.
+        ///
+        void SetGpuCulling(bool isEnabled);
+        inline bool IsGpuCullingEnabled() const { return m_GpuCuller != nullptr; }
+
+        ///
+        /// Returns the GPU culler, to validate it and print its stats, or nullptr when the GPU culling is disabled.
+        ///
+        inline GpuCuller * GetGpuCuller() const { return m_GpuCuller; }
+
+        ///
+        /// Prints the stats of the last frame, such as the changes of state saved by sorting the draws.
+        ///
+        void PrintStats() const;
+
     private:
         void CreateForwardRenderPass();
         void DestroyForwardRenderpass();
@@ -48,8 +115,43 @@ namespace VulkanDemo
         void CreateSynchronization();
         void DestroySynchronization();
 
+        void CreateDescriptorSet();
+        void DestroyDescriptorSet();
+
         VulkanManager * m_VulkanManager = nullptr;
 
+        ///
+        /// Finds the objects drawn in every view of the frame and their levels of detail, and queues their draws, in the
+        /// order of the views. With the GPU culling, the objects in the frustum of a view are queued, and their instances
+        /// are culled again by the GpuCuller, against the frustum and the depth buffer.
+        ///
+        void CullViews(SceneRenderInfo const & renderInfo);
+
+        ///
+        /// Merges the queued draws into instanced draws, writes the data of their instances to the instance buffer, and
+        /// builds their commands, written to the indirect buffer on the indirect paths, or prepared for the GpuCuller.
+        ///
+        void BatchDraws(SceneRenderInfo const & renderInfo);
+
+        ///
+        /// Records the draws of the batches of every view within its viewport, on the draw path.
+        ///
+        void RecordDraws();
+
+        FrustumCuller m_FrustumCuller;
+        OcclusionCuller m_OcclusionCuller;
+        LodSelector m_LodSelector;
+        RenderQueue m_RenderQueue;
+        InstanceBatcher m_InstanceBatcher;
+        DrawCommandBuilder m_DrawCommandBuilder;
+        DrawCommandBuilder::Path m_DrawPath = DrawCommandBuilder::Path::Direct;
+        std::vector<SceneView> m_Views;
+        std::vector<Frustum> m_Frustums;
+        std::vector<glm::mat4> m_ViewProjections;
+        std::vector<uint32_t> m_ViewObjects;
+        GpuCuller * m_GpuCuller = nullptr;
+        std::vector<GpuCuller::View> m_GpuViews;
+
         bool m_IsInitialized = false;
         int m_Width = -1;
         int m_Height = -1;
@@ -64,9 +166,16 @@ namespace VulkanDemo
         VkImage m_ForwardDepthStencilImage = VK_NULL_HANDLE;
         VkDeviceMemory m_ForwardDepthStencilMemory = VK_NULL_HANDLE;
         VkImageView m_ForwardDepthStencilImageView = VK_NULL_HANDLE;
+        VkImageView m_ForwardDepthSampledView = VK_NULL_HANDLE;  // Depth aspect, read by the GpuCuller.
 
         VkFramebuffer m_ForwardFramebuffer = VK_NULL_HANDLE;
 
+        InstancePipelineGenerator * m_InstancePipeline = nullptr;
+        VkDescriptorSet m_InstanceDescriptorSet = VK_NULL_HANDLE;
+
+        MappedBuffer m_InstanceBuffer{ VK_BUFFER_USAGE_STORAGE_BUFFER_BIT };   // Data of the instances.
+        MappedBuffer m_IndirectBuffer{ VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT };  // Draw commands of the indirect paths.
+
         VkCommandBuffer m_CommandBuffer = NULL;
 
         ///
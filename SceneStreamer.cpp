@@ -0,0 +1,423 @@
+#include "SceneStreamer.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "Camera.h"
+#include "GameObject.h"
+#include "Scene.h"
+#include "SceneFile.h"
+#include "Shared.h"
+#include "Transform.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+namespace VulkanDemo
+{
+    const uint32_t SceneStreamer::SliceSize;
+
+    namespace
+    {
+        ///
+        /// Streaming is never urgent enough to take time from the main thread.
+        ///
+        void LowerCurrentThreadPriority()
+        {
+#ifdef _WIN32
+            SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+#endif
+        }
+    }
+
+    SceneStreamer::SceneStreamer(Scene & scene, uint32_t decodeThreadCount) :
+        m_Scene(scene)
+    {
+        m_IoThread = std::thread(&SceneStreamer::IoThreadMain, this);
+        for (uint32_t i = 0; i < std::max(decodeThreadCount, 1u); ++i)
+        {
+            m_DecodeThreads.emplace_back(&SceneStreamer::DecodeThreadMain, this);
+        }
+    }
+
+    SceneStreamer::~SceneStreamer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Exit = true;
+        }
+        m_ReadCondition.notify_all();
+        m_DecodeCondition.notify_all();
+
+        m_IoThread.join();
+        for (auto & thread : m_DecodeThreads)
+        {
+            thread.join();
+        }
+
+        // The requests still queued were dropped by the threads, but the chunks they finished may hold objects.
+        for (auto & chunk : m_Chunks)
+        {
+            if (chunk->state != ChunkState::Loaded)
+            {
+                DestroyObjects(*chunk, chunk->count);
+            }
+        }
+    }
+
+    SceneStreamer::ChunkId SceneStreamer::AddChunk(std::string const & path, glm::vec3 const & center, float radius)
+    {
+        std::unique_ptr<Chunk> chunk{ new Chunk() };
+        chunk->path = path;
+        chunk->center = center;
+        chunk->radius = radius;
+        m_Chunks.push_back(std::move(chunk));
+        return (ChunkId)m_Chunks.size() - 1;
+    }
+
+    void SceneStreamer::SetCamera(Camera const * camera)
+    {
+        m_Camera = camera != nullptr ? camera->GetHandle() : ComponentHandle{};
+    }
+
+    void SceneStreamer::SetRadii(float loadRadius, float evictRadius)
+    {
+        assert(evictRadius >= loadRadius);
+        m_LoadRadius = loadRadius;
+        m_EvictRadius = evictRadius;
+    }
+
+    bool SceneStreamer::IsChunkLoaded(ChunkId chunk) const
+    {
+        return m_Chunks[chunk]->state == ChunkState::Loaded;
+    }
+
+    bool SceneStreamer::IsBusy() const
+    {
+        return m_InFlightCount > 0 || !m_AttachQueue.empty() || !m_DetachQueue.empty();
+    }
+
+    void SceneStreamer::Update()
+    {
+        Clock::time_point start = Clock::now();
+        Clock::time_point deadline = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(m_FrameBudget));
+
+        CollectFinishedChunks();
+
+        glm::vec3 cameraPosition;
+        if (FindCameraPosition(cameraPosition))
+        {
+            UpdateRequests(cameraPosition);
+        }
+
+        // Destroying first releases memory before more is attached. One slice is always processed, so that streaming
+        // progresses even when the budget is too small.
+        bool isFirstSlice = true;
+        while ((!m_DetachQueue.empty() || !m_AttachQueue.empty()) && (isFirstSlice || Clock::now() < deadline))
+        {
+            isFirstSlice = false;
+            if (!m_DetachQueue.empty())
+            {
+                if (DetachSlice(*m_DetachQueue.front()))
+                {
+                    m_DetachQueue.pop_front();
+                }
+                continue;
+            }
+
+            // Chunks evicted while waiting to be attached are left in the queue, and skipped here.
+            Chunk & chunk = *m_AttachQueue.front();
+            if ((chunk.state != ChunkState::Staged && chunk.state != ChunkState::Attaching) || AttachSlice(chunk))
+            {
+                m_AttachQueue.pop_front();
+            }
+        }
+
+        double elapsed = GetMilliseconds(start, Clock::now());
+        ++m_Stats.frameCount;
+        m_Stats.totalUpdateTime += elapsed;
+        m_Stats.maxUpdateTime = std::max(m_Stats.maxUpdateTime, elapsed);
+        if (elapsed > m_FrameBudget)
+        {
+            ++m_Stats.hitchCount;
+        }
+    }
+
+    void SceneStreamer::CollectFinishedChunks()
+    {
+        std::vector<Chunk *> finishedChunks;
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            finishedChunks.swap(m_FinishedChunks);
+        }
+
+        for (Chunk * chunk : finishedChunks)
+        {
+            --m_InFlightCount;
+            chunk->attachedCount = 0;
+
+            if (chunk->isCancelled)
+            {
+                ++m_Stats.chunksCancelled;
+                chunk->state = ChunkState::Detaching;
+                m_DetachQueue.push_back(chunk);
+            }
+            else if (!chunk->isValid)
+            {
+                ++m_Stats.chunksFailed;
+                chunk->state = ChunkState::Failed;
+                chunk->store.reset();
+            }
+            else
+            {
+                chunk->state = ChunkState::Staged;
+                m_AttachQueue.push_back(chunk);
+            }
+        }
+    }
+
+    bool SceneStreamer::FindCameraPosition(glm::vec3 & position)
+    {
+        Component * camera = m_Scene.GetComponent(m_Camera);
+        if (camera == nullptr)
+        {
+            Span<Component * const> cameras = m_Scene.GetComponentsOfType(ComponentType::Camera);
+            if (cameras.empty())
+            {
+                return false;
+            }
+            camera = cameras[0];
+        }
+
+        Transform * transform = camera->GetGameObject()->GetTransform();
+        if (transform == nullptr)
+        {
+            return false;
+        }
+
+        position = glm::vec3{ transform->GetLocalToWorldMatrix()[3] };
+        return true;
+    }
+
+    void SceneStreamer::UpdateRequests(glm::vec3 const & cameraPosition)
+    {
+        for (auto & pointer : m_Chunks)
+        {
+            Chunk & chunk = *pointer;
+            float distance = glm::length(chunk.center - cameraPosition) - chunk.radius;
+
+            switch (chunk.state)
+            {
+            case ChunkState::Unloaded:
+                if (distance <= m_LoadRadius)
+                {
+                    chunk.state = ChunkState::Reading;
+                    chunk.isCancelled = false;
+                    chunk.isValid = false;
+                    chunk.requestTime = Clock::now();
+                    ++m_Stats.chunksRequested;
+                    ++m_InFlightCount;
+                    {
+                        std::lock_guard<std::mutex> lock(m_Mutex);
+                        m_ReadQueue.push_back(&chunk);
+                    }
+                    m_ReadCondition.notify_one();
+                }
+                break;
+
+            case ChunkState::Reading:
+                // The background threads skip the remaining work, and the chunk is discarded once it comes back.
+                if (distance > m_EvictRadius)
+                {
+                    chunk.isCancelled = true;
+                }
+                break;
+
+            case ChunkState::Staged:
+            case ChunkState::Attaching:
+            case ChunkState::Loaded:
+                if (distance > m_EvictRadius)
+                {
+                    if (chunk.state == ChunkState::Loaded)
+                    {
+                        ++m_Stats.chunksEvicted;
+                    }
+                    else
+                    {
+                        ++m_Stats.chunksCancelled;
+                    }
+                    chunk.state = ChunkState::Detaching;
+                    m_DetachQueue.push_back(&chunk);
+                }
+                break;
+
+            default:
+                break;
+            }
+        }
+    }
+
+    bool SceneStreamer::AttachSlice(Chunk & chunk)
+    {
+        chunk.state = ChunkState::Attaching;
+
+        // Objects are in pre-order, so parents are always attached before their children.
+        uint32_t count = std::min(SliceSize, chunk.count - chunk.attachedCount);
+        m_Scene.AddGameObjects(chunk.gameObjects + chunk.attachedCount, (int)count);
+        chunk.attachedCount += count;
+        m_Stats.objectsAttached += count;
+        if (chunk.attachedCount < chunk.count)
+        {
+            return false;
+        }
+
+        // Every transform has moved to the store of the scene.
+        chunk.store.reset();
+        chunk.state = ChunkState::Loaded;
+
+        double latency = GetMilliseconds(chunk.requestTime, Clock::now());
+        ++m_Stats.chunksLoaded;
+        m_Stats.totalLoadLatency += latency;
+        m_Stats.maxLoadLatency = std::max(m_Stats.maxLoadLatency, latency);
+        return true;
+    }
+
+    bool SceneStreamer::DetachSlice(Chunk & chunk)
+    {
+        DestroyObjects(chunk, SliceSize);
+        if (chunk.count > 0)
+        {
+            return false;
+        }
+
+        chunk.store.reset();
+        chunk.state = ChunkState::Unloaded;
+        return true;
+    }
+
+    void SceneStreamer::DestroyObjects(Chunk & chunk, uint32_t maxCount)
+    {
+        // In reverse pre-order, the descendants of an object are destroyed before it, so no object has children left
+        // when it is destroyed.
+        uint32_t count = std::min(maxCount, chunk.count);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            delete &chunk.gameObjects[chunk.count - 1 - i];
+        }
+
+        chunk.count -= count;
+        chunk.attachedCount = std::min(chunk.attachedCount, chunk.count);
+        m_Stats.objectsDestroyed += count;
+        if (chunk.count == 0)
+        {
+            chunk.gameObjects = nullptr;
+        }
+    }
+
+    void SceneStreamer::IoThreadMain()
+    {
+        LowerCurrentThreadPriority();
+
+        for (;;)
+        {
+            Chunk * chunk;
+            {
+                std::unique_lock<std::mutex> lock(m_Mutex);
+                m_ReadCondition.wait(lock, [this]() { return m_Exit || !m_ReadQueue.empty(); });
+                if (m_Exit)
+                {
+                    return;
+                }
+                chunk = m_ReadQueue.front();
+                m_ReadQueue.pop_front();
+            }
+
+            bool isRead = false;
+            if (!chunk->isCancelled && chunk->file.Open(chunk->path.c_str()))
+            {
+                // Touch every page, so that the decode threads don't wait for the disk.
+                static const size_t PageSize = 4096;
+                uint8_t const * data = chunk->file.GetData();
+                uint32_t sum = 0;
+                for (size_t offset = 0; offset < chunk->file.GetSize(); offset += PageSize)
+                {
+                    sum += data[offset];
+                }
+                volatile uint32_t sink = sum;
+                (void)sink;
+                isRead = true;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                if (isRead)
+                {
+                    m_DecodeQueue.push_back(chunk);
+                }
+                else
+                {
+                    m_FinishedChunks.push_back(chunk);
+                }
+            }
+            if (isRead)
+            {
+                m_DecodeCondition.notify_one();
+            }
+        }
+    }
+
+    void SceneStreamer::DecodeThreadMain()
+    {
+        LowerCurrentThreadPriority();
+
+        for (;;)
+        {
+            Chunk * chunk;
+            {
+                std::unique_lock<std::mutex> lock(m_Mutex);
+                m_DecodeCondition.wait(lock, [this]() { return m_Exit || !m_DecodeQueue.empty(); });
+                if (m_Exit)
+                {
+                    return;
+                }
+                chunk = m_DecodeQueue.front();
+                m_DecodeQueue.pop_front();
+            }
+
+            if (!chunk->isCancelled)
+            {
+                chunk->store.reset(new TransformStore());
+                chunk->isValid = SceneFile::Instantiate(chunk->file, *chunk->store, chunk->gameObjects, chunk->count);
+            }
+            chunk->file.Close();
+
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_FinishedChunks.push_back(chunk);
+        }
+    }
+
+    void SceneStreamer::PrintStats() const
+    {
+        uint64_t frameCount = std::max(m_Stats.frameCount, (uint64_t)1);
+        uint32_t loadedCount = std::max(m_Stats.chunksLoaded, 1u);
+        StatsRows rows = {
+            { "Frames", std::to_string(m_Stats.frameCount) },
+            { "Hitches (over budget)", std::to_string(m_Stats.hitchCount) },
+            { "Frame budget (ms)", FormatStat(m_FrameBudget) },
+            { "Average update (ms)", FormatStat(m_Stats.totalUpdateTime / frameCount) },
+            { "Worst update (ms)", FormatStat(m_Stats.maxUpdateTime) },
+            { "Chunks requested", std::to_string(m_Stats.chunksRequested) },
+            { "Chunks loaded", std::to_string(m_Stats.chunksLoaded) },
+            { "Chunks evicted", std::to_string(m_Stats.chunksEvicted) },
+            { "Chunks cancelled", std::to_string(m_Stats.chunksCancelled) },
+            { "Chunks failed", std::to_string(m_Stats.chunksFailed) },
+            { "Objects attached", std::to_string(m_Stats.objectsAttached) },
+            { "Objects destroyed", std::to_string(m_Stats.objectsDestroyed) },
+            { "Average load latency (ms)", FormatStat(m_Stats.totalLoadLatency / loadedCount) },
+            { "Worst load latency (ms)", FormatStat(m_Stats.maxLoadLatency) },
+        };
+
+        PrintStatsTable("Streaming", rows);
+    }
+} // VulkanDemo
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Component.h"
+#include "MappedFile.h"
+#include "TransformStore.h"
+
+namespace VulkanDemo
+{
+    class Camera;
+    class GameObject;
+    class Scene;
+
+    ///
+    /// Streams chunks of a large world in and out of a scene around the active camera.
+    ///
+    /// Every chunk is a scene file (see SceneFile) with a bounding sphere. A chunk whose sphere gets within the load
+    /// radius of the camera is mapped and paged in by an I/O thread, then instantiated by a decode thread in a staging
+    /// transform store of its own. Update() is called once per frame on the main thread: it attaches the staged
+    /// objects to the scene and destroys the objects of the chunks that went beyond the evict radius, a slice at a
+    /// time, until the frame budget is spent. Large chunks are therefore attached over several frames, parents first.
+    ///
+    /// The objects of a chunk belong to the streamer. They can be modified, but not destroyed nor moved to another
+    /// chunk's hierarchy.
+    ///
+    /// Frames in which the streaming work exceeded the budget are counted as hitches in the statistics.
+    ///
+    class SceneStreamer
+    {
+    public:
+        typedef uint32_t ChunkId;
+
+        struct Stats
+        {
+            uint64_t frameCount = 0;
+            uint64_t hitchCount = 0;            // Frames in which Update() took longer than the budget.
+            double totalUpdateTime = 0;         // In milliseconds, as all the times below.
+            double maxUpdateTime = 0;
+            uint32_t chunksRequested = 0;
+            uint32_t chunksLoaded = 0;          // Fully attached to the scene.
+            uint32_t chunksEvicted = 0;
+            uint32_t chunksCancelled = 0;       // Went out of range before being attached.
+            uint32_t chunksFailed = 0;
+            uint64_t objectsAttached = 0;
+            uint64_t objectsDestroyed = 0;
+            double totalLoadLatency = 0;        // From the request to the end of the attachment.
+            double maxLoadLatency = 0;
+        };
+
+        ///
+        /// @param[in] decodeThreadCount  Number of threads instantiating the chunks, in addition to the I/O thread.
+        ///
+        explicit SceneStreamer(Scene & scene, uint32_t decodeThreadCount = 2);
+
+        ///
+        /// Stops the background threads and destroys the chunks that are not attached. The objects of the attached
+        /// chunks are left to the scene.
+        ///
+        ~SceneStreamer();
+
+        ChunkId AddChunk(std::string const & path, glm::vec3 const & center, float radius);
+
+        ///
+        /// Sets the camera around which the chunks are streamed. It must be part of the scene. By default, or when it
+        /// has been removed, the first camera of the scene is used.
+        ///
+        void SetCamera(Camera const * camera);
+
+        ///
+        /// Chunks are requested when their bounding sphere is within loadRadius of the camera, and evicted when it is
+        /// farther than evictRadius. The difference avoids reloading the chunks at the boundary over and over.
+        ///
+        void SetRadii(float loadRadius, float evictRadius);
+
+        inline void SetFrameBudget(double milliseconds) { m_FrameBudget = milliseconds; }
+
+        ///
+        /// Picks up the chunks finished by the background threads, requests and evicts chunks around the camera, and
+        /// attaches or destroys objects within the frame budget. Must be called once per frame, on the main thread.
+        ///
+        void Update();
+
+        bool IsChunkLoaded(ChunkId chunk) const;
+
+        ///
+        /// Indicates whether chunks are being read, decoded, attached or destroyed.
+        ///
+        bool IsBusy() const;
+
+        inline Stats const & GetStats() const { return m_Stats; }
+        void PrintStats() const;
+
+    private:
+        SceneStreamer(SceneStreamer const & other) = delete;
+        void operator=(SceneStreamer const & other) = delete;
+
+        typedef std::chrono::high_resolution_clock Clock;
+
+        enum class ChunkState
+        {
+            Unloaded,
+            Reading,    // Owned by the I/O thread, then by a decode thread. Only the main thread changes the state.
+            Staged,     // Decoded, waiting to be attached.
+            Attaching,
+            Loaded,
+            Detaching,
+            Failed,
+        };
+
+        struct Chunk
+        {
+            std::string path;
+            glm::vec3 center;
+            float radius;
+
+            ChunkState state = ChunkState::Unloaded;
+            std::atomic<bool> isCancelled{ false };
+            bool isValid = false;
+            Clock::time_point requestTime;
+
+            // Written by the background threads until the chunk is finished.
+            MappedFile file;
+            std::unique_ptr<TransformStore> store;
+            GameObject * gameObjects = nullptr;
+            uint32_t count = 0;
+
+            // Number of objects attached to the scene.
+            uint32_t attachedCount = 0;
+        };
+
+        static const uint32_t SliceSize = 256;
+
+        void IoThreadMain();
+        void DecodeThreadMain();
+
+        void CollectFinishedChunks();
+        void UpdateRequests(glm::vec3 const & cameraPosition);
+        bool FindCameraPosition(glm::vec3 & position);
+
+        ///
+        /// Attaches or destroys a slice of objects of the chunk, and returns true once the chunk is done.
+        ///
+        bool AttachSlice(Chunk & chunk);
+        bool DetachSlice(Chunk & chunk);
+
+        ///
+        /// Destroys up to maxCount objects at the end of the chunk.
+        ///
+        void DestroyObjects(Chunk & chunk, uint32_t maxCount);
+
+        Scene & m_Scene;
+        std::vector<std::unique_ptr<Chunk>> m_Chunks;
+        ComponentHandle m_Camera;
+
+        float m_LoadRadius = 100;
+        float m_EvictRadius = 150;
+        double m_FrameBudget = 2;
+
+        // Chunks waiting for the main thread, in order.
+        std::deque<Chunk *> m_AttachQueue;
+        std::deque<Chunk *> m_DetachQueue;
+        uint32_t m_InFlightCount = 0;
+
+        // Shared with the background threads.
+        std::mutex m_Mutex;
+        std::condition_variable m_ReadCondition;
+        std::condition_variable m_DecodeCondition;
+        std::deque<Chunk *> m_ReadQueue;
+        std::deque<Chunk *> m_DecodeQueue;
+        std::vector<Chunk *> m_FinishedChunks;
+        bool m_Exit = false;
+
+        std::thread m_IoThread;
+        std::vector<std::thread> m_DecodeThreads;
+
+        Stats m_Stats;
+    };
+} // VulkanDemo
@@ -105,6 +105,24 @@ namespace VulkanDemo
         return constFragModule;
     }
 
+    VkShaderModule ShaderLoader::GetInstanceVert()
+    {
+        if (instanceVertModule == VK_NULL_HANDLE)
+        {
+            instanceVertModule = LoadShaderModule("instance.vert");
+        }
+        return instanceVertModule;
+    }
+
+    VkShaderModule ShaderLoader::GetVisibleInstanceVert()
+    {
+        if (visibleInstanceVertModule == VK_NULL_HANDLE)
+        {
+            visibleInstanceVertModule = LoadShaderModule("visible_instance.vert");
+        }
+        return visibleInstanceVertModule;
+    }
+
     VkShaderModule ShaderLoader::GetBlitVert()
     {
         if (blitVertModule == VK_NULL_HANDLE)
@@ -122,4 +140,22 @@ namespace VulkanDemo
         }
         return blitFragModule;
     }
+
+    VkShaderModule ShaderLoader::GetHzbComp()
+    {
+        if (hzbCompModule == VK_NULL_HANDLE)
+        {
+            hzbCompModule = LoadShaderModule("hzb.comp");
+        }
+        return hzbCompModule;
+    }
+
+    VkShaderModule ShaderLoader::GetCullComp()
+    {
+        if (cullCompModule == VK_NULL_HANDLE)
+        {
+            cullCompModule = LoadShaderModule("cull.comp");
+        }
+        return cullCompModule;
+    }
 }
@@ -17,9 +17,15 @@ namespace VulkanDemo
         VkShaderModule GetConstVert();
         VkShaderModule GetConstFrag();
 
+        VkShaderModule GetInstanceVert();
+        VkShaderModule GetVisibleInstanceVert();
+
         VkShaderModule GetBlitVert();
         VkShaderModule GetBlitFrag();
 
+        VkShaderModule GetHzbComp();
+        VkShaderModule GetCullComp();
+
     private:
         VkShaderModule LoadShaderModule(char const * path);
 
@@ -28,7 +34,13 @@ namespace VulkanDemo
         VkShaderModule constVertModule = VK_NULL_HANDLE;
         VkShaderModule constFragModule = VK_NULL_HANDLE;
 
+        VkShaderModule instanceVertModule = VK_NULL_HANDLE;
+        VkShaderModule visibleInstanceVertModule = VK_NULL_HANDLE;
+
         VkShaderModule blitVertModule = VK_NULL_HANDLE;
         VkShaderModule blitFragModule = VK_NULL_HANDLE;
+
+        VkShaderModule hzbCompModule = VK_NULL_HANDLE;
+        VkShaderModule cullCompModule = VK_NULL_HANDLE;
     };
 }
@@ -5,6 +5,7 @@
 #include <Windows.h>
 #include <iostream>
 #include <iomanip>
+#include <sstream>
 #include <vector>
 #include <algorithm>
 
@@ -218,6 +219,22 @@ namespace VulkanDemo
         }
     }
 
+    void PrintStatsTable(const char * title, StatsRows const & rows)
+    {
+        const char * headers[] = { title, "Value" };
+        PrintTable(2, (int)rows.size(), headers, [&rows](int row, int col) {
+            return col == 0 ? rows[row].first : rows[row].second.c_str();
+        });
+    }
+
+    std::string FormatStat(double value)
+    {
+        std::ostringstream oss;
+        oss.precision(3);
+        oss << std::fixed << value;
+        return oss.str();
+    }
+
     void Fail(const char * message, int code)
     {
         std::cout << "Fatal Error: " << message << std::endl;
@@ -6,10 +6,15 @@
 
 #include <vulkan/vulkan.h>
 
+#include <chrono>
 #include <functional>
+#include <string>
+#include <utility>
+#include <vector>
 
 namespace VulkanDemo
 {
+    typedef std::chrono::high_resolution_clock Clock;
     ///
     /// Allocates device memory for the buffer, and binds it to it. Terminates the application on failure to find a
     /// suitable memory type or if the allocation or binding operation fails.
@@ -38,6 +43,27 @@ namespace VulkanDemo
     ///
     void PrintTable(int colCount, int rowCount, const char * const * colHeaders, std::function<const char *(int row, int col)> getItem);
 
+    typedef std::vector<std::pair<const char *, std::string>> StatsRows;
+
+    ///
+    /// Displays the statistics of a system as a table of names and values, under the given title.
+    ///
+    void PrintStatsTable(const char * title, StatsRows const & rows);
+
+    ///
+    /// Formats a value of the statistics, such as a duration in milliseconds, with 3 decimals.
+    ///
+    std::string FormatStat(double value);
+
+    ///
+    /// Returns the time from start to end in milliseconds, for the time points of any clock, such as Clock.
+    ///
+    template<typename TimePoint>
+    inline double GetMilliseconds(TimePoint start, TimePoint end)
+    {
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    }
+
     ///
     /// Logs the message of a fatal error and exits the application with the given code.
     ///
@@ -0,0 +1,227 @@
+#include "SimulationLoop.h"
+
+#include <algorithm>
+#include <cassert>
+#include <string>
+#include <utility>
+
+#include "Scene.h"
+#include "Shared.h"
+
+namespace VulkanDemo
+{
+    const uint32_t SimulationLoop::MaxLagTickCount;
+    const uint32_t SimulationLoop::NoState;
+
+    SimulationLoop::SimulationLoop(Scene & scene, StepFunction step, float timeStep, uint32_t stateCount) :
+        m_Scene(scene),
+        m_Step(std::move(step)),
+        m_TimeStep(timeStep),
+        m_States(new RenderSnapshot[stateCount]),
+        m_StateDueTimes(stateCount),
+        m_PinCounts(stateCount, 0)
+    {
+        // The writer needs a state besides the two latest ones that the renderer blends.
+        assert(stateCount >= 3);
+        assert(timeStep > 0);
+
+        for (uint32_t i = 0; i < stateCount; ++i)
+        {
+            m_Order.push_back(i);
+        }
+    }
+
+    SimulationLoop::~SimulationLoop()
+    {
+        Stop();
+    }
+
+    void SimulationLoop::Start()
+    {
+        assert(!m_Thread.joinable());
+
+        // The states of a previous run are dropped, since the simulation time starts over.
+        m_PublishedCount = 0;
+        m_IsRunning = true;
+        m_Thread = std::thread{ &SimulationLoop::ThreadMain, this };
+    }
+
+    void SimulationLoop::Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock{ m_Mutex };
+            m_IsRunning = false;
+        }
+        m_StopCondition.notify_all();
+        m_ReleaseCondition.notify_all();
+        m_PublishCondition.notify_all();
+
+        if (m_Thread.joinable())
+        {
+            m_Thread.join();
+        }
+    }
+
+    void SimulationLoop::ThreadMain()
+    {
+        Clock::duration timeStep = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(m_TimeStep));
+        Clock::time_point due = Clock::now();
+        uint64_t tick = 0;
+
+        std::unique_lock<std::mutex> lock{ m_Mutex };
+        for (;;)
+        {
+            if (m_StopCondition.wait_until(lock, due, [this] { return !m_IsRunning; }))
+            {
+                break;
+            }
+
+            // Past a few ticks of lag, the late ticks are dropped rather than run back-to-back.
+            Clock::time_point start = Clock::now();
+            if (start - due > MaxLagTickCount * timeStep)
+            {
+                uint64_t droppedTickCount = (uint64_t)((start - due) / timeStep);
+                due += droppedTickCount * timeStep;
+                m_Stats.droppedTickCount += droppedTickCount;
+            }
+            double lag = GetMilliseconds(due, start);
+
+            uint32_t state = AcquireFreeState(lock);
+            if (state == NoState)
+            {
+                break;
+            }
+            lock.unlock();
+
+            Clock::time_point stepStart = Clock::now();
+            m_Step(m_Scene, tick * (double)m_TimeStep, m_TimeStep);
+
+            Clock::time_point extractStart = Clock::now();
+            RenderSnapshot & snapshot = m_States[state];
+            snapshot.Extract(m_Scene);
+            snapshot.m_FrameIndex = tick + 1;
+            snapshot.m_Time = snapshot.m_FrameIndex * (double)m_TimeStep;
+            m_Scene.GetChangeJournal().EndFrame();
+            Clock::time_point end = Clock::now();
+
+            lock.lock();
+            m_StateDueTimes[state] = due;
+            m_Order.push_back(state);
+            m_PublishedCount = std::min<uint64_t>(m_PublishedCount + 1, m_Order.size());
+
+            ++m_Stats.tickCount;
+            m_Stats.lag += lag;
+            m_Stats.maxLag = (std::max)(m_Stats.maxLag, lag);
+            m_Stats.stallTime += GetMilliseconds(start, stepStart);
+            m_Stats.stepTime += GetMilliseconds(stepStart, extractStart);
+            m_Stats.extractTime += GetMilliseconds(extractStart, end);
+            m_PublishCondition.notify_all();
+
+            ++tick;
+            due += timeStep;
+        }
+    }
+
+    uint32_t SimulationLoop::AcquireFreeState(std::unique_lock<std::mutex> & lock)
+    {
+        for (;;)
+        {
+            if (!m_IsRunning)
+            {
+                return NoState;
+            }
+
+            // The two latest states stay in the queue, since the renderer may blend them until the next one is
+            // published. The oldest state not pinned by the renderer is taken, to keep the extraction incremental.
+            size_t candidateCount = m_Order.size() - (size_t)(std::min)(m_PublishedCount, (uint64_t)2);
+            for (size_t i = 0; i < candidateCount; ++i)
+            {
+                uint32_t state = m_Order[i];
+                if (m_PinCounts[state] == 0)
+                {
+                    m_Order.erase(m_Order.begin() + i);
+                    m_PublishedCount = (std::min)(m_PublishedCount, (uint64_t)m_Order.size());
+                    return state;
+                }
+            }
+
+            m_ReleaseCondition.wait(lock);
+        }
+    }
+
+    RenderSnapshot const * SimulationLoop::AcquireFrame()
+    {
+        Clock::time_point start = Clock::now();
+        std::unique_lock<std::mutex> lock{ m_Mutex };
+        m_PublishCondition.wait(lock, [this] { return m_PublishedCount != 0 || !m_IsRunning; });
+
+        Clock::time_point now = Clock::now();
+        double waitTime = GetMilliseconds(start, now);
+        ++m_Stats.frameCount;
+        m_Stats.waitTime += waitTime;
+        m_Stats.maxWaitTime = (std::max)(m_Stats.maxWaitTime, waitTime);
+        if (m_PublishedCount == 0)
+        {
+            return nullptr;
+        }
+
+        // The scene is drawn one tick in the past: from the due time of the latest tick to the next one, the frames go
+        // from the previous state to the latest one.
+        uint32_t next = m_Order.back();
+        uint32_t previous = m_PublishedCount >= 2 ? m_Order[m_Order.size() - 2] : next;
+        float alpha = (float)(std::chrono::duration<double>(now - m_StateDueTimes[next]).count() / m_TimeStep);
+        if (alpha >= 1)
+        {
+            alpha = 1;
+            ++m_Stats.lateFrameCount;
+        }
+        alpha = (std::max)(alpha, 0.0f);
+
+        ++m_PinCounts[previous];
+        ++m_PinCounts[next];
+        lock.unlock();
+
+        Clock::time_point interpolateStart = Clock::now();
+        m_Frame.Interpolate(m_States[previous], m_States[next], alpha);
+        double interpolateTime = GetMilliseconds(interpolateStart, Clock::now());
+
+        lock.lock();
+        --m_PinCounts[previous];
+        --m_PinCounts[next];
+        m_Stats.interpolateTime += interpolateTime;
+        lock.unlock();
+        m_ReleaseCondition.notify_one();
+
+        return &m_Frame;
+    }
+
+    SimulationLoop::Stats SimulationLoop::GetStats() const
+    {
+        std::lock_guard<std::mutex> lock{ m_Mutex };
+        return m_Stats;
+    }
+
+    void SimulationLoop::PrintStats() const
+    {
+        Stats stats = GetStats();
+        double ticks = (double)(std::max)(stats.tickCount, (uint64_t)1);
+        double frames = (double)(std::max)(stats.frameCount, (uint64_t)1);
+        StatsRows rows = {
+            { "Time step (ms)", FormatStat(1000.0 * m_TimeStep) },
+            { "Ticks", std::to_string(stats.tickCount) },
+            { "Dropped ticks", std::to_string(stats.droppedTickCount) },
+            { "Average lag (ms)", FormatStat(stats.lag / ticks) },
+            { "Maximum lag (ms)", FormatStat(stats.maxLag) },
+            { "Average step (ms)", FormatStat(stats.stepTime / ticks) },
+            { "Average extraction (ms)", FormatStat(stats.extractTime / ticks) },
+            { "Stalls (ms)", FormatStat(stats.stallTime) },
+            { "Frames", std::to_string(stats.frameCount) },
+            { "Late frames", std::to_string(stats.lateFrameCount) },
+            { "Average render wait (ms)", FormatStat(stats.waitTime / frames) },
+            { "Maximum render wait (ms)", FormatStat(stats.maxWaitTime) },
+            { "Average interpolation (ms)", FormatStat(stats.interpolateTime / frames) },
+        };
+
+        PrintStatsTable("Simulation loop", rows);
+    }
+} // VulkanDemo
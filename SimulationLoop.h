@@ -0,0 +1,129 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "RenderSnapshot.h"
+
+namespace VulkanDemo
+{
+    class Scene;
+
+    ///
+    /// Steps a scene at a fixed rate on its own thread, and hands its states to the render thread, which draws them at
+    /// its own rate.
+    ///
+    /// Tick k runs once the wall clock reaches k time steps after Start(). It calls the step function, extracts the
+    /// state of the scene into a RenderSnapshot and publishes it, then ends the frame of the change journal. The states
+    /// go through a bounded queue: the simulation writes the oldest state that the renderer doesn't hold, and waits
+    /// when there is none.
+    ///
+    /// The renderer draws the scene one time step in the past, blending the two latest states, so that the motion
+    /// stays smooth whatever the two rates. When the simulation falls behind, the latest state is drawn as is. When it
+    /// falls more than MaxLagTickCount ticks behind, the late ticks are dropped, slowing the simulation down instead of
+    /// spiraling.
+    ///
+    /// Usage Notes:
+    /// - Between Start() and Stop(), only the step function may access the scene.
+    /// - AcquireFrame() must be called from a single thread, the render thread.
+    /// - With more states than SceneChangeJournal::HistoryLength - 1, every extraction copies all the objects.
+    ///
+    class SimulationLoop
+    {
+    public:
+        typedef std::function<void(Scene & scene, double time, float timeStep)> StepFunction;
+
+        static const uint32_t MaxLagTickCount = 5;
+
+        struct Stats
+        {
+            uint64_t tickCount = 0;
+            uint64_t droppedTickCount = 0;
+            double stepTime = 0;            // In milliseconds, as the times below, summed over the ticks.
+            double extractTime = 0;
+            double lag = 0;                 // Delay between the scheduled and actual start of the ticks.
+            double maxLag = 0;
+            double stallTime = 0;           // Time the simulation waited for a state that the renderer released.
+
+            uint64_t frameCount = 0;
+            double waitTime = 0;            // Time the render thread waited for the states, summed over the frames.
+            double maxWaitTime = 0;
+            uint64_t lateFrameCount = 0;    // Frames drawing the latest state as is, the next tick being overdue.
+            double interpolateTime = 0;
+        };
+
+        ///
+        /// @param[in] timeStep     Duration of a tick, in seconds.
+        /// @param[in] stateCount   Capacity of the queue of states, at least 3.
+        ///
+        SimulationLoop(Scene & scene, StepFunction step, float timeStep = 1 / 60.0f, uint32_t stateCount = 3);
+        ~SimulationLoop();
+
+        ///
+        /// Starts the simulation thread, which runs the first tick right away.
+        ///
+        void Start();
+
+        ///
+        /// Waits for the current tick to complete and stops the simulation thread.
+        ///
+        void Stop();
+
+        ///
+        /// Returns the state to draw now, blended from the two latest states, waiting for the first tick if needed. The
+        /// snapshot belongs to the render thread and stays valid until the next call. Returns nullptr if the loop is
+        /// stopped before any tick.
+        ///
+        RenderSnapshot const * AcquireFrame();
+
+        inline float GetTimeStep() const { return m_TimeStep; }
+
+        Stats GetStats() const;
+        void PrintStats() const;
+
+    private:
+        SimulationLoop(SimulationLoop const & other) = delete;
+        void operator=(SimulationLoop const & other) = delete;
+
+        typedef std::chrono::steady_clock Clock;
+
+        static const uint32_t NoState = UINT32_MAX;
+
+        void ThreadMain();
+
+        ///
+        /// Removes from the queue the state that the next tick writes, waiting for the renderer to release one if needed.
+        /// Returns NoState if stopped meanwhile.
+        ///
+        uint32_t AcquireFreeState(std::unique_lock<std::mutex> & lock);
+
+        Scene & m_Scene;
+        StepFunction m_Step;
+        float m_TimeStep;
+
+        std::thread m_Thread;
+        bool m_IsRunning = false;
+
+        // Queue of states, from the oldest to the latest in m_Order, the last m_PublishedCount ones holding ticks. The
+        // state being written is out of the queue. The renderer pins the two latest while it blends them.
+        std::unique_ptr<RenderSnapshot[]> m_States;
+        std::vector<Clock::time_point> m_StateDueTimes; // Scheduled time of the tick of every state.
+        std::vector<uint32_t> m_Order;
+        std::vector<uint32_t> m_PinCounts;
+        uint64_t m_PublishedCount = 0;
+        RenderSnapshot m_Frame;
+
+        mutable std::mutex m_Mutex;
+        std::condition_variable m_PublishCondition;
+        std::condition_variable m_ReleaseCondition;
+        std::condition_variable m_StopCondition;
+
+        Stats m_Stats;
+    };
+} // VulkanDemo
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include "Span.h"
+
+namespace VulkanDemo
+{
+    ///
+    /// Generational handle to a value stored in a SlotMap. The tag only prevents mixing up handles of different kinds.
+    /// A handle becomes stale when its value is erased: the slot can be reused, but with a different generation.
+    ///
+    template<typename Tag>
+    struct SlotMapHandle
+    {
+        uint32_t index = UINT32_MAX;
+        uint32_t generation = 0;
+
+        inline bool IsNull() const { return index == UINT32_MAX; }
+
+        inline bool operator==(SlotMapHandle const & other) const { return index == other.index && generation == other.generation; }
+        inline bool operator!=(SlotMapHandle const & other) const { return !(*this == other); }
+    };
+
+    ///
+    /// Container giving O(1) insertion, erasure and lookup through generational handles, while keeping the values
+    /// packed in a dense array for iteration. Erasing a value moves the last value into its place, so the iteration order
+    /// is not stable across erasures.
+    ///
+    template<typename T, typename Tag>
+    class SlotMap
+    {
+    public:
+        typedef SlotMapHandle<Tag> Handle;
+
+        Handle Insert(T const & value)
+        {
+            uint32_t index;
+            if (m_FreeHead != UINT32_MAX)
+            {
+                index = m_FreeHead;
+                m_FreeHead = m_Slots[index].denseOrNextFree;
+            }
+            else
+            {
+                index = (uint32_t)m_Slots.size();
+                m_Slots.push_back(Slot{});
+            }
+
+            m_Slots[index].denseOrNextFree = (uint32_t)m_Values.size();
+            m_Values.push_back(value);
+            m_DenseToSlot.push_back(index);
+
+            Handle handle;
+            handle.index = index;
+            handle.generation = m_Slots[index].generation;
+            return handle;
+        }
+
+        ///
+        /// Returns false if the handle is stale.
+        ///
+        bool Erase(Handle handle)
+        {
+            if (!Contains(handle))
+            {
+                return false;
+            }
+
+            Slot & slot = m_Slots[handle.index];
+            uint32_t dense = slot.denseOrNextFree;
+            uint32_t last = (uint32_t)m_Values.size() - 1;
+            if (dense != last)
+            {
+                m_Values[dense] = m_Values[last];
+                m_DenseToSlot[dense] = m_DenseToSlot[last];
+                m_Slots[m_DenseToSlot[dense]].denseOrNextFree = dense;
+            }
+            m_Values.pop_back();
+            m_DenseToSlot.pop_back();
+
+            ++slot.generation;
+            slot.denseOrNextFree = m_FreeHead;
+            m_FreeHead = handle.index;
+            return true;
+        }
+
+        inline bool Contains(Handle handle) const
+        {
+            return handle.index < m_Slots.size() && m_Slots[handle.index].generation == handle.generation && !IsFree(handle.index);
+        }
+
+        ///
+        /// Returns nullptr if the handle is stale.
+        ///
+        inline T * Get(Handle handle) { return Contains(handle) ? &m_Values[m_Slots[handle.index].denseOrNextFree] : nullptr; }
+        inline T const * Get(Handle handle) const { return Contains(handle) ? &m_Values[m_Slots[handle.index].denseOrNextFree] : nullptr; }
+
+        ///
+        /// Returns the position of the value in the dense array. The handle must be valid.
+        ///
+        inline uint32_t GetDenseIndex(Handle handle) const { assert(Contains(handle)); return m_Slots[handle.index].denseOrNextFree; }
+
+        inline Handle GetHandle(uint32_t dense) const
+        {
+            Handle handle;
+            handle.index = m_DenseToSlot[dense];
+            handle.generation = m_Slots[handle.index].generation;
+            return handle;
+        }
+
+        inline uint32_t size() const { return (uint32_t)m_Values.size(); }
+        inline bool empty() const { return m_Values.empty(); }
+
+        ///
+        /// Upper bound of the slot indices, usable to size arrays indexed by handle.index.
+        ///
+        inline uint32_t GetSlotCount() const { return (uint32_t)m_Slots.size(); }
+
+        inline Span<T const> GetValues() const { return Span<T const>{ m_Values.data(), m_Values.size() }; }
+        inline Span<T> GetValues() { return Span<T>{ m_Values.data(), m_Values.size() }; }
+
+        inline T const * begin() const { return m_Values.data(); }
+        inline T const * end() const { return m_Values.data() + m_Values.size(); }
+
+        void Clear()
+        {
+            for (uint32_t dense = 0; dense < m_DenseToSlot.size(); ++dense)
+            {
+                uint32_t index = m_DenseToSlot[dense];
+                ++m_Slots[index].generation;
+                m_Slots[index].denseOrNextFree = m_FreeHead;
+                m_FreeHead = index;
+            }
+            m_Values.clear();
+            m_DenseToSlot.clear();
+        }
+
+        ///
+        /// Reserves room for count values. The capacity grows geometrically, so that reserving a few more values at a
+        /// time keeps a constant amortized cost.
+        ///
+        void Reserve(uint32_t count)
+        {
+            if (count > m_Values.capacity())
+            {
+                size_t capacity = std::max((size_t)count, 2 * m_Values.capacity());
+                m_Values.reserve(capacity);
+                m_DenseToSlot.reserve(capacity);
+                m_Slots.reserve(capacity);
+            }
+        }
+
+    private:
+        struct Slot
+        {
+            uint32_t denseOrNextFree = UINT32_MAX;
+            uint32_t generation = 0;
+        };
+
+        inline bool IsFree(uint32_t index) const
+        {
+            uint32_t dense = m_Slots[index].denseOrNextFree;
+            return dense >= m_DenseToSlot.size() || m_DenseToSlot[dense] != index;
+        }
+
+        std::vector<T>          m_Values;
+        std::vector<uint32_t>   m_DenseToSlot;
+        std::vector<Slot>       m_Slots;
+        uint32_t                m_FreeHead = UINT32_MAX;
+    };
+} // VulkanDemo
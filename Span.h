@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+
+namespace VulkanDemo
+{
+    ///
+    /// Non-owning view over a contiguous array.
+    ///
+    template<typename T>
+    class Span
+    {
+    public:
+        Span() {}
+        Span(T * data, size_t size) : m_Data{ data }, m_Size{ size } {}
+
+        inline T * data() const { return m_Data; }
+        inline size_t size() const { return m_Size; }
+        inline bool empty() const { return m_Size == 0; }
+
+        inline T * begin() const { return m_Data; }
+        inline T * end() const { return m_Data + m_Size; }
+
+        inline T & operator[](size_t index) const { assert(index < m_Size); return m_Data[index]; }
+
+    private:
+        T * m_Data = nullptr;
+        size_t m_Size = 0;
+    };
+} // VulkanDemo
@@ -0,0 +1,127 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace VulkanDemo
+{
+    ThreadPool::ThreadPool(uint32_t threadCount)
+    {
+        if (threadCount == 0)
+        {
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        for (uint32_t i = 1; i < threadCount; ++i)
+        {
+            m_Workers.emplace_back(&ThreadPool::WorkerMain, this);
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock{ m_Mutex };
+            m_Exit = true;
+        }
+        m_WakeCondition.notify_all();
+
+        for (auto & worker : m_Workers)
+        {
+            worker.join();
+        }
+    }
+
+    void ThreadPool::ParallelFor(uint32_t count, uint32_t granularity, std::function<void(uint32_t begin, uint32_t end)> const & function)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+
+        granularity = std::max(1u, granularity);
+        if (m_Workers.empty() || count <= granularity)
+        {
+            function(0, count);
+            return;
+        }
+
+        // A few chunks per thread balance the load without making the chunks too small.
+        uint32_t chunkCount = GetThreadCount() * 4;
+        uint32_t chunkSize = (count + chunkCount - 1) / chunkCount;
+        chunkSize = (chunkSize + granularity - 1) / granularity * granularity;
+
+        Loop loop;
+        loop.function = &function;
+        loop.count = count;
+        loop.chunkSize = chunkSize;
+        loop.chunkCount = (count + chunkSize - 1) / chunkSize;
+        {
+            std::lock_guard<std::mutex> lock{ m_Mutex };
+            m_Loops.push_back(&loop);
+        }
+        m_WakeCondition.notify_all();
+
+        RunChunks(loop);
+
+        // Every chunk is taken, so no other worker joins the loop, but some may still be running their last chunk.
+        std::unique_lock<std::mutex> lock{ m_Mutex };
+        m_Loops.erase(std::find(m_Loops.begin(), m_Loops.end(), &loop));
+        m_DoneCondition.wait(lock, [&loop]() { return loop.busyWorkers == 0; });
+    }
+
+    ThreadPool & ThreadPool::GetDefault()
+    {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    void ThreadPool::WorkerMain()
+    {
+        std::unique_lock<std::mutex> lock{ m_Mutex };
+        for (;;)
+        {
+            Loop * loop = nullptr;
+            m_WakeCondition.wait(lock, [this, &loop]() { return m_Exit || (loop = FindPendingLoop()) != nullptr; });
+            if (m_Exit)
+            {
+                return;
+            }
+
+            // The calling thread waits for the busy workers before the loop leaves its stack.
+            ++loop->busyWorkers;
+            lock.unlock();
+            RunChunks(*loop);
+            lock.lock();
+            if (--loop->busyWorkers == 0)
+            {
+                m_DoneCondition.notify_all();
+            }
+        }
+    }
+
+    void ThreadPool::RunChunks(Loop & loop)
+    {
+        for (;;)
+        {
+            uint32_t chunk = loop.nextChunk.fetch_add(1);
+            if (chunk >= loop.chunkCount)
+            {
+                return;
+            }
+            uint32_t begin = chunk * loop.chunkSize;
+            (*loop.function)(begin, std::min(begin + loop.chunkSize, loop.count));
+        }
+    }
+
+    ThreadPool::Loop * ThreadPool::FindPendingLoop() const
+    {
+        for (Loop * loop : m_Loops)
+        {
+            if (loop->nextChunk.load() < loop->chunkCount)
+            {
+                return loop;
+            }
+        }
+        return nullptr;
+    }
+} // VulkanDemo
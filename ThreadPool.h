@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace VulkanDemo
+{
+    ///
+    /// Fixed set of worker threads used to run data-parallel loops.
+    ///
+    /// Usage Notes:
+    /// - ParallelFor() must not be called from inside a function run by ParallelFor(). It may be called from several
+    ///   threads at once, such as the simulation and render threads. The workers then share the loops, each worker
+    ///   taking the chunks of the oldest loop that has some left.
+    /// - The calling thread takes part in the work, so a pool created with a thread count of 1 has no worker thread and
+    ///   runs everything inline.
+    ///
+    class ThreadPool
+    {
+    public:
+        ///
+        /// @param[in] threadCount  Total number of threads running the loops, including the calling thread. Assign 0 to
+        ///                         use the number of hardware threads.
+        ///
+        explicit ThreadPool(uint32_t threadCount = 0);
+        ~ThreadPool();
+
+        inline uint32_t GetThreadCount() const { return (uint32_t)m_Workers.size() + 1; }
+
+        ///
+        /// Calls function(begin, end) on contiguous ranges covering [0, count) and returns once all of them are done.
+        /// The ranges start on multiples of the granularity, which should cover at least a cache line of the data
+        /// written by the function.
+        ///
+        void ParallelFor(uint32_t count, uint32_t granularity, std::function<void(uint32_t begin, uint32_t end)> const & function);
+
+        ///
+        /// Pool shared by the engine systems, using all the hardware threads.
+        ///
+        static ThreadPool & GetDefault();
+
+    private:
+        ThreadPool(ThreadPool const & other) = delete;
+        void operator=(ThreadPool const & other) = delete;
+
+        ///
+        /// Loop being run, owned by the stack of its calling thread.
+        ///
+        struct Loop
+        {
+            std::function<void(uint32_t, uint32_t)> const * function;
+            uint32_t                count;
+            uint32_t                chunkSize;
+            uint32_t                chunkCount;
+            std::atomic<uint32_t>   nextChunk{ 0 };
+            uint32_t                busyWorkers = 0;    // Protected by m_Mutex.
+        };
+
+        void WorkerMain();
+        static void RunChunks(Loop & loop);
+
+        ///
+        /// Returns the oldest loop with chunks left, or nullptr. Must be called with m_Mutex locked.
+        ///
+        Loop * FindPendingLoop() const;
+
+        std::vector<std::thread>    m_Workers;
+
+        std::mutex                  m_Mutex;
+        std::condition_variable     m_WakeCondition;
+        std::condition_variable     m_DoneCondition;
+        std::vector<Loop *>         m_Loops;    // In start order.
+        bool                        m_Exit = false;
+    };
+} // VulkanDemo
@@ -3,16 +3,172 @@
 #include <cassert>
 #include <algorithm>
 
+#include "GameObject.h"
+#include "MatrixKernels.h"
+#include "Scene.h"
+
 namespace VulkanDemo
 {
     Transform::Transform() :
-        m_LocalPosition{ 0, 0, 0 },
-        m_LocalRotation{ 1, 0, 0, 0 },
-        m_LocalScale{ 1, 1, 1 }
+        Component{ TypeId },
+        m_Store{ &TransformStore::GetDetachedStore() },
+        m_StoreHandle{ TransformStore::InvalidHandle }
     {
+        m_StoreHandle = m_Store->Allocate(this);
+    }
+
+    Transform::Transform(TransformStore & store, TransformStore::Handle handle) :
+        Component{ TypeId },
+        m_Store{ &store },
+        m_StoreHandle{ handle }
+    {
+    }
+
+    Transform * Transform::CreateBatch(TransformStore & store, uint32_t count, glm::vec3 const * localPositions,
+        glm::quat const * localRotations, glm::vec3 const * localScales)
+    {
+        Transform * transforms = static_cast<Transform *>(GetPool().AllocateContiguous(count));
+
+        // The slots are known before the objects are constructed, which lets the store record its owners up front.
+        std::vector<Transform *> owners(count);
+        std::vector<TransformStore::Handle> handles(count);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            owners[i] = transforms + i;
+        }
+        store.AllocateBulk(count, owners.data(), localPositions, localRotations, localScales, handles.data());
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            ::new (transforms + i) Transform(store, handles[i]);
+        }
+        return transforms;
     }
 
     Transform::~Transform()
     {
+        // Detach while the transform is still complete, so that the GameObject can move it out of its scene store.
+        if (GetGameObject() != nullptr)
+        {
+            GetGameObject()->RemoveComponent(*this);
+        }
+
+        m_Store->Free(m_StoreHandle);
+        m_StoreHandle = TransformStore::InvalidHandle;
+        m_Store = nullptr;
+    }
+
+    glm::mat4 const & Transform::GetLocalToWorldMatrix() const
+    {
+        if (!IsLocalToWorldDirty())
+        {
+            return m_Store->GetLocalToWorldMatrix(m_StoreHandle);
+        }
+
+        // Collect the outdated ancestors. Because of the invariant, they form a contiguous chain starting from this
+        // transform, and the first up-to-date ancestor (if any) can be used as is.
+        static thread_local std::vector<Transform const *> chain;
+        chain.clear();
+
+        Transform const * current = this;
+        while (current != nullptr && current->IsLocalToWorldDirty())
+        {
+            chain.push_back(current);
+            current = current->GetParentTransform();
+        }
+
+        // Recompute from the top-most outdated transform down to this one. A root transform uses its local matrix as
+        // is.
+        bool hasParent = current != nullptr;
+        glm::mat4 matrix = hasParent ? current->m_Store->GetLocalToWorldMatrix(current->m_StoreHandle) : glm::mat4{ 1 };
+        for (auto iter = chain.rbegin(); iter != chain.rend(); ++iter)
+        {
+            Transform const * transform = *iter;
+            glm::mat4 const & localMatrix = transform->m_Store->UpdateLocalMatrix(transform->m_StoreHandle);
+            if (hasParent)
+            {
+                MatrixKernels::Multiply(1, &matrix, &localMatrix, &matrix);
+            }
+            else
+            {
+                matrix = localMatrix;
+            }
+            hasParent = true;
+
+            transform->m_Store->SetLocalToWorldMatrix(transform->m_StoreHandle, matrix);
+            transform->m_Store->ClearFlags(transform->m_StoreHandle, TransformStore::LocalToWorldDirty);
+        }
+
+        return m_Store->GetLocalToWorldMatrix(m_StoreHandle);
+    }
+
+    glm::mat4 const & Transform::GetWorldToLocalMatrix() const
+    {
+        if ((m_Store->GetFlags(m_StoreHandle) & TransformStore::WorldToLocalDirty) != 0)
+        {
+            m_Store->SetWorldToLocalMatrix(m_StoreHandle, glm::inverse(GetLocalToWorldMatrix()));
+            m_Store->ClearFlags(m_StoreHandle, TransformStore::WorldToLocalDirty);
+        }
+        return m_Store->GetWorldToLocalMatrix(m_StoreHandle);
+    }
+
+    Transform * Transform::GetParentTransform() const
+    {
+        GameObject const * gameObject = GetGameObject();
+        if (gameObject == nullptr)
+        {
+            return nullptr;
+        }
+
+        for (GameObject const * parent = gameObject->GetParent(); parent != nullptr; parent = parent->GetParent())
+        {
+            if (parent->GetTransform() != nullptr)
+            {
+                return parent->GetTransform();
+            }
+        }
+        return nullptr;
+    }
+
+    void Transform::MoveToStore(TransformStore & store)
+    {
+        if (&store == m_Store)
+        {
+            return;
+        }
+
+        TransformStore::Handle handle = store.Allocate(this);
+        store.SetLocalPosition(handle, m_Store->GetLocalPosition(m_StoreHandle));
+        store.SetLocalRotation(handle, m_Store->GetLocalRotation(m_StoreHandle));
+        store.SetLocalScale(handle, m_Store->GetLocalScale(m_StoreHandle));
+        store.SetLocalToWorldMatrix(handle, m_Store->GetLocalToWorldMatrix(m_StoreHandle));
+        store.SetWorldToLocalMatrix(handle, m_Store->GetWorldToLocalMatrix(m_StoreHandle));
+        store.ClearFlags(handle, TransformStore::AllDirty);
+        store.SetFlags(handle, m_Store->GetFlags(m_StoreHandle));
+
+        m_Store->Free(m_StoreHandle);
+        m_Store = &store;
+        m_StoreHandle = handle;
+    }
+
+    void Transform::Invalidate()
+    {
+        // An outdated transform whose change is not recorded yet during the current frame must still record it, for
+        // its whole subtree.
+        GameObject * gameObject = GetGameObject();
+        bool isNewChange = gameObject != nullptr && gameObject->RecordChange(SceneChangeJournal::TransformChanged);
+        if (IsLocalToWorldDirty() && !isNewChange)
+        {
+            return;
+        }
+
+        if (gameObject != nullptr && gameObject->GetTransform() == this)
+        {
+            gameObject->InvalidateWorldMatrices();
+        }
+        else
+        {
+            m_Store->SetFlags(m_StoreHandle, TransformStore::AllDirty);
+        }
     }
 } // VulkanDemo
@@ -1,33 +1,92 @@
 #pragma once
 
 #include "Component.h"
+#include "PoolAllocator.h"
+#include "TransformStore.h"
 
 #include <glm/gtc/quaternion.hpp>
 #include <vector>
 
 namespace VulkanDemo
 {
-    class Transform : public Component
+    ///
+    /// The data of the transform is kept in a TransformStore. Transforms that are attached to a GameObject that is part
+    /// of a Scene live in the store of that scene, the others live in the detached store.
+    ///
+    /// The world matrices are computed lazily through the chain of parents of the GameObject and cached. Changing a local
+    /// value or the parent of a GameObject marks the cached matrices of the subtree as outdated. The invariant maintained
+    /// is that when a transform is outdated, the transforms of all its descendants are outdated too.
+    ///
+    class Transform : public Component, public Pooled<Transform>
     {
     public:
+        static constexpr char const * PoolName = "Transform";
+        static const ComponentType::Id TypeId = ComponentType::Transform;
+
         Transform();
         virtual ~Transform();
 
-        inline glm::vec3 const & GetLocalPosition() const { return m_LocalPosition; }
-        inline void SetLocalPosition(glm::vec3 const & localPosition) { m_LocalPosition = localPosition; }
+        using Pooled<Transform>::CreateBatch;
+
+        ///
+        /// Creates count transforms in contiguous slots, with their data allocated in bulk in the given store from
+        /// arrays of local values. The transforms must be attached to GameObjects that end up in the scene owning the
+        /// store.
+        ///
+        static Transform * CreateBatch(TransformStore & store, uint32_t count, glm::vec3 const * localPositions,
+            glm::quat const * localRotations, glm::vec3 const * localScales);
+
+        inline glm::vec3 GetLocalPosition() const { return m_Store->GetLocalPosition(m_StoreHandle); }
+        inline void SetLocalPosition(glm::vec3 const & localPosition) { m_Store->SetLocalPosition(m_StoreHandle, localPosition); Invalidate(); }
+
+        inline glm::quat GetLocalRotation() const { return m_Store->GetLocalRotation(m_StoreHandle); }
+        inline void SetLocalRotation(glm::quat const & localRotation) { m_Store->SetLocalRotation(m_StoreHandle, localRotation); Invalidate(); }
+
+        inline glm::vec3 GetLocalScale() const { return m_Store->GetLocalScale(m_StoreHandle); }
+        inline void SetLocalScale(glm::vec3 const & localScale) { m_Store->SetLocalScale(m_StoreHandle, localScale); Invalidate(); }
+
+        ///
+        /// Returns the matrix transforming from the local space to the world space. Only the outdated transforms of the
+        /// chain of parents are recomputed.
+        ///
+        glm::mat4 const & GetLocalToWorldMatrix() const;
 
-        inline glm::quat const & GetLocalRotation() const { return m_LocalRotation; }
-        inline void SetLocalRotation(glm::quat const & localRotation) { m_LocalRotation = localRotation; }
+        ///
+        /// Returns the inverse of GetLocalToWorldMatrix(), recomputed only if outdated.
+        ///
+        glm::mat4 const & GetWorldToLocalMatrix() const;
 
-        inline glm::vec3 const & GetLocalScale() const { return m_LocalScale; }
-        inline void SetLocalScale(glm::vec3 const & localScale) { m_LocalScale = localScale; }
+        ///
+        /// Returns the transform of the closest ancestor of the GameObject that has one, or nullptr.
+        ///
+        Transform * GetParentTransform() const;
+
+        inline bool IsLocalToWorldDirty() const { return (m_Store->GetFlags(m_StoreHandle) & TransformStore::LocalToWorldDirty) != 0; }
+
+        inline TransformStore * GetStore() const { return m_Store; }
+        inline TransformStore::Handle GetStoreHandle() const { return m_StoreHandle; }
+
+        ///
+        /// Moves the data of the transform to another store. The local values and cached matrices are preserved.
+        ///
+        void MoveToStore(TransformStore & store);
 
     private:
         Transform(Transform const & other) = delete;
         void operator=(Transform const & other) = delete;
 
-        glm::vec3 m_LocalPosition;
-        glm::quat m_LocalRotation;
-        glm::vec3 m_LocalScale;
+        ///
+        /// Adopts an entry already allocated in the store.
+        ///
+        Transform(TransformStore & store, TransformStore::Handle handle);
+
+        ///
+        /// Marks the cached matrices of this transform and its descendants as outdated. Nothing is done if they already
+        /// are.
+        ///
+        void Invalidate();
+
+        TransformStore * m_Store;
+        TransformStore::Handle m_StoreHandle;
     };
 } // VulkanDemo
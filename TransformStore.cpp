@@ -0,0 +1,361 @@
+#include "TransformStore.h"
+
+#include <algorithm>
+#include <cassert>
+#include <type_traits>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "MatrixKernels.h"
+#include "ThreadPool.h"
+#include "Transform.h"
+
+namespace VulkanDemo
+{
+    const TransformStore::Handle TransformStore::InvalidHandle;
+    const uint32_t TransformStore::NoParent;
+    const uint32_t TransformStore::ExternalParentBit;
+    const uint32_t TransformStore::BatchSize;
+
+    TransformStore::TransformStore()
+    {
+    }
+
+    TransformStore::~TransformStore()
+    {
+    }
+
+    TransformStore::Handle TransformStore::Allocate(Transform * owner)
+    {
+        Handle handle;
+        if (!m_FreeHandles.empty())
+        {
+            handle = m_FreeHandles.back();
+            m_FreeHandles.pop_back();
+        }
+        else
+        {
+            handle = (Handle)m_HandleToDense.size();
+            m_HandleToDense.push_back(0);
+        }
+
+        m_HandleToDense[handle] = (uint32_t)m_Owners.size();
+
+        m_LocalPositions.push_back(glm::vec3{ 0, 0, 0 });
+        m_LocalRotations.push_back(glm::quat{ 1, 0, 0, 0 });
+        m_LocalScales.push_back(glm::vec3{ 1, 1, 1 });
+        m_LocalMatrices.push_back(glm::mat4{ 1 });
+        m_LocalToWorldMatrices.push_back(glm::mat4{ 1 });
+        m_WorldToLocalMatrices.push_back(glm::mat4{ 1 });
+        m_Flags.push_back(AllDirty);
+        m_Owners.push_back(owner);
+        m_DenseToHandle.push_back(handle);
+        m_IsHierarchyChanged = true;
+
+        return handle;
+    }
+
+    void TransformStore::AllocateBulk(uint32_t count, Transform * const * owners, glm::vec3 const * localPositions, glm::quat const * localRotations,
+        glm::vec3 const * localScales, Handle * handles)
+    {
+        uint32_t first = GetCount();
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            Handle handle;
+            if (!m_FreeHandles.empty())
+            {
+                handle = m_FreeHandles.back();
+                m_FreeHandles.pop_back();
+            }
+            else
+            {
+                handle = (Handle)m_HandleToDense.size();
+                m_HandleToDense.push_back(0);
+            }
+
+            m_HandleToDense[handle] = first + i;
+            m_DenseToHandle.push_back(handle);
+            handles[i] = handle;
+        }
+
+        // The matrices are recomputed before being read since the entries are outdated, so they are left as they are
+        // resized.
+        m_LocalPositions.insert(m_LocalPositions.end(), localPositions, localPositions + count);
+        m_LocalRotations.insert(m_LocalRotations.end(), localRotations, localRotations + count);
+        m_LocalScales.insert(m_LocalScales.end(), localScales, localScales + count);
+        m_LocalMatrices.resize(first + count);
+        m_LocalToWorldMatrices.resize(first + count);
+        m_WorldToLocalMatrices.resize(first + count);
+        m_Flags.resize(first + count, AllDirty);
+        m_Owners.insert(m_Owners.end(), owners, owners + count);
+        m_IsHierarchyChanged = true;
+    }
+
+    void TransformStore::Free(Handle handle)
+    {
+        assert(handle < m_HandleToDense.size());
+
+        uint32_t dense = m_HandleToDense[handle];
+        uint32_t last = (uint32_t)m_Owners.size() - 1;
+
+        // Move the last entry into the freed slot to keep the arrays packed.
+        if (dense != last)
+        {
+            m_LocalPositions[dense] = m_LocalPositions[last];
+            m_LocalRotations[dense] = m_LocalRotations[last];
+            m_LocalScales[dense] = m_LocalScales[last];
+            m_LocalMatrices[dense] = m_LocalMatrices[last];
+            m_LocalToWorldMatrices[dense] = m_LocalToWorldMatrices[last];
+            m_WorldToLocalMatrices[dense] = m_WorldToLocalMatrices[last];
+            m_Flags[dense] = m_Flags[last];
+            m_Owners[dense] = m_Owners[last];
+            m_DenseToHandle[dense] = m_DenseToHandle[last];
+            m_HandleToDense[m_DenseToHandle[dense]] = dense;
+        }
+
+        m_LocalPositions.pop_back();
+        m_LocalRotations.pop_back();
+        m_LocalScales.pop_back();
+        m_LocalMatrices.pop_back();
+        m_LocalToWorldMatrices.pop_back();
+        m_WorldToLocalMatrices.pop_back();
+        m_Flags.pop_back();
+        m_Owners.pop_back();
+        m_DenseToHandle.pop_back();
+
+        m_HandleToDense[handle] = UINT32_MAX;
+        m_FreeHandles.push_back(handle);
+        m_IsHierarchyChanged = true;
+    }
+
+    glm::mat4 const & TransformStore::UpdateLocalMatrix(Handle handle)
+    {
+        uint32_t dense = GetDenseIndex(handle);
+        MatrixKernels::ComposeTrs(1, &m_LocalPositions[dense], &m_LocalRotations[dense], &m_LocalScales[dense], &m_LocalMatrices[dense]);
+        return m_LocalMatrices[dense];
+    }
+
+    void TransformStore::UpdateLocalMatrices()
+    {
+        MatrixKernels::ComposeTrs(GetCount(), m_LocalPositions.data(), m_LocalRotations.data(), m_LocalScales.data(), m_LocalMatrices.data());
+    }
+
+    void TransformStore::UpdateWorldMatrices(ThreadPool & threadPool)
+    {
+        if (m_IsHierarchyChanged)
+        {
+            SortByHierarchyLevel();
+        }
+
+        // Parents from other stores are resolved up front, so that the parallel part only reads from this store.
+        for (size_t i = 0; i < m_ExternalParents.size(); ++i)
+        {
+            m_ExternalParentMatrices[i] = m_ExternalParents[i]->GetLocalToWorldMatrix();
+        }
+
+        // The levels are split on multiples of BatchSize in the whole arrays, clamped to the bounds of the level, so
+        // that every chunk starts on a cache line of the matrices and the flags whichever offset the level has, and no
+        // two threads write to the same line.
+        for (size_t level = 0; level + 1 < m_LevelOffsets.size(); ++level)
+        {
+            uint32_t levelBegin = m_LevelOffsets[level];
+            uint32_t levelEnd = m_LevelOffsets[level + 1];
+            if (levelBegin == levelEnd)
+            {
+                continue;
+            }
+
+            uint32_t firstChunk = levelBegin / BatchSize;
+            uint32_t chunkCount = (levelEnd + BatchSize - 1) / BatchSize - firstChunk;
+            threadPool.ParallelFor(chunkCount, 1, [this, levelBegin, levelEnd, firstChunk, level](uint32_t beginChunk, uint32_t endChunk) {
+                uint32_t begin = std::max(levelBegin, (firstChunk + beginChunk) * BatchSize);
+                uint32_t end = std::min(levelEnd, (firstChunk + endChunk) * BatchSize);
+                if (level == 0)
+                {
+                    UpdateRootWorldMatrices(begin, end);
+                }
+                else
+                {
+                    UpdateChildWorldMatrices(begin, end);
+                }
+            });
+        }
+    }
+
+    void TransformStore::UpdateRootWorldMatrices(uint32_t begin, uint32_t end)
+    {
+        for (uint32_t dense = begin; dense < end; ++dense)
+        {
+            uint8_t flags = m_Flags[dense];
+            if ((flags & LocalToWorldDirty) == 0)
+            {
+                continue;
+            }
+
+            MatrixKernels::ComposeTrs(1, &m_LocalPositions[dense], &m_LocalRotations[dense], &m_LocalScales[dense], &m_LocalMatrices[dense]);
+
+            uint32_t parent = m_Parents[dense];
+            if (parent == NoParent)
+            {
+                m_LocalToWorldMatrices[dense] = m_LocalMatrices[dense];
+            }
+            else
+            {
+                assert((parent & ExternalParentBit) != 0);
+                MatrixKernels::Multiply(1, &m_ExternalParentMatrices[parent & ~ExternalParentBit], &m_LocalMatrices[dense], &m_LocalToWorldMatrices[dense]);
+            }
+
+            m_Flags[dense] = flags & ~LocalToWorldDirty;
+        }
+    }
+
+    void TransformStore::UpdateChildWorldMatrices(uint32_t begin, uint32_t end)
+    {
+        glm::mat4 parentMatrices[BatchSize];
+
+        uint32_t dense = begin;
+        while (dense < end)
+        {
+            if ((m_Flags[dense] & LocalToWorldDirty) == 0)
+            {
+                ++dense;
+                continue;
+            }
+
+            // Process the run of consecutive outdated entries with the batch kernels.
+            uint32_t runBegin = dense;
+            while (dense < end && dense - runBegin < BatchSize && (m_Flags[dense] & LocalToWorldDirty) != 0)
+            {
+                parentMatrices[dense - runBegin] = m_LocalToWorldMatrices[m_Parents[dense]];
+                ++dense;
+            }
+            uint32_t runCount = dense - runBegin;
+
+            MatrixKernels::ComposeTrs(runCount, &m_LocalPositions[runBegin], &m_LocalRotations[runBegin], &m_LocalScales[runBegin], &m_LocalMatrices[runBegin]);
+            MatrixKernels::Multiply(runCount, parentMatrices, &m_LocalMatrices[runBegin], &m_LocalToWorldMatrices[runBegin]);
+
+            for (uint32_t i = runBegin; i < dense; ++i)
+            {
+                m_Flags[i] &= ~LocalToWorldDirty;
+            }
+        }
+    }
+
+    void TransformStore::SortByHierarchyLevel()
+    {
+        uint32_t count = GetCount();
+
+        // Find the parents, using the current dense indices.
+        std::vector<uint32_t> parents(count, NoParent);
+        m_ExternalParents.clear();
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            Transform * parent = m_Owners[i] != nullptr ? m_Owners[i]->GetParentTransform() : nullptr;
+            if (parent == nullptr)
+            {
+                continue;
+            }
+
+            if (parent->GetStore() == this)
+            {
+                parents[i] = GetDenseIndex(parent->GetStoreHandle());
+            }
+            else
+            {
+                parents[i] = (uint32_t)m_ExternalParents.size() | ExternalParentBit;
+                m_ExternalParents.push_back(parent);
+            }
+        }
+        m_ExternalParentMatrices.resize(m_ExternalParents.size());
+
+        // Compute the depths, walking up until an entry whose depth is known.
+        static const uint32_t UnknownDepth = UINT32_MAX;
+        std::vector<uint32_t> depths(count, UnknownDepth);
+        std::vector<uint32_t> chain;
+        uint32_t maxDepth = 0;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            uint32_t current = i;
+            while (depths[current] == UnknownDepth)
+            {
+                uint32_t parent = parents[current];
+                if (parent == NoParent || (parent & ExternalParentBit) != 0)
+                {
+                    depths[current] = 0;
+                    break;
+                }
+                chain.push_back(current);
+                current = parent;
+            }
+
+            uint32_t depth = depths[current];
+            while (!chain.empty())
+            {
+                depths[chain.back()] = ++depth;
+                chain.pop_back();
+            }
+            maxDepth = std::max(maxDepth, depth);
+        }
+
+        // Counting sort by depth, stable to keep the existing order within a level.
+        m_LevelOffsets.assign(maxDepth + 2, 0);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            ++m_LevelOffsets[depths[i] + 1];
+        }
+        for (uint32_t level = 1; level < m_LevelOffsets.size(); ++level)
+        {
+            m_LevelOffsets[level] += m_LevelOffsets[level - 1];
+        }
+
+        std::vector<uint32_t> oldToNew(count);
+        std::vector<uint32_t> newToOld(count);
+        {
+            std::vector<uint32_t> cursors(m_LevelOffsets.begin(), m_LevelOffsets.end() - 1);
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                uint32_t position = cursors[depths[i]]++;
+                oldToNew[i] = position;
+                newToOld[position] = i;
+            }
+        }
+
+        // Apply the permutation to every dense array. The capacity is preserved, so that the entries added after a
+        // sort don't reallocate the arrays.
+        auto permute = [&newToOld, count](auto & values) {
+            typename std::remove_reference<decltype(values)>::type sorted;
+            sorted.reserve(values.capacity());
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                sorted.push_back(values[newToOld[i]]);
+            }
+            values.swap(sorted);
+        };
+        permute(m_LocalPositions);
+        permute(m_LocalRotations);
+        permute(m_LocalScales);
+        permute(m_LocalMatrices);
+        permute(m_LocalToWorldMatrices);
+        permute(m_WorldToLocalMatrices);
+        permute(m_Flags);
+        permute(m_Owners);
+        permute(m_DenseToHandle);
+
+        m_Parents.resize(count);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            uint32_t parent = parents[newToOld[i]];
+            bool isInternal = parent != NoParent && (parent & ExternalParentBit) == 0;
+            m_Parents[i] = isInternal ? oldToNew[parent] : parent;
+            m_HandleToDense[m_DenseToHandle[i]] = i;
+        }
+
+        m_IsHierarchyChanged = false;
+    }
+
+    TransformStore & TransformStore::GetDetachedStore()
+    {
+        static TransformStore store;
+        return store;
+    }
+} // VulkanDemo
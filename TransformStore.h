@@ -0,0 +1,170 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "AlignedAllocator.h"
+
+namespace VulkanDemo
+{
+    class ThreadPool;
+    class Transform;
+
+    ///
+    /// Structure-of-arrays storage for the data of Transform components.
+    ///
+    /// Every attribute lives in its own densely packed array so that passes touching all the transforms stream linearly
+    /// through memory instead of chasing a pointer per object. Transforms are identified by stable handles which are
+    /// translated into dense indices. Freeing a transform moves the last entry into the freed dense slot, so dense
+    /// indices are only valid until the next call to Free().
+    ///
+    /// The store also caches the local, local-to-world and world-to-local matrices. Flags track which cached values are
+    /// outdated; the Transform component is in charge of keeping them consistent with the hierarchy.
+    ///
+    /// UpdateWorldMatrices() recomputes all the outdated world matrices at once. For that purpose, the dense arrays are
+    /// kept sorted by depth in the hierarchy, which makes every level a contiguous range whose parents are all in the
+    /// previous levels.
+    ///
+    class TransformStore
+    {
+    public:
+        typedef uint32_t Handle;
+        static const Handle InvalidHandle = UINT32_MAX;
+
+        enum Flags : uint8_t
+        {
+            LocalToWorldDirty = 1 << 0,
+            WorldToLocalDirty = 1 << 1,
+            AllDirty = LocalToWorldDirty | WorldToLocalDirty,
+        };
+
+        TransformStore();
+        ~TransformStore();
+
+        ///
+        /// Allocates an entry initialized to the identity transform.
+        ///
+        Handle Allocate(Transform * owner);
+        void Free(Handle handle);
+
+        ///
+        /// Allocates count entries at once, with one copy per array of local values. The handles are written to the
+        /// output array, and the matrices of the new entries are outdated.
+        ///
+        void AllocateBulk(uint32_t count, Transform * const * owners, glm::vec3 const * localPositions, glm::quat const * localRotations,
+            glm::vec3 const * localScales, Handle * handles);
+
+        inline uint32_t GetDenseIndex(Handle handle) const { return m_HandleToDense[handle]; }
+        inline uint32_t GetCount() const { return (uint32_t)m_Owners.size(); }
+
+        inline glm::vec3 GetLocalPosition(Handle handle) const { return m_LocalPositions[GetDenseIndex(handle)]; }
+        inline void SetLocalPosition(Handle handle, glm::vec3 const & localPosition) { m_LocalPositions[GetDenseIndex(handle)] = localPosition; }
+
+        inline glm::quat GetLocalRotation(Handle handle) const { return m_LocalRotations[GetDenseIndex(handle)]; }
+        inline void SetLocalRotation(Handle handle, glm::quat const & localRotation) { m_LocalRotations[GetDenseIndex(handle)] = localRotation; }
+
+        inline glm::vec3 GetLocalScale(Handle handle) const { return m_LocalScales[GetDenseIndex(handle)]; }
+        inline void SetLocalScale(Handle handle, glm::vec3 const & localScale) { m_LocalScales[GetDenseIndex(handle)] = localScale; }
+
+        inline glm::mat4 const & GetLocalMatrix(Handle handle) const { return m_LocalMatrices[GetDenseIndex(handle)]; }
+
+        ///
+        /// Recomputes the local matrix from the local position, rotation and scale, and returns it.
+        ///
+        glm::mat4 const & UpdateLocalMatrix(Handle handle);
+
+        inline glm::mat4 const & GetLocalToWorldMatrix(Handle handle) const { return m_LocalToWorldMatrices[GetDenseIndex(handle)]; }
+        inline void SetLocalToWorldMatrix(Handle handle, glm::mat4 const & matrix) { m_LocalToWorldMatrices[GetDenseIndex(handle)] = matrix; }
+
+        inline glm::mat4 const & GetWorldToLocalMatrix(Handle handle) const { return m_WorldToLocalMatrices[GetDenseIndex(handle)]; }
+        inline void SetWorldToLocalMatrix(Handle handle, glm::mat4 const & matrix) { m_WorldToLocalMatrices[GetDenseIndex(handle)] = matrix; }
+
+        inline uint8_t GetFlags(Handle handle) const { return m_Flags[GetDenseIndex(handle)]; }
+        inline void SetFlags(Handle handle, uint8_t flags) { m_Flags[GetDenseIndex(handle)] |= flags; }
+        inline void ClearFlags(Handle handle, uint8_t flags) { m_Flags[GetDenseIndex(handle)] &= ~flags; }
+
+        ///
+        /// Direct access to the dense arrays, indexed from 0 to GetCount() - 1.
+        ///
+        inline glm::vec3 const * GetLocalPositions() const { return m_LocalPositions.data(); }
+        inline glm::quat const * GetLocalRotations() const { return m_LocalRotations.data(); }
+        inline glm::vec3 const * GetLocalScales() const { return m_LocalScales.data(); }
+        inline glm::mat4 const * GetLocalMatrices() const { return m_LocalMatrices.data(); }
+        inline glm::mat4 const * GetLocalToWorldMatrices() const { return m_LocalToWorldMatrices.data(); }
+        inline uint8_t const * GetFlags() const { return m_Flags.data(); }
+        inline Transform * const * GetOwners() const { return m_Owners.data(); }
+
+        ///
+        /// Must be called when the parent of a transform of the store may have changed.
+        ///
+        inline void MarkHierarchyChanged() { m_IsHierarchyChanged = true; }
+
+        ///
+        /// Recomputes the outdated local-to-world matrices level by level, each level being split across the threads
+        /// of the pool. The results are identical to the ones of Transform::GetLocalToWorldMatrix().
+        ///
+        void UpdateWorldMatrices(ThreadPool & threadPool);
+
+        ///
+        /// Recomputes the local matrix of every transform in a single linear pass over the dense arrays.
+        ///
+        void UpdateLocalMatrices();
+
+        ///
+        /// Store used by the transforms that are not part of a scene.
+        ///
+        static TransformStore & GetDetachedStore();
+
+    private:
+        TransformStore(TransformStore const & other) = delete;
+        void operator=(TransformStore const & other) = delete;
+
+        static const uint32_t NoParent = UINT32_MAX;
+        static const uint32_t ExternalParentBit = 0x80000000;
+
+        // Entries per parallel chunk and per kernel batch. The chunks start on multiples of BatchSize of the dense
+        // indices, so in the 64 byte aligned arrays they start on a cache line of the flags and of the matrices.
+        static const uint32_t BatchSize = 64;
+
+        ///
+        /// Sorts the dense arrays by depth in the hierarchy and computes the parent of every entry.
+        ///
+        void SortByHierarchyLevel();
+
+        ///
+        /// Updates the outdated entries of the first level, whose parents are either absent or in another store.
+        ///
+        void UpdateRootWorldMatrices(uint32_t begin, uint32_t end);
+
+        ///
+        /// Updates the outdated entries of a level whose parents are all in this store.
+        ///
+        void UpdateChildWorldMatrices(uint32_t begin, uint32_t end);
+
+        // Dense arrays, all of the same size.
+        std::vector<glm::vec3>      m_LocalPositions;
+        std::vector<glm::quat>      m_LocalRotations;
+        std::vector<glm::vec3>      m_LocalScales;
+        AlignedVector<glm::mat4>    m_LocalMatrices;
+        AlignedVector<glm::mat4>    m_LocalToWorldMatrices;
+        std::vector<glm::mat4>      m_WorldToLocalMatrices;
+        AlignedVector<uint8_t>      m_Flags;
+        std::vector<Transform *>    m_Owners;
+        std::vector<Handle>         m_DenseToHandle;
+
+        // Hierarchy, valid when m_IsHierarchyChanged is false. m_Parents contains a dense index, NoParent, or an index
+        // in m_ExternalParents tagged with ExternalParentBit for parents living in another store.
+        bool                        m_IsHierarchyChanged = true;
+        std::vector<uint32_t>       m_Parents;
+        std::vector<uint32_t>       m_LevelOffsets;
+        std::vector<Transform *>    m_ExternalParents;
+        std::vector<glm::mat4>      m_ExternalParentMatrices;
+
+        // Indirection from the handles to the dense arrays.
+        std::vector<uint32_t>       m_HandleToDense;
+        std::vector<Handle>         m_FreeHandles;
+    };
+} // VulkanDemo
@@ -127,6 +127,13 @@ namespace VulkanDemo
         graphicsQueueCreateInfo.queueCount = (uint32_t)queuePriorities.size();
         graphicsQueueCreateInfo.pQueuePriorities = queuePriorities.data();
 
+        // The indirect draws use several draws per call and the first instance of the draws, when supported.
+        VkPhysicalDeviceFeatures supportedFeatures;
+        vkGetPhysicalDeviceFeatures(m_PhysicalDevice, &supportedFeatures);
+        m_EnabledFeatures = {};
+        m_EnabledFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+        m_EnabledFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+
         VkDeviceCreateInfo deviceCreateInfo{};
         deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
         deviceCreateInfo.pNext = NULL;
@@ -134,7 +141,7 @@ namespace VulkanDemo
         deviceCreateInfo.pQueueCreateInfos = &graphicsQueueCreateInfo;
         deviceCreateInfo.enabledExtensionCount = (uint32_t)m_UsedDeviceExtensionNames.size();
         deviceCreateInfo.ppEnabledExtensionNames = m_UsedDeviceExtensionNames.data();
-        deviceCreateInfo.pEnabledFeatures = NULL;
+        deviceCreateInfo.pEnabledFeatures = &m_EnabledFeatures;
 
         CheckResult(vkCreateDevice(m_PhysicalDevice, &deviceCreateInfo, NULL, &m_Device));
 
@@ -186,11 +193,13 @@ namespace VulkanDemo
 
     void VulkanManager::CreateDescriptorPools()
     {
-        std::array<VkDescriptorPoolSize, 1> poolSizes;
+        std::array<VkDescriptorPoolSize, 2> poolSizes;
 
         // TODO: Make this configurable.
         poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
         poolSizes[0].descriptorCount = 10;
+        poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+        poolSizes[1].descriptorCount = 10;
 
         VkDescriptorPoolCreateInfo descriptorPoolCreateInfo{};
         descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
@@ -24,6 +24,11 @@ namespace VulkanDemo
         
         inline VkDescriptorPool     GetDescriptorPool() const { return m_DescriptorPool; }
 
+        ///
+        /// Optional features of the physical device enabled on the device, when supported.
+        ///
+        inline VkPhysicalDeviceFeatures const & GetEnabledFeatures() const { return m_EnabledFeatures; }
+
     private:
         void CreateInstance();
         void DestroyInstance();
@@ -63,6 +68,7 @@ namespace VulkanDemo
         VkPhysicalDevice        m_PhysicalDevice = NULL;
         VkDevice                m_Device = NULL;
         VmaAllocator           m_Allocator = NULL;
+        VkPhysicalDeviceFeatures m_EnabledFeatures = {};
 
         std::vector<const char*> m_UsedInstanceLayerNames;
         std::vector<const char*> m_UsedInstanceExtensionNames;
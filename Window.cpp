@@ -314,7 +314,7 @@ namespace VulkanDemo
         m_ImageCount = 0;
     }
 
-    void Window::Render()
+    void Window::Render(RenderSnapshot const * snapshot)
     {
         m_UIRenderer->BeginNewFrame();
 
@@ -322,7 +322,7 @@ namespace VulkanDemo
         SceneRenderResult renderResult;
 
         SceneRenderInfo renderInfo{};
-        renderInfo.scene = nullptr;
+        renderInfo.snapshot = snapshot;
         renderInfo.width = m_Width;
         renderInfo.height = m_Height;
         renderInfo.waitSemaphore = // TODO: We need a texture-usage book keeping mechanism.
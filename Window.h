@@ -26,7 +26,14 @@ namespace VulkanDemo
         inline int GetHeight() const { return m_Height; }
 
         bool Run();
-        void Render();
+
+        ///
+        /// Draws a state of the scene, which may be null to only draw the UI.
+        ///
+        void Render(RenderSnapshot const * snapshot);
+
+        inline SceneRenderer & GetSceneRenderer() { return m_SceneRenderer; }
+        inline SceneRenderer const & GetSceneRenderer() const { return m_SceneRenderer; }
 
     private:
         class CommandBufferPool
@@ -1,9 +1,23 @@
 #include "Application.h"
+#include "Benchmarks.h"
+
+#include <cstring>
 
 using namespace VulkanDemo;
 
-int main()
+int main(int argc, char ** argv)
 {
+    // Usage: VulkanDemo.exe --benchmark <name>
+    if (argc >= 2 && strcmp(argv[1], "--benchmark") == 0)
+    {
+        if (argc < 3 || !RunBenchmark(argv[2]))
+        {
+            ListBenchmarks();
+            return 1;
+        }
+        return 0;
+    }
+
     Application::GetInstance().MainLoop();
     return 0;
 }
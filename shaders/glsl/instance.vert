@@ -0,0 +1,26 @@
+#version 450 core
+
+// Draws the instances of a batch at their world matrices. The instance buffer is bound from the binding offset of the
+// batch, which the instance indices of its draw command are relative to.
+
+struct Instance
+{
+    mat4 worldMatrix;
+};
+
+layout(location = 0) in vec4 pos;
+
+layout(std430, set = 0, binding = 0) readonly buffer Instances
+{
+    Instance instances[];
+};
+
+layout(push_constant) uniform Parameters
+{
+    mat4 viewProjection;
+} parameters;
+
+void main()
+{
+    gl_Position = parameters.viewProjection * (instances[gl_InstanceIndex].worldMatrix * pos);
+}
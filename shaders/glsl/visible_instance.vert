@@ -0,0 +1,32 @@
+#version 450 core
+
+// Draws the visible instances of a batch culled by cull.comp at their world matrices. Both instance buffers are bound
+// from the binding offset of the batch: the instance indices of its draw command read the visible instances, which
+// are the indices of the instances to draw.
+
+struct Instance
+{
+    mat4 worldMatrix;
+};
+
+layout(location = 0) in vec4 pos;
+
+layout(std430, set = 0, binding = 0) readonly buffer Instances
+{
+    Instance instances[];
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer VisibleInstances
+{
+    uint visibleInstances[];
+};
+
+layout(push_constant) uniform Parameters
+{
+    mat4 viewProjection;
+} parameters;
+
+void main()
+{
+    gl_Position = parameters.viewProjection * (instances[visibleInstances[gl_InstanceIndex]].worldMatrix * pos);
+}